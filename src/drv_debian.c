@@ -49,12 +49,22 @@
 
 #include <libexslt/exslt.h>
 
-#undef NETCF_TRANSACTION
-#define NETCF_TRANSACTION "/bin/false"
-
 static const char *const network_interfaces_path =
     "/files/etc/network/interfaces";
 
+/* The files that ncf_change_begin takes a snapshot of: the interfaces
+ * file, the files it may source, and the modprobe config we add bond
+ * aliases to */
+static const char *const snapshot_interfaces[] = { "interfaces", NULL };
+static const char *const snapshot_all[] = { "", NULL };
+
+static const struct snapshot_files snapshot_files[] = {
+    { "etc/network", snapshot_interfaces },
+    { "etc/network/interfaces.d", snapshot_all },
+    { "etc/modprobe.d", snapshot_all },
+    { NULL, NULL }
+};
+
 /* Augeas should only load the files we are interested in */
 static const struct augeas_pv augeas_xfm_common_pv[] = {
     /* Interfaces files */
@@ -233,6 +243,12 @@ static int all_slaves(struct netcf *ncf, char ***slaves) {
 }
 
 
+/* Is INTF one of the NSLAVES names in SLAVES, which all_slaves returned
+ * and which was sorted with cmpstrp ? */
+static bool in_slaves(const char *intf, int nslaves, char **slaves) {
+    return bsearch(&intf, slaves, nslaves, sizeof(*slaves), cmpstrp) != NULL;
+}
+
 static bool is_slave(struct netcf *ncf, const char *intf) {
     bool r = false;
     char **slaves;
@@ -318,8 +334,8 @@ static int uniq_device_names(struct netcf *ncf,
 }
 
 static int list_interfaces(struct netcf *ncf, char ***intf) {
-    int result = 0, ndevs;
-    char **devs = NULL;
+    int result = 0, ndevs, nslaves = 0;
+    char **devs = NULL, **slaves = NULL;
 
     ndevs = aug_fmt_match(ncf, &devs, "%s/iface", network_interfaces_path);
     ERR_COND_BAIL(ndevs < 0, ncf, EOTHER);
@@ -327,9 +343,15 @@ static int list_interfaces(struct netcf *ncf, char ***intf) {
     result = uniq_device_names(ncf, ndevs, devs, intf);
     ERR_BAIL(ncf);
 
-    /* Filter out the interfaces that are slaves/subordinate */
+    /* Filter out the interfaces that are slaves/subordinate. Collect the
+     * slaves once rather than with is_slave for every interface, which
+     * makes listing quadratic in the number of bridges and bonds */
+    nslaves = all_slaves(ncf, &slaves);
+    ERR_BAIL(ncf);
+    qsort(slaves, nslaves, sizeof(*slaves), cmpstrp);
+
     for (int i = 0; i < result;) {
-        if (is_slave(ncf, (*intf)[i])) {
+        if (in_slaves((*intf)[i], nslaves, slaves)) {
             FREE((*intf)[i]);
             memmove(*intf + i, *intf + i + 1,
                     (result - (i + 1))*sizeof((*intf)[0]));
@@ -339,10 +361,12 @@ static int list_interfaces(struct netcf *ncf, char ***intf) {
         }
     }
 
+    free_matches(nslaves, &slaves);
     free_matches(ndevs, &devs);
     return result;
 
  error:
+    free_matches(result, intf);
     free_matches(ndevs, &devs);
     return -1;
 }
@@ -713,8 +737,8 @@ static int aug_put_xml(struct netcf *ncf, xmlDocPtr xml) {
 }
 
 /* return the current static configuration (as saved on disk) */
-char *drv_xml_desc(struct netcf_if *nif) {
-    char *result = NULL;
+int drv_xml_desc(struct netcf_if *nif, xmlOutputBufferPtr out) {
+    int result = -1;
     struct netcf *ncf;
     xmlDocPtr aug_xml = NULL;
 
@@ -722,7 +746,7 @@ char *drv_xml_desc(struct netcf_if *nif) {
     aug_xml = aug_get_xml(nif);
     ERR_BAIL(ncf);
 
-    result = apply_stylesheet_to_string(ncf, ncf->driver->put, aug_xml);
+    result = apply_stylesheet_to_output(ncf, ncf->driver->put, aug_xml, out);
 
  error:
     xmlFreeDoc(aug_xml);
@@ -732,9 +756,9 @@ char *drv_xml_desc(struct netcf_if *nif) {
 /* return the current live configuration state - a combination of
  * drv_xml_desc + results of querying the interface directly */
 
-char *drv_xml_state(struct netcf_if *nif) {
-    char *result = NULL;
-    int r, result_len;
+int drv_xml_state(struct netcf_if *nif, xmlOutputBufferPtr out) {
+    int result = -1;
+    int r;
     struct netcf *ncf;
     xmlDocPtr ncf_xml = NULL;
     xmlNodePtr root;
@@ -754,17 +778,13 @@ char *drv_xml_state(struct netcf_if *nif) {
     add_state_to_xml_doc(nif, ncf_xml);
     ERR_BAIL(ncf);
 
-    r = xsltSaveResultToString((xmlChar **)&result, &result_len,
-                               ncf_xml, ncf->driver->put);
+    r = xsltSaveResultTo(out, ncf_xml, ncf->driver->put);
     ERR_NOMEM(r < 0, ncf);
+    result = 0;
 
- done:
+ error:
     xmlFreeDoc(ncf_xml);
     return result;
- error:
-    FREE(result);
-    result = 0;
-    goto done;
 }
 
 /* Report various status info about the interface as bits in
@@ -908,33 +928,66 @@ static void bond_setup(struct netcf *ncf, const char *name, bool alias) {
 }
 
 
-struct netcf_if *drv_define(struct netcf *ncf, const char *xml_str) {
-    struct netcf_if *result = NULL;
-    xmlDocPtr ncf_xml = NULL, aug_xml = NULL;
+/* Parse and validate the interface definition XML_STR and transform it
+ * into Augeas XML. Returns the name of the interface and sets NCF_XML and
+ * AUG_XML, or returns NULL on error
+ */
+static char *define_prepare(struct netcf *ncf, const char *xml_str,
+                            unsigned int flags,
+                            xmlDocPtr *ncf_xml, xmlDocPtr *aug_xml) {
     char *name = NULL;
 
-    ncf_xml = parse_xml(ncf, xml_str);
+    *aug_xml = NULL;
+    *ncf_xml = parse_xml(ncf, xml_str);
     ERR_BAIL(ncf);
 
-    rng_validate(ncf, ncf_xml);
+    rng_validate_cached(ncf, *ncf_xml, xml_str, flags);
     ERR_BAIL(ncf);
 
-    name = device_name_from_xml(ncf, ncf_xml);
+    name = device_name_from_xml(ncf, *ncf_xml);
     ERR_COND_BAIL(name == NULL, ncf, EINTERNAL);
     ERR_THROW(strlen(name) >= IFNAMSIZ, ncf, EINTERNAL,
               "The interface name '%s' exceeds the maximum allowed length: %d",
               name, IFNAMSIZ - 1);
 
-    rm_all_interfaces(ncf, ncf_xml);
+    *aug_xml = apply_stylesheet(ncf, ncf->driver->get, *ncf_xml);
     ERR_BAIL(ncf);
 
-    aug_xml = apply_stylesheet(ncf, ncf->driver->get, ncf_xml);
+    return name;
+ error:
+    FREE(name);
+    xmlFreeDoc(*ncf_xml);
+    xmlFreeDoc(*aug_xml);
+    *ncf_xml = NULL;
+    *aug_xml = NULL;
+    return NULL;
+}
+
+/* Replace all interfaces mentioned in NCF_XML with the definition of
+ * interface NAME in AUG_XML in the Augeas tree, without saving */
+static void define_apply(struct netcf *ncf, const char *name,
+                         xmlDocPtr ncf_xml, xmlDocPtr aug_xml) {
+    rm_all_interfaces(ncf, ncf_xml);
     ERR_BAIL(ncf);
 
     aug_put_xml(ncf, aug_xml);
     ERR_BAIL(ncf);
 
     bond_setup(ncf, name, true);
+ error:
+    return;
+}
+
+struct netcf_if *drv_define(struct netcf *ncf, const char *xml_str,
+                            unsigned int flags) {
+    xmlDocPtr ncf_xml = NULL, aug_xml = NULL;
+    char *name = NULL;
+    struct netcf_if *result = NULL;
+
+    name = define_prepare(ncf, xml_str, flags, &ncf_xml, &aug_xml);
+    ERR_BAIL(ncf);
+
+    define_apply(ncf, name, ncf_xml, aug_xml);
     ERR_BAIL(ncf);
 
     aug_save_assert(ncf);
@@ -952,6 +1005,18 @@ struct netcf_if *drv_define(struct netcf *ncf, const char *xml_str) {
     goto done;
 }
 
+int drv_define_many(struct netcf *ncf, int ndocs, const char *const *xmls,
+                    unsigned int flags, struct netcf_if **ifaces,
+                    int *status) {
+    static const struct define_ops ops = {
+        .prepare = define_prepare,
+        .lock = NULL,
+        .apply = define_apply
+    };
+
+    return define_many(ncf, &ops, ndocs, xmls, flags, ifaces, status);
+}
+
 int drv_undefine(struct netcf_if *nif) {
     struct netcf *ncf = nif->ncf;
 
@@ -969,6 +1034,25 @@ int drv_undefine(struct netcf_if *nif) {
     return -1;
 }
 
+int drv_undefine_many(struct netcf *ncf, int nifaces,
+                      struct netcf_if **ifaces) {
+    for (int i=0; i < nifaces; i++) {
+        bond_setup(ncf, ifaces[i]->name, false);
+        ERR_BAIL(ncf);
+
+        rm_interface(ncf, ifaces[i]->name);
+        ERR_BAIL(ncf);
+    }
+
+    aug_save_group(ncf);
+    ERR_BAIL(ncf);
+
+    return 0;
+ error:
+    aug_revert(ncf);
+    return -1;
+}
+
 int drv_lookup_by_mac_string(struct netcf *ncf, const char *mac,
                              int maxifaces, struct netcf_if **ifaces)
 {
@@ -1078,6 +1162,73 @@ int drv_if_down(struct netcf_if *nif) {
     return result;
 }
 
+int drv_if_up_down_names(struct netcf_if *nif, bool up, const char **prog,
+                         char ***names) {
+    /* ifupdown takes care of the ports of a bridge itself */
+    *prog = up ? IFUP : IFDOWN;
+    return if_up_down_names(nif, up, 0, NULL, names);
+}
+
+/* Bring all of IFACES up or down with a single ifup or ifdown, which
+ * handles dependencies between them itself, and work out from its output
+ * which interfaces failed. Interfaces are passed in the order given for
+ * ifup, and in the opposite order for ifdown */
+static int if_up_down_batch(struct netcf *ncf, int nifaces,
+                            struct netcf_if **ifaces, bool up, int *status) {
+    const char **argv = NULL;
+    char *output = NULL;
+    netcf_errcode_t errcode;
+    bool attributed = false;
+    int r, result = -1;
+
+    if (nifaces == 0)
+        return 0;
+
+    r = ALLOC_N(argv, nifaces + 2);
+    ERR_NOMEM(r < 0, ncf);
+    argv[0] = up ? IFUP : IFDOWN;
+    for (int i=0; i < nifaces; i++)
+        argv[i + 1] = ifaces[up ? i : nifaces - 1 - i]->name;
+    argv[nifaces + 1] = NULL;
+
+    run_program(ncf, argv, &output);
+    if (ncf->errcode == NETCF_NOERROR)
+        goto check_active;
+    if (ncf->errcode == NETCF_ENOMEM || output == NULL)
+        goto error;
+
+    /* Blame the interfaces ifupdown complained about, or all of them if
+     * we can't tell */
+    errcode = ncf->errcode;
+    for (int i=0; i < nifaces; i++) {
+        if (if_failed_in_output(output, ifaces[i]->name)) {
+            status[i] = errcode;
+            attributed = true;
+        }
+    }
+    for (int i=0; i < nifaces && !attributed; i++)
+        status[i] = errcode;
+
+ check_active:
+    result = if_check_active(ncf, nifaces, ifaces, up, status);
+
+ error:
+    FREE(output);
+    FREE(argv);
+    return result;
+}
+
+int drv_if_up_many(struct netcf *ncf, int nifaces, struct netcf_if **ifaces,
+                   unsigned int maxjobs ATTRIBUTE_UNUSED, int *status) {
+    return if_up_down_batch(ncf, nifaces, ifaces, true, status);
+}
+
+int drv_if_down_many(struct netcf *ncf, int nifaces,
+                     struct netcf_if **ifaces,
+                     unsigned int maxjobs ATTRIBUTE_UNUSED, int *status) {
+    return if_up_down_batch(ncf, nifaces, ifaces, false, status);
+}
+
 /* Functions to take a snapshot of network config (change_begin), and
  * later either revert to that config (change_rollback), or make the
  * new config permanent (change_commit).
@@ -1088,7 +1239,7 @@ drv_change_begin(struct netcf *ncf, unsigned int flags)
     int result = -1;
 
     ERR_THROW(flags != 0, ncf, EOTHER, "unsupported flags value %d", flags);
-    run1(ncf, NETCF_TRANSACTION, "change-begin");
+    snapshot_begin(ncf, snapshot_files);
     ERR_BAIL(ncf);
     result = 0;
 error:
@@ -1096,12 +1247,14 @@ error:
 }
 
 int
-drv_change_rollback(struct netcf *ncf, unsigned int flags)
+drv_change_rollback(struct netcf *ncf, unsigned int flags,
+                    int maxnames ATTRIBUTE_UNUSED,
+                    char **names ATTRIBUTE_UNUSED)
 {
     int result = -1;
 
     ERR_THROW(flags != 0, ncf, EOTHER, "unsupported flags value %d", flags);
-    run1(ncf, NETCF_TRANSACTION, "change-rollback");
+    snapshot_rollback(ncf, snapshot_files);
     ERR_BAIL(ncf);
     result = 0;
 error:
@@ -1114,7 +1267,7 @@ drv_change_commit(struct netcf *ncf, unsigned int flags)
     int result = -1;
 
     ERR_THROW(flags != 0, ncf, EOTHER, "unsupported flags value %d", flags);
-    run1(ncf, NETCF_TRANSACTION, "change-commit");
+    snapshot_commit(ncf);
     ERR_BAIL(ncf);
     result = 0;
 error:
@@ -1169,12 +1322,16 @@ static int drv_put_aug(struct netcf *ncf, const char *aug_xml, char **ncf_xml) {
  */
 int ncf_get_aug(struct netcf *ncf, const char *ncf_xml, char **aug_xml) {
     API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
 
     return drv_get_aug(ncf, ncf_xml, aug_xml);
 }
 
 int ncf_put_aug(struct netcf *ncf, const char *aug_xml, char **ncf_xml) {
     API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
 
     return drv_put_aug(ncf, aug_xml, ncf_xml);
 }
@@ -250,8 +250,20 @@ int drv_if_up(struct netcf_if *nif) {
     return -1;
 }
 
+int drv_if_up_many(struct netcf *ncf, int nifaces, struct netcf_if **ifaces,
+                   unsigned int maxjobs ATTRIBUTE_UNUSED, int *status) {
+    return if_up_down_each(ncf, nifaces, ifaces, true, status);
+}
+
+int drv_if_down_many(struct netcf *ncf, int nifaces,
+                     struct netcf_if **ifaces,
+                     unsigned int maxjobs ATTRIBUTE_UNUSED, int *status) {
+    return if_up_down_each(ncf, nifaces, ifaces, false, status);
+}
 
-struct netcf_if *drv_define(struct netcf *ncf, const char *xml_str ATTRIBUTE_UNUSED) {
+
+struct netcf_if *drv_define(struct netcf *ncf, const char *xml_str ATTRIBUTE_UNUSED,
+                            unsigned int flags ATTRIBUTE_UNUSED) {
     struct netcf_if *result = NULL;
 
     ERR_THROW(1 == 1, ncf, EOTHER, "not implemented on this platform");
@@ -260,6 +272,19 @@ error:
     return result;
 }
 
+int drv_define_many(struct netcf *ncf, int ndocs ATTRIBUTE_UNUSED,
+                    const char *const *xmls ATTRIBUTE_UNUSED,
+                    unsigned int flags ATTRIBUTE_UNUSED,
+                    struct netcf_if **ifaces ATTRIBUTE_UNUSED,
+                    int *status ATTRIBUTE_UNUSED) {
+    int result = -1;
+
+    ERR_THROW(1 == 1, ncf, EOTHER, "not implemented on this platform");
+
+error:
+    return result;
+}
+
 int drv_undefine(struct netcf_if *nif) {
     int result = -1;
 
@@ -269,9 +294,20 @@ error:
     return result;
 }
 
+int drv_undefine_many(struct netcf *ncf, int nifaces ATTRIBUTE_UNUSED,
+                      struct netcf_if **ifaces ATTRIBUTE_UNUSED) {
+    int result = -1;
+
+    ERR_THROW(1 == 1, ncf, EOTHER, "not implemented on this platform");
+    result = 0;
+error:
+    return result;
+}
 
-char *drv_xml_desc(struct netcf_if *nif) {
-    char *result = NULL;
+
+int drv_xml_desc(struct netcf_if *nif,
+                 xmlOutputBufferPtr out ATTRIBUTE_UNUSED) {
+    int result = -1;
 
     ERR_THROW(1 == 1, nif->ncf, EOTHER, "not implemented on this platform");
 
@@ -279,8 +315,9 @@ error:
     return result;
 }
 
-char *drv_xml_state(struct netcf_if *nif) {
-    char *result = NULL;
+int drv_xml_state(struct netcf_if *nif,
+                  xmlOutputBufferPtr out ATTRIBUTE_UNUSED) {
+    int result = -1;
 
     ERR_THROW(1 == 1, nif->ncf, EOTHER, "not implemented on this platform");
 
@@ -322,7 +359,9 @@ error:
 }
 
 int
-drv_change_rollback(struct netcf *ncf, unsigned int flags ATTRIBUTE_UNUSED)
+drv_change_rollback(struct netcf *ncf, unsigned int flags ATTRIBUTE_UNUSED,
+                    int maxnames ATTRIBUTE_UNUSED,
+                    char **names ATTRIBUTE_UNUSED)
 {
     int result = -1;
 
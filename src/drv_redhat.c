@@ -56,6 +56,21 @@ static const char *const network_scripts_path =
 static const char *const ifcfg_path =
     "/files/etc/sysconfig/network-scripts/*";
 
+/* Where modprobed_alias_bond puts new aliases */
+static const char *const modprobed_netcf_path =
+    "/files/etc/modprobe.d/netcf.conf";
+
+/* The files that ncf_change_begin takes a snapshot of; this has to match
+ * what netcf-transaction.sh does at boot */
+static const char *const snapshot_prefixes[] = {
+    "ifcfg-", "route-", "rule-", NULL
+};
+
+static const struct snapshot_files snapshot_files[] = {
+    { "etc/sysconfig/network-scripts", snapshot_prefixes },
+    { NULL, NULL }
+};
+
 /* Augeas should only load the files we are interested in */
 static const struct augeas_pv augeas_xfm_common_pv[] = {
     /* Ifcfg files */
@@ -413,6 +428,7 @@ void drv_close(struct netcf *ncf) {
     netlink_close(ncf);
     if (ncf->driver->ioctl_fd >= 0)
         close(ncf->driver->ioctl_fd);
+    lock_files_free(ncf);
     aug_close(ncf->driver->augeas);
     FREE(ncf->driver->augeas_xfm_tables);
     FREE(ncf->driver);
@@ -555,13 +571,102 @@ static xmlDocPtr aug_get_xml(struct netcf *ncf, int nint, char **intf) {
     return NULL;
 }
 
+/* Return true if LABEL is the label of a comment in the Augeas tree */
+static bool is_comment_label(const char *label) {
+    return STREQLEN(label, "#comment", strlen("#comment"));
+}
+
+/* Bring the file at PATH in the Augeas tree in line with the nodes of
+ * TREE, changing as little as possible, so that files whose contents do
+ * not change are not written by aug_save.
+ *
+ * If the file already has the same entries in the same order, ignoring
+ * comments, only the values that differ are changed; otherwise, the file
+ * is cleared out entirely and filled from TREE */
+static void aug_put_tree(struct netcf *ncf, augeas *aug, const char *path,
+                         xmlNodePtr tree) {
+    char **matches = NULL, **children = NULL;
+    char *label = NULL, *value = NULL, *lpath = NULL;
+    int nmatches = 0, nchildren = 0, r;
+    bool same_labels = true;
+
+    r = xasprintf(&lpath, "%s/*", path);
+    ERR_NOMEM(r < 0, ncf);
+    nmatches = aug_match(aug, lpath, &matches);
+    ERR_THROW(nmatches < 0, ncf, EOTHER, "aug_match of '%s' failed", lpath);
+    FREE(lpath);
+
+    /* The existing entries, leaving out comments */
+    r = ALLOC_N(children, nmatches);
+    ERR_NOMEM(r < 0, ncf);
+    for (int i=0; i < nmatches; i++) {
+        if (! is_comment_label(matches[i] + strlen(path) + 1))
+            children[nchildren++] = matches[i];
+    }
+
+    int n = 0;
+    list_for_each(node, tree->children) {
+        label = xml_prop(node, "label");
+        if (n >= nchildren
+            || ! STREQ_NULLABLE(children[n] + strlen(path) + 1, label))
+            same_labels = false;
+        xmlFree(label);
+        label = NULL;
+        n += 1;
+    }
+    if (n != nchildren)
+        same_labels = false;
+
+    if (! same_labels) {
+        /* This is a little drastic, since it clears out the file
+         * entirely */
+        r = aug_rm(aug, path);
+        ERR_THROW(r < 0, ncf, EINTERNAL, "aug_rm of '%s' failed", path);
+    }
+
+    n = 0;
+    list_for_each(node, tree->children) {
+        const char *old = NULL;
+
+        label = xml_prop(node, "label");
+        value = xml_prop(node, "value");
+        if (same_labels) {
+            r = aug_get(aug, children[n], &old);
+            ERR_THROW(r < 0, ncf, EOTHER, "aug_get of '%s' failed",
+                      children[n]);
+            if (! STREQ_NULLABLE(old, value)) {
+                r = aug_set(aug, children[n], value);
+                ERR_THROW(r < 0, ncf, EOTHER, "aug_set of '%s' failed",
+                          children[n]);
+            }
+        } else {
+            r = xasprintf(&lpath, "%s/%s", path, label);
+            ERR_NOMEM(r < 0, ncf);
+
+            r = aug_set(aug, lpath, value);
+            ERR_THROW(r < 0, ncf, EOTHER, "aug_set of '%s' failed", lpath);
+            FREE(lpath);
+        }
+        xmlFree(label);
+        xmlFree(value);
+        label = value = NULL;
+        n += 1;
+    }
+
+ error:
+    xmlFree(label);
+    xmlFree(value);
+    FREE(lpath);
+    FREE(children);
+    free_matches(nmatches, &matches);
+}
+
 /* Write the XML doc in the simple Augeas format into the Augeas tree */
 static int aug_put_xml(struct netcf *ncf, xmlDocPtr xml) {
     xmlNodePtr forest;
-    char *path = NULL, *lpath = NULL, *label = NULL, *value = NULL;
+    char *path = NULL;
     augeas *aug = NULL;
     int result = -1;
-    int r;
 
     aug = get_augeas(ncf);
     ERR_BAIL(ncf);
@@ -576,33 +681,32 @@ static int aug_put_xml(struct netcf *ncf, xmlDocPtr xml) {
                   EINTERNAL, "expected node labeled 'tree', not '%s'",
                   tree->name);
         path = xml_prop(tree, "path");
-        /* This is a little drastic, since it clears out the file entirely */
-        r = aug_rm(aug, path);
-        ERR_THROW(r < 0, ncf, EINTERNAL, "aug_rm of '%s' failed", path);
-        list_for_each(node, tree->children) {
-            label = xml_prop(node, "label");
-            value = xml_prop(node, "value");
-            r = xasprintf(&lpath, "%s/%s", path, label);
-            ERR_NOMEM(r < 0, ncf);
-
-            r = aug_set(aug, lpath, value);
-            ERR_THROW(r < 0, ncf, EOTHER,
-                      "aug_set of '%s' failed", lpath);
-            FREE(lpath);
-            xmlFree(label);
-            xmlFree(value);
-            label = value = NULL;
-        }
+        aug_put_tree(ncf, aug, path, tree);
+        ERR_BAIL(ncf);
         xmlFree(path);
         path = NULL;
-
     }
     result = 0;
  error:
-    xmlFree(label);
-    xmlFree(value);
     xmlFree(path);
-    FREE(lpath);
+    return result;
+}
+
+/* Return true if the file at PATH in the Augeas tree is one of the trees
+ * in the FOREST of the simple Augeas XML; FOREST may be NULL */
+static bool forest_has_path(xmlDocPtr forest, const char *path) {
+    xmlNodePtr root;
+    bool result = false;
+
+    if (forest == NULL || (root = xmlDocGetRootElement(forest)) == NULL)
+        return false;
+    list_for_each(tree, root->children) {
+        char *p = xml_prop(tree, "path");
+        result = STREQ_NULLABLE(p, path);
+        xmlFree(p);
+        if (result)
+            break;
+    }
     return result;
 }
 
@@ -631,8 +735,8 @@ static xmlDocPtr aug_get_xml_for_nif(struct netcf_if *nif) {
 }
 
 /* return the current static configuration (as saved on disk) */
-char *drv_xml_desc(struct netcf_if *nif) {
-    char *result = NULL;
+int drv_xml_desc(struct netcf_if *nif, xmlOutputBufferPtr out) {
+    int result = -1;
     struct netcf *ncf;
     xmlDocPtr aug_xml = NULL;
 
@@ -640,7 +744,7 @@ char *drv_xml_desc(struct netcf_if *nif) {
     aug_xml = aug_get_xml_for_nif(nif);
     ERR_BAIL(ncf);
 
-    result = apply_stylesheet_to_string(ncf, ncf->driver->put, aug_xml);
+    result = apply_stylesheet_to_output(ncf, ncf->driver->put, aug_xml, out);
 
  error:
     xmlFreeDoc(aug_xml);
@@ -650,9 +754,9 @@ char *drv_xml_desc(struct netcf_if *nif) {
 /* return the current live configuration state - a combination of
  * drv_xml_desc + results of querying the interface directly */
 
-char *drv_xml_state(struct netcf_if *nif) {
-    char *result = NULL;
-    int r, result_len;
+int drv_xml_state(struct netcf_if *nif, xmlOutputBufferPtr out) {
+    int result = -1;
+    int r;
     struct netcf *ncf;
     xmlDocPtr ncf_xml = NULL;
     xmlNodePtr root;
@@ -672,17 +776,13 @@ char *drv_xml_state(struct netcf_if *nif) {
     add_state_to_xml_doc(nif, ncf_xml);
     ERR_BAIL(ncf);
 
-    r = xsltSaveResultToString((xmlChar **)&result, &result_len,
-                               ncf_xml, ncf->driver->put);
+    r = xsltSaveResultTo(out, ncf_xml, ncf->driver->put);
     ERR_NOMEM(r < 0, ncf);
+    result = 0;
 
- done:
+ error:
     xmlFreeDoc(ncf_xml);
     return result;
- error:
-    FREE(result);
-    result = 0;
-    goto done;
 }
 
 /* Report various status info about the interface as bits in
@@ -792,37 +892,49 @@ static int bridge_slaves(struct netcf *ncf, const char *name, char ***slaves) {
 }
 
 
+/* The paths of the ifcfg-* files for interface NAME and all its slaves */
+static int interface_ifcfgs(struct netcf *ncf, const char *name,
+                            char ***matches) {
+    /* The last or clause catches slaves of a bond that are enslaved to
+     * a bridge NAME */
+    return aug_fmt_match(ncf, matches,
+          "%s[ DEVICE = '%s' or BRIDGE = '%s' or MASTER = '%s' "
+          "    or MASTER = ../*[BRIDGE = '%s']/DEVICE ]",
+                  ifcfg_path, name, name, name, name);
+}
+
 /* For an interface NAME, remove the ifcfg-* files for that interface and
- * all its slaves. */
-static void rm_interface(struct netcf *ncf, const char *name) {
-    int r;
-    char *path = NULL;
+ * all its slaves. Files that are in the forest KEEP are left alone, since
+ * they are about to be overwritten anyway; KEEP may be NULL */
+static void rm_interface(struct netcf *ncf, const char *name, xmlDocPtr keep) {
+    int r, nmatches = 0;
+    char **matches = NULL;
     augeas *aug = NULL;
 
     aug = get_augeas(ncf);
     ERR_BAIL(ncf);
 
-    /* The last or clause catches slaves of a bond that are enslaved to
-     * a bridge NAME */
-    r = xasprintf(&path,
-          "%s[ DEVICE = '%s' or BRIDGE = '%s' or MASTER = '%s' "
-          "    or MASTER = ../*[BRIDGE = '%s']/DEVICE ]",
-                  ifcfg_path, name, name, name, name);
-    ERR_NOMEM(r < 0, ncf);
+    nmatches = interface_ifcfgs(ncf, name, &matches);
+    ERR_BAIL(ncf);
 
-    r = aug_rm(aug, path);
-    ERR_COND_BAIL(r < 0, ncf, EOTHER);
+    for (int i=0; i < nmatches; i++) {
+        if (forest_has_path(keep, matches[i]))
+            continue;
+        r = aug_rm(aug, matches[i]);
+        ERR_COND_BAIL(r < 0, ncf, EOTHER);
+    }
  error:
-    FREE(path);
+    free_matches(nmatches, &matches);
 }
 
 /* Remove all interfaces and their slaves mentioned in NCF_XML.  We need to
  * remove interfaces one by one when we define an interface, since what
  * will become a subinterface may not be related to the new toplevel
  * interface, and calling RM_INTERFACE on the toplevel interface is
- * therefore not enough.
+ * therefore not enough. Files in the forest KEEP are not removed.
  */
-static void rm_all_interfaces(struct netcf *ncf, xmlDocPtr ncf_xml) {
+static void rm_all_interfaces(struct netcf *ncf, xmlDocPtr ncf_xml,
+                              xmlDocPtr keep) {
     xmlXPathContextPtr context = NULL;
     xmlXPathObjectPtr obj = NULL;
 
@@ -839,7 +951,7 @@ static void rm_all_interfaces(struct netcf *ncf, xmlDocPtr ncf_xml) {
     for (int i=0; i < ns->nodeNr; i++) {
         xmlChar *name = xmlGetProp(ns->nodeTab[i], BAD_CAST "name");
         ERR_NOMEM(name == NULL, ncf);
-        rm_interface(ncf, (char *) name);
+        rm_interface(ncf, (char *) name, keep);
         xmlFree(name);
         ERR_BAIL(ncf);
     }
@@ -883,33 +995,121 @@ static void bond_setup(struct netcf *ncf, const char *name, bool alias) {
     return;
 }
 
-struct netcf_if *drv_define(struct netcf *ncf, const char *xml_str) {
-    xmlDocPtr ncf_xml = NULL, aug_xml = NULL;
+/* Add the files that changing or removing interface NAME touches to the
+ * files we lock. This is only a guess made without holding any locks;
+ * lock_files_cover_save finds the files we missed */
+static void lock_interface(struct netcf *ncf, const char *name) {
+    char **matches = NULL;
+    int nmatches = 0;
+
+    nmatches = interface_ifcfgs(ncf, name, &matches);
+    ERR_BAIL(ncf);
+    for (int i=0; i < nmatches; i++) {
+        lock_files_add(ncf, matches[i]);
+        ERR_BAIL(ncf);
+    }
+    if (is_bond(ncf, name))
+        lock_files_add(ncf, modprobed_netcf_path);
+ error:
+    free_matches(nmatches, &matches);
+}
+
+/* Same as LOCK_INTERFACE for defining NAME as AUG_XML: the files
+ * currently used by NAME, and the ones in AUG_XML */
+static void lock_define(struct netcf *ncf, const char *name,
+                        xmlDocPtr aug_xml) {
+    xmlNodePtr forest = xmlDocGetRootElement(aug_xml);
+    bool bond = false;
+
+    ERR_THROW(forest == NULL, ncf, EINTERNAL, "missing root element");
+    lock_interface(ncf, name);
+    ERR_BAIL(ncf);
+
+    list_for_each(tree, forest->children) {
+        char *path = xml_prop(tree, "path");
+        ERR_NOMEM(path == NULL, ncf);
+        lock_files_add(ncf, path);
+        xmlFree(path);
+        ERR_BAIL(ncf);
+        list_for_each(node, tree->children) {
+            char *label = xml_prop(node, "label");
+            bond = bond || STREQ_NULLABLE(label, "MASTER");
+            xmlFree(label);
+        }
+    }
+    if (bond)
+        lock_files_add(ncf, modprobed_netcf_path);
+ error:
+    return;
+}
+
+/* Parse and validate the interface definition XML_STR and transform it
+ * into Augeas XML. Returns the name of the interface and sets NCF_XML and
+ * AUG_XML, or returns NULL on error
+ */
+static char *define_prepare(struct netcf *ncf, const char *xml_str,
+                            unsigned int flags,
+                            xmlDocPtr *ncf_xml, xmlDocPtr *aug_xml) {
     char *name = NULL;
-    struct netcf_if *result = NULL;
 
-    ncf_xml = parse_xml(ncf, xml_str);
+    *aug_xml = NULL;
+    *ncf_xml = parse_xml(ncf, xml_str);
     ERR_BAIL(ncf);
 
-    rng_validate(ncf, ncf_xml);
+    rng_validate_cached(ncf, *ncf_xml, xml_str, flags);
     ERR_BAIL(ncf);
 
-    name = device_name_from_xml(ncf, ncf_xml);
+    name = device_name_from_xml(ncf, *ncf_xml);
     ERR_COND_BAIL(name == NULL, ncf, EINTERNAL);
     ERR_THROW(strlen(name) >= IFNAMSIZ, ncf, EINTERNAL,
               "The interface name '%s' exceeds the maximum allowed length: %d",
               name, IFNAMSIZ - 1);
 
-    rm_all_interfaces(ncf, ncf_xml);
+    *aug_xml = apply_stylesheet(ncf, ncf->driver->get, *ncf_xml);
     ERR_BAIL(ncf);
 
-    aug_xml = apply_stylesheet(ncf, ncf->driver->get, ncf_xml);
+    return name;
+ error:
+    FREE(name);
+    xmlFreeDoc(*ncf_xml);
+    xmlFreeDoc(*aug_xml);
+    *ncf_xml = NULL;
+    *aug_xml = NULL;
+    return NULL;
+}
+
+/* Replace all interfaces mentioned in NCF_XML with the definition of
+ * interface NAME in AUG_XML in the Augeas tree, without saving */
+static void define_apply(struct netcf *ncf, const char *name,
+                         xmlDocPtr ncf_xml, xmlDocPtr aug_xml) {
+    rm_all_interfaces(ncf, ncf_xml, aug_xml);
     ERR_BAIL(ncf);
 
     aug_put_xml(ncf, aug_xml);
     ERR_BAIL(ncf);
 
     bond_setup(ncf, name, true);
+ error:
+    return;
+}
+
+struct netcf_if *drv_define(struct netcf *ncf, const char *xml_str,
+                            unsigned int flags) {
+    xmlDocPtr ncf_xml = NULL, aug_xml = NULL;
+    char *name = NULL;
+    struct netcf_if *result = NULL;
+
+    name = define_prepare(ncf, xml_str, flags, &ncf_xml, &aug_xml);
+    ERR_BAIL(ncf);
+
+    lock_define(ncf, name, aug_xml);
+    ERR_BAIL(ncf);
+    do {
+        lock_files_acquire(ncf);
+        ERR_BAIL(ncf);
+        define_apply(ncf, name, ncf_xml, aug_xml);
+        ERR_BAIL(ncf);
+    } while (! lock_files_cover_save(ncf));
     ERR_BAIL(ncf);
 
     aug_save_assert(ncf);
@@ -919,6 +1119,7 @@ struct netcf_if *drv_define(struct netcf *ncf, const char *xml_str) {
     ERR_BAIL(ncf);
 
  done:
+    lock_files_release(ncf);
     xmlFreeDoc(ncf_xml);
     xmlFreeDoc(aug_xml);
     return result;
@@ -927,23 +1128,238 @@ struct netcf_if *drv_define(struct netcf *ncf, const char *xml_str) {
     goto done;
 }
 
+int drv_define_many(struct netcf *ncf, int ndocs, const char *const *xmls,
+                    unsigned int flags, struct netcf_if **ifaces,
+                    int *status) {
+    static const struct define_ops ops = {
+        .prepare = define_prepare,
+        .lock = lock_define,
+        .apply = define_apply
+    };
+
+    return define_many(ncf, &ops, ndocs, xmls, flags, ifaces, status);
+}
+
 int drv_undefine(struct netcf_if *nif) {
     struct netcf *ncf = nif->ncf;
+    int result = -1;
 
-    bond_setup(ncf, nif->name, false);
+    lock_interface(ncf, nif->name);
     ERR_BAIL(ncf);
+    do {
+        lock_files_acquire(ncf);
+        ERR_BAIL(ncf);
+
+        bond_setup(ncf, nif->name, false);
+        ERR_BAIL(ncf);
 
-    rm_interface(ncf, nif->name);
+        rm_interface(ncf, nif->name, NULL);
+        ERR_BAIL(ncf);
+    } while (! lock_files_cover_save(ncf));
     ERR_BAIL(ncf);
 
     aug_save_assert(ncf);
     ERR_BAIL(ncf);
 
-    return 0;
+    result = 0;
  error:
+    lock_files_release(ncf);
+    return result;
+}
+
+/* The entries of one ifcfg file that relate it to other interfaces */
+struct ifcfg {
+    char *path;                 /* Augeas path of the file */
+    char *device;
+    char *type;
+    char *bridge;
+    char *master;
+};
+
+static void free_ifcfg_table(int nifcfgs, struct ifcfg **ifcfgs) {
+    if (*ifcfgs == NULL)
+        return;
+    for (int i=0; i < nifcfgs; i++) {
+        struct ifcfg *f = *ifcfgs + i;
+        FREE(f->path);
+        FREE(f->device);
+        FREE(f->type);
+        FREE(f->bridge);
+        FREE(f->master);
+    }
+    FREE(*ifcfgs);
+}
+
+/* Copy the value of the entry NAME in the ifcfg file at PATH into VALUE,
+ * or set it to NULL if there is no such entry */
+static void get_ifcfg_entry(struct netcf *ncf, augeas *aug, const char *path,
+                            const char *name, char **value) {
+    char *p = NULL;
+    const char *v = NULL;
+    int r;
+
+    *value = NULL;
+    r = xasprintf(&p, "%s/%s", path, name);
+    ERR_NOMEM(r < 0, ncf);
+    r = aug_get(aug, p, &v);
+    if (r == 1 && v != NULL) {
+        *value = strdup(v);
+        ERR_NOMEM(*value == NULL, ncf);
+    }
+ error:
+    FREE(p);
+}
+
+/* Load DEVICE, TYPE, BRIDGE and MASTER of all ifcfg files in one pass
+ * over the tree, so that operations on many interfaces do not have to
+ * search all files for each of them */
+static int load_ifcfg_table(struct netcf *ncf, struct ifcfg **ifcfgs) {
+    augeas *aug = NULL;
+    char **matches = NULL;
+    int nmatches = 0, r;
+
+    *ifcfgs = NULL;
+    aug = get_augeas(ncf);
+    ERR_BAIL(ncf);
+
+    nmatches = aug_match(aug, ifcfg_path, &matches);
+    ERR_COND_BAIL(nmatches < 0, ncf, EOTHER);
+    r = ALLOC_N(*ifcfgs, nmatches);
+    ERR_NOMEM(r < 0, ncf);
+
+    for (int i=0; i < nmatches; i++) {
+        struct ifcfg *f = *ifcfgs + i;
+
+        f->path = matches[i];
+        matches[i] = NULL;
+        get_ifcfg_entry(ncf, aug, f->path, "DEVICE", &f->device);
+        get_ifcfg_entry(ncf, aug, f->path, "TYPE", &f->type);
+        get_ifcfg_entry(ncf, aug, f->path, "BRIDGE", &f->bridge);
+        get_ifcfg_entry(ncf, aug, f->path, "MASTER", &f->master);
+        ERR_BAIL(ncf);
+    }
+    free_matches(nmatches, &matches);
+    return nmatches;
+ error:
+    free_ifcfg_table(nmatches, ifcfgs);
+    free_matches(nmatches, &matches);
     return -1;
 }
 
+/* Same as IS_BOND, but using the table IFCFGS */
+static bool ifcfg_is_bond(int nifcfgs, const struct ifcfg *ifcfgs,
+                          const char *name) {
+    for (int i=0; i < nifcfgs; i++)
+        if (STREQ_NULLABLE(ifcfgs[i].master, name))
+            return true;
+    return false;
+}
+
+/* Same as BOND_SETUP with ALIAS == false, but using the table IFCFGS */
+static void ifcfg_unalias_bonds(struct netcf *ncf, int nifcfgs,
+                                const struct ifcfg *ifcfgs,
+                                const char *name) {
+    bool bridge = false;
+
+    if (ifcfg_is_bond(nifcfgs, ifcfgs, name)) {
+        modprobed_unalias_bond(ncf, name);
+        ERR_BAIL(ncf);
+    }
+
+    for (int i=0; i < nifcfgs; i++)
+        if (STREQ_NULLABLE(ifcfgs[i].device, name)
+            && STREQ_NULLABLE(ifcfgs[i].type, "Bridge"))
+            bridge = true;
+    if (! bridge)
+        return;
+
+    for (int i=0; i < nifcfgs; i++) {
+        const char *slave = ifcfgs[i].device;
+        if (slave != NULL && STREQ_NULLABLE(ifcfgs[i].bridge, name)
+            && ifcfg_is_bond(nifcfgs, ifcfgs, slave)) {
+            modprobed_unalias_bond(ncf, slave);
+            ERR_BAIL(ncf);
+        }
+    }
+ error:
+    return;
+}
+
+/* Mark the files that RM_INTERFACE would remove for NAME in REMOVE */
+static void ifcfg_mark_interface(int nifcfgs, const struct ifcfg *ifcfgs,
+                                 const char *name, bool *remove) {
+    for (int i=0; i < nifcfgs; i++) {
+        const struct ifcfg *f = ifcfgs + i;
+
+        if (STREQ_NULLABLE(f->device, name)
+            || STREQ_NULLABLE(f->bridge, name)
+            || STREQ_NULLABLE(f->master, name)) {
+            remove[i] = true;
+        }
+        /* Slaves of a bond that is enslaved to the bridge NAME */
+        if (f->device != NULL && STREQ_NULLABLE(f->bridge, name)) {
+            for (int j=0; j < nifcfgs; j++)
+                if (STREQ_NULLABLE(ifcfgs[j].master, f->device))
+                    remove[j] = true;
+        }
+    }
+}
+
+int drv_undefine_many(struct netcf *ncf, int nifaces,
+                      struct netcf_if **ifaces) {
+    struct ifcfg *ifcfgs = NULL;
+    bool *remove = NULL;
+    augeas *aug = NULL;
+    int nifcfgs = 0, r, result = -1;
+
+    for (int i=0; i < nifaces; i++) {
+        lock_interface(ncf, ifaces[i]->name);
+        ERR_BAIL(ncf);
+    }
+
+    do {
+        FREE(remove);
+        free_ifcfg_table(nifcfgs, &ifcfgs);
+        lock_files_acquire(ncf);
+        ERR_BAIL(ncf);
+
+        aug = get_augeas(ncf);
+        ERR_BAIL(ncf);
+
+        nifcfgs = load_ifcfg_table(ncf, &ifcfgs);
+        ERR_BAIL(ncf);
+        r = ALLOC_N(remove, nifcfgs);
+        ERR_NOMEM(r < 0, ncf);
+
+        for (int i=0; i < nifaces; i++) {
+            ifcfg_unalias_bonds(ncf, nifcfgs, ifcfgs, ifaces[i]->name);
+            ERR_BAIL(ncf);
+            ifcfg_mark_interface(nifcfgs, ifcfgs, ifaces[i]->name, remove);
+        }
+
+        for (int i=0; i < nifcfgs; i++) {
+            if (remove[i]) {
+                r = aug_rm(aug, ifcfgs[i].path);
+                ERR_COND_BAIL(r < 0, ncf, EOTHER);
+            }
+        }
+    } while (! lock_files_cover_save(ncf));
+    ERR_BAIL(ncf);
+
+    aug_save_group(ncf);
+    ERR_BAIL(ncf);
+    result = 0;
+
+ done:
+    lock_files_release(ncf);
+    FREE(remove);
+    free_ifcfg_table(nifcfgs, &ifcfgs);
+    return result;
+ error:
+    aug_revert(ncf);
+    goto done;
+}
+
 int drv_lookup_by_mac_string(struct netcf *ncf, const char *mac,
                              int maxifaces, struct netcf_if **ifaces)
 {
@@ -1025,17 +1441,16 @@ const char *drv_mac_string(struct netcf_if *nif) {
  * Bringing interfaces up/down
  */
 
-int drv_if_up(struct netcf_if *nif) {
+/* Bring up the interface NAME, and the slaves of bridges first */
+static int if_up_name(struct netcf *ncf, const char *name) {
     static const char *const ifup = "ifup";
-    struct netcf *ncf = nif->ncf;
     char **slaves = NULL;
     int nslaves = 0;
     int result = -1;
-    int is_active, retries;
 
-    if (is_bridge(ncf, nif->name)) {
+    if (is_bridge(ncf, name)) {
         /* Bring up bridge slaves before the bridge */
-        nslaves = bridge_slaves(ncf, nif->name, &slaves);
+        nslaves = bridge_slaves(ncf, name, &slaves);
         ERR_BAIL(ncf);
 
         for (int i=0; i < nslaves; i++) {
@@ -1043,7 +1458,45 @@ int drv_if_up(struct netcf_if *nif) {
             ERR_BAIL(ncf);
         }
     }
-    run1(ncf, ifup, nif->name);
+    run1(ncf, ifup, name);
+    ERR_BAIL(ncf);
+    result = 0;
+ error:
+    free_matches(nslaves, &slaves);
+    return result;
+}
+
+/* Bring down the interface NAME, and the slaves of bridges after it */
+static int if_down_name(struct netcf *ncf, const char *name) {
+    static const char *const ifdown = "ifdown";
+    char **slaves = NULL;
+    int nslaves = 0;
+    int result = -1;
+
+    run1(ncf, ifdown, name);
+    ERR_BAIL(ncf);
+    if (is_bridge(ncf, name)) {
+        /* Bring up bridge slaves after the bridge */
+        nslaves = bridge_slaves(ncf, name, &slaves);
+        ERR_BAIL(ncf);
+
+        for (int i=0; i < nslaves; i++) {
+            run1(ncf, ifdown, slaves[i]);
+            ERR_BAIL(ncf);
+        }
+    }
+    result = 0;
+ error:
+    free_matches(nslaves, &slaves);
+    return result;
+}
+
+int drv_if_up(struct netcf_if *nif) {
+    struct netcf *ncf = nif->ncf;
+    int result = -1;
+    int is_active, retries;
+
+    if_up_name(ncf, nif->name);
     ERR_BAIL(ncf);
 
     for (retries = 0; retries < 10; retries++) {
@@ -1056,35 +1509,249 @@ int drv_if_up(struct netcf_if *nif) {
               "possible disconnected cable.", nif->name);
     result = 0;
  error:
-    free_matches(nslaves, &slaves);
     return result;
 }
 
 int drv_if_down(struct netcf_if *nif) {
-    static const char *const ifdown = "ifdown";
+    return if_down_name(nif->ncf, nif->name);
+}
+
+int drv_if_up_down_names(struct netcf_if *nif, bool up, const char **prog,
+                         char ***names) {
     struct netcf *ncf = nif->ncf;
     char **slaves = NULL;
     int nslaves = 0;
-    int result = -1;
 
-    run1(ncf, ifdown, nif->name);
-    ERR_BAIL(ncf);
+    *prog = up ? "ifup" : "ifdown";
     if (is_bridge(ncf, nif->name)) {
-        /* Bring up bridge slaves after the bridge */
         nslaves = bridge_slaves(ncf, nif->name, &slaves);
-        ERR_BAIL(ncf);
+        if (nslaves < 0)
+            return -1;
+    }
+    return if_up_down_names(nif, up, nslaves, slaves, names);
+}
+
+/* The ifup or ifdown jobs for a group of interfaces. A bridge depends on
+ * its slaves, a bond on its slaves and a VLAN on its physical device,
+ * but only if those are in the group, too */
+struct if_jobs {
+    int               njobs;
+    char            **names;            /* the device of each job */
+    const char     *(*argvs)[3];
+    struct exec_job  *jobs;
+};
+
+static void if_jobs_free(struct if_jobs *ij) {
+    for (int i=0; i < ij->njobs; i++) {
+        FREE(ij->names[i]);
+        FREE(ij->jobs[i].deps);
+    }
+    FREE(ij->names);
+    FREE(ij->argvs);
+    FREE(ij->jobs);
+    ij->njobs = 0;
+}
+
+static int if_job_find(struct if_jobs *ij, const char *name) {
+    for (int i=0; i < ij->njobs; i++)
+        if (STREQ(ij->names[i], name))
+            return i;
+    return -1;
+}
+
+/* Make job JOB wait for job DEP */
+static void if_job_depend(struct netcf *ncf, struct if_jobs *ij,
+                          int job, int dep) {
+    struct exec_job *j = ij->jobs + job;
+    int r;
+
+    if (job == dep)
+        return;
+    for (int d=0; d < j->ndeps; d++)
+        if (j->deps[d] == dep)
+            return;
+    r = REALLOC_N(j->deps, j->ndeps + 1);
+    ERR_NOMEM(r < 0, ncf);
+    j->deps[j->ndeps++] = dep;
+ error:
+    return;
+}
+
+/* Add a job for the device NAME, and, if it is a bridge, for its slaves,
+ * since that is what if_up_name does. Returns the index of the job for
+ * NAME, or -1 on error */
+static int if_job_add(struct netcf *ncf, struct if_jobs *ij,
+                      const char *name) {
+    char **slaves = NULL;
+    int nslaves = 0, job, r;
+
+    job = if_job_find(ij, name);
+    if (job >= 0)
+        return job;
+
+    r = REALLOC_N(ij->names, ij->njobs + 1);
+    ERR_NOMEM(r < 0, ncf);
+    r = REALLOC_N(ij->argvs, ij->njobs + 1);
+    ERR_NOMEM(r < 0, ncf);
+    r = REALLOC_N(ij->jobs, ij->njobs + 1);
+    ERR_NOMEM(r < 0, ncf);
+    job = ij->njobs;
+    MEMZERO(ij->jobs + job, 1);
+    ij->names[job] = strdup(name);
+    ERR_NOMEM(ij->names[job] == NULL, ncf);
+    ij->njobs += 1;
 
+    if (is_bridge(ncf, name)) {
+        nslaves = bridge_slaves(ncf, name, &slaves);
+        ERR_BAIL(ncf);
         for (int i=0; i < nslaves; i++) {
-            run1(ncf, ifdown, slaves[i]);
+            if_job_add(ncf, ij, slaves[i]);
             ERR_BAIL(ncf);
         }
     }
-    result = 0;
+    free_matches(nslaves, &slaves);
+    return job;
  error:
     free_matches(nslaves, &slaves);
+    return -1;
+}
+
+/* Add the dependencies between the jobs in IJ */
+static void if_jobs_link(struct netcf *ncf, struct if_jobs *ij) {
+    augeas *aug = NULL;
+    char *path = NULL, *sub = NULL, *base = NULL;
+    const char *value;
+    int r;
+
+    aug = get_augeas(ncf);
+    ERR_BAIL(ncf);
+
+    for (int i=0; i < ij->njobs; i++) {
+        const char *name = ij->names[i];
+        int master, dep;
+
+        path = find_ifcfg_path(ncf, name);
+        ERR_BAIL(ncf);
+        if (path == NULL)
+            continue;
+
+        /* Slaves come before their bond or bridge */
+        for (int s = 0; s < ARRAY_CARDINALITY(subif_paths); s++) {
+            r = xasprintf(&sub, "%s/%s", path, subif_paths[s]);
+            ERR_NOMEM(r < 0, ncf);
+            if (aug_get(aug, sub, &value) == 1 && value != NULL
+                && (master = if_job_find(ij, value)) >= 0) {
+                if_job_depend(ncf, ij, master, i);
+                ERR_BAIL(ncf);
+            }
+            FREE(sub);
+        }
+
+        /* VLANs come after their physical device */
+        r = xasprintf(&sub, "%s/PHYSDEV", path);
+        ERR_NOMEM(r < 0, ncf);
+        if (aug_get(aug, sub, &value) == 1 && value != NULL) {
+            base = strdup(value);
+            ERR_NOMEM(base == NULL, ncf);
+        } else if (strchr(name, '.') != NULL) {
+            base = strndup(name, strrchr(name, '.') - name);
+            ERR_NOMEM(base == NULL, ncf);
+        }
+        FREE(sub);
+        if (base != NULL && (dep = if_job_find(ij, base)) >= 0) {
+            if_job_depend(ncf, ij, i, dep);
+            ERR_BAIL(ncf);
+        }
+        FREE(base);
+        FREE(path);
+    }
+ error:
+    FREE(path);
+    FREE(sub);
+    FREE(base);
+}
+
+/* Bring up (if UP is true) or down all interfaces in IFACES together,
+ * running up to MAXJOBS ifup or ifdown at once. For ifdown, everything
+ * runs in the opposite order from ifup */
+static int if_up_down_many(struct netcf *ncf, int nifaces,
+                           struct netcf_if **ifaces, unsigned int maxjobs,
+                           bool up, int *status) {
+    struct if_jobs ij;
+    int *index = NULL, **rdeps = NULL, *nrdeps = NULL;
+    int r, result = -1;
+
+    MEMZERO(&ij, 1);
+    r = ALLOC_N(index, nifaces);
+    ERR_NOMEM(r < 0, ncf);
+
+    for (int i=0; i < nifaces; i++) {
+        index[i] = if_job_add(ncf, &ij, ifaces[i]->name);
+        ERR_BAIL(ncf);
+    }
+    if_jobs_link(ncf, &ij);
+    ERR_BAIL(ncf);
+
+    for (int i=0; i < ij.njobs; i++) {
+        ij.argvs[i][0] = up ? "ifup" : "ifdown";
+        ij.argvs[i][1] = ij.names[i];
+        ij.argvs[i][2] = NULL;
+        ij.jobs[i].argv = ij.argvs[i];
+    }
+
+    if (!up) {
+        /* Turn all dependencies around */
+        r = ALLOC_N(rdeps, ij.njobs);
+        ERR_NOMEM(r < 0, ncf);
+        r = ALLOC_N(nrdeps, ij.njobs);
+        ERR_NOMEM(r < 0, ncf);
+        for (int i=0; i < ij.njobs; i++) {
+            for (int d=0; d < ij.jobs[i].ndeps; d++) {
+                int dep = ij.jobs[i].deps[d];
+
+                r = REALLOC_N(rdeps[dep], nrdeps[dep] + 1);
+                ERR_NOMEM(r < 0, ncf);
+                rdeps[dep][nrdeps[dep]++] = i;
+            }
+        }
+        for (int i=0; i < ij.njobs; i++) {
+            FREE(ij.jobs[i].deps);
+            ij.jobs[i].deps = rdeps[i];
+            ij.jobs[i].ndeps = nrdeps[i];
+            rdeps[i] = NULL;
+        }
+    }
+
+    r = run_jobs(ncf, ij.njobs, ij.jobs, maxjobs);
+    if (r < 0)
+        goto error;
+    for (int i=0; i < nifaces; i++)
+        status[i] = ij.jobs[index[i]].status;
+
+    result = if_check_active(ncf, nifaces, ifaces, up, status);
+
+ error:
+    if (rdeps != NULL)
+        for (int i=0; i < ij.njobs; i++)
+            FREE(rdeps[i]);
+    FREE(rdeps);
+    FREE(nrdeps);
+    FREE(index);
+    if_jobs_free(&ij);
     return result;
 }
 
+int drv_if_up_many(struct netcf *ncf, int nifaces, struct netcf_if **ifaces,
+                   unsigned int maxjobs, int *status) {
+    return if_up_down_many(ncf, nifaces, ifaces, maxjobs, true, status);
+}
+
+int drv_if_down_many(struct netcf *ncf, int nifaces,
+                     struct netcf_if **ifaces, unsigned int maxjobs,
+                     int *status) {
+    return if_up_down_many(ncf, nifaces, ifaces, maxjobs, false, status);
+}
+
 /* Functions to take a snapshot of network config (change_begin), and
  * later either revert to that config (change_rollback), or make the
  * new config permanent (change_commit).
@@ -1095,23 +1762,215 @@ drv_change_begin(struct netcf *ncf, unsigned int flags)
     int result = -1;
 
     ERR_THROW(flags != 0, ncf, EOTHER, "unsupported flags value %d", flags);
-    run1(ncf, NETCF_TRANSACTION, "change-begin");
+    snapshot_begin(ncf, snapshot_files);
     ERR_BAIL(ncf);
     result = 0;
 error:
     return result;
 }
 
+/* Find the toplevel interface that the device NAME belongs to, following
+ * the MASTER and BRIDGE entries in ifcfg files the same way that
+ * aug_all_related_ifcfgs does. Returns NULL if there is no ifcfg file for
+ * NAME */
+static char *toplevel_interface(struct netcf *ncf, const char *name) {
+    augeas *aug = NULL;
+    char *path = NULL, *sub = NULL, *result = NULL;
+    const char *master;
+    int r;
+
+    aug = get_augeas(ncf);
+    ERR_BAIL(ncf);
+
+    /* A device can be enslaved to a bond that is attached to a bridge,
+     * but it doesn't go deeper than that */
+    for (int depth = 0; depth < 3; depth++) {
+        path = find_ifcfg_path(ncf, result == NULL ? name : result);
+        ERR_BAIL(ncf);
+        if (path == NULL)
+            break;
+        if (result == NULL) {
+            result = strdup(name);
+            ERR_NOMEM(result == NULL, ncf);
+        }
+
+        master = NULL;
+        for (int s = 0; master == NULL && s < ARRAY_CARDINALITY(subif_paths);
+             s++) {
+            r = xasprintf(&sub, "%s/%s", path, subif_paths[s]);
+            ERR_NOMEM(r < 0, ncf);
+            if (aug_get(aug, sub, &master) != 1)
+                master = NULL;
+            FREE(sub);
+        }
+        FREE(path);
+        if (master == NULL)
+            break;
+        FREE(result);
+        result = strdup(master);
+        ERR_NOMEM(result == NULL, ncf);
+    }
+    return result;
+ error:
+    FREE(path);
+    FREE(sub);
+    FREE(result);
+    return NULL;
+}
+
+/* Add the toplevel interface that the ifcfg, route or rule file FNAME,
+ * a path as returned by snapshot_changes, belongs to in the current
+ * configuration to IFACES, unless it is already there */
+static void add_changed_interface(struct netcf *ncf, const char *fname,
+                                  int *nifaces, char ***ifaces) {
+    augeas *aug = NULL;
+    char *path = NULL, *escaped = NULL, *top = NULL;
+    const char *dev;
+    int r;
+
+    aug = get_augeas(ncf);
+    ERR_BAIL(ncf);
+
+    fname = strrchr(fname, '/') + 1;
+    dev = strchr(fname, '-') + 1;
+    if (STREQLEN(fname, "ifcfg-", strlen("ifcfg-"))) {
+        const char *device;
+
+        r = aug_escape_name_wrap(ncf, aug, fname, &escaped);
+        ERR_NOMEM(r < 0, ncf);
+        r = xasprintf(&path, "%s/%s/DEVICE", network_scripts_path,
+                      escaped ? escaped : fname);
+        ERR_NOMEM(r < 0, ncf);
+        if (aug_get(aug, path, &device) == 1 && device != NULL)
+            dev = device;
+    }
+
+    top = toplevel_interface(ncf, dev);
+    ERR_BAIL(ncf);
+    if (top == NULL)
+        goto error;
+    for (int i=0; i < *nifaces; i++)
+        if (STREQ((*ifaces)[i], top))
+            goto error;
+    r = REALLOC_N(*ifaces, *nifaces + 1);
+    ERR_NOMEM(r < 0, ncf);
+    (*ifaces)[(*nifaces)++] = top;
+    top = NULL;
+ error:
+    FREE(top);
+    FREE(path);
+    FREE(escaped);
+}
+
+/* List the toplevel interfaces whose configuration is in one of the
+ * CHANGED files, VLANs last since they need their physical device */
+static int changed_interfaces(struct netcf *ncf, int nchanged, char **changed,
+                              char ***ifaces) {
+    int nifaces = 0, nvlans = 0;
+
+    *ifaces = NULL;
+    for (int i=0; i < nchanged; i++) {
+        add_changed_interface(ncf, changed[i], &nifaces, ifaces);
+        ERR_BAIL(ncf);
+    }
+    /* Move VLANs to the end, keeping the order otherwise */
+    for (int i=0; i < nifaces - nvlans;) {
+        char *name = (*ifaces)[i];
+        int r;
+
+        r = aug_fmt_match(ncf, NULL, "%s[DEVICE = '%s'][VLAN = 'yes']",
+                          ifcfg_path, name);
+        ERR_COND_BAIL(r < 0, ncf, EOTHER);
+        if (r > 0 || strchr(name, '.') != NULL) {
+            memmove(*ifaces + i, *ifaces + i + 1,
+                    (nifaces - i - 1) * sizeof((*ifaces)[0]));
+            (*ifaces)[nifaces - 1] = name;
+            nvlans += 1;
+        } else {
+            i += 1;
+        }
+    }
+    return nifaces;
+ error:
+    free_matches(nifaces, ifaces);
+    return -1;
+}
+
+/* With NETCF_CHANGE_RESTART, a failure to bring one interface down or up
+ * does not stop us: the files are always put back, every interface is
+ * tried, and the first error is reported at the end */
 int
-drv_change_rollback(struct netcf *ncf, unsigned int flags)
+drv_change_rollback(struct netcf *ncf, unsigned int flags,
+                    int maxnames, char **names)
 {
+    char **changed = NULL, **down = NULL, **up = NULL;
+    int nchanged = 0, ndown = 0, nup = 0, ntouched = 0;
+    struct ncf_error first = { NETCF_NOERROR, NULL };
     int result = -1;
 
-    ERR_THROW(flags != 0, ncf, EOTHER, "unsupported flags value %d", flags);
-    run1(ncf, NETCF_TRANSACTION, "change-rollback");
+    ERR_THROW((flags & ~NETCF_CHANGE_RESTART) != 0, ncf, EOTHER,
+              "unsupported flags value %d", flags);
+
+    /* Find the interfaces affected by the rollback, both in the current
+     * configuration and in the one we go back to */
+    nchanged = snapshot_changes(ncf, snapshot_files, &changed);
+    if (nchanged < 0)
+        nchanged = 0;
+    else
+        ndown = changed_interfaces(ncf, nchanged, changed, &down);
+    if (ndown < 0)
+        ndown = 0;
+    error_set_aside(ncf, &first);
+
+    if (flags & NETCF_CHANGE_RESTART) {
+        for (int i = ndown - 1; i >= 0; i--) {
+            if_down_name(ncf, down[i]);
+            error_set_aside(ncf, &first);
+        }
+    }
+
+    snapshot_rollback(ncf, snapshot_files);
+    error_set_aside(ncf, &first);
+
+    nup = changed_interfaces(ncf, nchanged, changed, &up);
+    if (error_set_aside(ncf, &first) != NETCF_NOERROR) {
+        /* Bring back what we took down, as far as it still exists */
+        nup = 0;
+        for (int i=0; i < ndown && (flags & NETCF_CHANGE_RESTART); i++) {
+            if_up_name(ncf, down[i]);
+            error_set_aside(ncf, &first);
+        }
+    }
+    if (flags & NETCF_CHANGE_RESTART) {
+        for (int i=0; i < nup; i++) {
+            if_up_name(ncf, up[i]);
+            error_set_aside(ncf, &first);
+        }
+    }
+
+    for (int i=0; i < ndown + nup; i++) {
+        char *name = i < ndown ? down[i] : up[i - ndown];
+        bool seen = false;
+
+        for (int j=0; j < ndown && i >= ndown; j++)
+            seen = seen || STREQ(down[j], name);
+        if (seen)
+            continue;
+        if (ntouched < maxnames) {
+            names[ntouched] = strdup(name);
+            ERR_NOMEM(names[ntouched] == NULL, ncf);
+        }
+        ntouched += 1;
+    }
+
+    error_restore(ncf, &first);
     ERR_BAIL(ncf);
-    result = 0;
-error:
+    result = ntouched;
+ error:
+    error_restore(ncf, &first);
+    free_matches(nchanged, &changed);
+    free_matches(ndown, &down);
+    free_matches(nup, &up);
     return result;
 }
 
@@ -1121,7 +1980,7 @@ drv_change_commit(struct netcf *ncf, unsigned int flags)
     int result = -1;
 
     ERR_THROW(flags != 0, ncf, EOTHER, "unsupported flags value %d", flags);
-    run1(ncf, NETCF_TRANSACTION, "change-commit");
+    snapshot_commit(ncf);
     ERR_BAIL(ncf);
     result = 0;
 error:
@@ -1176,12 +2035,16 @@ static int drv_put_aug(struct netcf *ncf, const char *aug_xml, char **ncf_xml) {
  */
 int ncf_get_aug(struct netcf *ncf, const char *ncf_xml, char **aug_xml) {
     API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
 
     return drv_get_aug(ncf, ncf_xml, aug_xml);
 }
 
 int ncf_put_aug(struct netcf *ncf, const char *aug_xml, char **ncf_xml) {
     API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
 
     return drv_put_aug(ncf, aug_xml, ncf_xml);
 }
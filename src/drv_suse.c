@@ -57,9 +57,6 @@
 
 #define NETRULE_PATH "/etc/udev/rules.d/70-persistent-net.rules"
 
-#undef NETCF_TRANSACTION
-#define NETCF_TRANSACTION "/bin/false"
-
 static const char *const aug_files =
     "/files";
 
@@ -75,6 +72,24 @@ static const char *const udev_netrule_path =
 static const char *const ifcfg_prefix =
     "ifcfg-";
 
+/* The files that ncf_change_begin takes a snapshot of: the ifcfg and
+ * route files, the modprobe config we add bond aliases to, and the udev
+ * rules that name interfaces */
+static const char *const snapshot_network[] = {
+    "ifcfg-", "ifroute-", "routes", NULL
+};
+static const char *const snapshot_all[] = { "", NULL };
+static const char *const snapshot_netrules[] = {
+    "70-persistent-net.rules", NULL
+};
+
+static const struct snapshot_files snapshot_files[] = {
+    { "etc/sysconfig/network", snapshot_network },
+    { "etc/modprobe.d", snapshot_all },
+    { "etc/udev/rules.d", snapshot_netrules },
+    { NULL, NULL }
+};
+
 /* Augeas should only load the files we are interested in */
 static const struct augeas_pv augeas_xfm_common_pv[] = {
     /* Netrule files */
@@ -775,8 +790,8 @@ static xmlDocPtr aug_get_xml_for_nif(struct netcf_if *nif) {
 }
 
 /* return the current static configuration (as saved on disk) */
-char *drv_xml_desc(struct netcf_if *nif) {
-    char *result = NULL;
+int drv_xml_desc(struct netcf_if *nif, xmlOutputBufferPtr out) {
+    int result = -1;
     struct netcf *ncf;
     xmlDocPtr aug_xml = NULL;
 
@@ -784,7 +799,7 @@ char *drv_xml_desc(struct netcf_if *nif) {
     aug_xml = aug_get_xml_for_nif(nif);
     ERR_BAIL(ncf);
 
-    result = apply_stylesheet_to_string(ncf, ncf->driver->put, aug_xml);
+    result = apply_stylesheet_to_output(ncf, ncf->driver->put, aug_xml, out);
 
  error:
     xmlFreeDoc(aug_xml);
@@ -794,9 +809,9 @@ char *drv_xml_desc(struct netcf_if *nif) {
 /* return the current live configuration state - a combination of
  * drv_xml_desc + results of querying the interface directly */
 
-char *drv_xml_state(struct netcf_if *nif) {
-    char *result = NULL;
-    int r, result_len;
+int drv_xml_state(struct netcf_if *nif, xmlOutputBufferPtr out) {
+    int result = -1;
+    int r;
     struct netcf *ncf;
     xmlDocPtr ncf_xml = NULL;
     xmlNodePtr root;
@@ -816,17 +831,13 @@ char *drv_xml_state(struct netcf_if *nif) {
     add_state_to_xml_doc(nif, ncf_xml);
     ERR_BAIL(ncf);
 
-    r = xsltSaveResultToString((xmlChar **)&result, &result_len,
-                               ncf_xml, ncf->driver->put);
+    r = xsltSaveResultTo(out, ncf_xml, ncf->driver->put);
     ERR_NOMEM(r < 0, ncf);
+    result = 0;
 
- done:
+ error:
     xmlFreeDoc(ncf_xml);
     return result;
- error:
-    FREE(result);
-    result = 0;
-    goto done;
 }
 
 /* Report various status info about the interface as bits in
@@ -1054,33 +1065,66 @@ static void bond_setup(struct netcf *ncf, const char *name, bool alias) {
     return;
 }
 
-struct netcf_if *drv_define(struct netcf *ncf, const char *xml_str) {
-    xmlDocPtr ncf_xml = NULL, aug_xml = NULL;
+/* Parse and validate the interface definition XML_STR and transform it
+ * into Augeas XML. Returns the name of the interface and sets NCF_XML and
+ * AUG_XML, or returns NULL on error
+ */
+static char *define_prepare(struct netcf *ncf, const char *xml_str,
+                            unsigned int flags,
+                            xmlDocPtr *ncf_xml, xmlDocPtr *aug_xml) {
     char *name = NULL;
-    struct netcf_if *result = NULL;
 
-    ncf_xml = parse_xml(ncf, xml_str);
+    *aug_xml = NULL;
+    *ncf_xml = parse_xml(ncf, xml_str);
     ERR_BAIL(ncf);
 
-    rng_validate(ncf, ncf_xml);
+    rng_validate_cached(ncf, *ncf_xml, xml_str, flags);
     ERR_BAIL(ncf);
 
-    name = device_name_from_xml(ncf, ncf_xml);
+    name = device_name_from_xml(ncf, *ncf_xml);
     ERR_COND_BAIL(name == NULL, ncf, EINTERNAL);
     ERR_THROW(strlen(name) >= IFNAMSIZ, ncf, EINTERNAL,
               "The interface name '%s' exceeds the maximum allowed length: %d",
               name, IFNAMSIZ - 1);
 
-    rm_all_interfaces(ncf, ncf_xml);
+    *aug_xml = apply_stylesheet(ncf, ncf->driver->get, *ncf_xml);
     ERR_BAIL(ncf);
 
-    aug_xml = apply_stylesheet(ncf, ncf->driver->get, ncf_xml);
+    return name;
+ error:
+    FREE(name);
+    xmlFreeDoc(*ncf_xml);
+    xmlFreeDoc(*aug_xml);
+    *ncf_xml = NULL;
+    *aug_xml = NULL;
+    return NULL;
+}
+
+/* Replace all interfaces mentioned in NCF_XML with the definition of
+ * interface NAME in AUG_XML in the Augeas tree, without saving */
+static void define_apply(struct netcf *ncf, const char *name,
+                         xmlDocPtr ncf_xml, xmlDocPtr aug_xml) {
+    rm_all_interfaces(ncf, ncf_xml);
     ERR_BAIL(ncf);
 
     aug_put_xml(ncf, aug_xml);
     ERR_BAIL(ncf);
 
     bond_setup(ncf, name, true);
+ error:
+    return;
+}
+
+struct netcf_if *drv_define(struct netcf *ncf, const char *xml_str,
+                            unsigned int flags) {
+    xmlDocPtr ncf_xml = NULL, aug_xml = NULL;
+    char *name = NULL;
+    struct netcf_if *result = NULL;
+
+    name = define_prepare(ncf, xml_str, flags, &ncf_xml, &aug_xml);
+    ERR_BAIL(ncf);
+
+    define_apply(ncf, name, ncf_xml, aug_xml);
     ERR_BAIL(ncf);
 
     aug_save_assert(ncf);
@@ -1098,6 +1142,18 @@ struct netcf_if *drv_define(struct netcf *ncf, const char *xml_str) {
     goto done;
 }
 
+int drv_define_many(struct netcf *ncf, int ndocs, const char *const *xmls,
+                    unsigned int flags, struct netcf_if **ifaces,
+                    int *status) {
+    static const struct define_ops ops = {
+        .prepare = define_prepare,
+        .lock = NULL,
+        .apply = define_apply
+    };
+
+    return define_many(ncf, &ops, ndocs, xmls, flags, ifaces, status);
+}
+
 int drv_undefine(struct netcf_if *nif) {
     struct netcf *ncf = nif->ncf;
 
@@ -1115,6 +1171,25 @@ int drv_undefine(struct netcf_if *nif) {
     return -1;
 }
 
+int drv_undefine_many(struct netcf *ncf, int nifaces,
+                      struct netcf_if **ifaces) {
+    for (int i=0; i < nifaces; i++) {
+        bond_setup(ncf, ifaces[i]->name, false);
+        ERR_BAIL(ncf);
+
+        rm_interface(ncf, ifaces[i]->name);
+        ERR_BAIL(ncf);
+    }
+
+    aug_save_group(ncf);
+    ERR_BAIL(ncf);
+
+    return 0;
+ error:
+    aug_revert(ncf);
+    return -1;
+}
+
 int drv_lookup_by_mac_string(struct netcf *ncf, const char *mac,
                              int maxifaces, struct netcf_if **ifaces)
 {
@@ -1260,6 +1335,32 @@ int drv_if_down(struct netcf_if *nif) {
     return result;
 }
 
+int drv_if_up_down_names(struct netcf_if *nif, bool up, const char **prog,
+                         char ***names) {
+    struct netcf *ncf = nif->ncf;
+    char **slaves = NULL;
+    int nslaves = 0;
+
+    *prog = up ? "ifup" : "ifdown";
+    if (is_bridge(ncf, nif->name)) {
+        nslaves = bridge_slaves(ncf, nif->name, &slaves);
+        if (nslaves < 0)
+            return -1;
+    }
+    return if_up_down_names(nif, up, nslaves, slaves, names);
+}
+
+int drv_if_up_many(struct netcf *ncf, int nifaces, struct netcf_if **ifaces,
+                   unsigned int maxjobs ATTRIBUTE_UNUSED, int *status) {
+    return if_up_down_each(ncf, nifaces, ifaces, true, status);
+}
+
+int drv_if_down_many(struct netcf *ncf, int nifaces,
+                     struct netcf_if **ifaces,
+                     unsigned int maxjobs ATTRIBUTE_UNUSED, int *status) {
+    return if_up_down_each(ncf, nifaces, ifaces, false, status);
+}
+
 /* Functions to take a snapshot of network config (change_begin), and
  * later either revert to that config (change_rollback), or make the
  * new config permanent (change_commit).
@@ -1270,7 +1371,7 @@ drv_change_begin(struct netcf *ncf, unsigned int flags)
     int result = -1;
 
     ERR_THROW(flags != 0, ncf, EOTHER, "unsupported flags value %d", flags);
-    run1(ncf, NETCF_TRANSACTION, "change-begin");
+    snapshot_begin(ncf, snapshot_files);
     ERR_BAIL(ncf);
     result = 0;
 error:
@@ -1278,12 +1379,14 @@ error:
 }
 
 int
-drv_change_rollback(struct netcf *ncf, unsigned int flags)
+drv_change_rollback(struct netcf *ncf, unsigned int flags,
+                    int maxnames ATTRIBUTE_UNUSED,
+                    char **names ATTRIBUTE_UNUSED)
 {
     int result = -1;
 
     ERR_THROW(flags != 0, ncf, EOTHER, "unsupported flags value %d", flags);
-    run1(ncf, NETCF_TRANSACTION, "change-rollback");
+    snapshot_rollback(ncf, snapshot_files);
     ERR_BAIL(ncf);
     result = 0;
 error:
@@ -1296,7 +1399,7 @@ drv_change_commit(struct netcf *ncf, unsigned int flags)
     int result = -1;
 
     ERR_THROW(flags != 0, ncf, EOTHER, "unsupported flags value %d", flags);
-    run1(ncf, NETCF_TRANSACTION, "change-commit");
+    snapshot_commit(ncf);
     ERR_BAIL(ncf);
     result = 0;
 error:
@@ -1351,12 +1454,16 @@ static int drv_put_aug(struct netcf *ncf, const char *aug_xml, char **ncf_xml) {
  */
 int ncf_get_aug(struct netcf *ncf, const char *ncf_xml, char **aug_xml) {
     API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
 
     return drv_get_aug(ncf, ncf_xml, aug_xml);
 }
 
 int ncf_put_aug(struct netcf *ncf, const char *aug_xml, char **ncf_xml) {
     API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
 
     return drv_put_aug(ncf, aug_xml, ncf_xml);
 }
@@ -31,8 +31,19 @@
 #include <unistd.h>
 #include <ctype.h>
 #include <errno.h>
+#include <time.h>
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#else
+#define STAP_PROBE3(provider, name, arg1, arg2, arg3)
+#define STAP_PROBE4(provider, name, arg1, arg2, arg3, arg4)
+#endif
 
 #include "safe-alloc.h"
+#include "sha256.h"
+#ifndef WIN32
+#include "rngc.h"
+#endif
 #include "ref.h"
 #include "list.h"
 #include "netcf.h"
@@ -80,10 +91,300 @@ void free_netcf(struct netcf *ncf) {
         return;
 
     assert(ncf->ref == 0);
+    api_destroy(ncf);
     free(ncf->root);
     free(ncf);
 }
 
+/*
+ * Thread safety
+ */
+
+#ifdef HAVE_LIBPTHREAD
+/* The error that the last call on a handle left behind in this thread */
+struct thread_error {
+    struct thread_error *next;
+    const struct netcf  *ncf;
+    unsigned long        serial;
+    netcf_errcode_t      errcode;
+    char                *errdetails;
+};
+
+static pthread_key_t thread_error_key;
+static pthread_once_t thread_error_once = PTHREAD_ONCE_INIT;
+
+static void thread_errors_free(void *opaque) {
+    struct thread_error *te = opaque;
+
+    while (te != NULL) {
+        struct thread_error *next = te->next;
+        free(te->errdetails);
+        free(te);
+        te = next;
+    }
+}
+
+static void thread_error_key_init(void) {
+    pthread_key_create(&thread_error_key, thread_errors_free);
+}
+
+/* Find this thread's error for NCF; create it if CREATE */
+static struct thread_error *thread_error(const struct netcf *ncf,
+                                         bool create) {
+    struct thread_error *head, *te;
+
+    pthread_once(&thread_error_once, thread_error_key_init);
+    head = pthread_getspecific(thread_error_key);
+    for (te = head; te != NULL; te = te->next) {
+        if (te->ncf == ncf && te->serial == ncf->serial)
+            return te;
+    }
+    if (!create)
+        return NULL;
+
+    /* Reuse the entry of a handle that was closed, if there is one */
+    for (te = head; te != NULL; te = te->next) {
+        if (te->ncf == ncf)
+            break;
+    }
+    if (te == NULL) {
+        te = calloc(1, sizeof(*te));
+        if (te == NULL)
+            return NULL;
+        te->ncf = ncf;
+        te->next = head;
+        pthread_setspecific(thread_error_key, te);
+    }
+    te->serial = ncf->serial;
+    return te;
+}
+
+/* Free this thread's error for NCF, which is being closed, so that a
+ * thread that opens and closes many handles doesn't pile them up. The
+ * errors other threads keep for NCF go when they exit, or are reused for
+ * the next handle at the same address */
+static void thread_error_remove(const struct netcf *ncf) {
+    struct thread_error *head, **tep;
+
+    pthread_once(&thread_error_once, thread_error_key_init);
+    head = pthread_getspecific(thread_error_key);
+    for (tep = &head; *tep != NULL; tep = &(*tep)->next) {
+        struct thread_error *te = *tep;
+
+        if (te->ncf == ncf) {
+            *tep = te->next;
+            free(te->errdetails);
+            free(te);
+            pthread_setspecific(thread_error_key, head);
+            return;
+        }
+    }
+}
+#endif
+
+int api_init(struct netcf *ncf) {
+    static unsigned long serial = 0;
+
+    ncf->serial = __atomic_add_fetch(&serial, 1, __ATOMIC_RELAXED);
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutexattr_t attr;
+    pthread_rwlockattr_t rwattr;
+    int r;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    r = pthread_mutex_init(&ncf->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (r != 0)
+        return -1;
+
+    /* Don't let a steady stream of queries starve out a define */
+    pthread_rwlockattr_init(&rwattr);
+#ifdef __GLIBC__
+    pthread_rwlockattr_setkind_np(&rwattr,
+                                  PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    r = pthread_rwlock_init(&ncf->calls, &rwattr);
+    pthread_rwlockattr_destroy(&rwattr);
+    if (r != 0) {
+        pthread_mutex_destroy(&ncf->lock);
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+void api_destroy(struct netcf *ncf) {
+#ifdef HAVE_LIBPTHREAD
+    thread_error_remove(ncf);
+    pthread_rwlock_destroy(&ncf->calls);
+    pthread_mutex_destroy(&ncf->lock);
+#endif
+}
+
+static struct netcf *api_lock(struct netcf *ncf) {
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_lock(&ncf->lock);
+#endif
+    ncf->errcode = NETCF_NOERROR;
+    FREE(ncf->errdetails);
+    if (ncf->driver != NULL)
+        drv_entry(ncf);
+    return ncf;
+}
+
+struct netcf *api_enter(struct netcf *ncf) {
+#ifdef HAVE_LIBPTHREAD
+    pthread_rwlock_wrlock(&ncf->calls);
+#endif
+    return api_lock(ncf);
+}
+
+struct netcf *api_enter_read(struct netcf *ncf) {
+#ifdef HAVE_LIBPTHREAD
+    pthread_rwlock_rdlock(&ncf->calls);
+#endif
+    return api_lock(ncf);
+}
+
+int api_enter_exclusive(struct netcf *ncf) {
+#ifdef HAVE_LIBPTHREAD
+    struct thread_error *te;
+
+    if (pthread_rwlock_trywrlock(&ncf->calls) != 0) {
+        te = thread_error(ncf, true);
+        if (te != NULL) {
+            te->errcode = NETCF_EINUSE;
+            FREE(te->errdetails);
+        }
+        return -1;
+    }
+    pthread_mutex_lock(&ncf->lock);
+#endif
+    ncf->errcode = NETCF_NOERROR;
+    FREE(ncf->errdetails);
+    return 0;
+}
+
+void api_exit(struct netcf **ncfp) {
+    struct netcf *ncf = *ncfp;
+
+    if (ncf == NULL)
+        return;
+#ifdef HAVE_LIBPTHREAD
+    struct thread_error *te = thread_error(ncf, true);
+
+    if (te != NULL) {
+        te->errcode = ncf->errcode;
+        FREE(te->errdetails);
+        if (ncf->errdetails != NULL)
+            te->errdetails = strdup(ncf->errdetails);
+    }
+    pthread_mutex_unlock(&ncf->lock);
+    pthread_rwlock_unlock(&ncf->calls);
+#endif
+}
+
+/* Only called when there is no error to set aside yet, which saves us
+ * from having to put it somewhere */
+void api_suspend(struct netcf *ncf) {
+    assert(ncf->errcode == NETCF_NOERROR);
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&ncf->lock);
+#endif
+}
+
+void api_resume(struct netcf *ncf) {
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_lock(&ncf->lock);
+#endif
+    /* Whatever is here now was left behind by other threads */
+    ncf->errcode = NETCF_NOERROR;
+    FREE(ncf->errdetails);
+}
+
+netcf_errcode_t api_error(struct netcf *ncf, const char **details) {
+#ifdef HAVE_LIBPTHREAD
+    struct thread_error *te = thread_error(ncf, false);
+
+    if (te != NULL) {
+        *details = te->errdetails;
+        return te->errcode;
+    }
+#endif
+    /* No API call from this thread yet, e.g. right after ncf_init */
+    *details = ncf->errdetails;
+    return ncf->errcode;
+}
+
+static unsigned long long now_nsecs(void) {
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+/* Other threads may be updating the same statistic, e.g. around XSLT
+ * which runs with the lock suspended, so everything here is atomic. A
+ * reader can see the fields of one statistic slightly out of step with
+ * each other, which does not matter for what they are used for */
+static void stats_add(struct netcf *ncf, netcf_stat_t stat,
+                      unsigned long long ns) {
+    struct netcf_stat *st = ncf->stats + stat;
+    unsigned long long usecs = ns / 1000;
+    unsigned long long max;
+    int bucket = 0;
+
+    if (usecs > 0)
+        bucket = 63 - __builtin_clzll(usecs);
+    if (bucket >= NETCF_STAT_BUCKETS)
+        bucket = NETCF_STAT_BUCKETS - 1;
+
+    __atomic_add_fetch(&st->count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&st->total_ns, ns, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&st->hist[bucket], 1, __ATOMIC_RELAXED);
+    max = __atomic_load_n(&st->max_ns, __ATOMIC_RELAXED);
+    while (ns > max &&
+           !__atomic_compare_exchange_n(&st->max_ns, &max, ns, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+struct span span_begin(struct netcf *ncf, netcf_stat_t kind,
+                       const char *attr) {
+    static unsigned long long ids = 0;
+    struct span span;
+
+    span.ncf = ncf;
+    span.info.id = __atomic_add_fetch(&ids, 1, __ATOMIC_RELAXED);
+    span.info.kind = kind;
+    span.info.attr = attr;
+    span.info.start_ns = now_nsecs();
+    span.info.end_ns = 0;
+
+    STAP_PROBE3(netcf, span_begin, span.info.id, ncf_stat_name(kind), attr);
+    if (ncf->trace_cb != NULL)
+        ncf->trace_cb(ncf->trace_opaque, NETCF_TRACE_BEGIN, &span.info);
+    return span;
+}
+
+void span_end(struct span *span) {
+    struct netcf *ncf = span->ncf;
+    unsigned long long ns;
+
+    span->info.end_ns = now_nsecs();
+    ns = span->info.end_ns - span->info.start_ns;
+    stats_add(ncf, span->info.kind, ns);
+
+    STAP_PROBE4(netcf, span_end, span->info.id,
+                ncf_stat_name(span->info.kind), span->info.attr, ns);
+    if (ncf->trace_cb != NULL)
+        ncf->trace_cb(ncf->trace_opaque, NETCF_TRACE_END, &span->info);
+}
+
 /* Like asprintf, but set *STRP to NULL on error */
 int xasprintf(char **strp, const char *format, ...) {
   va_list args;
@@ -193,6 +494,28 @@ void vreport_error(struct netcf *ncf, netcf_errcode_t errcode,
     }
 }
 
+netcf_errcode_t error_set_aside(struct netcf *ncf, struct ncf_error *err) {
+    netcf_errcode_t errcode = ncf->errcode;
+
+    if (errcode != NETCF_NOERROR && err->errcode == NETCF_NOERROR) {
+        err->errcode = errcode;
+        err->details = ncf->errdetails;
+        ncf->errdetails = NULL;
+    }
+    ncf->errcode = NETCF_NOERROR;
+    FREE(ncf->errdetails);
+    return errcode;
+}
+
+void error_restore(struct netcf *ncf, struct ncf_error *err) {
+    if (err->errcode == NETCF_NOERROR)
+        return;
+    ncf->errcode = err->errcode;
+    FREE(ncf->errdetails);
+    ncf->errdetails = err->details;
+    err->errcode = NETCF_NOERROR;
+    err->details = NULL;
+}
 
 xsltStylesheetPtr parse_stylesheet(struct netcf *ncf,
                                           const char *fname) {
@@ -219,29 +542,39 @@ xsltStylesheetPtr parse_stylesheet(struct netcf *ncf,
     return result;
 }
 
+/* The first error from an XSLT transform. Transforms record their errors
+ * here rather than in the struct netcf, so that they can run without
+ * holding its lock */
+struct xslt_error {
+    netcf_errcode_t errcode;
+    char           *details;
+};
+
 ATTRIBUTE_FORMAT(printf, 2, 3)
 static void apply_stylesheet_error(void *ctx, const char *format, ...) {
-    struct netcf *ncf = ctx;
+    struct xslt_error *err = ctx;
     va_list ap;
 
+    if (err->errcode != NETCF_NOERROR)
+        return;
+    err->errcode = NETCF_EXSLTFAILED;
     va_start(ap, format);
-    vreport_error(ncf, NETCF_EXSLTFAILED, format, ap);
+    if (vasprintf(&err->details, format, ap) < 0)
+        err->details = NULL;
     va_end(ap);
 }
 
-xmlDocPtr apply_stylesheet(struct netcf *ncf, xsltStylesheetPtr style,
-                           xmlDocPtr doc) {
+static xmlDocPtr transform(xsltStylesheetPtr style, xmlDocPtr doc,
+                           struct xslt_error *err) {
     xsltTransformContextPtr ctxt;
     xmlDocPtr res = NULL;
-    int r;
 
     ctxt = xsltNewTransformContext(style, doc);
-    ERR_NOMEM(ctxt == NULL, ncf);
-
-    xsltSetTransformErrorFunc(ctxt, ncf, apply_stylesheet_error);
-
-    r = xslt_register_exts(ctxt);
-    ERR_NOMEM(r < 0, ncf);
+    if (ctxt == NULL || xslt_register_exts(ctxt) < 0) {
+        err->errcode = NETCF_ENOMEM;
+        goto done;
+    }
+    xsltSetTransformErrorFunc(ctxt, err, apply_stylesheet_error);
 
     res = xsltApplyStylesheetUser(style, doc, NULL, NULL, NULL, ctxt);
     if ((ctxt->state == XSLT_STATE_ERROR) ||
@@ -249,14 +582,49 @@ xmlDocPtr apply_stylesheet(struct netcf *ncf, xsltStylesheetPtr style,
         xmlFreeDoc(res);
         res = NULL;
         /* Fallback, in case our error handler isn't called */
-        report_error(ncf, NETCF_EXSLTFAILED, NULL);
+        if (err->errcode == NETCF_NOERROR)
+            err->errcode = NETCF_EXSLTFAILED;
     }
 
-error:
+ done:
     xsltFreeTransformContext(ctxt);
     return res;
 }
 
+/* The file name of STYLE, for tracing */
+static const char *stylesheet_name(xsltStylesheetPtr style) {
+    const char *url, *name;
+
+    if (style->doc == NULL || style->doc->URL == NULL)
+        return NULL;
+    url = (const char *) style->doc->URL;
+    name = strrchr(url, '/');
+    return name != NULL ? name + 1 : url;
+}
+
+static void report_xslt_error(struct netcf *ncf, struct xslt_error *err) {
+    if (err->errcode == NETCF_NOERROR)
+        return;
+    if (err->details != NULL)
+        report_error(ncf, err->errcode, "%s", err->details);
+    else
+        report_error(ncf, err->errcode, NULL);
+    FREE(err->details);
+}
+
+xmlDocPtr apply_stylesheet(struct netcf *ncf, xsltStylesheetPtr style,
+                           xmlDocPtr doc) {
+    struct xslt_error err = { NETCF_NOERROR, NULL };
+    struct span span = span_begin(ncf, NETCF_STAT_XSLT,
+                                  stylesheet_name(style));
+    xmlDocPtr res;
+
+    res = transform(style, doc, &err);
+    span_end(&span);
+    report_xslt_error(ncf, &err);
+    return res;
+}
+
 char *apply_stylesheet_to_string(struct netcf *ncf, xsltStylesheetPtr style,
                                  xmlDocPtr doc) {
     xmlDocPtr doc_xfm = NULL;
@@ -277,6 +645,27 @@ char *apply_stylesheet_to_string(struct netcf *ncf, xsltStylesheetPtr style,
     return NULL;
 }
 
+int apply_stylesheet_to_output(struct netcf *ncf, xsltStylesheetPtr style,
+                               xmlDocPtr doc, xmlOutputBufferPtr out) {
+    struct xslt_error err = { NETCF_NOERROR, NULL };
+    struct span span;
+    xmlDocPtr doc_xfm;
+
+    /* Neither DOC nor OUT are shared with anybody, and STYLE does not
+     * change after drv_init, so the transform does not need the lock */
+    api_suspend(ncf);
+    span = span_begin(ncf, NETCF_STAT_XSLT, stylesheet_name(style));
+    doc_xfm = transform(style, doc, &err);
+    span_end(&span);
+    if (doc_xfm != NULL && xsltSaveResultTo(out, doc_xfm, style) < 0)
+        err.errcode = NETCF_ENOMEM;
+    xmlFreeDoc(doc_xfm);
+    api_resume(ncf);
+
+    report_xslt_error(ncf, &err);
+    return err.errcode == NETCF_NOERROR ? 0 : -1;
+}
+
 /* Callback for reporting RelaxNG errors */
 void rng_error(void *ctx, const char *format, ...) {
     struct netcf *ncf = ctx;
@@ -287,12 +676,38 @@ void rng_error(void *ctx, const char *format, ...) {
     va_end(ap);
 }
 
-xmlRelaxNGPtr rng_parse(struct netcf *ncf, const char *fname) {
+/* Namespace of the v:serial attribute in our schemas */
+#define VERSION_NS "http://netcf.org/xml/version/1.0"
+
+/* Return the v:serial of the start element of the schema DOC, or -1 */
+static int rng_serial(xmlDocPtr doc) {
+    xmlNodePtr cur = xmlDocGetRootElement(doc);
+    xmlChar *serial;
+    int result = -1;
+
+    for (cur = cur ? cur->children : NULL; cur != NULL; cur = cur->next) {
+        if (cur->type == XML_ELEMENT_NODE
+            && xmlStrEqual(cur->name, BAD_CAST "start"))
+            break;
+    }
+    if (cur == NULL)
+        return -1;
+
+    serial = xmlGetNsProp(cur, BAD_CAST "serial", BAD_CAST VERSION_NS);
+    if (serial != NULL)
+        result = atoi((char *) serial);
+    xmlFree(serial);
+    return result;
+}
+
+xmlRelaxNGPtr rng_parse(struct netcf *ncf, const char *fname, int *serial) {
     char *path = NULL;
     xmlRelaxNGPtr result = NULL;
     xmlRelaxNGParserCtxtPtr ctxt = NULL;
+    xmlDocPtr doc = NULL;
     int r;
 
+    *serial = -1;
     r = xasprintf(&path, "%s/xml/%s", ncf->data_dir, fname);
     ERR_NOMEM(r < 0, ncf);
 
@@ -302,21 +717,41 @@ xmlRelaxNGPtr rng_parse(struct netcf *ncf, const char *fname) {
         goto error;
     }
 
-    ctxt = xmlRelaxNGNewParserCtxt(path);
+    doc = xmlReadFile(path, NULL, XML_PARSE_NONET);
+    ERR_THROW(doc == NULL, ncf, EFILE, "Could not parse %s", path);
+    *serial = rng_serial(doc);
+
+    ctxt = xmlRelaxNGNewDocParserCtxt(doc);
+    ERR_NOMEM(ctxt == NULL, ncf);
     xmlRelaxNGSetParserErrors(ctxt, rng_error, rng_error, ncf);
 
     result = xmlRelaxNGParse(ctxt);
 
  error:
     xmlRelaxNGFreeParserCtxt(ctxt);
+    xmlFreeDoc(doc);
     free(path);
     return result;
 }
 
 void rng_validate(struct netcf *ncf, xmlDocPtr doc) {
     xmlRelaxNGValidCtxtPtr ctxt;
+    struct span span = span_begin(ncf, NETCF_STAT_RNG_VALIDATE, NULL);
     int r;
 
+#ifndef WIN32
+    /* The compiled validator only ever says yes when the interpreter
+     * would, too; for anything it rejects, we run the interpreter to get
+     * a definite answer and proper error messages */
+    if (ncf->rngc != NULL && rngc_validate(ncf->rngc, doc) == 1) {
+        NCF_COUNT(ncf, RNG_NATIVE);
+        span_end(&span);
+        return;
+    }
+#endif
+
+    NCF_COUNT(ncf, RNG_VALIDATE);
+
     ctxt = xmlRelaxNGNewValidCtxt(ncf->rng);
     xmlRelaxNGSetValidErrors(ctxt, rng_error, rng_error, ncf);
 
@@ -326,6 +761,82 @@ void rng_validate(struct netcf *ncf, xmlDocPtr doc) {
            "Interface definition fails to validate");
 
     xmlRelaxNGFreeValidCtxt(ctxt);
+    span_end(&span);
+}
+
+/* The serial of the schema the caller validated with is kept in bits
+ * 8-15 of the flags, see NETCF_DEFINE_VALIDATED */
+#define DEFINE_SERIAL(flags) ((int) (((flags) >> 8) & 0xff))
+
+void rng_validate_cached(struct netcf *ncf, xmlDocPtr doc,
+                         const char *xml_str, unsigned int flags) {
+    unsigned char digest[RNG_DIGEST_SIZE];
+    struct rng_cache_entry *lru = ncf->rng_cache;
+
+    if ((flags & NETCF_DEFINE_VALIDATED & 0xff)
+        && DEFINE_SERIAL(flags) == ncf->rng_serial) {
+        NCF_COUNT(ncf, RNG_TRUSTED);
+        return;
+    }
+
+    sha256_buffer(xml_str, strlen(xml_str), digest);
+    for (int i=0; i < RNG_CACHE_SIZE; i++) {
+        struct rng_cache_entry *entry = ncf->rng_cache + i;
+
+        if (entry->used > 0
+            && memcmp(entry->digest, digest, RNG_DIGEST_SIZE) == 0) {
+            entry->used = ++ncf->rng_cache_clock;
+            NCF_COUNT(ncf, RNG_CACHED);
+            return;
+        }
+        if (entry->used < lru->used)
+            lru = entry;
+    }
+
+    rng_validate(ncf, doc);
+    if (ncf->errcode == NETCF_NOERROR) {
+        memcpy(lru->digest, digest, RNG_DIGEST_SIZE);
+        lru->used = ++ncf->rng_cache_clock;
+    }
+}
+
+int ncf_validate_xml(struct netcf *ncf, const char *ncf_xml, int native) {
+    xmlDocPtr doc = NULL;
+    struct rngc *rngc = ncf->rngc;
+    int result = -1;
+
+    API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
+
+    doc = parse_xml(ncf, ncf_xml);
+    ERR_BAIL(ncf);
+
+    if (native) {
+        ERR_THROW(rngc == NULL, ncf, EINVALIDOP,
+                  "no compiled validator for schema serial %d",
+                  ncf->rng_serial);
+#ifndef WIN32
+        result = rngc_validate(rngc, doc);
+#endif
+        goto error;
+    }
+
+    /* Hide the compiled validator from rng_validate */
+    ncf->rngc = NULL;
+    rng_validate(ncf, doc);
+    ncf->rngc = rngc;
+    if (ncf->errcode == NETCF_EXMLINVALID) {
+        ncf->errcode = NETCF_NOERROR;
+        FREE(ncf->errdetails);
+        result = 0;
+    } else if (ncf->errcode == NETCF_NOERROR) {
+        result = 1;
+    }
+
+ error:
+    xmlFreeDoc(doc);
+    return result;
 }
 
 /* Called from SAX on parsing errors in the XML. */
@@ -416,4 +927,32 @@ xmlNodePtr xml_node(xmlDocPtr doc,
     return ret;
 }
 
+int if_up_down_each(struct netcf *ncf, int nifaces, struct netcf_if **ifaces,
+                    bool up, int *status) {
+    netcf_errcode_t errcode = NETCF_NOERROR;
+    char *errdetails = NULL;
+    int result = 0;
+
+    for (int n=0; n < nifaces; n++) {
+        int i = up ? n : nifaces - 1 - n;
+
+        if ((up ? drv_if_up(ifaces[i]) : drv_if_down(ifaces[i])) == 0) {
+            result += 1;
+            continue;
+        }
+        /* Keep going, but remember the first failure */
+        status[i] = ncf->errcode;
+        if (errcode == NETCF_NOERROR) {
+            errcode = ncf->errcode;
+            errdetails = ncf->errdetails;
+            ncf->errdetails = NULL;
+        }
+        ncf->errcode = NETCF_NOERROR;
+        FREE(ncf->errdetails);
+    }
+    ncf->errcode = errcode;
+    ncf->errdetails = errdetails;
+    return result;
+}
+
 /* vim: set ts=4 sw=4 et: */
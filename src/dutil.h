@@ -58,6 +58,20 @@ void vreport_error(struct netcf *ncf, netcf_errcode_t errcode,
                    const char *format, va_list ap)
     ATTRIBUTE_FORMAT(printf, 3, 0);
 
+/* The first of several errors, set aside so that we can carry on with
+ * the work that does not depend on what failed */
+struct ncf_error {
+    netcf_errcode_t  errcode;
+    char            *details;
+};
+
+/* Move the error in NCF to ERR, unless ERR already holds one, and clear
+ * the error in NCF. Returns the error code NCF had */
+netcf_errcode_t error_set_aside(struct netcf *ncf, struct ncf_error *err);
+
+/* Make the error in ERR, if there is one, the error of NCF */
+void error_restore(struct netcf *ncf, struct ncf_error *err);
+
 /* XSLT extension functions in xslt_ext.c */
 int xslt_register_exts(xsltTransformContextPtr ctxt);
 
@@ -73,15 +87,29 @@ xmlDocPtr apply_stylesheet(struct netcf *ncf, xsltStylesheetPtr style,
 char *apply_stylesheet_to_string(struct netcf *ncf, xsltStylesheetPtr style,
                                  xmlDocPtr doc);
 
+/* Same as APPLY_STYLESHEET, but write the resulting XML document to OUT.
+ * NCF is unlocked while the transform runs, so that other threads can use
+ * it; DOC and OUT must therefore not be shared with anything else */
+int apply_stylesheet_to_output(struct netcf *ncf, xsltStylesheetPtr style,
+                               xmlDocPtr doc, xmlOutputBufferPtr out);
+
 /* Callback for reporting RelaxNG errors */
 void rng_error(void *ctx, const char *format, ...);
 
-/* Initialize a rng pointer from the file NCF->data_dir/xml/FNAME */
-xmlRelaxNGPtr rng_parse(struct netcf *ncf, const char *fname);
+/* Initialize a rng pointer from the file NCF->data_dir/xml/FNAME. The
+ * v:serial of its start element is stored in SERIAL, or -1 if there is
+ * none */
+xmlRelaxNGPtr rng_parse(struct netcf *ncf, const char *fname, int *serial);
 
 /* Validate the xml document doc using the previously initialized rng pointer */
 void rng_validate(struct netcf *ncf, xmlDocPtr doc);
 
+/* Validate DOC, which was parsed from XML_STR, like RNG_VALIDATE, but
+ * skip the validation if XML_STR passed it before, or if FLAGS (from
+ * NETCF_DEFINE_FLAG_T) indicate that the caller already validated it */
+void rng_validate_cached(struct netcf *ncf, xmlDocPtr doc,
+                         const char *xml_str, unsigned int flags);
+
 /* Called from SAX on parsing errors in the XML. */
 void catch_xml_error(void *ctx, const char *msg ATTRIBUTE_UNUSED, ...);
 
@@ -103,6 +131,13 @@ xmlNodePtr xml_new_node(xmlDocPtr doc,
 xmlNodePtr xml_node(xmlDocPtr doc,
                     xmlNodePtr parent, const char *name);
 
+/* Bring the NIFACES interfaces in IFACES up (or down if UP is false) one
+ * at a time with drv_if_up or drv_if_down, in the order given for up and
+ * in the opposite order for down, for drivers that can not do better.
+ * Follows the conventions of ncf_if_up_many */
+int if_up_down_each(struct netcf *ncf, int nifaces, struct netcf_if **ifaces,
+                    bool up, int *status);
+
 #endif
 
 /* vim: set ts=4 sw=4 et: */
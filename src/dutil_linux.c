@@ -42,17 +42,26 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <linux/fs.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
+#include "configmake.h"
 #include "safe-alloc.h"
 #include "read-file.h"
 #include "ref.h"
 #include "list.h"
 #include "netcf.h"
 #include "dutil.h"
+#include "dutil_posix.h"
 #include "dutil_linux.h"
+#include "shm.h"
 
 #ifndef AVOID_NET_IF_H
 # include <net/if.h>
@@ -194,8 +203,10 @@ augeas *get_augeas(struct netcf *ncf) {
     if (ncf->driver->load_augeas &&
         ncf->driver->load_augeas_time != current_time) {
         augeas *aug = ncf->driver->augeas;
+        struct span span = span_begin(ncf, NETCF_STAT_AUG_LOAD, NULL);
 
         r = aug_load(aug);
+        span_end(&span);
         ERR_THROW(r < 0, ncf, EOTHER, "failed to load config files");
 
         /* FIXME: we need to produce _much_ better diagnostics here - need
@@ -220,17 +231,9 @@ augeas *get_augeas(struct netcf *ncf) {
     return NULL;
 }
 
-int aug_save_assert(struct netcf *ncf)
-{
-    int r = -1;
+/* Report the errors from a failed aug_save */
+static void report_save_error(struct netcf *ncf, augeas *aug) {
     const char *err, *errmsg, *path = "unknown";
-    augeas *aug = get_augeas(ncf);
-
-    ERR_BAIL(ncf);
-
-    r = aug_save(aug);
-    if (r >= 0)
-        goto done;
 
     if (NCF_DEBUG(ncf)) {
         fprintf(stderr, "Errors from aug_save:\n");
@@ -255,12 +258,1090 @@ int aug_save_assert(struct netcf *ncf)
     } else {
         report_error(ncf, NETCF_EOTHER, "aug_save failed: unknown failure");
     }
+}
+
+int aug_save_assert(struct netcf *ncf)
+{
+    int r = -1;
+    augeas *aug = get_augeas(ncf);
+
+    ERR_BAIL(ncf);
+
+    if (ncf->durability != NETCF_DURABILITY_DEFAULT)
+        return aug_save_group(ncf);
+
+    r = aug_save(aug);
+    if (r < 0)
+        report_save_error(ncf, aug);
 
  error:
- done:
     return r;
 }
 
+void aug_revert(struct netcf *ncf) {
+    ncf->driver->load_augeas = 1;
+    ncf->driver->load_augeas_time = 0;
+}
+
+/* Suffix of the links to the old contents of files that aug_save_group
+ * keeps while saving */
+#define SAVE_GROUP_BACKUP ".netcf-backup"
+
+/* Suffix that augeas adds to new files in "newfile" mode */
+#define SAVE_GROUP_STAGED ".augnew"
+
+/* Add the file for the augeas path PATH to the list FILES of NFILES
+ * file names, unless it is already there */
+static void add_save_group_file(struct netcf *ncf, const char *path,
+                                char ***files, int *nfiles) {
+    char *fname = NULL;
+    int r;
+
+    if (! STREQLEN(path, "/files/", strlen("/files/")))
+        return;
+    r = xasprintf(&fname, "%s%s", ncf->root, path + strlen("/files/"));
+    ERR_NOMEM(r < 0, ncf);
+
+    for (int i=0; i < *nfiles; i++) {
+        if (STREQ((*files)[i], fname)) {
+            FREE(fname);
+            return;
+        }
+    }
+    r = REALLOC_N(*files, *nfiles + 1);
+    ERR_NOMEM(r < 0, ncf);
+    (*files)[(*nfiles)++] = fname;
+    return;
+ error:
+    FREE(fname);
+}
+
+/* List the files that the next aug_save will write or delete */
+static int save_group_files(struct netcf *ncf, augeas *aug, char ***files) {
+    char **matches = NULL;
+    int nmatches = 0, nfiles = 0, r;
+    const char *path;
+
+    *files = NULL;
+
+    /* A dry run records all the files it would write */
+    r = aug_set(aug, "/augeas/save", "noop");
+    ERR_THROW(r < 0, ncf, EOTHER, "failed to set augeas save mode");
+    r = aug_save(aug);
+    aug_set(aug, "/augeas/save", "overwrite");
+    if (r < 0) {
+        report_save_error(ncf, aug);
+        goto error;
+    }
+
+    nmatches = aug_match(aug, "/augeas/events/saved", &matches);
+    ERR_COND_BAIL(nmatches < 0, ncf, EOTHER);
+    for (int i=0; i < nmatches; i++) {
+        r = aug_get(aug, matches[i], &path);
+        if (r == 1 && path != NULL) {
+            add_save_group_file(ncf, path, files, &nfiles);
+            ERR_BAIL(ncf);
+        }
+    }
+    free_matches(nmatches, &matches);
+
+    /* Files whose tree was removed entirely will be deleted */
+    nmatches = aug_match(aug, "/augeas/files//path", &matches);
+    ERR_COND_BAIL(nmatches < 0, ncf, EOTHER);
+    for (int i=0; i < nmatches; i++) {
+        r = aug_get(aug, matches[i], &path);
+        if (r == 1 && path != NULL && aug_match(aug, path, NULL) == 0) {
+            add_save_group_file(ncf, path, files, &nfiles);
+            ERR_BAIL(ncf);
+        }
+    }
+    free_matches(nmatches, &matches);
+
+    return nfiles;
+ error:
+    free_matches(nmatches, &matches);
+    free_matches(nfiles, files);
+    return -1;
+}
+
+/* The order in which save_group_staged moves the new version of FNAME
+ * into place: files that others refer to go first, so that a crash
+ * halfway through does not leave behind, for example, a bond slave
+ * without its master */
+static int save_group_rank(const char *fname) {
+    char *staged = NULL, *text = NULL;
+    size_t length;
+    int rank = 1;
+
+    if (strstr(fname, "/modprobe.d/") != NULL
+        || strstr(fname, "/modprobe.conf") != NULL)
+        return 0;
+
+    if (xasprintf(&staged, "%s" SAVE_GROUP_STAGED, fname) < 0)
+        return rank;
+    text = read_file(staged, &length);
+    if (text != NULL) {
+        for (char *line = text; line != NULL; line = strchr(line, '\n')) {
+            if (*line == '\n')
+                line += 1;
+            if (STREQLEN(line, "MASTER=", strlen("MASTER="))) {
+                rank = 3;
+                break;
+            }
+            if (STREQLEN(line, "BRIDGE=", strlen("BRIDGE=")))
+                rank = 2;
+        }
+    }
+    FREE(text);
+    FREE(staged);
+    return rank;
+}
+
+/* Flush the staged versions of FILES to disk. If we can, we sync each
+ * filesystem involved once, rather than every file */
+static void save_group_flush(struct netcf *ncf, int nfiles, char **files) {
+    char *staged = NULL;
+#ifdef HAVE_SYNCFS
+    dev_t *synced = NULL;
+    int nsynced = 0;
+#endif
+    int fd = -1, r;
+
+    for (int i=0; i < nfiles; i++) {
+        r = xasprintf(&staged, "%s" SAVE_GROUP_STAGED, files[i]);
+        ERR_NOMEM(r < 0, ncf);
+        fd = open(staged, O_RDONLY|O_CLOEXEC);
+        if (fd < 0) {
+            /* Files that are being deleted have no staged version */
+            ERR_THROW(errno != ENOENT, ncf, EFILE, "failed to open %s: %s",
+                      staged, strerror(errno));
+            FREE(staged);
+            continue;
+        }
+#ifdef HAVE_SYNCFS
+        struct stat st;
+        bool seen = false;
+
+        ERR_THROW(fstat(fd, &st) < 0, ncf, EFILE, "failed to stat %s: %s",
+                  staged, strerror(errno));
+        for (int j=0; j < nsynced; j++)
+            seen = seen || synced[j] == st.st_dev;
+        if (! seen) {
+            ERR_THROW(syncfs(fd) < 0, ncf, EFILE, "failed to sync %s: %s",
+                      staged, strerror(errno));
+            r = REALLOC_N(synced, nsynced + 1);
+            ERR_NOMEM(r < 0, ncf);
+            synced[nsynced++] = st.st_dev;
+        }
+#else
+        ERR_THROW(fdatasync(fd) < 0, ncf, EFILE, "failed to sync %s: %s",
+                  staged, strerror(errno));
+#endif
+        close(fd);
+        fd = -1;
+        FREE(staged);
+    }
+ error:
+    if (fd >= 0)
+        close(fd);
+    FREE(staged);
+#ifdef HAVE_SYNCFS
+    FREE(synced);
+#endif
+}
+
+/* Make the renames into the directories of FILES durable */
+static void save_group_sync_dirs(struct netcf *ncf, int nfiles, char **files) {
+    char *dir = NULL;
+    int fd;
+
+    for (int i=0; i < nfiles; i++) {
+        const char *slash = strrchr(files[i], '/');
+        bool seen = false;
+
+        if (slash == NULL)
+            continue;
+        for (int j=0; j < i; j++) {
+            const char *s = strrchr(files[j], '/');
+            seen = seen || (s != NULL && s - files[j] == slash - files[i]
+                            && STREQLEN(files[j], files[i], s - files[j]));
+        }
+        if (seen)
+            continue;
+
+        dir = strndup(files[i], slash == files[i] ? 1 : slash - files[i]);
+        ERR_NOMEM(dir == NULL, ncf);
+        fd = open(dir, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+        ERR_THROW(fd < 0, ncf, EFILE, "failed to open %s: %s",
+                  dir, strerror(errno));
+        if (fsync(fd) < 0) {
+            report_error(ncf, NETCF_EFILE, "failed to sync %s: %s",
+                         dir, strerror(errno));
+            close(fd);
+            goto error;
+        }
+        close(fd);
+        FREE(dir);
+    }
+ error:
+    FREE(dir);
+}
+
+/* Save by having augeas write new versions of FILES next to the old
+ * ones, flushing them according to the durability policy, and renaming
+ * them into place in dependency order. Augeas deletes files right away
+ * even in "newfile" mode; we only make sure they are gone at the end */
+static void save_group_staged(struct netcf *ncf, augeas *aug,
+                              int nfiles, char **files) {
+    char *staged = NULL;
+    int *order = NULL, *rank = NULL;
+    int r;
+
+    r = aug_set(aug, "/augeas/save", "newfile");
+    ERR_THROW(r < 0, ncf, EOTHER, "failed to set augeas save mode");
+    r = aug_save(aug);
+    aug_set(aug, "/augeas/save", "overwrite");
+    if (r < 0) {
+        report_save_error(ncf, aug);
+        goto error;
+    }
+
+    if (ncf->durability != NETCF_DURABILITY_NONE) {
+        save_group_flush(ncf, nfiles, files);
+        ERR_BAIL(ncf);
+    }
+
+    r = ALLOC_N(order, nfiles);
+    ERR_NOMEM(r < 0, ncf);
+    r = ALLOC_N(rank, nfiles);
+    ERR_NOMEM(r < 0, ncf);
+    for (int i=0; i < nfiles; i++) {
+        int j;
+
+        rank[i] = save_group_rank(files[i]);
+        for (j = i; j > 0 && rank[order[j-1]] > rank[i]; j--)
+            order[j] = order[j-1];
+        order[j] = i;
+    }
+
+    for (int i=0; i < nfiles; i++) {
+        const char *fname = files[order[i]];
+
+        r = xasprintf(&staged, "%s" SAVE_GROUP_STAGED, fname);
+        ERR_NOMEM(r < 0, ncf);
+        if (rename(staged, fname) < 0) {
+            ERR_THROW(errno != ENOENT, ncf, EFILE,
+                      "failed to rename %s to %s: %s",
+                      staged, fname, strerror(errno));
+            ERR_THROW(unlink(fname) < 0 && errno != ENOENT, ncf, EFILE,
+                      "failed to remove %s: %s", fname, strerror(errno));
+        }
+        FREE(staged);
+    }
+
+    if (ncf->durability == NETCF_DURABILITY_FULL)
+        save_group_sync_dirs(ncf, nfiles, files);
+
+ error:
+    FREE(staged);
+    FREE(order);
+    FREE(rank);
+}
+
+int aug_save_group(struct netcf *ncf) {
+    augeas *aug = NULL;
+    char **files = NULL;
+    bool *backed_up = NULL;
+    char *backup = NULL;
+    bool saving = false;
+    int nfiles = 0, r, result = -1;
+
+    aug = get_augeas(ncf);
+    ERR_BAIL(ncf);
+
+    nfiles = save_group_files(ncf, aug, &files);
+    ERR_BAIL(ncf);
+    r = ALLOC_N(backed_up, nfiles);
+    ERR_NOMEM(r < 0, ncf);
+
+    /* Keep a link to the old contents of every file. Augeas writes files
+     * by renaming a new file over the old one, which leaves the link
+     * pointing at the old contents */
+    for (int i=0; i < nfiles; i++) {
+        r = xasprintf(&backup, "%s" SAVE_GROUP_BACKUP, files[i]);
+        ERR_NOMEM(r < 0, ncf);
+        if (unlink(backup) < 0 && errno != ENOENT) {
+            report_error(ncf, NETCF_EFILE, "failed to remove %s: %s",
+                         backup, strerror(errno));
+        } else if (link(files[i], backup) == 0) {
+            backed_up[i] = true;
+        } else if (errno != ENOENT) {
+            report_error(ncf, NETCF_EFILE, "failed to link %s to %s: %s",
+                         files[i], backup, strerror(errno));
+        }
+        FREE(backup);
+        if (ncf->errcode != NETCF_NOERROR)
+            goto restore;
+    }
+
+    saving = true;
+    if (ncf->durability == NETCF_DURABILITY_DEFAULT) {
+        r = aug_save(aug);
+        if (r < 0) {
+            report_save_error(ncf, aug);
+            goto restore;
+        }
+    } else {
+        save_group_staged(ncf, aug, nfiles, files);
+        if (ncf->errcode != NETCF_NOERROR)
+            goto restore;
+    }
+    result = 0;
+
+ restore:
+    /* Drop the backups, unless saving failed; in that case, put the old
+     * files back and remove new ones */
+    for (int i=0; i < nfiles; i++) {
+        r = xasprintf(&backup, "%s" SAVE_GROUP_BACKUP, files[i]);
+        if (r < 0) {
+            report_error(ncf, NETCF_ENOMEM, NULL);
+            continue;
+        }
+        if (result == 0 || ! saving) {
+            if (backed_up[i])
+                unlink(backup);
+        } else if (backed_up[i]) {
+            /* If FILES[I] was never replaced, the rename does nothing
+             * and leaves the backup in place */
+            if (rename(backup, files[i]) < 0)
+                report_error(ncf, NETCF_EFILE, "failed to restore %s: %s",
+                             files[i], strerror(errno));
+            unlink(backup);
+        } else {
+            unlink(files[i]);
+        }
+        FREE(backup);
+        if (result < 0 && saving
+            && ncf->durability != NETCF_DURABILITY_DEFAULT) {
+            if (xasprintf(&backup, "%s" SAVE_GROUP_STAGED, files[i]) >= 0)
+                unlink(backup);
+            FREE(backup);
+        }
+    }
+    if (result < 0)
+        aug_revert(ncf);
+
+ error:
+    FREE(backed_up);
+    free_matches(nfiles, &files);
+    return result;
+}
+
+/*
+ * Transactions
+ *
+ * A transaction is a snapshot of the network configuration files, taken
+ * by snapshot_begin into NETCF_SNAPSHOT_DIR. snapshot_commit throws it
+ * away, and snapshot_rollback puts the files from it back. The layout of
+ * the snapshot is the same that netcf-transaction.sh uses, so that the
+ * init script can roll back uncommitted changes at boot.
+ */
+#define NETCF_SNAPSHOT_DIR "/lib/netcf/network-snapshot"
+#define NETCF_ROLLBACK_DIR "/lib/netcf/network-rollback"
+
+/* How many old rollback directories to keep around */
+#define NETCF_ROLLBACK_KEEP 20
+
+/* Suffix for files that snapshot_rollback writes before renaming them
+ * into place */
+#define SNAPSHOT_RESTORE ".netcf-restore"
+
+/* Return the absolute path of the directory DIR under LOCALSTATEDIR */
+static char *snapshot_path(struct netcf *ncf, const char *dir) {
+    char *path = NULL;
+
+    if (xasprintf(&path, "%s%s%s", ncf->root, LOCALSTATEDIR + 1, dir) < 0)
+        report_error(ncf, NETCF_ENOMEM, NULL);
+    return path;
+}
+
+/* Create the directory PATH and all its missing parents */
+static void mkdir_parents(struct netcf *ncf, const char *path) {
+    char *dir = NULL;
+
+    dir = strdup(path);
+    ERR_NOMEM(dir == NULL, ncf);
+    for (char *p = strchr(dir + 1, '/'); ; p = strchr(p + 1, '/')) {
+        if (p != NULL)
+            *p = '\0';
+        ERR_THROW(mkdir(dir, 0755) < 0 && errno != EEXIST, ncf, EFILE,
+                  "failed to create directory %s: %s", dir, strerror(errno));
+        if (p == NULL)
+            break;
+        *p = '/';
+    }
+ error:
+    FREE(dir);
+}
+
+/* Does the file NAME in DIR belong to FILES ? */
+static bool snapshot_matches(const struct snapshot_files *files,
+                             const char *name) {
+    for (int i=0; files->prefixes[i] != NULL; i++)
+        if (STREQLEN(name, files->prefixes[i], strlen(files->prefixes[i])))
+            return true;
+    return false;
+}
+
+/* List the names of all regular files in DIR that belong to FILES. A
+ * missing DIR has no files */
+static int snapshot_list(struct netcf *ncf, const char *dir,
+                         const struct snapshot_files *files, char ***names) {
+    DIR *dp = NULL;
+    struct dirent *de;
+    struct stat st;
+    char *path = NULL;
+    int nnames = 0, r;
+
+    *names = NULL;
+    dp = opendir(dir);
+    if (dp == NULL) {
+        ERR_THROW(errno != ENOENT, ncf, EFILE, "failed to open %s: %s",
+                  dir, strerror(errno));
+        return 0;
+    }
+    while ((de = readdir(dp)) != NULL) {
+        if (! snapshot_matches(files, de->d_name))
+            continue;
+        r = xasprintf(&path, "%s/%s", dir, de->d_name);
+        ERR_NOMEM(r < 0, ncf);
+        r = stat(path, &st);
+        FREE(path);
+        if (r < 0 || ! S_ISREG(st.st_mode))
+            continue;
+        r = REALLOC_N(*names, nnames + 1);
+        ERR_NOMEM(r < 0, ncf);
+        (*names)[nnames] = strdup(de->d_name);
+        ERR_NOMEM((*names)[nnames] == NULL, ncf);
+        nnames += 1;
+    }
+    closedir(dp);
+    return nnames;
+ error:
+    if (dp != NULL)
+        closedir(dp);
+    FREE(path);
+    free_matches(nnames, names);
+    return -1;
+}
+
+static bool names_contain(int nnames, char **names, const char *name) {
+    for (int i=0; i < nnames; i++)
+        if (names[i] != NULL && STREQ(names[i], name))
+            return true;
+    return false;
+}
+
+/* Copy SRC to DST, which must not exist yet, preserving mode, ownership
+ * and timestamps like 'cp -p'. Where the filesystem supports it, the copy
+ * shares its blocks with SRC */
+static void copy_file(struct netcf *ncf, const char *src, const char *dst) {
+    int sfd = -1, dfd = -1;
+    struct stat st;
+    struct timespec times[2];
+    char buf[8192];
+    ssize_t n;
+
+    sfd = open(src, O_RDONLY|O_CLOEXEC);
+    ERR_THROW(sfd < 0, ncf, EFILE, "failed to open %s: %s",
+              src, strerror(errno));
+    ERR_THROW(fstat(sfd, &st) < 0, ncf, EFILE, "failed to stat %s: %s",
+              src, strerror(errno));
+    dfd = open(dst, O_WRONLY|O_CREAT|O_EXCL|O_CLOEXEC, st.st_mode & 07777);
+    ERR_THROW(dfd < 0, ncf, EFILE, "failed to create %s: %s",
+              dst, strerror(errno));
+
+#ifdef FICLONE
+    if (ioctl(dfd, FICLONE, sfd) < 0)
+#endif
+    {
+        while ((n = read(sfd, buf, sizeof(buf))) != 0) {
+            ERR_THROW(n < 0 && errno != EINTR, ncf, EFILE,
+                      "failed to read %s: %s", src, strerror(errno));
+            for (ssize_t w = 0, off = 0; n > 0 && off < n; off += w) {
+                w = write(dfd, buf + off, n - off);
+                if (w < 0 && errno == EINTR)
+                    w = 0;
+                ERR_THROW(w < 0, ncf, EFILE, "failed to write %s: %s",
+                          dst, strerror(errno));
+            }
+        }
+    }
+
+    /* Like cp, we don't mind if we can't give the copy away */
+    if (fchown(dfd, st.st_uid, st.st_gid) < 0)
+        fchmod(dfd, st.st_mode & 0777);
+    times[0] = st.st_atim;
+    times[1] = st.st_mtim;
+    ERR_THROW(futimens(dfd, times) < 0, ncf, EFILE,
+              "failed to set timestamps of %s: %s", dst, strerror(errno));
+    ERR_THROW(close(dfd) < 0, ncf, EFILE, "failed to write %s: %s",
+              dst, strerror(errno));
+    dfd = -1;
+ error:
+    if (sfd >= 0)
+        close(sfd);
+    if (dfd >= 0) {
+        close(dfd);
+        unlink(dst);
+    }
+}
+
+/* Copy the file NAME from directory SRC to directory DST */
+static void copy_file_to(struct netcf *ncf, const char *src, const char *dst,
+                         const char *name) {
+    char *from = NULL, *to = NULL;
+    int r;
+
+    r = xasprintf(&from, "%s/%s", src, name);
+    ERR_NOMEM(r < 0, ncf);
+    r = xasprintf(&to, "%s/%s", dst, name);
+    ERR_NOMEM(r < 0, ncf);
+    copy_file(ncf, from, to);
+ error:
+    FREE(from);
+    FREE(to);
+}
+
+/* Read up to LEN bytes from FD into BUF, fewer only at the end of the
+ * file. Returns the number of bytes read, or -1 on error */
+static ssize_t read_full(int fd, char *buf, size_t len) {
+    size_t off = 0;
+
+    while (off < len) {
+        ssize_t n = read(fd, buf + off, len - off);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        off += n;
+    }
+    return off;
+}
+
+/* Do the files SNAP and CUR have the same contents ? A difference in size
+ * settles it; otherwise the bytes are compared, since an edit can keep
+ * both the size and the modification time, e.g. with 'cp -p' or within
+ * the granularity of the timestamps */
+static bool same_contents(const char *snap, const char *cur) {
+    char sbuf[4096], cbuf[4096];
+    int sfd = -1, cfd = -1;
+    struct stat sst, cst;
+    bool result = false;
+
+    sfd = open(snap, O_RDONLY|O_CLOEXEC);
+    if (sfd < 0)
+        goto done;
+    cfd = open(cur, O_RDONLY|O_CLOEXEC);
+    if (cfd < 0)
+        goto done;
+    if (fstat(sfd, &sst) < 0 || fstat(cfd, &cst) < 0)
+        goto done;
+    if (sst.st_size != cst.st_size)
+        goto done;
+
+    for (;;) {
+        ssize_t slen = read_full(sfd, sbuf, sizeof(sbuf));
+        ssize_t clen = read_full(cfd, cbuf, sizeof(cbuf));
+
+        if (slen < 0 || clen != slen || memcmp(sbuf, cbuf, slen) != 0)
+            goto done;
+        if (slen == 0)
+            break;
+    }
+    result = true;
+ done:
+    if (sfd >= 0)
+        close(sfd);
+    if (cfd >= 0)
+        close(cfd);
+    return result;
+}
+
+/* Remove the directory DIR and everything in it */
+static void remove_dir(struct netcf *ncf, const char *dir) {
+    DIR *dp = NULL;
+    struct dirent *de;
+    struct stat st;
+    char *path = NULL;
+    int r;
+
+    dp = opendir(dir);
+    if (dp == NULL) {
+        ERR_THROW(errno != ENOENT, ncf, EFILE, "failed to open %s: %s",
+                  dir, strerror(errno));
+        return;
+    }
+    while ((de = readdir(dp)) != NULL) {
+        if (STREQ(de->d_name, ".") || STREQ(de->d_name, ".."))
+            continue;
+        r = xasprintf(&path, "%s/%s", dir, de->d_name);
+        ERR_NOMEM(r < 0, ncf);
+        if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+            remove_dir(ncf, path);
+            ERR_BAIL(ncf);
+        } else {
+            ERR_THROW(unlink(path) < 0 && errno != ENOENT, ncf, EFILE,
+                      "failed to remove %s: %s", path, strerror(errno));
+        }
+        FREE(path);
+    }
+    ERR_THROW(rmdir(dir) < 0 && errno != ENOENT, ncf, EFILE,
+              "failed to remove %s: %s", dir, strerror(errno));
+ error:
+    if (dp != NULL)
+        closedir(dp);
+    FREE(path);
+}
+
+/* Remove the directory DIR in one step, by renaming it out of the way
+ * before removing it */
+static void discard_dir(struct netcf *ncf, const char *dir) {
+    char *tmp = NULL;
+    int r;
+
+    r = xasprintf(&tmp, "%s.XXXXXX", dir);
+    ERR_NOMEM(r < 0, ncf);
+    ERR_THROW(mkdtemp(tmp) == NULL, ncf, EFILE,
+              "failed to create directory %s: %s", tmp, strerror(errno));
+    /* Renaming over an empty directory replaces it */
+    if (rename(dir, tmp) < 0) {
+        report_error(ncf, NETCF_EFILE, "failed to rename %s: %s",
+                     dir, strerror(errno));
+        rmdir(tmp);
+        goto error;
+    }
+    remove_dir(ncf, tmp);
+ error:
+    FREE(tmp);
+}
+
+/* Write the current time to the file PATH, in the format of date(1) */
+static void write_date(struct netcf *ncf, const char *path) {
+    char buf[128];
+    time_t now = time(NULL);
+    struct tm tm;
+    FILE *fp = NULL;
+
+    localtime_r(&now, &tm);
+    strftime(buf, sizeof(buf), "%a %b %e %H:%M:%S %Z %Y", &tm);
+    fp = fopen(path, "we");
+    ERR_THROW(fp == NULL, ncf, EFILE, "failed to create %s: %s",
+              path, strerror(errno));
+    fprintf(fp, "%s\n", buf);
+    ERR_THROW(fclose(fp) != 0, ncf, EFILE, "failed to write %s: %s",
+              path, strerror(errno));
+ error:
+    return;
+}
+
+/* Return the absolute path of the directory that FILES lives in */
+static char *snapshot_files_dir(struct netcf *ncf,
+                                const struct snapshot_files *files) {
+    char *dir = NULL;
+
+    if (xasprintf(&dir, "%s%s", ncf->root, files->dir) < 0)
+        report_error(ncf, NETCF_ENOMEM, NULL);
+    return dir;
+}
+
+/* Return the directory in the snapshot or rollback directory BASE that
+ * holds the copies of the files for the I'th entry of a list of struct
+ * snapshot_files. The first entry is kept in BASE itself, where
+ * netcf-transaction.sh expects it, the others in numbered
+ * subdirectories */
+static char *snapshot_entry_dir(struct netcf *ncf, const char *base, int i) {
+    char *dir = NULL;
+    int r;
+
+    if (i == 0)
+        r = xasprintf(&dir, "%s", base);
+    else
+        r = xasprintf(&dir, "%s/%d", base, i);
+    if (r < 0)
+        report_error(ncf, NETCF_ENOMEM, NULL);
+    return dir;
+}
+
+/* Copy the files for all entries in FILES into the directory BASE */
+static void snapshot_copy(struct netcf *ncf,
+                          const struct snapshot_files *files,
+                          const char *base) {
+    char *dir = NULL, *copy = NULL;
+    char **names = NULL;
+    int nnames = 0;
+
+    for (int i=0; files[i].dir != NULL; i++) {
+        dir = snapshot_files_dir(ncf, files + i);
+        ERR_BAIL(ncf);
+        copy = snapshot_entry_dir(ncf, base, i);
+        ERR_BAIL(ncf);
+        ERR_THROW(i > 0 && mkdir(copy, 0700) < 0 && errno != EEXIST,
+                  ncf, EFILE, "failed to create directory %s: %s",
+                  copy, strerror(errno));
+
+        nnames = snapshot_list(ncf, dir, files + i, &names);
+        ERR_BAIL(ncf);
+        for (int j=0; j < nnames; j++) {
+            copy_file_to(ncf, dir, copy, names[j]);
+            ERR_BAIL(ncf);
+        }
+        free_matches(nnames, &names);
+        FREE(dir);
+        FREE(copy);
+    }
+ error:
+    free_matches(nnames, &names);
+    FREE(dir);
+    FREE(copy);
+}
+
+int snapshot_begin(struct netcf *ncf, const struct snapshot_files *files) {
+    char *snapdir = NULL, *tmp = NULL, *path = NULL;
+    int r, result = -1;
+    struct stat st;
+
+    snapdir = snapshot_path(ncf, NETCF_SNAPSHOT_DIR);
+    ERR_BAIL(ncf);
+    ERR_THROW(lstat(snapdir, &st) == 0, ncf, EINVALIDOP,
+              "there is already an open transaction (%s exists)", snapdir);
+
+    /* Build the snapshot under a temporary name, and make it appear all
+     * at once */
+    r = xasprintf(&tmp, "%s.XXXXXX", snapdir);
+    ERR_NOMEM(r < 0, ncf);
+    *strrchr(tmp, '/') = '\0';
+    mkdir_parents(ncf, tmp);
+    ERR_BAIL(ncf);
+    tmp[strlen(tmp)] = '/';
+    ERR_THROW(mkdtemp(tmp) == NULL, ncf, EFILE,
+              "failed to create directory %s: %s", tmp, strerror(errno));
+
+    snapshot_copy(ncf, files, tmp);
+    ERR_BAIL(ncf);
+    r = xasprintf(&path, "%s/date", tmp);
+    ERR_NOMEM(r < 0, ncf);
+    write_date(ncf, path);
+    ERR_BAIL(ncf);
+
+    if (rename(tmp, snapdir) < 0) {
+        ERR_THROW(errno == EEXIST || errno == ENOTEMPTY, ncf, EINVALIDOP,
+                  "there is already an open transaction (%s exists)",
+                  snapdir);
+        ERR_THROW(true, ncf, EFILE, "failed to rename %s to %s: %s",
+                  tmp, snapdir, strerror(errno));
+    }
+    result = 0;
+ error:
+    if (result < 0 && tmp != NULL) {
+        /* Keep the first error */
+        netcf_errcode_t errcode = ncf->errcode;
+        char *errdetails = ncf->errdetails;
+
+        ncf->errcode = NETCF_NOERROR;
+        ncf->errdetails = NULL;
+        remove_dir(ncf, tmp);
+        FREE(ncf->errdetails);
+        ncf->errcode = errcode;
+        ncf->errdetails = errdetails;
+    }
+    FREE(path);
+    FREE(tmp);
+    FREE(snapdir);
+    return result;
+}
+
+int snapshot_commit(struct netcf *ncf) {
+    char *snapdir = NULL;
+    struct stat st;
+    int result = -1;
+
+    snapdir = snapshot_path(ncf, NETCF_SNAPSHOT_DIR);
+    ERR_BAIL(ncf);
+    ERR_THROW(stat(snapdir, &st) < 0 || ! S_ISDIR(st.st_mode), ncf,
+              EINVALIDOP, "no pending transaction to commit");
+    discard_dir(ncf, snapdir);
+    ERR_BAIL(ncf);
+    result = 0;
+ error:
+    FREE(snapdir);
+    return result;
+}
+
+static int cmpstrp(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/* Remove all but the newest NETCF_ROLLBACK_KEEP rollback directories */
+static void prune_rollback_dirs(struct netcf *ncf) {
+    char *base = NULL, *parent = NULL, *path = NULL;
+    const char *prefix;
+    char **names = NULL;
+    int nnames = 0, r;
+    DIR *dp = NULL;
+    struct dirent *de;
+
+    base = snapshot_path(ncf, NETCF_ROLLBACK_DIR "-");
+    ERR_BAIL(ncf);
+    prefix = strrchr(base, '/') + 1;
+    parent = strndup(base, prefix - base - 1);
+    ERR_NOMEM(parent == NULL, ncf);
+
+    dp = opendir(parent);
+    ERR_THROW(dp == NULL, ncf, EFILE, "failed to open %s: %s",
+              parent, strerror(errno));
+    while ((de = readdir(dp)) != NULL) {
+        if (! STREQLEN(de->d_name, prefix, strlen(prefix)))
+            continue;
+        r = REALLOC_N(names, nnames + 1);
+        ERR_NOMEM(r < 0, ncf);
+        names[nnames] = strdup(de->d_name);
+        ERR_NOMEM(names[nnames] == NULL, ncf);
+        nnames += 1;
+    }
+    qsort(names, nnames, sizeof(*names), cmpstrp);
+
+    /* The names sort by the time they were created */
+    for (int i=0; i + NETCF_ROLLBACK_KEEP < nnames; i++) {
+        r = xasprintf(&path, "%s/%s", parent, names[i]);
+        ERR_NOMEM(r < 0, ncf);
+        remove_dir(ncf, path);
+        ERR_BAIL(ncf);
+        FREE(path);
+    }
+
+ error:
+    if (dp != NULL)
+        closedir(dp);
+    free_matches(nnames, &names);
+    FREE(path);
+    FREE(parent);
+    FREE(base);
+}
+
+/* Replace the file NAME in DIR with the one from SNAPDIR. The new file
+ * is created in DIR and renamed into place, so that it gets the SELinux
+ * label of files in DIR, and DIR never lacks the file */
+static void restore_file(struct netcf *ncf, const char *snapdir,
+                         const char *dir, const char *name) {
+    char *from = NULL, *tmp = NULL, *to = NULL;
+    int r;
+
+    r = xasprintf(&from, "%s/%s", snapdir, name);
+    ERR_NOMEM(r < 0, ncf);
+    r = xasprintf(&to, "%s/%s", dir, name);
+    ERR_NOMEM(r < 0, ncf);
+    r = xasprintf(&tmp, "%s" SNAPSHOT_RESTORE, to);
+    ERR_NOMEM(r < 0, ncf);
+
+    unlink(tmp);
+    copy_file(ncf, from, tmp);
+    ERR_BAIL(ncf);
+    if (rename(tmp, to) < 0) {
+        report_error(ncf, NETCF_EFILE, "failed to restore %s: %s",
+                     to, strerror(errno));
+        unlink(tmp);
+    }
+ error:
+    FREE(from);
+    FREE(tmp);
+    FREE(to);
+}
+
+/* Add the files for FILES that differ between the directory DIR and its
+ * copy SNAPDIR to CHANGED, as paths relative to the root */
+static void entry_changes(struct netcf *ncf, const struct snapshot_files *files,
+                          const char *dir, const char *snapdir,
+                          int *nchanged, char ***changed) {
+    char *cur = NULL, *snap = NULL;
+    char **names = NULL, **saved = NULL;
+    int nnames = 0, nsaved = 0, r;
+
+    nnames = snapshot_list(ncf, dir, files, &names);
+    ERR_BAIL(ncf);
+    nsaved = snapshot_list(ncf, snapdir, files, &saved);
+    ERR_BAIL(ncf);
+
+    r = REALLOC_N(*changed, *nchanged + nnames + nsaved);
+    ERR_NOMEM(r < 0, ncf);
+    for (int i=0; i < nnames + nsaved; i++) {
+        const char *name = i < nnames ? names[i] : saved[i - nnames];
+        bool differs = true;
+
+        if (i >= nnames && names_contain(nnames, names, name))
+            continue;
+        if (i < nnames && names_contain(nsaved, saved, name)) {
+            r = xasprintf(&cur, "%s/%s", dir, name);
+            ERR_NOMEM(r < 0, ncf);
+            r = xasprintf(&snap, "%s/%s", snapdir, name);
+            ERR_NOMEM(r < 0, ncf);
+            differs = ! same_contents(snap, cur);
+            FREE(cur);
+            FREE(snap);
+        }
+        if (differs) {
+            r = xasprintf(*changed + *nchanged, "%s/%s", files->dir, name);
+            ERR_NOMEM(r < 0, ncf);
+            *nchanged += 1;
+        }
+    }
+ error:
+    free_matches(nnames, &names);
+    free_matches(nsaved, &saved);
+    FREE(cur);
+    FREE(snap);
+}
+
+int snapshot_changes(struct netcf *ncf, const struct snapshot_files *files,
+                     char ***changed) {
+    char *snapdir = NULL, *dir = NULL, *copy = NULL;
+    int nchanged = 0;
+    struct stat st;
+
+    *changed = NULL;
+    snapdir = snapshot_path(ncf, NETCF_SNAPSHOT_DIR);
+    ERR_BAIL(ncf);
+    ERR_THROW(stat(snapdir, &st) < 0 || ! S_ISDIR(st.st_mode), ncf,
+              EINVALIDOP, "no pending transaction");
+
+    for (int i=0; files[i].dir != NULL; i++) {
+        dir = snapshot_files_dir(ncf, files + i);
+        ERR_BAIL(ncf);
+        copy = snapshot_entry_dir(ncf, snapdir, i);
+        ERR_BAIL(ncf);
+        entry_changes(ncf, files + i, dir, copy, &nchanged, changed);
+        ERR_BAIL(ncf);
+        FREE(dir);
+        FREE(copy);
+    }
+    FREE(snapdir);
+    return nchanged;
+ error:
+    free_matches(nchanged, changed);
+    FREE(dir);
+    FREE(copy);
+    FREE(snapdir);
+    return -1;
+}
+
+/* Make the files for FILES in DIR the same as their copies in SNAPDIR.
+ * Only files that differ from the snapshot are touched, so that the
+ * files of interfaces that were not changed are left alone */
+static void rollback_entry(struct netcf *ncf, const struct snapshot_files *files,
+                           const char *dir, const char *snapdir) {
+    char *cur = NULL, *snap = NULL;
+    char **names = NULL, **saved = NULL;
+    int nnames = 0, nsaved = 0, r;
+
+    nnames = snapshot_list(ncf, dir, files, &names);
+    ERR_BAIL(ncf);
+    nsaved = snapshot_list(ncf, snapdir, files, &saved);
+    ERR_BAIL(ncf);
+
+    for (int i=0; i < nnames; i++) {
+        r = xasprintf(&cur, "%s/%s", dir, names[i]);
+        ERR_NOMEM(r < 0, ncf);
+        if (names_contain(nsaved, saved, names[i])) {
+            r = xasprintf(&snap, "%s/%s", snapdir, names[i]);
+            ERR_NOMEM(r < 0, ncf);
+            if (! same_contents(snap, cur)) {
+                restore_file(ncf, snapdir, dir, names[i]);
+                ERR_BAIL(ncf);
+            }
+            FREE(snap);
+        } else {
+            ERR_THROW(unlink(cur) < 0 && errno != ENOENT, ncf, EFILE,
+                      "failed to remove %s: %s", cur, strerror(errno));
+        }
+        FREE(cur);
+    }
+    for (int i=0; i < nsaved; i++) {
+        if (names_contain(nnames, names, saved[i]))
+            continue;
+        restore_file(ncf, snapdir, dir, saved[i]);
+        ERR_BAIL(ncf);
+    }
+ error:
+    free_matches(nnames, &names);
+    free_matches(nsaved, &saved);
+    FREE(cur);
+    FREE(snap);
+}
+
+int snapshot_rollback(struct netcf *ncf, const struct snapshot_files *files) {
+    char *snapdir = NULL, *dir = NULL, *copy = NULL;
+    char *rbdir = NULL, *rbbase = NULL;
+    int r, result = -1;
+    struct stat st;
+    char stamp[64];
+    time_t now = time(NULL);
+    struct tm tm;
+
+    snapdir = snapshot_path(ncf, NETCF_SNAPSHOT_DIR);
+    ERR_BAIL(ncf);
+    ERR_THROW(stat(snapdir, &st) < 0 || ! S_ISDIR(st.st_mode), ncf,
+              EINVALIDOP, "no pending transaction to rollback");
+
+    prune_rollback_dirs(ncf);
+    ERR_BAIL(ncf);
+
+    /* Save a copy of the current config "just in case" */
+    localtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%Y.%m.%d-%H:%M:%S", &tm);
+    rbbase = snapshot_path(ncf, NETCF_ROLLBACK_DIR);
+    ERR_BAIL(ncf);
+    r = xasprintf(&rbdir, "%s-%s", rbbase, stamp);
+    ERR_NOMEM(r < 0, ncf);
+    if (mkdir(rbdir, 0700) < 0) {
+        /* Two rollbacks within one second share the directory */
+        ERR_THROW(errno != EEXIST, ncf, EFILE,
+                  "failed to create rollback directory %s: %s",
+                  rbdir, strerror(errno));
+        remove_dir(ncf, rbdir);
+        ERR_BAIL(ncf);
+        ERR_THROW(mkdir(rbdir, 0700) < 0, ncf, EFILE,
+                  "failed to create rollback directory %s: %s",
+                  rbdir, strerror(errno));
+    }
+    snapshot_copy(ncf, files, rbdir);
+    ERR_BAIL(ncf);
+
+    for (int i=0; files[i].dir != NULL; i++) {
+        dir = snapshot_files_dir(ncf, files + i);
+        ERR_BAIL(ncf);
+        copy = snapshot_entry_dir(ncf, snapdir, i);
+        ERR_BAIL(ncf);
+        rollback_entry(ncf, files + i, dir, copy);
+        ERR_BAIL(ncf);
+        FREE(dir);
+        FREE(copy);
+    }
+
+    discard_dir(ncf, snapdir);
+    ERR_BAIL(ncf);
+    result = 0;
+ error:
+    aug_revert(ncf);
+    FREE(dir);
+    FREE(copy);
+    FREE(rbdir);
+    FREE(rbbase);
+    FREE(snapdir);
+    return result;
+}
+
 ATTRIBUTE_FORMAT(printf, 4, 5)
 int defnode(struct netcf *ncf, const char *name, const char *value,
                    const char *format, ...) {
@@ -364,6 +1445,7 @@ int aug_fmt_rm(struct netcf *ncf, const char *fmt, ...)
 int aug_fmt_match(struct netcf *ncf, char ***matches, const char *fmt, ...) {
     augeas *aug = NULL;
     char *path = NULL;
+    struct span span;
     va_list args;
     int r;
 
@@ -378,7 +1460,9 @@ int aug_fmt_match(struct netcf *ncf, char ***matches, const char *fmt, ...) {
         ERR_NOMEM(1, ncf);
     }
 
+    span = span_begin(ncf, NETCF_STAT_AUG_MATCH, path);
     r = aug_match(aug, path, matches);
+    span_end(&span);
     ERR_COND_BAIL(r < 0, ncf, EOTHER);
 
     free(path);
@@ -470,6 +1554,14 @@ void modprobed_alias_bond(struct netcf *ncf, const char *name) {
 
     ERR_BAIL(ncf);
 
+    /* Leave the file alone if the alias is already there */
+    nmatches = aug_fmt_match(ncf, NULL,
+        "/files/etc/modprobe.d/*/alias[ . = '%s'][modulename = 'bonding']",
+                             name);
+    ERR_BAIL(ncf);
+    if (nmatches > 0)
+        goto done;
+
     nmatches = aug_fmt_match(ncf, NULL,
                              "/files/etc/modprobe.d/*/alias[ . = '%s']",
                              name);
@@ -497,6 +1589,7 @@ void modprobed_alias_bond(struct netcf *ncf, const char *name) {
     r = aug_set(aug, path, "bonding");
     ERR_COND_BAIL(r < 0, ncf, EOTHER);
 
+ done:
  error:
     FREE(path);
 }
@@ -520,6 +1613,327 @@ void modprobed_unalias_bond(struct netcf *ncf, const char *name) {
     FREE(path);
 }
 
+/*
+ * Locking against other processes
+ *
+ * Every process that uses netcf has its own augeas tree. Without some
+ * coordination, two of them that change the same files at the same time
+ * silently lose one of the changes when they save. Before a driver
+ * changes the tree, it therefore locks the files it is about to touch.
+ *
+ * Augeas replaces files by renaming a new version over them, which makes
+ * locks on the files themselves useless. Instead, each file corresponds to
+ * a byte in NETCF_LOCK_FILE, picked by hashing its augeas path, and we
+ * lock that byte with an OFD lock. Changes to unrelated interfaces lock
+ * different bytes and can go ahead at the same time; two files that hash
+ * to the same byte merely cost us some concurrency. Locks are always
+ * taken in ascending order of their bytes, so that processes can not
+ * deadlock.
+ *
+ * Which files a change touches is only known for sure once it has been
+ * made, and then only from the tree as it was before we held any locks.
+ * lock_files_cover_save therefore checks the files that aug_save is about
+ * to write against the ones we locked; if it finds others, the change has
+ * to be made over, after locking those too.
+ */
+#define NETCF_LOCK_FILE "/lib/netcf/lock"
+#define NETCF_LOCK_SLOTS 4096
+
+/* OFD locks belong to an open file, not a process, so that two handles in
+ * the same process keep each other out, too. Without them, we fall back
+ * to process-wide locks */
+#ifdef F_OFD_SETLKW
+# define LOCK_FILES_SETLKW F_OFD_SETLKW
+# define LOCK_FILES_SETLK F_OFD_SETLK
+#else
+# define LOCK_FILES_SETLKW F_SETLKW
+# define LOCK_FILES_SETLK F_SETLK
+#endif
+
+struct file_locks {
+    int            fd;                  /* NETCF_LOCK_FILE, or -1 */
+    int            npaths;
+    char         **paths;               /* Augeas paths of the files */
+    bool           held;
+};
+
+static unsigned int lock_slot(const char *path) {
+    /* FNV-1a */
+    unsigned int h = 2166136261u;
+
+    for (const char *p = path; *p != '\0'; p++) {
+        h ^= (unsigned char) *p;
+        h *= 16777619u;
+    }
+    return h % NETCF_LOCK_SLOTS;
+}
+
+static int cmp_slot(const void *p1, const void *p2) {
+    unsigned int s1 = *(const unsigned int *) p1;
+    unsigned int s2 = *(const unsigned int *) p2;
+
+    return (s1 > s2) - (s1 < s2);
+}
+
+static struct file_locks *file_locks(struct netcf *ncf) {
+    struct file_locks *locks = ncf->driver->locks;
+
+    if (locks == NULL) {
+        if (ALLOC(locks) < 0) {
+            report_error(ncf, NETCF_ENOMEM, NULL);
+            return NULL;
+        }
+        locks->fd = -1;
+        ncf->driver->locks = locks;
+    }
+    return locks;
+}
+
+void lock_files_add(struct netcf *ncf, const char *path) {
+    struct file_locks *locks = file_locks(ncf);
+    int r;
+
+    ERR_BAIL(ncf);
+    for (int i=0; i < locks->npaths; i++)
+        if (STREQ(locks->paths[i], path))
+            return;
+
+    r = REALLOC_N(locks->paths, locks->npaths + 1);
+    ERR_NOMEM(r < 0, ncf);
+    locks->paths[locks->npaths] = strdup(path);
+    ERR_NOMEM(locks->paths[locks->npaths] == NULL, ncf);
+    locks->npaths += 1;
+ error:
+    return;
+}
+
+static int lock_byte(int fd, short type, unsigned int slot, bool wait) {
+    struct flock fl;
+    int r;
+
+    MEMZERO(&fl, 1);
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = slot;
+    /* Unlocking length 0 drops all our locks at once */
+    fl.l_len = (type == F_UNLCK) ? 0 : 1;
+    do {
+        r = fcntl(fd, wait ? LOCK_FILES_SETLKW : LOCK_FILES_SETLK, &fl);
+    } while (r < 0 && errno == EINTR);
+    return r;
+}
+
+void lock_files_acquire(struct netcf *ncf) {
+    struct file_locks *locks = file_locks(ncf);
+    unsigned int *slots = NULL;
+    char *path = NULL;
+    augeas *aug;
+    int r;
+
+    ERR_BAIL(ncf);
+    assert(! locks->held);
+
+    if (locks->fd < 0) {
+        char *dir = snapshot_path(ncf, "/lib/netcf");
+        ERR_BAIL(ncf);
+        mkdir_parents(ncf, dir);
+        FREE(dir);
+        ERR_BAIL(ncf);
+
+        path = snapshot_path(ncf, NETCF_LOCK_FILE);
+        ERR_BAIL(ncf);
+        locks->fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC, 0600);
+        ERR_THROW(locks->fd < 0, ncf, EFILE, "failed to open %s: %s",
+                  path, strerror(errno));
+        FREE(path);
+    }
+
+    r = ALLOC_N(slots, locks->npaths);
+    ERR_NOMEM(r < 0, ncf);
+    for (int i=0; i < locks->npaths; i++)
+        slots[i] = lock_slot(locks->paths[i]);
+    qsort(slots, locks->npaths, sizeof(*slots), cmp_slot);
+
+    locks->held = true;
+    for (int i=0; i < locks->npaths; i++) {
+        if (i > 0 && slots[i] == slots[i-1])
+            continue;
+        r = lock_byte(locks->fd, F_WRLCK, slots[i], true);
+        ERR_THROW(r < 0, ncf, EFILE, "failed to lock %s: %s",
+                  NETCF_LOCK_FILE, strerror(errno));
+    }
+
+    /* Another process may have changed the files since we read them, and
+     * within the same second as our last load; make sure augeas reads
+     * them again rather than trusting their mtime */
+    aug = ncf->driver->augeas;
+    for (int i=0; aug != NULL && i < locks->npaths; i++) {
+        r = xasprintf(&path, "/augeas%s/mtime", locks->paths[i]);
+        ERR_NOMEM(r < 0, ncf);
+        aug_rm(aug, path);
+        FREE(path);
+    }
+    aug_revert(ncf);
+
+ error:
+    FREE(path);
+    FREE(slots);
+}
+
+void lock_files_release(struct netcf *ncf) {
+    struct file_locks *locks = ncf->driver->locks;
+
+    if (locks == NULL)
+        return;
+    if (locks->held)
+        lock_byte(locks->fd, F_UNLCK, 0, false);
+    locks->held = false;
+    free_matches(locks->npaths, &locks->paths);
+    locks->npaths = 0;
+}
+
+bool lock_files_cover_save(struct netcf *ncf) {
+    struct file_locks *locks = ncf->driver->locks;
+    char **files = NULL;
+    int nfiles = 0, nlocked;
+    bool result = true;
+    augeas *aug;
+
+    aug = get_augeas(ncf);
+    ERR_BAIL(ncf);
+
+    nfiles = save_group_files(ncf, aug, &files);
+    ERR_BAIL(ncf);
+
+    nlocked = locks->npaths;
+    for (int i=0; i < nfiles; i++) {
+        /* save_group_files gives us file names; turn them back into
+         * augeas paths */
+        char *path = NULL;
+        int r = xasprintf(&path, "/files/%s", files[i] + strlen(ncf->root));
+        ERR_NOMEM(r < 0, ncf);
+        lock_files_add(ncf, path);
+        FREE(path);
+        ERR_BAIL(ncf);
+    }
+
+    if (locks->npaths > nlocked) {
+        /* Keep the paths we now know about for the next round */
+        char **paths = locks->paths;
+        int npaths = locks->npaths;
+
+        locks->paths = NULL;
+        locks->npaths = 0;
+        lock_files_release(ncf);
+        locks->paths = paths;
+        locks->npaths = npaths;
+        aug_revert(ncf);
+        result = false;
+    }
+
+ error:
+    free_matches(nfiles, &files);
+    return result;
+}
+
+void lock_files_free(struct netcf *ncf) {
+    struct file_locks *locks = ncf->driver->locks;
+
+    if (locks == NULL)
+        return;
+    lock_files_release(ncf);
+    if (locks->fd >= 0)
+        close(locks->fd);
+    FREE(ncf->driver->locks);
+}
+
+int define_many(struct netcf *ncf, const struct define_ops *ops,
+                int ndocs, const char *const *xmls, unsigned int flags,
+                struct netcf_if **ifaces, int *status) {
+    xmlDocPtr *ncf_xmls = NULL, *aug_xmls = NULL;
+    char **names = NULL;
+    struct ncf_error first = { .errcode = NETCF_NOERROR };
+    int r, result = -1;
+
+    r = ALLOC_N(ncf_xmls, ndocs);
+    ERR_NOMEM(r < 0, ncf);
+    r = ALLOC_N(aug_xmls, ndocs);
+    ERR_NOMEM(r < 0, ncf);
+    r = ALLOC_N(names, ndocs);
+    ERR_NOMEM(r < 0, ncf);
+
+    /* Check and transform all documents before touching the tree. A
+     * failing document is skipped; we keep the first error around */
+    for (int i=0; i < ndocs; i++) {
+        names[i] = ops->prepare(ncf, xmls[i], flags,
+                                ncf_xmls + i, aug_xmls + i);
+        if (names[i] == NULL)
+            status[i] = error_set_aside(ncf, &first);
+    }
+
+    for (int i=0; ops->lock != NULL && i < ndocs; i++) {
+        if (names[i] == NULL)
+            continue;
+        ops->lock(ncf, names[i], aug_xmls[i]);
+        ERR_BAIL(ncf);
+    }
+
+    do {
+        if (ops->lock != NULL) {
+            lock_files_acquire(ncf);
+            ERR_BAIL(ncf);
+        }
+        for (int i=0; i < ndocs; i++) {
+            if (names[i] == NULL)
+                continue;
+            ops->apply(ncf, names[i], ncf_xmls[i], aug_xmls[i]);
+            if (ncf->errcode != NETCF_NOERROR) {
+                aug_revert(ncf);
+                goto error;
+            }
+        }
+    } while (ops->lock != NULL && ! lock_files_cover_save(ncf));
+    ERR_BAIL(ncf);
+
+    aug_save_group(ncf);
+    ERR_BAIL(ncf);
+
+    result = 0;
+    for (int i=0; i < ndocs; i++) {
+        if (names[i] == NULL)
+            continue;
+        ifaces[i] = make_netcf_if(ncf, names[i]);
+        ERR_BAIL(ncf);
+        names[i] = NULL;
+        result += 1;
+    }
+    error_restore(ncf, &first);
+
+ done:
+    lock_files_release(ncf);
+    for (int i=0; i < ndocs; i++) {
+        if (ncf_xmls != NULL)
+            xmlFreeDoc(ncf_xmls[i]);
+        if (aug_xmls != NULL)
+            xmlFreeDoc(aug_xmls[i]);
+        if (names != NULL)
+            FREE(names[i]);
+    }
+    FREE(ncf_xmls);
+    FREE(aug_xmls);
+    FREE(names);
+    FREE(first.details);
+    return result;
+ error:
+    for (int i=0; i < ndocs; i++) {
+        if (status[i] == NETCF_NOERROR)
+            status[i] = ncf->errcode;
+        unref(ifaces[i], netcf_if);
+    }
+    result = -1;
+    goto done;
+}
+
 /*
  * ioctl and netlink-related utilities
  */
@@ -545,6 +1959,77 @@ int if_is_active(struct netcf *ncf, const char *intf) {
     return ((ifr.ifr_flags & flags_to_check) == flags_to_check);
 }
 
+/* Does the interface name that ends right before P end there ? A '.'
+ * only ends it when the sentence ends, too: in "eth0.42", it is part of
+ * the name */
+static bool if_name_ends_at(const char *p) {
+    if (*p == '.')
+        p += 1;
+    return *p == '\0' || c_isspace(*p) || strchr(":=\"'", *p) != NULL;
+}
+
+/* The messages we look for are the ones ifupdown prints when it gives up
+ * on an interface, e.g. "ifup: failed to bring up eth0" or "ifdown:
+ * unknown interface eth0" */
+bool if_failed_in_output(const char *output, const char *name) {
+    static const char *const markers[] = {
+        "failed to bring up ", "failed to bring down ",
+        "unknown interface ", "ignoring unknown interface "
+    };
+    size_t len = strlen(name);
+
+    for (int m=0; m < ARRAY_CARDINALITY(markers); m++) {
+        const char *p = output;
+
+        while ((p = strcasestr(p, markers[m])) != NULL) {
+            p += strlen(markers[m]);
+            if (STREQLEN(p, name, len) && if_name_ends_at(p + len))
+                return true;
+        }
+    }
+    return false;
+}
+
+int ncf_if_failed_in_output(const char *output, const char *name) {
+    return if_failed_in_output(output, name);
+}
+
+int if_check_active(struct netcf *ncf, int nifaces, struct netcf_if **ifaces,
+                    bool up, int *status) {
+    struct ncf_error first = { .errcode = NETCF_NOERROR };
+    int result = 0;
+
+    error_set_aside(ncf, &first);
+
+    /* Give interfaces that were brought up a moment to become active */
+    for (int retries = 0; up && retries < 10; retries++) {
+        bool waiting = false;
+
+        for (int i=0; i < nifaces; i++)
+            if (status[i] == NETCF_NOERROR
+                && !if_is_active(ncf, ifaces[i]->name))
+                waiting = true;
+        if (!waiting)
+            break;
+        usleep(250000);
+    }
+
+    for (int i=0; i < nifaces; i++) {
+        if (up && status[i] == NETCF_NOERROR
+            && !if_is_active(ncf, ifaces[i]->name)) {
+            report_error(ncf, NETCF_EOTHER,
+                         "interface %s failed to become active - "
+                         "possible disconnected cable.", ifaces[i]->name);
+            status[i] = NETCF_EOTHER;
+        }
+        if (status[i] == NETCF_NOERROR)
+            result += 1;
+    }
+
+    error_restore(ncf, &first);
+    return result;
+}
+
 netcf_if_type_t if_type(struct netcf *ncf, const char *intf) {
     char *path;
     struct stat stats;
@@ -709,6 +2194,9 @@ error:
 
 int netlink_close(struct netcf *ncf) {
 
+    ncf_shm_close(ncf->driver->shm);
+    ncf->driver->shm = NULL;
+
     if (ncf->driver->addr_cache) {
         nl_cache_free(ncf->driver->addr_cache);
         ncf->driver->addr_cache = NULL;
@@ -1213,9 +2701,25 @@ error:
     return;
 }
 
+/* Update CACHE, the link or address cache according to NAME, with any
+ * recent changes */
+static int refill_cache(struct netcf *ncf, struct nl_cache *cache,
+                        const char *name) {
+    struct span span = span_begin(ncf, NETCF_STAT_NETLINK_REFILL, name);
+    int code;
+
+    code = nl_cache_refill(ncf->driver->nl_sock, cache);
+    span_end(&span);
+    ERR_THROW((code < 0), ncf, ENETLINK,
+              "failed to refill interface %s cache", name);
+    return 0;
+ error:
+    return -1;
+}
+
 void add_state_to_xml_doc(struct netcf_if *nif, xmlDocPtr doc) {
     xmlNodePtr root;
-    int ifindex, code;
+    int ifindex;
 
     root = xmlDocGetRootElement(doc);
     ERR_THROW((root == NULL), nif->ncf, EINTERNAL,
@@ -1223,15 +2727,10 @@ void add_state_to_xml_doc(struct netcf_if *nif, xmlDocPtr doc) {
     ERR_THROW(!xmlStrEqual(root->name, BAD_CAST "interface"),
               nif->ncf, EINTERNAL, "root document is not an interface");
 
-    /* Update the caches with any recent changes */
-    code = nl_cache_refill(nif->ncf->driver->nl_sock,
-                           nif->ncf->driver->link_cache);
-    ERR_THROW((code < 0), nif->ncf, ENETLINK,
-              "failed to refill interface index cache");
-    code = nl_cache_refill(nif->ncf->driver->nl_sock,
-                           nif->ncf->driver->addr_cache);
-    ERR_THROW((code < 0), nif->ncf, ENETLINK,
-              "failed to refill interface address cache");
+    if (refill_cache(nif->ncf, nif->ncf->driver->link_cache, "link") < 0)
+        goto error;
+    if (refill_cache(nif->ncf, nif->ncf->driver->addr_cache, "address") < 0)
+        goto error;
 
     ifindex = rtnl_link_name2i(nif->ncf->driver->link_cache, nif->name);
     /* We ignore an error return here, because that usually just
@@ -1250,4 +2749,364 @@ error:
     return;
 }
 
+/*
+ * Shared interface state, see shm.c
+ */
+
+struct shm_publish_data {
+    struct netcf           *ncf;
+    struct netcf_shm_entry *entries;
+    int                     nentries;
+    int                     maxentries;
+};
+
+static void shm_link_cb(struct nl_object *obj, void *arg) {
+    struct shm_publish_data *data = arg;
+    struct rtnl_link *iflink = (struct rtnl_link *) obj;
+    struct netcf_shm_entry *entry;
+    struct nl_addr *addr;
+    const char *name = rtnl_link_get_name(iflink);
+
+    if (name == NULL || data->nentries >= data->maxentries)
+        return;
+    entry = data->entries + data->nentries;
+    strncpy(entry->name, name, sizeof(entry->name) - 1);
+    entry->ifindex = rtnl_link_get_ifindex(iflink);
+    entry->flags = rtnl_link_get_flags(iflink);
+    entry->mtu = rtnl_link_get_mtu(iflink);
+    addr = rtnl_link_get_addr(iflink);
+    if (addr != NULL && !nl_addr_iszero(addr))
+        nl_addr2str(addr, entry->mac, sizeof(entry->mac));
+    data->nentries += 1;
+}
+
+static void shm_addr_cb(struct nl_object *obj, void *arg) {
+    struct shm_publish_data *data = arg;
+    struct rtnl_addr *addr = (struct rtnl_addr *) obj;
+    struct nl_addr *local_addr = rtnl_addr_get_local(addr);
+    int ifindex = rtnl_addr_get_ifindex(addr);
+    int family;
+
+    if (local_addr == NULL)
+        return;
+    family = nl_addr_get_family(local_addr);
+    if (family != AF_INET && family != AF_INET6)
+        return;
+
+    for (int i=0; i < data->nentries; i++) {
+        struct netcf_shm_entry *entry = data->entries + i;
+        struct netcf_shm_address *a;
+
+        if (entry->ifindex != ifindex)
+            continue;
+        if (entry->naddrs < NETCF_SHM_ADDRS) {
+            a = entry->addrs + entry->naddrs;
+            a->family = family;
+            a->prefix = nl_addr_get_prefixlen(local_addr);
+            inet_ntop(family, nl_addr_get_binary_addr(local_addr),
+                      a->address, sizeof(a->address));
+            entry->naddrs += 1;
+        }
+        break;
+    }
+}
+
+int shm_publish(struct netcf *ncf, const char *path) {
+    struct shm_publish_data data = { .ncf = ncf };
+    char errbuf[128];
+
+    if (path == NULL)
+        path = SHM_PATH;
+    if (ncf->driver->shm == NULL) {
+        ncf->driver->shm = shm_create(path);
+        ERR_THROW_STRERROR(ncf->driver->shm == NULL, ncf, EFILE,
+                           "failed to open %s for publishing: %s",
+                           path, errbuf);
+    }
+    ERR_THROW(STRNEQ(ncf->driver->shm->path, path), ncf, EINVALIDOP,
+              "already publishing to %s", ncf->driver->shm->path);
+
+    if (refill_cache(ncf, ncf->driver->link_cache, "link") < 0)
+        goto error;
+    if (refill_cache(ncf, ncf->driver->addr_cache, "address") < 0)
+        goto error;
+
+    data.maxentries = nl_cache_nitems(ncf->driver->link_cache);
+    ERR_NOMEM(ALLOC_N(data.entries, data.maxentries) < 0, ncf);
+    nl_cache_foreach(ncf->driver->link_cache, shm_link_cb, &data);
+    nl_cache_foreach(ncf->driver->addr_cache, shm_addr_cb, &data);
+    shm_update(ncf->driver->shm, data.entries, data.nentries);
+    FREE(data.entries);
+    return 0;
+ error:
+    FREE(data.entries);
+    return -1;
+}
+
+/*
+ * Asynchronous ifup/ifdown
+ */
+
+/* How often, and how many times, we check whether an interface became
+ * active after ifup, unless netlink tells us earlier */
+#define OP_ACTIVE_INTERVAL 250
+#define OP_ACTIVE_TRIES 10
+
+enum op_phase {
+    OP_RUNNING,                 /* running ifup/ifdown for NAMES[STEP] */
+    OP_WAIT_ACTIVE,             /* waiting for the interface to come up */
+    OP_DONE
+};
+
+struct netcf_op {
+    struct netcf_if   *nif;
+    bool               up;
+    enum op_phase      phase;
+    const char        *prog;
+    int                nnames;
+    char             **names;
+    int                step;
+    struct exec_proc  *proc;
+    int                epfd;            /* what the caller polls */
+    int                timerfd;         /* wakeups while the program
+                                         * runs, and activity checks */
+    int                nlfd;            /* link change notifications */
+    int                tries;
+    netcf_errcode_t    errcode;
+    char              *errdetails;
+};
+
+/* Arm the timer of OP to expire after MSECS, and then every INTERVAL
+ * msecs; 0 for MSECS disarms it */
+static int op_set_timer(struct netcf_op *op, unsigned int msecs,
+                        unsigned int interval) {
+    struct itimerspec its = {
+        .it_value = { msecs / 1000, (msecs % 1000) * 1000000 },
+        .it_interval = { interval / 1000, (interval % 1000) * 1000000 }
+    };
+
+    return timerfd_settime(op->timerfd, 0, &its, NULL);
+}
+
+/* Drain the notifications from FD, which is nonblocking. Returns true if
+ * there were any */
+static bool op_drain(int fd) {
+    char buf[4096];
+    bool seen = false;
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        seen = true;
+    return seen;
+}
+
+/* Start running the program for the current step of OP */
+static void op_start_step(struct netcf *ncf, struct netcf_op *op) {
+    const char *const argv[] = { op->prog, op->names[op->step], NULL };
+    struct epoll_event ev = { .events = EPOLLIN };
+    int r;
+
+    op->proc = exec_start(ncf, argv);
+    ERR_BAIL(ncf);
+    r = epoll_ctl(op->epfd, EPOLL_CTL_ADD, exec_proc_fd(op->proc), &ev);
+    ERR_THROW(r < 0, ncf, EEXEC, "failed to watch output of '%s'",
+              exec_proc_name(op->proc));
+ error:
+    return;
+}
+
+/* Done with the current program of OP */
+static void op_end_step(struct netcf_op *op) {
+    if (op->proc != NULL && exec_proc_fd(op->proc) >= 0)
+        epoll_ctl(op->epfd, EPOLL_CTL_DEL, exec_proc_fd(op->proc), NULL);
+    exec_proc_free(op->proc);
+    op->proc = NULL;
+    if (op->timerfd >= 0)
+        op_set_timer(op, 0, 0);
+}
+
+/* Have the caller's poll wake up for link changes, now that they mean
+ * something to us. Before, ifup itself makes plenty of them, and nobody
+ * would read them. Not being able to do that only means that we notice
+ * the interface come up a little later */
+static void op_watch_links(struct netcf_op *op) {
+    struct epoll_event ev = { .events = EPOLLIN };
+
+    if (op->nlfd < 0)
+        return;
+    op_drain(op->nlfd);
+    if (epoll_ctl(op->epfd, EPOLL_CTL_ADD, op->nlfd, &ev) < 0) {
+        close(op->nlfd);
+        op->nlfd = -1;
+    }
+}
+
+/* Move OP along as far as we can without blocking */
+static void op_advance(struct netcf *ncf, struct netcf_op *op) {
+    int r;
+
+    while (op->phase == OP_RUNNING) {
+        op_drain(op->timerfd);
+
+        r = exec_proc_poll(ncf, op->proc);
+        if (r > 0) {
+            /* Wake the caller up for the exec timeout, and to reap a
+             * program that closed its output but is still around */
+            int msecs = exec_proc_wait_msecs(op->proc);
+
+            r = op_set_timer(op, msecs < 0 ? 0 : msecs == 0 ? 1 : msecs, 0);
+            ERR_THROW(r < 0, ncf, EEXEC, "failed to set timer for '%s'",
+                      exec_proc_name(op->proc));
+            return;
+        }
+        op_end_step(op);
+        ERR_BAIL(ncf);
+
+        if (op->step + 1 < op->nnames) {
+            op->step += 1;
+            op_start_step(ncf, op);
+            ERR_BAIL(ncf);
+        } else if (op->up) {
+            op->phase = OP_WAIT_ACTIVE;
+            op_watch_links(op);
+            r = op_set_timer(op, 1, OP_ACTIVE_INTERVAL);
+            ERR_THROW(r < 0, ncf, EOTHER, "failed to set timer for %s",
+                      op->nif->name);
+        } else {
+            op->phase = OP_DONE;
+        }
+    }
+
+    if (op->phase == OP_WAIT_ACTIVE) {
+        bool ticked = op_drain(op->timerfd);
+        bool changed = op->nlfd >= 0 && op_drain(op->nlfd);
+
+        if (!ticked && !changed)
+            return;
+        if (if_is_active(ncf, op->nif->name)) {
+            op->phase = OP_DONE;
+        } else if (ticked && ++op->tries >= OP_ACTIVE_TRIES) {
+            ERR_THROW(true, ncf, EOTHER,
+                      "interface %s failed to become active - "
+                      "possible disconnected cable.", op->nif->name);
+        }
+    }
+    return;
+
+ error:
+    op->phase = OP_DONE;
+}
+
+int if_up_down_names(struct netcf_if *nif, bool up, int nslaves,
+                     char **slaves, char ***names) {
+    struct netcf *ncf = nif->ncf;
+    int nnames = nslaves, r;
+
+    *names = slaves;
+    r = REALLOC_N(*names, nnames + 1);
+    ERR_NOMEM(r < 0, ncf);
+    nnames += 1;
+    if (up) {
+        /* Bridge slaves before the bridge */
+        (*names)[nnames - 1] = strdup(nif->name);
+    } else {
+        /* Bridge slaves after the bridge */
+        memmove(*names + 1, *names, (nnames - 1) * sizeof((*names)[0]));
+        (*names)[0] = strdup(nif->name);
+    }
+    ERR_NOMEM((*names)[up ? nnames - 1 : 0] == NULL, ncf);
+    return nnames;
+ error:
+    free_matches(nnames, names);
+    return -1;
+}
+
+struct netcf_op *op_start(struct netcf_if *nif, bool up) {
+    struct netcf *ncf = nif->ncf;
+    struct netcf_op *op = NULL;
+    struct epoll_event ev = { .events = EPOLLIN };
+    struct sockaddr_nl addr = { .nl_family = AF_NETLINK,
+                                .nl_groups = RTMGRP_LINK };
+    int r;
+
+    r = ALLOC(op);
+    ERR_NOMEM(r < 0, ncf);
+    op->nif = ref(nif);
+    op->up = up;
+    op->epfd = op->timerfd = op->nlfd = -1;
+
+    op->nnames = drv_if_up_down_names(nif, up, &op->prog, &op->names);
+    ERR_BAIL(ncf);
+
+    op->epfd = epoll_create1(EPOLL_CLOEXEC);
+    ERR_THROW(op->epfd < 0, ncf, EOTHER, "failed to create epoll fd");
+    op->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+    ERR_THROW(op->timerfd < 0, ncf, EOTHER, "failed to create timer fd");
+    r = epoll_ctl(op->epfd, EPOLL_CTL_ADD, op->timerfd, &ev);
+    ERR_THROW(r < 0, ncf, EOTHER, "failed to watch timer fd");
+
+    if (up) {
+        /* Only watched once ifup is done, see op_watch_links */
+        op->nlfd = socket(AF_NETLINK, SOCK_RAW|SOCK_NONBLOCK|SOCK_CLOEXEC,
+                          NETLINK_ROUTE);
+        if (op->nlfd >= 0
+            && bind(op->nlfd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+            close(op->nlfd);
+            op->nlfd = -1;
+        }
+    }
+
+    op->phase = OP_RUNNING;
+    op_start_step(ncf, op);
+    ERR_BAIL(ncf);
+    return op;
+
+ error:
+    op_free(op);
+    return NULL;
+}
+
+int op_fd(struct netcf_op *op) {
+    return op->epfd;
+}
+
+struct netcf *op_ncf(struct netcf_op *op) {
+    return op->nif->ncf;
+}
+
+int op_result(struct netcf_op *op) {
+    struct netcf *ncf = op->nif->ncf;
+
+    if (op->phase != OP_DONE) {
+        op_advance(ncf, op);
+        if (op->phase != OP_DONE)
+            return 1;
+        /* Remember how things ended, for later calls */
+        op->errcode = ncf->errcode;
+        op->errdetails = ncf->errdetails;
+        ncf->errdetails = NULL;
+        ncf->errcode = NETCF_NOERROR;
+    }
+    if (op->errcode == NETCF_NOERROR)
+        return 0;
+    report_error(ncf, op->errcode, "%s",
+                 op->errdetails != NULL ? op->errdetails : "");
+    return -1;
+}
+
+void op_free(struct netcf_op *op) {
+    if (op == NULL)
+        return;
+    op_end_step(op);
+    if (op->epfd >= 0)
+        close(op->epfd);
+    if (op->timerfd >= 0)
+        close(op->timerfd);
+    if (op->nlfd >= 0)
+        close(op->nlfd);
+    free_matches(op->nnames, &op->names);
+    FREE(op->errdetails);
+    unref(op->nif, netcf_if);
+    FREE(op);
+}
+
 /* vim: set ts=4 sw=4 et: */
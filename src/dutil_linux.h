@@ -46,6 +46,8 @@ struct driver {
     unsigned int       copy_augeas_xfm : 1;
     unsigned int       augeas_xfm_num_tables;
     const struct augeas_xfm_table **augeas_xfm_tables;
+    struct file_locks *locks;           /* See lock_files_acquire */
+    struct netcf_shm  *shm;             /* Set by ncf_shm_publish */
 };
 
 struct augeas_pv {
@@ -70,9 +72,92 @@ int remove_augeas_xfm_table(struct netcf *ncf,
 /* Get or create the augeas instance from NCF */
 augeas *get_augeas(struct netcf *ncf);
 
-/* Save changes in augeas and raise error with message on failure */
+/* Save changes in augeas and raise error with message on failure. Unless
+ * the durability policy of NCF is NETCF_DURABILITY_DEFAULT, this is the
+ * same as aug_save_group */
 int aug_save_assert(struct netcf *ncf);
 
+/* Save changes in augeas like aug_save_assert, but all-or-nothing: if
+ * writing any file fails, the files that were already written are
+ * restored, and the changes to the tree are discarded.
+ *
+ * Unless the durability policy of NCF is NETCF_DURABILITY_DEFAULT, all
+ * files are written under a temporary name first, flushed to disk as the
+ * policy requires, and then renamed into place in dependency order */
+int aug_save_group(struct netcf *ncf);
+
+/* Discard unsaved changes to the augeas tree; the next GET_AUGEAS
+ * reloads all files */
+void aug_revert(struct netcf *ncf);
+
+/* The configuration files that a transaction covers: all regular files
+ * in DIR, relative to the root, whose names start with one of PREFIXES.
+ * The snapshot functions take a list of these, terminated by an entry
+ * whose DIR is NULL */
+struct snapshot_files {
+    const char         *dir;
+    const char *const  *prefixes;       /* NULL terminated */
+};
+
+/* Take a snapshot of FILES for ncf_change_begin. Fails with
+ * NETCF_EINVALIDOP if there already is one */
+int snapshot_begin(struct netcf *ncf, const struct snapshot_files *files);
+
+/* Throw away the snapshot taken by snapshot_begin */
+int snapshot_commit(struct netcf *ncf);
+
+/* List the files in FILES that were changed, added or removed since
+ * snapshot_begin, as paths relative to the root. Returns the number of
+ * paths in CHANGED, or -1 on error */
+int snapshot_changes(struct netcf *ncf, const struct snapshot_files *files,
+                     char ***changed);
+
+/* Put the files from the snapshot taken by snapshot_begin back in place
+ * and throw the snapshot away. Only files that differ from the snapshot
+ * are touched */
+int snapshot_rollback(struct netcf *ncf, const struct snapshot_files *files);
+
+/* Locks that keep other processes from changing the files we are about
+ * to change. A driver that changes the tree:
+ *
+ *   - adds the augeas paths of the files it expects to touch with
+ *     lock_files_add, and locks all of them with lock_files_acquire;
+ *     this also makes the next GET_AUGEAS read them again
+ *   - makes its changes, and calls lock_files_cover_save. If that
+ *     returns false, the changes also touch files we did not lock; they
+ *     have been discarded, and the driver has to start over with
+ *     lock_files_acquire, which now also locks those files
+ *   - saves, and calls lock_files_release
+ */
+void lock_files_add(struct netcf *ncf, const char *path);
+void lock_files_acquire(struct netcf *ncf);
+bool lock_files_cover_save(struct netcf *ncf);
+void lock_files_release(struct netcf *ncf);
+/* Release the locks and close the lock file, for drv_close */
+void lock_files_free(struct netcf *ncf);
+
+/* How a driver defines one interface, for define_many */
+struct define_ops {
+    /* Check XML_STR and turn it into *NCF_XML and *AUG_XML. Returns the
+     * name of the interface, or NULL on error */
+    char *(*prepare)(struct netcf *ncf, const char *xml_str,
+                     unsigned int flags,
+                     xmlDocPtr *ncf_xml, xmlDocPtr *aug_xml);
+    /* Add the files that defining NAME touches with lock_files_add; NULL
+     * if the driver does not lock files */
+    void (*lock)(struct netcf *ncf, const char *name, xmlDocPtr aug_xml);
+    /* Put the interface NAME into the augeas tree */
+    void (*apply)(struct netcf *ncf, const char *name,
+                  xmlDocPtr ncf_xml, xmlDocPtr aug_xml);
+};
+
+/* drv_define_many with the steps in OPS: prepare all documents, skipping
+ * the ones that fail, apply the others, and save them all at once, or
+ * revert all of them if applying or saving fails */
+int define_many(struct netcf *ncf, const struct define_ops *ops,
+                int ndocs, const char *const *xmls, unsigned int flags,
+                struct netcf_if **ifaces, int *status);
+
 /* Define a node inside the augeas tree */
 ATTRIBUTE_FORMAT(printf, 4, 5)
 int defnode(struct netcf *ncf, const char *name, const char *value,
@@ -129,6 +214,24 @@ int netlink_close(struct netcf *ncf);
 /* Check if the interface INTF is up using an ioctl call */
 int if_is_active(struct netcf *ncf, const char *intf);
 
+/* Did ifup or ifdown complain about the interface NAME in OUTPUT ? */
+bool if_failed_in_output(const char *output, const char *name);
+
+/* Once ifup or ifdown ran for all of IFACES, mark the interfaces in
+ * STATUS that were brought up (if UP is true) but did not become active
+ * as failed. The error NCF had when called, if any, stays the reported
+ * one. Returns the number of interfaces whose status is still
+ * NETCF_NOERROR */
+int if_check_active(struct netcf *ncf, int nifaces, struct netcf_if **ifaces,
+                    bool up, int *status);
+
+/* Put NIF and the NSLAVES bridge ports in SLAVES into *NAMES in the order
+ * in which they are brought up, or down if UP is false, for
+ * drv_if_up_down_names. Takes over SLAVES. Returns the number of names,
+ * or -1 on error */
+int if_up_down_names(struct netcf_if *nif, bool up, int nslaves,
+                     char **slaves, char ***names);
+
 /* Interface types recognized by netcf. */
 typedef enum {
     NETCF_IFACE_TYPE_NONE = 0,  /* not yet determined */
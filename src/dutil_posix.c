@@ -32,7 +32,14 @@
 #include <errno.h>
 
 #include <sys/wait.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <signal.h>
+#include <sched.h>
+#include <spawn.h>
+#include <dirent.h>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -43,7 +50,6 @@
 #include <arpa/inet.h>
 
 #include "safe-alloc.h"
-#include "read-file.h"
 #include "ref.h"
 #include "list.h"
 #include "netcf.h"
@@ -52,8 +58,22 @@
 
 /*
  * Executing external programs
+ *
+ * We are often called from large, multithreaded processes like libvirtd,
+ * where fork() has to copy huge page tables and closing every possible
+ * file descriptor in the child means up to a million close() calls. We
+ * therefore start programs with posix_spawn and let it close inherited
+ * descriptors with a single close_range() where the C library supports
+ * that. Otherwise we use clone(CLONE_VM|CLONE_VFORK) ourselves and mark
+ * inherited descriptors close-on-exec, rather than closing them one by
+ * one.
+ *
+ * Each program runs in a process group of its own, so that when we kill
+ * it, whatever it started in turn goes with it.
  */
 
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP
+
 static int
 exec_program(struct netcf *ncf,
              const char *const*argv,
@@ -61,10 +81,12 @@ exec_program(struct netcf *ncf,
              pid_t *pid,
              int *outfd)
 {
-    sigset_t oldmask, newmask;
-    struct sigaction sig_action;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t mask;
     char errbuf[128];
     int pipeout[2] = {-1, -1};
+    int r;
 
     /* commandline is only used for error reporting */
     if (commandline == NULL)
@@ -72,50 +94,127 @@ exec_program(struct netcf *ncf,
 
     /* create a pipe to receive stdout+stderr from child */
     if (outfd) {
-        if (pipe(pipeout) < 0) {
+        if (pipe2(pipeout, O_CLOEXEC) < 0) {
             strerror_r(errno, errbuf, sizeof(errbuf));
             report_error(ncf, NETCF_EEXEC,
-                         "failed to create pipe while forking for '%s': %s",
+                         "failed to create pipe while spawning '%s': %s",
                          commandline, errbuf);
             goto error;
         }
         *outfd = pipeout[0];
     }
 
-    /*
-     * Need to block signals now, so that child process can safely
-     * kill off caller's signal handlers without a race.
-     */
-    sigfillset(&newmask);
-    if (pthread_sigmask(SIG_SETMASK, &newmask, &oldmask) != 0) {
-        strerror_r(errno, errbuf, sizeof(errbuf));
-        report_error(ncf, NETCF_EEXEC,
-                     "failed to set signal mask while forking for '%s': %s",
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    /* Reset all signal handlers and unmask all signals in the child,
+     * since we've no idea what the caller's done with them */
+    sigfillset(&mask);
+    posix_spawnattr_setsigdefault(&attr, &mask);
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF
+                                    | POSIX_SPAWN_SETSIGMASK
+                                    | POSIX_SPAWN_SETPGROUP);
+
+    if (pipeout[1] >= 0) {
+        /* direct stdout and stderr to the pipe */
+        posix_spawn_file_actions_adddup2(&actions, pipeout[1],
+                                         STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, pipeout[1],
+                                         STDERR_FILENO);
+    }
+    /* close all other open file descriptors */
+    posix_spawn_file_actions_addclosefrom_np(&actions, 3);
+
+    r = posix_spawnp(pid, argv[0], &actions, &attr,
+                     (char **) argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    ERR_THROW(r == ENOENT, ncf, EEXEC,
+              "Running '%s' program not found", commandline);
+    if (r != 0) {
+        strerror_r(r, errbuf, sizeof(errbuf));
+        report_error(ncf, NETCF_EEXEC, "failed to spawn '%s': %s",
                      commandline, errbuf);
         goto error;
     }
 
-    *pid = fork();
+    /* parent doesn't use write side of the pipe */
+    if (pipeout[1] >= 0)
+        close(pipeout[1]);
+    return 0;
 
-    ERR_THROW_STRERROR(*pid < 0, ncf, EEXEC, "failed to fork for '%s': %s",
-                       commandline, errbuf);
+error:
+    if (pipeout[0] >= 0)
+        close(pipeout[0]);
+    if (pipeout[1] >= 0)
+        close(pipeout[1]);
+    if (outfd)
+        *outfd = -1;
+    return -1;
+}
 
-    if (*pid) { /* parent */
-        /* Restore our original signal mask now that the child is
-           safely running */
-        ERR_THROW_STRERROR(pthread_sigmask(SIG_SETMASK, &oldmask, NULL) != 0,
-                           ncf, EEXEC,
-                           "failed to restore signal mask while forking for '%s': %s",
-                           commandline, errbuf);
+#else /* ! HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP */
 
-        /* parent doesn't use write side of the pipe */
-        if (pipeout[1] >= 0)
-            close(pipeout[1]);
+#ifndef CLOSE_RANGE_CLOEXEC
+# define CLOSE_RANGE_CLOEXEC (1U << 2)
+#endif
 
-        return 0;
+/* Size of the stack for the child of clone(); it only runs until execvp */
+#define EXEC_STACK_SIZE (64 * 1024)
+
+struct exec_child {
+    const char *const *argv;
+    int                pipeout[2];
+};
+
+/* Mark all file descriptors from LOWFD up close-on-exec. This runs in a
+ * child that shares memory with its parent, and therefore must not
+ * allocate memory, which rules out opendir() */
+static void cloexec_from(int lowfd) {
+    char buf[4096] __attribute__((aligned(8)));
+    long n;
+    int dfd;
+
+# ifdef SYS_close_range
+    if (syscall(SYS_close_range, lowfd, ~0U, CLOSE_RANGE_CLOEXEC) == 0)
+        return;
+# endif
+
+    dfd = open("/proc/self/fd", O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if (dfd < 0) {
+        int openmax = sysconf(_SC_OPEN_MAX);
+
+        for (int i = lowfd; i < openmax; i++)
+            close(i);
+        return;
     }
+    while ((n = syscall(SYS_getdents64, dfd, buf, sizeof(buf))) > 0) {
+        for (long off = 0; off < n;) {
+            struct dirent64 *de = (struct dirent64 *) (buf + off);
+            int fd = 0;
+            const char *p;
 
-    /* child */
+            off += de->d_reclen;
+            for (p = de->d_name; *p >= '0' && *p <= '9'; p++)
+                fd = 10 * fd + (*p - '0');
+            if (*p != '\0' || p == de->d_name || fd < lowfd || fd == dfd)
+                continue;
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+    close(dfd);
+}
+
+/* The child of clone(); it shares memory with the parent, which is
+ * suspended until we call execvp or _exit */
+static int exec_child(void *opaque) {
+    struct exec_child *child = opaque;
+    struct sigaction sig_action;
+    sigset_t newmask;
 
     /* Clear out all signal handlers from parent so nothing unexpected
        can happen in our child once we unblock signals */
@@ -124,8 +223,7 @@ exec_program(struct netcf *ncf,
     sig_action.sa_flags = 0;
     sigemptyset(&sig_action.sa_mask);
 
-    int i;
-    for (i = 1; i < NSIG; i++) {
+    for (int i = 1; i < NSIG; i++) {
         /* Only possible errors are EFAULT or EINVAL
            The former wont happen, the latter we
            expect, so no need to check return value */
@@ -142,44 +240,283 @@ exec_program(struct netcf *ncf,
         _exit(EXIT_SIGMASK);
     }
 
-    if (pipeout[1] >= 0) {
+    /* Only fails for a session leader, which a new child is not */
+    setpgid(0, 0);
+
+    if (child->pipeout[1] >= 0) {
         /* direct stdout and stderr to the pipe */
-        if (dup2(pipeout[1], fileno(stdout)) < 0
-            || dup2(pipeout[1], fileno(stderr)) < 0) {
+        if (dup2(child->pipeout[1], STDOUT_FILENO) < 0
+            || dup2(child->pipeout[1], STDERR_FILENO) < 0) {
             /* return a unique code and let the parent log the error */
             _exit(EXIT_DUP2);
         }
     }
-    /* child doesn't use the read side of the pipe */
-    if (pipeout[0] >= 0)
-        close(pipeout[0]);
 
-    /* close all open file descriptors */
-    int openmax = sysconf (_SC_OPEN_MAX);
-    for (i = 3; i < openmax; i++)
-        close(i);
+    /* don't pass any other open file descriptors on */
+    cloexec_from(3);
 
-    execvp(argv[0], (char **) argv);
+    execvp(child->argv[0], (char **) child->argv);
 
     /* if execvp() returns, it has failed */
     /* return a unique code and let the parent log the error */
     _exit(errno == ENOENT ? EXIT_ENOENT : EXIT_CANNOT_INVOKE);
+}
+
+static int
+exec_program(struct netcf *ncf,
+             const char *const*argv,
+             const char *commandline,
+             pid_t *pid,
+             int *outfd)
+{
+    sigset_t oldmask, newmask;
+    struct exec_child child = { argv, { -1, -1 } };
+    char errbuf[128];
+    char *stack = MAP_FAILED;
+    bool masked = false;
+
+    /* commandline is only used for error reporting */
+    if (commandline == NULL)
+        commandline = argv[0];
+
+    /* create a pipe to receive stdout+stderr from child */
+    if (outfd) {
+        if (pipe2(child.pipeout, O_CLOEXEC) < 0) {
+            strerror_r(errno, errbuf, sizeof(errbuf));
+            report_error(ncf, NETCF_EEXEC,
+                         "failed to create pipe while forking for '%s': %s",
+                         commandline, errbuf);
+            goto error;
+        }
+        *outfd = child.pipeout[0];
+    }
+
+    stack = mmap(NULL, EXEC_STACK_SIZE, PROT_READ|PROT_WRITE,
+                 MAP_PRIVATE|MAP_ANONYMOUS|MAP_STACK, -1, 0);
+    ERR_THROW_STRERROR(stack == MAP_FAILED, ncf, EEXEC,
+                       "failed to allocate stack for '%s': %s",
+                       commandline, errbuf);
+
+    /*
+     * Need to block signals now, so that the child, which shares our
+     * memory, can safely kill off caller's signal handlers without a
+     * race.
+     */
+    sigfillset(&newmask);
+    if (pthread_sigmask(SIG_SETMASK, &newmask, &oldmask) != 0) {
+        strerror_r(errno, errbuf, sizeof(errbuf));
+        report_error(ncf, NETCF_EEXEC,
+                     "failed to set signal mask while forking for '%s': %s",
+                     commandline, errbuf);
+        goto error;
+    }
+    masked = true;
+
+    /* The stack grows down on all architectures we care about */
+    *pid = clone(exec_child, stack + EXEC_STACK_SIZE,
+                 CLONE_VM|CLONE_VFORK|SIGCHLD, &child);
+
+    ERR_THROW_STRERROR(*pid < 0, ncf, EEXEC, "failed to fork for '%s': %s",
+                       commandline, errbuf);
+
+    /* Restore our original signal mask now that the child is
+       safely running */
+    masked = false;
+    ERR_THROW_STRERROR(pthread_sigmask(SIG_SETMASK, &oldmask, NULL) != 0,
+                       ncf, EEXEC,
+                       "failed to restore signal mask while forking for '%s': %s",
+                       commandline, errbuf);
+
+    munmap(stack, EXEC_STACK_SIZE);
+    /* parent doesn't use write side of the pipe */
+    if (child.pipeout[1] >= 0)
+        close(child.pipeout[1]);
+
+    return 0;
 
 error:
-    /* This is cleanup of parent process only - child
-       should never jump here on error */
-    if (pipeout[0] >= 0)
-        close(pipeout[0]);
-    if (pipeout[1] >= 0)
-        close(pipeout[1]);
+    if (masked)
+        pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+    if (stack != MAP_FAILED)
+        munmap(stack, EXEC_STACK_SIZE);
+    if (child.pipeout[0] >= 0)
+        close(child.pipeout[0]);
+    if (child.pipeout[1] >= 0)
+        close(child.pipeout[1]);
     if (outfd)
         *outfd = -1;
     return -1;
 }
 
+#endif /* ! HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP */
+
+/* How much of a program's output we keep for error messages */
+#define EXEC_OUTPUT_MAX (64 * 1024)
+/* Lines longer than this are passed to the output callback in pieces */
+#define EXEC_LINE_MAX 1024
+/* How long a program gets to exit after SIGTERM before we SIGKILL it */
+#define EXEC_KILL_GRACE 2000
+/* How long we give a program we SIGKILLed to go away when we must not
+ * block; it hardly ever takes more than a few msecs */
+#define EXEC_KILL_REAP 100
+
+struct exec_output {
+    char   *text;                   /* the output we keep, NUL-terminated */
+    size_t  len;
+    bool    truncated;
+    char    line[EXEC_LINE_MAX];    /* the line we are passing to the
+                                     * output callback */
+    size_t  linelen;
+};
+
+/* Milliseconds on the monotonic clock */
+static long long now_msecs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/* Hand the current line to the output callback. Returns -1 if the
+ * callback asks us to cancel the program */
+static int flush_line(struct netcf *ncf, struct exec_output *out) {
+    int r;
+
+    out->line[out->linelen] = '\0';
+    out->linelen = 0;
+    r = ncf->output_cb(ncf->output_opaque, out->line);
+    return r < 0 ? -1 : 0;
+}
+
+/* Record LEN bytes of output from BUF. Returns -1 if the output callback
+ * cancels the program */
+static int add_output(struct netcf *ncf, struct exec_output *out,
+                      const char *buf, size_t len) {
+    size_t keep = len;
+
+    if (out->len + keep > EXEC_OUTPUT_MAX) {
+        keep = EXEC_OUTPUT_MAX - out->len;
+        out->truncated = true;
+    }
+    memcpy(out->text + out->len, buf, keep);
+    out->len += keep;
+    out->text[out->len] = '\0';
+
+    if (ncf->output_cb == NULL)
+        return 0;
+    for (size_t i=0; i < len; i++) {
+        if (buf[i] == '\n') {
+            if (flush_line(ncf, out) < 0)
+                return -1;
+        } else {
+            out->line[out->linelen++] = buf[i];
+            if (out->linelen == EXEC_LINE_MAX - 1 && flush_line(ncf, out) < 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+/* Wait for PID to exit until DEADLINE, or forever if DEADLINE is 0.
+ * Returns PID once it has exited, 0 if the deadline passed, and -1 on
+ * error */
+static pid_t wait_child(pid_t pid, int *status, long long deadline) {
+    pid_t r;
+
+    while (true) {
+        r = waitpid(pid, status, deadline > 0 ? WNOHANG : 0);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r != 0 || now_msecs() >= deadline)
+            return r;
+        usleep(10 * 1000);
+    }
+}
+
+/* Ask PID and its process group to terminate, and kill them if PID takes
+ * too long. What is left of the group once PID is gone is killed, too;
+ * the group keeps PID from being reused until all of it is gone */
+static void kill_child(pid_t pid) {
+    int status;
+
+    kill(-pid, SIGTERM);
+    if (wait_child(pid, &status, now_msecs() + EXEC_KILL_GRACE) == 0) {
+        kill(-pid, SIGKILL);
+        wait_child(pid, &status, 0);
+    }
+    kill(-pid, SIGKILL);
+}
+
+/* Kill PID and its process group without a grace period, for callers
+ * that must not block */
+static void kill_child_now(pid_t pid) {
+    int status;
+
+    kill(-pid, SIGKILL);
+    wait_child(pid, &status, now_msecs() + EXEC_KILL_REAP);
+}
+
+/* Report an error if the program ARGV_STR, which produced OUT, did not
+ * exit successfully with EXITSTATUS. Returns the error code we
+ * reported, or NETCF_NOERROR */
+static netcf_errcode_t exit_error(struct netcf *ncf, const char *argv_str,
+                                  int exitstatus, struct exec_output *out) {
+    const char *more = out->truncated ? "..." : "";
+
+    if (!WIFEXITED(exitstatus) && WIFSIGNALED(exitstatus)) {
+        report_error(ncf, NETCF_EEXEC, "'%s' terminated by signal: %d",
+                     argv_str, WTERMSIG(exitstatus));
+        return NETCF_EEXEC;
+    }
+    if (!WIFEXITED(exitstatus)) {
+        report_error(ncf, NETCF_EEXEC, "'%s' terminated improperly",
+                     argv_str);
+        return NETCF_EEXEC;
+    }
+
+    switch (WEXITSTATUS(exitstatus)) {
+    case 0:
+        return NETCF_NOERROR;
+    case EXIT_ENOENT:
+        report_error(ncf, NETCF_EEXEC,
+                     "Running '%s' program not found", argv_str);
+        return NETCF_EEXEC;
+    case EXIT_CANNOT_INVOKE:
+        report_error(ncf, NETCF_EEXEC,
+                     "Running '%s' program located but not usable", argv_str);
+        return NETCF_EEXEC;
+    case EXIT_SIGMASK:
+        report_error(ncf, NETCF_EEXEC,
+                     "Running '%s' failed to reset child process signal mask",
+                     argv_str);
+        return NETCF_EEXEC;
+    case EXIT_DUP2:
+        report_error(ncf, NETCF_EEXEC,
+                     "Running '%s' failed to dup2 child process stdout/stderr",
+                     argv_str);
+        return NETCF_EEXEC;
+    case EXIT_INVALID_IN_THIS_STATE:
+        report_error(ncf, NETCF_EINVALIDOP,
+                     "Running '%s' operation is invalid in this state: %s%s",
+                     argv_str, out->text, more);
+        return NETCF_EINVALIDOP;
+    default:
+        report_error(ncf, NETCF_EEXEC,
+                     "Running '%s' failed with exit code %d: %s%s",
+                     argv_str, WEXITSTATUS(exitstatus), out->text, more);
+        return NETCF_EEXEC;
+    }
+}
+
 /**
  * Run a command without using the shell.
  *
+ * The combined stdout and stderr of the command is passed line by line
+ * to the handle's output callback, if there is one, and the first
+ * EXEC_OUTPUT_MAX bytes of it are returned in OUTPUT. If the command
+ * takes longer than the handle's exec timeout, it is killed and we fail
+ * with NETCF_ETIMEOUT.
+ *
  * return 0 if the command run and exited with 0 status; Otherwise
  * return -1
  *
@@ -192,75 +529,506 @@ int run_program(struct netcf *ncf, const char *const *argv, char **output)
     char *argv_str;
     int ret = -1;
     char errbuf[128];
-    char *outtext = NULL;
+    struct exec_output out;
     int outfd = -1;
-    FILE *outfile = NULL;
-    size_t outlen;
+    long long deadline = 0;
+    bool timed_out = false, cancelled = false;
+    struct span span;
 
-    if (!output)
-        output = &outtext;
+    MEMZERO(&out, 1);
+    if (output)
+        *output = NULL;
 
     argv_str = argv_to_string(argv);
     ERR_NOMEM(argv_str == NULL, ncf);
+    span = span_begin(ncf, NETCF_STAT_EXEC, argv_str);
+
+    ERR_NOMEM(ALLOC_N(out.text, EXEC_OUTPUT_MAX + 1) < 0, ncf);
+
+    if (ncf->exec_timeout > 0)
+        deadline = now_msecs() + ncf->exec_timeout;
 
     exec_program(ncf, argv, argv_str, &childpid, &outfd);
     ERR_BAIL(ncf);
 
-    outfile = fdopen(outfd, "r");
-    ERR_THROW_STRERROR(outfile == NULL, ncf, EEXEC,
-                       "Failed to create file stream for output while executing '%s': %s",
-                       argv_str, errbuf);
+    while (true) {
+        struct pollfd pfd = { .fd = outfd, .events = POLLIN };
+        int timeout = -1;
+        char buf[4096];
+        ssize_t n;
 
-    *output = fread_file(outfile, &outlen);
-    ERR_THROW_STRERROR(*output == NULL, ncf, EEXEC,
-                       "Error while reading output from execution of '%s': %s",
-                       argv_str, errbuf);
+        if (deadline > 0) {
+            long long left = deadline - now_msecs();
+            if (left <= 0) {
+                timed_out = true;
+                break;
+            }
+            timeout = left;
+        }
 
-    /* finished with the stream. Close it so the child can exit. */
-    fclose(outfile);
-    outfile = NULL;
+        n = poll(&pfd, 1, timeout);
+        if (n < 0 && errno == EINTR)
+            continue;
+        ERR_THROW_STRERROR(n < 0, ncf, EEXEC,
+                           "Error while reading output from execution of '%s': %s",
+                           argv_str, errbuf);
+        if (n == 0)
+            continue;
 
-    while ((waitret = waitpid(childpid, &exitstatus, 0)) == -1 &&
-           errno == EINTR) {
-        /* empty loop */
+        n = read(outfd, buf, sizeof(buf));
+        if (n < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        ERR_THROW_STRERROR(n < 0, ncf, EEXEC,
+                           "Error while reading output from execution of '%s': %s",
+                           argv_str, errbuf);
+        if (n == 0)
+            break;
+        if (add_output(ncf, &out, buf, n) < 0) {
+            cancelled = true;
+            break;
+        }
     }
+    if (!timed_out && !cancelled && out.linelen > 0 && ncf->output_cb != NULL)
+        cancelled = flush_line(ncf, &out) < 0;
 
-    ERR_THROW_STRERROR(waitret == -1, ncf, EEXEC,
-                       "Failed waiting for completion of '%s': %s",
-                       argv_str, errbuf);
-    ERR_THROW(!WIFEXITED(exitstatus) && WIFSIGNALED(exitstatus), ncf, EEXEC,
-              "'%s' terminated by signal: %d",
-              argv_str, WTERMSIG(exitstatus));
-    ERR_THROW(!WIFEXITED(exitstatus), ncf, EEXEC,
-              "'%s' terminated improperly", argv_str);
-    ERR_THROW(WEXITSTATUS(exitstatus) == EXIT_ENOENT, ncf, EEXEC,
-              "Running '%s' program not found", argv_str);
-    ERR_THROW(WEXITSTATUS(exitstatus) == EXIT_CANNOT_INVOKE, ncf, EEXEC,
-              "Running '%s' program located but not usable", argv_str);
-    ERR_THROW(WEXITSTATUS(exitstatus) == EXIT_SIGMASK, ncf, EEXEC,
-              "Running '%s' failed to reset child process signal mask",
-              argv_str);
-    ERR_THROW(WEXITSTATUS(exitstatus) == EXIT_DUP2, ncf, EEXEC,
-              "Running '%s' failed to dup2 child process stdout/stderr",
-              argv_str);
-    ERR_THROW(WEXITSTATUS(exitstatus) == EXIT_INVALID_IN_THIS_STATE, ncf, EINVALIDOP,
-              "Running '%s' operation is invalid in this state: %s",
-              argv_str, *output);
-    ERR_THROW(WEXITSTATUS(exitstatus) != 0, ncf, EEXEC,
-              "Running '%s' failed with exit code %d: %s",
-              argv_str, WEXITSTATUS(exitstatus), *output);
+    /* finished with the pipe. Close it so the child can exit. */
+    close(outfd);
+    outfd = -1;
+
+    if (!timed_out && !cancelled) {
+        waitret = wait_child(childpid, &exitstatus, deadline);
+        ERR_THROW_STRERROR(waitret == -1, ncf, EEXEC,
+                           "Failed waiting for completion of '%s': %s",
+                           argv_str, errbuf);
+        timed_out = (waitret == 0);
+    }
+    if (timed_out || cancelled) {
+        kill_child(childpid);
+        childpid = -1;
+    }
+    ERR_THROW(timed_out, ncf, ETIMEOUT,
+              "'%s' did not finish within %u ms",
+              argv_str, ncf->exec_timeout);
+    ERR_THROW(cancelled, ncf, EEXEC,
+              "'%s' was cancelled by the output callback", argv_str);
+    childpid = -1;
+
+    exit_error(ncf, argv_str, exitstatus, &out);
+    ERR_BAIL(ncf);
     ret = 0;
 
 error:
-    if (outfile)
-        fclose(outfile);
-    else if (outfd >= 0)
+    if (outfd >= 0)
         close(outfd);
-    FREE(outtext);
+    if (childpid > 0)
+        kill_child(childpid);
+    if (output != NULL && out.text != NULL) {
+        *output = out.text;
+        out.text = NULL;
+    }
+    FREE(out.text);
+    if (argv_str != NULL)
+        span_end(&span);
     FREE(argv_str);
     return ret;
 }
 
+/*
+ * Running several programs at once
+ */
+
+/* How long to sleep between checks for jobs that closed their output but
+ * have not exited yet, in msecs */
+#define JOB_REAP_INTERVAL 10
+
+enum job_state {
+    JOB_WAITING = 0,
+    JOB_RUNNING,
+    JOB_DONE
+};
+
+/* The bookkeeping run_jobs keeps for each job */
+struct job_run {
+    enum job_state     state;
+    pid_t              pid;
+    int                fd;              /* read side of the output pipe,
+                                         * -1 after EOF */
+    char              *argv_str;
+    long long          deadline;
+    struct span        span;            /* from start until reaped */
+    struct exec_output out;
+};
+
+/* Finish RUN after its program exited with EXITSTATUS, or, if TIMED_OUT
+ * or CANCELLED, after it was killed */
+static void job_finish(struct netcf *ncf, struct exec_job *job,
+                       struct job_run *run, int exitstatus,
+                       bool timed_out, bool cancelled) {
+    if (run->fd >= 0)
+        close(run->fd);
+    run->fd = -1;
+    if (timed_out || cancelled)
+        kill_child(run->pid);
+    run->pid = -1;
+    run->state = JOB_DONE;
+    span_end(&run->span);
+
+    if (timed_out) {
+        report_error(ncf, NETCF_ETIMEOUT, "'%s' did not finish within %u ms",
+                     run->argv_str, ncf->exec_timeout);
+        job->status = NETCF_ETIMEOUT;
+    } else if (cancelled) {
+        report_error(ncf, NETCF_EEXEC,
+                     "'%s' was cancelled by the output callback",
+                     run->argv_str);
+        job->status = NETCF_EEXEC;
+    } else {
+        job->status = exit_error(ncf, run->argv_str, exitstatus, &run->out);
+    }
+}
+
+/* Start JOB if it is ready. Returns true if it is running now */
+static bool job_start(struct netcf *ncf, struct exec_job *jobs,
+                      struct job_run *runs, int index) {
+    struct exec_job *job = jobs + index;
+    struct job_run *run = runs + index;
+
+    for (int d=0; d < job->ndeps; d++) {
+        struct exec_job *dep = jobs + job->deps[d];
+
+        if (runs[job->deps[d]].state != JOB_DONE)
+            return false;
+        if (dep->status != NETCF_NOERROR) {
+            /* Don't bother running jobs whose prerequisites failed */
+            job->status = dep->status;
+            run->state = JOB_DONE;
+            return false;
+        }
+    }
+
+    run->argv_str = argv_to_string(job->argv);
+    if (run->argv_str == NULL
+        || ALLOC_N(run->out.text, EXEC_OUTPUT_MAX + 1) < 0) {
+        report_error(ncf, NETCF_ENOMEM, NULL);
+        job->status = NETCF_ENOMEM;
+        run->state = JOB_DONE;
+        return false;
+    }
+    if (ncf->exec_timeout > 0)
+        run->deadline = now_msecs() + ncf->exec_timeout;
+
+    run->span = span_begin(ncf, NETCF_STAT_EXEC, run->argv_str);
+    if (exec_program(ncf, job->argv, run->argv_str, &run->pid,
+                     &run->fd) < 0) {
+        span_end(&run->span);
+        job->status = NETCF_EEXEC;
+        run->state = JOB_DONE;
+        return false;
+    }
+    run->state = JOB_RUNNING;
+    return true;
+}
+
+/* Collect output from the running jobs, and finish those that exited */
+static void jobs_wait(struct netcf *ncf, int njobs, struct exec_job *jobs,
+                      struct job_run *runs) {
+    struct pollfd pfds[njobs];
+    int npfds = 0, timeout = -1;
+    long long now = now_msecs();
+
+    for (int i=0; i < njobs; i++) {
+        struct job_run *run = runs + i;
+
+        if (run->state != JOB_RUNNING)
+            continue;
+        if (run->deadline > 0) {
+            long long left = run->deadline - now;
+            if (left <= 0) {
+                job_finish(ncf, jobs + i, run, 0, true, false);
+                return;
+            }
+            if (timeout < 0 || left < timeout)
+                timeout = left;
+        }
+        if (run->fd < 0) {
+            /* Output is closed, but the program has not exited yet */
+            if (timeout < 0 || timeout > JOB_REAP_INTERVAL)
+                timeout = JOB_REAP_INTERVAL;
+            continue;
+        }
+        pfds[npfds].fd = run->fd;
+        pfds[npfds].events = POLLIN;
+        pfds[npfds].revents = 0;
+        npfds += 1;
+    }
+
+    if (poll(pfds, npfds, timeout) < 0 && errno != EINTR)
+        return;
+
+    for (int i=0; i < njobs; i++) {
+        struct job_run *run = runs + i;
+        int exitstatus;
+        bool readable = false;
+
+        if (run->state != JOB_RUNNING)
+            continue;
+        for (int p=0; p < npfds; p++)
+            if (pfds[p].fd == run->fd && pfds[p].revents != 0)
+                readable = true;
+
+        if (readable) {
+            char buf[4096];
+            ssize_t n = read(run->fd, buf, sizeof(buf));
+
+            if (n < 0 && (errno == EINTR || errno == EAGAIN))
+                continue;
+            if (n > 0) {
+                if (add_output(ncf, &run->out, buf, n) < 0)
+                    job_finish(ncf, jobs + i, run, 0, false, true);
+                continue;
+            }
+            /* EOF or error: we are done reading */
+            if (ncf->output_cb != NULL && run->out.linelen > 0
+                && flush_line(ncf, &run->out) < 0) {
+                job_finish(ncf, jobs + i, run, 0, false, true);
+                continue;
+            }
+            close(run->fd);
+            run->fd = -1;
+        }
+        if (run->fd < 0
+            && waitpid(run->pid, &exitstatus, WNOHANG) == run->pid)
+            job_finish(ncf, jobs + i, run, exitstatus, false, false);
+    }
+}
+
+int run_jobs(struct netcf *ncf, int njobs, struct exec_job *jobs,
+             int maxjobs) {
+    struct job_run *runs = NULL;
+    int nrunning, ndone, nfailed = -1;
+    int r;
+
+    r = ALLOC_N(runs, njobs);
+    ERR_NOMEM(r < 0, ncf);
+    for (int i=0; i < njobs; i++) {
+        runs[i].pid = -1;
+        runs[i].fd = -1;
+        jobs[i].status = NETCF_NOERROR;
+    }
+    if (maxjobs <= 0)
+        maxjobs = 1;
+
+    while (true) {
+        bool progress;
+
+        /* Start whatever we can; marking a job as failed because one of
+         * its prerequisites failed can make more jobs ready */
+        do {
+            progress = false;
+            nrunning = 0;
+            for (int i=0; i < njobs; i++)
+                if (runs[i].state == JOB_RUNNING)
+                    nrunning += 1;
+            for (int i=0; i < njobs && nrunning < maxjobs; i++) {
+                if (runs[i].state != JOB_WAITING)
+                    continue;
+                if (job_start(ncf, jobs, runs, i))
+                    nrunning += 1;
+                if (runs[i].state != JOB_WAITING)
+                    progress = true;
+            }
+        } while (progress);
+
+        ndone = 0;
+        for (int i=0; i < njobs; i++)
+            if (runs[i].state == JOB_DONE)
+                ndone += 1;
+        if (ndone == njobs)
+            break;
+        if (nrunning == 0) {
+            /* The remaining jobs wait for each other */
+            for (int i=0; i < njobs; i++) {
+                if (runs[i].state == JOB_WAITING) {
+                    jobs[i].status = NETCF_EINTERNAL;
+                    runs[i].state = JOB_DONE;
+                }
+            }
+            report_error(ncf, NETCF_EINTERNAL, "circular job dependencies");
+            continue;
+        }
+
+        jobs_wait(ncf, njobs, jobs, runs);
+    }
+
+    nfailed = 0;
+    for (int i=0; i < njobs; i++)
+        if (jobs[i].status != NETCF_NOERROR)
+            nfailed += 1;
+
+ error:
+    if (runs != NULL) {
+        for (int i=0; i < njobs; i++) {
+            FREE(runs[i].argv_str);
+            FREE(runs[i].out.text);
+        }
+    }
+    FREE(runs);
+    return nfailed;
+}
+
+/*
+ * Programs that run in the background
+ */
+
+struct exec_proc {
+    pid_t              pid;
+    int                fd;              /* read side of the output pipe */
+    char              *argv_str;
+    long long          deadline;        /* 0 if there is no timeout */
+    unsigned int       timeout;
+    struct span        span;            /* from start until reaped */
+    bool               timing;          /* SPAN has not ended yet */
+    struct exec_output out;
+};
+
+/* PROC is gone, or about to be */
+static void exec_proc_reaped(struct exec_proc *proc) {
+    proc->pid = -1;
+    if (proc->timing)
+        span_end(&proc->span);
+    proc->timing = false;
+}
+
+struct exec_proc *exec_start(struct netcf *ncf, const char *const *argv) {
+    struct exec_proc *proc = NULL;
+    char errbuf[128];
+    int r;
+
+    r = ALLOC(proc);
+    ERR_NOMEM(r < 0, ncf);
+    proc->pid = -1;
+    proc->fd = -1;
+    proc->argv_str = argv_to_string(argv);
+    ERR_NOMEM(proc->argv_str == NULL, ncf);
+    r = ALLOC_N(proc->out.text, EXEC_OUTPUT_MAX + 1);
+    ERR_NOMEM(r < 0, ncf);
+
+    if (ncf->exec_timeout > 0) {
+        proc->timeout = ncf->exec_timeout;
+        proc->deadline = now_msecs() + proc->timeout;
+    }
+
+    proc->span = span_begin(ncf, NETCF_STAT_EXEC, proc->argv_str);
+    proc->timing = true;
+    exec_program(ncf, argv, proc->argv_str, &proc->pid, &proc->fd);
+    ERR_BAIL(ncf);
+    ERR_THROW_STRERROR(fcntl(proc->fd, F_SETFL, O_NONBLOCK) < 0,
+                       ncf, EEXEC, "failed to set up output of '%s': %s",
+                       proc->argv_str, errbuf);
+    return proc;
+ error:
+    exec_proc_free(proc);
+    return NULL;
+}
+
+int exec_proc_fd(struct exec_proc *proc) {
+    return proc->fd;
+}
+
+const char *exec_proc_name(struct exec_proc *proc) {
+    return proc->argv_str;
+}
+
+int exec_proc_poll(struct netcf *ncf, struct exec_proc *proc) {
+    char errbuf[128];
+    int exitstatus;
+    pid_t waitret;
+
+    while (proc->fd >= 0) {
+        char buf[4096];
+        ssize_t n = read(proc->fd, buf, sizeof(buf));
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && errno == EAGAIN)
+            goto running;
+        ERR_THROW_STRERROR(n < 0, ncf, EEXEC,
+                           "Error while reading output from execution of '%s': %s",
+                           proc->argv_str, errbuf);
+        if (n == 0) {
+            if (ncf->output_cb != NULL && proc->out.linelen > 0)
+                ERR_THROW(flush_line(ncf, &proc->out) < 0, ncf, EEXEC,
+                          "'%s' was cancelled by the output callback",
+                          proc->argv_str);
+            close(proc->fd);
+            proc->fd = -1;
+            break;
+        }
+        ERR_THROW(add_output(ncf, &proc->out, buf, n) < 0, ncf, EEXEC,
+                  "'%s' was cancelled by the output callback",
+                  proc->argv_str);
+    }
+
+    /* The program closed its output, but that does not mean that it is
+     * done; it may have handed stdout to a daemon, or closed it */
+    do {
+        waitret = waitpid(proc->pid, &exitstatus, WNOHANG);
+    } while (waitret < 0 && errno == EINTR);
+    ERR_THROW_STRERROR(waitret == -1, ncf, EEXEC,
+                       "Failed waiting for completion of '%s': %s",
+                       proc->argv_str, errbuf);
+    if (waitret == 0)
+        goto running;
+    exec_proc_reaped(proc);
+    exit_error(ncf, proc->argv_str, exitstatus, &proc->out);
+    ERR_BAIL(ncf);
+    return 0;
+
+ running:
+    if (proc->deadline > 0 && now_msecs() >= proc->deadline) {
+        kill_child_now(proc->pid);
+        exec_proc_reaped(proc);
+        ERR_THROW(true, ncf, ETIMEOUT, "'%s' did not finish within %u ms",
+                  proc->argv_str, proc->timeout);
+    }
+    return 1;
+ error:
+    return -1;
+}
+
+int exec_proc_wait_msecs(struct exec_proc *proc) {
+    int msecs = -1;
+
+    if (proc->deadline > 0) {
+        long long left = proc->deadline - now_msecs();
+        msecs = left > 0 ? left : 0;
+    }
+    if (proc->fd < 0 && (msecs < 0 || msecs > JOB_REAP_INTERVAL))
+        msecs = JOB_REAP_INTERVAL;
+    return msecs;
+}
+
+void exec_proc_free(struct exec_proc *proc) {
+    if (proc == NULL)
+        return;
+    if (proc->fd >= 0)
+        close(proc->fd);
+    if (proc->pid > 0)
+        kill_child_now(proc->pid);
+    exec_proc_reaped(proc);
+    FREE(proc->argv_str);
+    FREE(proc->out.text);
+    FREE(proc);
+}
+
+/* Exported for the exec benchmark in tests/ */
+int ncf_run_program(struct netcf *ncf, const char *const *argv,
+                    char **output) {
+    API_ENTRY(ncf);
+
+    return run_program(ncf, argv, output);
+}
+
 /* Run the program PROG with the single argument ARG */
 void run1(struct netcf *ncf, const char *prog, const char *arg) {
     const char *const argv[] = {
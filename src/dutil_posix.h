@@ -41,6 +41,55 @@ enum
 int run_program(struct netcf *ncf, const char *const *argv, char **output);
 void run1(struct netcf *ncf, const char *prog, const char *arg);
 
+/* A program to run as part of a batch with run_jobs */
+struct exec_job {
+    const char *const *argv;
+    int                ndeps;
+    int               *deps;    /* indices of the jobs that have to
+                                 * succeed before this one can start */
+    int                status;  /* set by run_jobs to NETCF_NOERROR or
+                                 * the error code for this job */
+};
+
+/* Run the NJOBS programs in JOBS, at most MAXJOBS at a time, starting each
+ * as soon as its prerequisites have finished. A job whose prerequisite
+ * failed is not run and gets the status of that prerequisite. ncf_error
+ * reports the first failure.
+ *
+ * Returns the number of jobs that failed, or -1 if we could not run any
+ */
+int run_jobs(struct netcf *ncf, int njobs, struct exec_job *jobs,
+             int maxjobs);
+
+/* A program running in the background, for callers that wait for it in
+ * their own event loop */
+struct exec_proc;
+
+/* Start the program ARGV in the background. Returns NULL on error */
+struct exec_proc *exec_start(struct netcf *ncf, const char *const *argv);
+
+/* A file descriptor that becomes readable when PROC has output for us or
+ * has exited. It is -1 once PROC has closed its output */
+int exec_proc_fd(struct exec_proc *proc);
+
+/* The command line of PROC, for error messages */
+const char *exec_proc_name(struct exec_proc *proc);
+
+/* Consume the output that PROC has produced so far without blocking.
+ * Returns 1 if it is still running, 0 if it has exited successfully, and
+ * -1 if it failed, with the same errors as run_program. A program that
+ * outlives the handle's exec timeout is killed */
+int exec_proc_poll(struct netcf *ncf, struct exec_proc *proc);
+
+/* How many msecs the caller may wait for EXEC_PROC_FD before it has to
+ * call exec_proc_poll again, for the exec timeout or for a program that
+ * closed its output but has not exited yet; -1 if only output matters */
+int exec_proc_wait_msecs(struct exec_proc *proc);
+
+/* Kill PROC if it is still running and free it, without waiting for it
+ * to shut down cleanly */
+void exec_proc_free(struct exec_proc *proc);
+
 /* Get a file descriptor to a ioctl socket */
 int init_ioctl_fd(struct netcf *ncf);
 
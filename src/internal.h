@@ -34,6 +34,10 @@
 #include <libxslt/transform.h>
 #include <libxml/relaxng.h>
 
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
 /*
  * Macros for gcc's attributes
  */
@@ -77,12 +81,20 @@
 #ifndef ATTRIBUTE_NOINLINE
 #define ATTRIBUTE_NOINLINE __attribute__((__noinline__))
 #endif
+
+#ifndef ATTRIBUTE_CLEANUP
+#define ATTRIBUTE_CLEANUP(func) __attribute__((__cleanup__(func)))
+#endif
 #else
 #define ATTRIBUTE_UNUSED
 #define ATTRIBUTE_FORMAT(...)
 #define ATTRIBUTE_PURE
 #define ATTRIBUTE_RETURN_CHECK
 #define ATTRIBUTE_NOINLINE
+/* API_ENTRY unlocks the handle, and API_TIMER ends its span, from a
+ * cleanup handler; without one, every API call would leave the handle
+ * locked */
+#error "netcf needs a compiler that supports __attribute__((cleanup))"
 #endif                                   /* __GNUC__ */
 
 /* This needs ATTRIBUTE_RETURN_CHECK */
@@ -148,19 +160,70 @@
         }                                               \
     } while(0)
 
-/* Clear error code and details */
-#define API_ENTRY(ncf)                          \
-    do {                                        \
-        (ncf)->errcode = NETCF_NOERROR;         \
-        FREE((ncf)->errdetails);                \
-        if (ncf->driver != NULL)                \
-            drv_entry(ncf);                     \
-    } while(0);
+/* Lock NCF and clear error code and details. The lock is released, and
+ * the error handed to the calling thread, by api_exit when the function
+ * that used API_ENTRY returns */
+#define API_ENTRY(ncf)                                                  \
+    API_TIMER(ncf)                                                      \
+    struct netcf *api_ncf_ ATTRIBUTE_CLEANUP(api_exit) = api_enter(ncf);
+
+/* Like API_ENTRY, for functions that do not change the configuration.
+ * Such calls still take turns using augeas, but they can overlap with
+ * each other where they drop the lock with api_suspend */
+#define API_ENTRY_READ(ncf)                                             \
+    API_TIMER(ncf)                                                      \
+    struct netcf *api_ncf_ ATTRIBUTE_CLEANUP(api_exit) =                \
+        api_enter_read(ncf);
+
+/* Count and trace the call as a NETCF_STAT_API span. It is declared
+ * first so that it also covers waiting for the lock */
+#define API_TIMER(ncf)                                                  \
+    struct span api_span_ ATTRIBUTE_CLEANUP(span_end) =                 \
+        span_begin((ncf), NETCF_STAT_API, __func__);
 
 /*
  * netcf structures and internal API's
  */
 struct driver;
+struct rngc;
+
+/* Counters for things we want to keep track of, mostly to find out how
+ * much work caches save us */
+typedef enum {
+    NCF_COUNTER_RNG_VALIDATE,         /* full RelaxNG validations */
+    NCF_COUNTER_RNG_NATIVE,           /* validations done by the generated
+                                       * validator in interface_rng.c */
+    NCF_COUNTER_RNG_CACHED,           /* validations skipped because the
+                                       * document was validated before */
+    NCF_COUNTER_RNG_TRUSTED,          /* validations skipped because the
+                                       * caller validated the document */
+    NCF_COUNTER_LAST
+} ncf_counter_t;
+
+#define NCF_COUNT(ncf, counter) ((ncf)->counters[NCF_COUNTER_##counter] += 1)
+
+/* A piece of expensive work, for ncf_get_stats, the trace callback and
+ * the USDT probes netcf:span_begin and netcf:span_end. Call span_begin
+ * before doing work of kind KIND about ATTR, which must stay valid until
+ * the span ends, and span_end afterwards. Neither needs NCF to be
+ * locked, so they can be used around api_suspend'ed work */
+struct span {
+    struct netcf      *ncf;
+    struct netcf_span  info;
+};
+struct span span_begin(struct netcf *ncf, netcf_stat_t kind,
+                       const char *attr);
+void span_end(struct span *span);
+
+/* Documents that passed validation, identified by the SHA-256 digest of
+ * their text. We remember the RNG_CACHE_SIZE most recently used ones */
+#define RNG_CACHE_SIZE 64
+#define RNG_DIGEST_SIZE 32
+
+struct rng_cache_entry {
+    unsigned char digest[RNG_DIGEST_SIZE];
+    unsigned long used;                   /* LRU clock, 0 for empty slots */
+};
 
 struct netcf {
     ref_t            ref;
@@ -168,12 +231,58 @@ struct netcf {
                                            * with '/' */
     const char      *data_dir;            /* Where to find stylesheets etc. */
     xmlRelaxNGPtr    rng;                 /* RNG of <interface> elements */
+    int              rng_serial;          /* v:serial of the RNG, or -1 */
+    struct rngc     *rngc;                /* Compiled RNG, NULL if it does
+                                           * not match RNG */
+    struct rng_cache_entry rng_cache[RNG_CACHE_SIZE];
+    unsigned long    rng_cache_clock;
     netcf_errcode_t  errcode;
     char            *errdetails;          /* Error details */
     struct driver   *driver;              /* Driver specific data */
     unsigned int     debug;
+    netcf_durability_t durability;        /* Set by ncf_set_durability */
+    unsigned int     exec_timeout;        /* In msecs, 0 for none */
+    ncf_output_callback output_cb;        /* Set by ncf_set_output_callback */
+    void            *output_opaque;
+    unsigned long    counters[NCF_COUNTER_LAST];
+    struct netcf_stat stats[NETCF_STAT_LAST]; /* Updated atomically, see
+                                           * span_end */
+    ncf_trace_callback trace_cb;          /* Set by ncf_set_trace_callback */
+    void            *trace_opaque;
+    int              remote;              /* Socket connected to netcfd,
+                                           * or -1 to use the driver */
+    unsigned long    serial;              /* Unique for each handle, so
+                                           * that per-thread error state of
+                                           * a closed handle is never
+                                           * mistaken for that of a new
+                                           * one at the same address */
+#ifdef HAVE_LIBPTHREAD
+    pthread_rwlock_t calls;               /* Held for writing by API_ENTRY,
+                                           * for reading by API_ENTRY_READ */
+    pthread_mutex_t  lock;                /* Guards everything else in here,
+                                           * and the driver; recursive */
+#endif
 };
 
+/* Thread safety: a struct netcf can be shared between threads. All API
+ * functions lock it with API_ENTRY or API_ENTRY_READ for their duration,
+ * and the error they leave behind is copied to storage private to the
+ * calling thread, which is what ncf_error reports. See dutil.c */
+int api_init(struct netcf *ncf);
+void api_destroy(struct netcf *ncf);
+struct netcf *api_enter(struct netcf *ncf);
+struct netcf *api_enter_read(struct netcf *ncf);
+void api_exit(struct netcf **ncfp);
+/* Let go of NCF's lock for a stretch of work that only touches data
+ * private to the calling thread, and take it back. There must be no error
+ * pending when suspending. Calls that used API_ENTRY keep other calls out
+ * even then */
+void api_suspend(struct netcf *ncf);
+void api_resume(struct netcf *ncf);
+/* Try to lock NCF for ncf_close; fails if another thread is using it */
+int api_enter_exclusive(struct netcf *ncf);
+netcf_errcode_t api_error(struct netcf *ncf, const char **details);
+
 struct netcf_if {
     ref_t         ref;
     struct netcf *ncf;
@@ -197,18 +306,84 @@ int drv_list_interfaces(struct netcf *ncf, int maxnames, char **names, unsigned
 struct netcf_if *drv_lookup_by_name(struct netcf *ncf, const char *name);
 int drv_lookup_by_mac_string(struct netcf *, const char *mac,
                              int maxifaces, struct netcf_if **ifaces);
-char *drv_xml_desc(struct netcf_if *);
-char *drv_xml_state(struct netcf_if *);
+/* Write the XML description or the live state of the interface to OUT,
+ * which remains owned by the caller. Return 0 on success, -1 on error */
+int drv_xml_desc(struct netcf_if *, xmlOutputBufferPtr out);
+int drv_xml_state(struct netcf_if *, xmlOutputBufferPtr out);
 int drv_if_status(struct netcf_if *nif, unsigned int *flags);
 int drv_change_begin(struct netcf *ncf, unsigned int flags);
-int drv_change_rollback(struct netcf *ncf, unsigned int flags);
+int drv_change_rollback(struct netcf *ncf, unsigned int flags,
+                        int maxnames, char **names);
 int drv_change_commit(struct netcf *ncf, unsigned int flags);
 
 const char *drv_mac_string(struct netcf_if *nif);
-struct netcf_if *drv_define(struct netcf *ncf, const char *xml);
+struct netcf_if *drv_define(struct netcf *ncf, const char *xml,
+                            unsigned int flags);
+int drv_define_many(struct netcf *ncf, int ndocs, const char *const *xmls,
+                    unsigned int flags, struct netcf_if **ifaces,
+                    int *status);
 int drv_undefine(struct netcf_if *nif);
+int drv_undefine_many(struct netcf *ncf, int nifaces,
+                      struct netcf_if **ifaces);
 int drv_if_up(struct netcf_if *nif);
 int drv_if_down(struct netcf_if *nif);
+int drv_if_up_many(struct netcf *ncf, int nifaces, struct netcf_if **ifaces,
+                   unsigned int maxjobs, int *status);
+int drv_if_down_many(struct netcf *ncf, int nifaces,
+                     struct netcf_if **ifaces, unsigned int maxjobs,
+                     int *status);
+/* The devices to run *PROG on, in order, to bring NIF up (or down if UP
+ * is false). Returns the number of devices in NAMES, or -1 on error */
+int drv_if_up_down_names(struct netcf_if *nif, bool up, const char **prog,
+                         char ***names);
+
+/* Asynchronous ifup/ifdown for ncf_if_up_async and friends, see
+ * dutil_linux.c */
+struct netcf_op *op_start(struct netcf_if *nif, bool up);
+int op_fd(struct netcf_op *op);
+struct netcf *op_ncf(struct netcf_op *op);
+int op_result(struct netcf_op *op);
+void op_free(struct netcf_op *op);
+
+/* Publish the state of all interfaces for ncf_shm_publish, see
+ * dutil_linux.c */
+int shm_publish(struct netcf *ncf, const char *path);
+
+/* Talking to netcfd, see remote.c. A handle that is connected to the
+ * daemon has no driver; the public API hands the calls it can serve to
+ * these functions instead */
+#ifdef WIN32
+# define NCF_REMOTE(ncf) false
+# define remote_unsupported(ncf) 0
+#else
+# define NCF_REMOTE(ncf) ((ncf)->remote >= 0)
+/* Report an error and return -1 if NCF uses netcfd, return 0 otherwise.
+ * For the calls that the daemon does not serve */
+int remote_unsupported(struct netcf *ncf);
+#endif
+/* Connect NCF to the daemon listening on PATH. If the daemon can't be
+ * reached, or serves another root, fail if REQUIRED and leave NCF local
+ * otherwise */
+int remote_open(struct netcf *ncf, const char *path, bool required);
+void remote_close(struct netcf *ncf);
+int remote_num_of_interfaces(struct netcf *ncf, unsigned int flags);
+int remote_list_interfaces(struct netcf *ncf, int maxnames, char **names,
+                           unsigned int flags);
+struct netcf_if *remote_lookup_by_name(struct netcf *ncf, const char *name);
+int remote_lookup_by_mac_string(struct netcf *ncf, const char *mac,
+                                int maxifaces, struct netcf_if **ifaces);
+const char *remote_mac_string(struct netcf_if *nif);
+/* The description, or the live state if STATE, of NIF */
+char *remote_xml(struct netcf_if *nif, bool state);
+int remote_if_status(struct netcf_if *nif, unsigned int *flags);
+struct netcf_if *remote_define(struct netcf *ncf, const char *xml,
+                               unsigned int flags);
+int remote_undefine(struct netcf_if *nif);
+int remote_if_up(struct netcf_if *nif);
+int remote_if_down(struct netcf_if *nif);
+int remote_change_begin(struct netcf *ncf, unsigned int flags);
+int remote_change_commit(struct netcf *ncf, unsigned int flags);
+int remote_change_rollback(struct netcf *ncf, unsigned int flags);
 
 /*
  * Useful for debugging, used by ncftransform (only needed for
@@ -220,4 +395,20 @@ int ncf_get_aug(struct netcf *, const char *ncf_xml, char **aug_xml);
 
 /* Transform the Augeas XML AUG_XML into interface XML NCF_XML */
 int ncf_put_aug(struct netcf *, const char *aug_xml, char **ncf_xml);
+
+/* Validate NCF_XML against the interface schema, with the compiled
+ * validator if NATIVE is nonzero, and with the RelaxNG interpreter
+ * otherwise. Returns 1 if NCF_XML is valid, 0 if it is not, and -1 on
+ * error. Used by the tests to compare the two validators */
+int ncf_validate_xml(struct netcf *, const char *ncf_xml, int native);
+
+/* Run the program ARGV without a shell and return its combined stdout
+ * and stderr in OUTPUT. Used to benchmark how quickly we can start
+ * programs */
+int ncf_run_program(struct netcf *, const char *const *argv, char **output);
+
+/* Return 1 if the OUTPUT of ifup or ifdown says that they failed for the
+ * interface NAME, and 0 otherwise. Used by the tests to check which
+ * interfaces a failing batch blames */
+int ncf_if_failed_in_output(const char *output, const char *name);
 #endif
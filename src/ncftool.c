@@ -476,6 +476,60 @@ static const struct command_def cmd_change_rollback_def = {
     .help = "rollback (revert) a set of network config changes",
 };
 
+static int cmd_stats(const struct command *cmd) {
+    struct netcf_stat stats[NETCF_STAT_LAST];
+    unsigned int flags = 0;
+    int nstats;
+
+    if (opt_present(cmd, "reset"))
+        flags |= NETCF_STATS_RESET;
+    nstats = ncf_get_stats(ncf, stats, NETCF_STAT_LAST, flags);
+    if (nstats < 0)
+        return CMD_RES_ERR;
+    if (nstats > NETCF_STAT_LAST)
+        nstats = NETCF_STAT_LAST;
+
+    printf("%-16s %10s %12s %10s %10s\n",
+           "", "count", "total ms", "avg us", "max us");
+    for (int i=0; i < nstats; i++) {
+        const struct netcf_stat *st = stats + i;
+        unsigned long long avg = st->count > 0 ? st->total_ns / st->count : 0;
+
+        printf("%-16s %10llu %12.3f %10.1f %10.1f\n", ncf_stat_name(i),
+               st->count, st->total_ns / 1e6, avg / 1e3, st->max_ns / 1e3);
+        if (!opt_present(cmd, "hist") || st->count == 0)
+            continue;
+        for (int j=0; j < NETCF_STAT_BUCKETS; j++) {
+            if (st->hist[j] == 0)
+                continue;
+            if (j == 0)
+                printf("    %12s < %-8llu %10llu\n", "", 2ULL, st->hist[j]);
+            else
+                printf("    %12llu - %-8llu %10llu\n",
+                       1ULL << j, 1ULL << (j + 1), st->hist[j]);
+        }
+    }
+    return CMD_RES_OK;
+}
+
+static const struct command_opt_def cmd_stats_opts[] = {
+    { .tag = CMD_OPT_BOOL, .name = "hist",
+      .help = "show how the times are distributed, in microseconds" },
+    { .tag = CMD_OPT_BOOL, .name = "reset",
+      .help = "start counting from zero again" },
+    CMD_OPT_DEF_LAST
+};
+
+static const struct command_def cmd_stats_def = {
+    .name = "stats",
+    .opts = cmd_stats_opts,
+    .handler = cmd_stats,
+    .synopsis = "show where netcf spent its time",
+    .help = "show how often, and for how long, netcf reloaded config files, "
+    "ran XSLT, validated XML, talked to the kernel or ran programs, "
+    "since it started or the last reset"
+};
+
 static int cmd_help(const struct command *cmd) {
     const char *name = param_value(cmd, "command");
     if (name == NULL) {
@@ -686,6 +740,7 @@ static const struct command_def *const commands[] = {
     &cmd_change_begin_def,
     &cmd_change_commit_def,
     &cmd_change_rollback_def,
+    &cmd_stats_def,
     &cmd_help_def,
     &cmd_quit_def,
     &cmd_def_last
@@ -35,6 +35,10 @@
 #include "internal.h"
 #include "netcf.h"
 #include "dutil.h"
+#ifndef WIN32
+#include "rngc.h"
+#include "remote_proto.h"
+#endif
 
 /* Human-readable error messages. This array is indexed by NETCF_ERRCODE_T */
 static const char *const errmsgs[] = {
@@ -51,13 +55,52 @@ static const char *const errmsgs[] = {
     "File operation failed",              /* EFILE */
     "ioctl operation failed",             /* EIOCTL */
     "NETLINK socket operation failed",    /* ENETLINK */
-    "Operation invalid in this state"     /* EINVALIDOP */
+    "Operation invalid in this state",    /* EINVALIDOP */
+    "external program timed out"          /* ETIMEOUT */
+};
+
+/* Names of the statistics, indexed by NETCF_STAT_T */
+static const char *const statnames[] = {
+    "api",                                /* API */
+    "aug-load",                           /* AUG_LOAD */
+    "aug-match",                          /* AUG_MATCH */
+    "xslt",                               /* XSLT */
+    "rng-validate",                       /* RNG_VALIDATE */
+    "netlink-refill",                     /* NETLINK_REFILL */
+    "exec"                                /* EXEC */
 };
 
 int ncf_init(struct netcf **ncf, const char *root) {
+    return ncf_init_flags(ncf, root, 0);
+}
+
+#ifndef WIN32
+/* Connect to netcfd if FLAGS ask for it. Handles are local unless the
+ * caller opts in, since many calls are not available through netcfd */
+static int init_remote(struct netcf *ncf, unsigned int flags) {
+    const char *path = getenv("NETCF_SOCKET");
+
+    if (!(flags & (NETCF_INIT_DAEMON|NETCF_INIT_TRY_DAEMON)))
+        return 0;
+    if (path == NULL)
+        path = REMOTE_SOCKET_PATH;
+    if (flags & NETCF_INIT_DAEMON)
+        return remote_open(ncf, path, true);
+    if (access(path, F_OK) < 0)
+        return 0;
+    return remote_open(ncf, path, false);
+}
+#endif
+
+int ncf_init_flags(struct netcf **ncf, const char *root, unsigned int flags) {
     *ncf = NULL;
     if (make_ref(*ncf) < 0)
         goto error;
+    (*ncf)->remote = -1;
+    if (api_init(*ncf) < 0) {
+        FREE(*ncf);
+        goto error;
+    }
     if (root == NULL) {
 #ifdef WIN32
         root = getenv("SYSTEMDRIVE");
@@ -79,8 +122,31 @@ int ncf_init(struct netcf **ncf, const char *root) {
     if ((*ncf)->data_dir == NULL)
         (*ncf)->data_dir = NETCF_DATADIR "/netcf";
     (*ncf)->debug = getenv("NETCF_DEBUG") != NULL;
-    (*ncf)->rng = rng_parse(*ncf, "interface.rng");
+    /* At most one of the flags */
+    ERR_THROW((flags & ~(NETCF_INIT_DAEMON|NETCF_INIT_LOCAL
+                         |NETCF_INIT_TRY_DAEMON)) != 0
+              || (flags & (flags - 1)) != 0,
+              *ncf, EOTHER, "unsupported flags value %u", flags);
+#ifdef WIN32
+    ERR_THROW(flags & NETCF_INIT_DAEMON, *ncf, EOTHER,
+              "netcfd is not available on this platform");
+#else
+    if (init_remote(*ncf, flags) < 0)
+        goto error;
+    if (NCF_REMOTE(*ncf))
+        return 0;
+#endif
+    (*ncf)->rng = rng_parse(*ncf, "interface.rng", &(*ncf)->rng_serial);
     ERR_BAIL(*ncf);
+#ifndef WIN32
+    /* Only use the compiled validator if it was generated from the same
+     * schema that we just loaded */
+    if ((*ncf)->rng_serial >= 0
+        && (*ncf)->rng_serial == rngc_interface.serial) {
+        (*ncf)->rngc = rngc_new(&rngc_interface);
+        ERR_NOMEM((*ncf)->rngc == NULL, *ncf);
+    }
+#endif
     return drv_init(*ncf);
 error:
     ncf_close(*ncf);
@@ -89,21 +155,77 @@ error:
 }
 
 int ncf_close(struct netcf *ncf) {
+    struct netcf *locked = NULL;
+
     if (ncf == NULL)
         return 0;
 
-    API_ENTRY(ncf);
+    /* Closing a handle that another thread is using is a bug in the
+     * caller; don't make it worse by waiting for the other thread */
+    if (api_enter_exclusive(ncf) < 0)
+        return -1;
+    locked = ncf;
 
     ERR_COND_BAIL(ncf->ref > 1, ncf, EINUSE);
 
-    drv_close(ncf);
+    if (NCF_REMOTE(ncf))
+        remote_close(ncf);
+    else
+        drv_close(ncf);
     xmlRelaxNGFree(ncf->rng);
+#ifndef WIN32
+    rngc_free(ncf->rngc);
+#endif
+    api_exit(&locked);
     unref(ncf, netcf);
     return 0;
  error:
+    api_exit(&locked);
     return -1;
 }
 
+int ncf_set_durability(struct netcf *ncf, unsigned int policy) {
+    API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
+    ERR_THROW(policy > NETCF_DURABILITY_FULL, ncf, EOTHER,
+              "unsupported durability policy %u", policy);
+    ncf->durability = policy;
+    return 0;
+ error:
+    return -1;
+}
+
+int ncf_set_exec_timeout(struct netcf *ncf, unsigned int msecs) {
+    API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
+    ncf->exec_timeout = msecs;
+    return 0;
+}
+
+int ncf_set_output_callback(struct netcf *ncf, ncf_output_callback callback,
+                            void *opaque) {
+    API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
+    ncf->output_cb = callback;
+    ncf->output_opaque = opaque;
+    return 0;
+}
+
+/* Not an API_ENTRY, whose span would end with a callback that never saw
+ * it begin */
+int ncf_set_trace_callback(struct netcf *ncf, ncf_trace_callback callback,
+                           void *opaque) {
+    struct netcf *locked = api_enter(ncf);
+
+    ncf->trace_cb = callback;
+    ncf->trace_opaque = opaque;
+    api_exit(&locked);
+    return 0;
+}
+
 /* Number of known interfaces and list of them.
  * For listing we identify the interfaces by UUID, since we don't want
  * to assume that each interface has a (device) name or a hwaddr.
@@ -111,16 +233,21 @@ int ncf_close(struct netcf *ncf) {
  * Maybe we should just list them as STRUCT NETCF_IF *
  */
 int ncf_num_of_interfaces(struct netcf *ncf, unsigned int flags) {
-    API_ENTRY(ncf);
+    API_ENTRY_READ(ncf);
+    if (NCF_REMOTE(ncf))
+        return remote_num_of_interfaces(ncf, flags);
     return drv_num_of_interfaces(ncf, flags);
 }
 
 int ncf_list_interfaces(struct netcf *ncf, int maxnames, char **names, unsigned int flags) {
     int result;
 
-    API_ENTRY(ncf);
+    API_ENTRY_READ(ncf);
     MEMZERO(names, maxnames);
-    result = drv_list_interfaces(ncf, maxnames, names, flags);
+    if (NCF_REMOTE(ncf))
+        result = remote_list_interfaces(ncf, maxnames, names, flags);
+    else
+        result = drv_list_interfaces(ncf, maxnames, names, flags);
     if (result < 0)
         for (int i=0; i < maxnames; i++)
             FREE(names[i]);
@@ -128,14 +255,18 @@ int ncf_list_interfaces(struct netcf *ncf, int maxnames, char **names, unsigned
 }
 
 struct netcf_if * ncf_lookup_by_name(struct netcf *ncf, const char *name) {
-    API_ENTRY(ncf);
+    API_ENTRY_READ(ncf);
+    if (NCF_REMOTE(ncf))
+        return remote_lookup_by_name(ncf, name);
     return drv_lookup_by_name(ncf, name);
 }
 
 int
 ncf_lookup_by_mac_string(struct netcf *ncf, const char *mac,
                          int maxifaces, struct netcf_if **ifaces) {
-    API_ENTRY(ncf);
+    API_ENTRY_READ(ncf);
+    if (NCF_REMOTE(ncf))
+        return remote_lookup_by_mac_string(ncf, mac, maxifaces, ifaces);
     return drv_lookup_by_mac_string(ncf, mac, maxifaces, ifaces);
 }
 
@@ -147,29 +278,82 @@ ncf_lookup_by_mac_string(struct netcf *ncf, const char *mac,
 struct netcf_if *
 ncf_define(struct netcf *ncf, const char *xml) {
     API_ENTRY(ncf);
-    return drv_define(ncf, xml);
+    if (NCF_REMOTE(ncf))
+        return remote_define(ncf, xml, 0);
+    return drv_define(ncf, xml, 0);
+}
+
+struct netcf_if *
+ncf_define_flags(struct netcf *ncf, const char *xml, unsigned int flags) {
+    API_ENTRY(ncf);
+    ERR_THROW((flags & ~(NETCF_DEFINE_VALIDATED | 0xff00)) != 0, ncf, EOTHER,
+              "unsupported flags value %d", flags);
+    if (NCF_REMOTE(ncf))
+        return remote_define(ncf, xml, flags);
+    return drv_define(ncf, xml, flags);
+ error:
+    return NULL;
+}
+
+int ncf_define_many(struct netcf *ncf, int ndocs, const char *const *xmls,
+                    unsigned int flags, struct netcf_if **ifaces,
+                    int *status) {
+    API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
+    ERR_THROW((flags & ~(NETCF_DEFINE_VALIDATED | 0xff00)) != 0, ncf, EOTHER,
+              "unsupported flags value %d", flags);
+    ERR_THROW(ndocs < 0, ncf, EOTHER, "invalid number of documents %d",
+              ndocs);
+    MEMZERO(ifaces, ndocs);
+    for (int i=0; i < ndocs; i++)
+        status[i] = NETCF_NOERROR;
+    return drv_define_many(ncf, ndocs, xmls, flags, ifaces, status);
+ error:
+    return -1;
 }
 
 const char *ncf_if_name(struct netcf_if *nif) {
-    API_ENTRY(nif->ncf);
+    API_ENTRY_READ(nif->ncf);
     return nif->name;
 }
 
 const char *ncf_if_mac_string(struct netcf_if *nif) {
-    API_ENTRY(nif->ncf);
+    API_ENTRY_READ(nif->ncf);
+    if (NCF_REMOTE(nif->ncf))
+        return remote_mac_string(nif);
     return drv_mac_string(nif);
 }
 
 /* Delete the definition */
 int ncf_if_undefine(struct netcf_if *nif) {
     API_ENTRY(nif->ncf);
+    if (NCF_REMOTE(nif->ncf))
+        return remote_undefine(nif);
     return drv_undefine(nif);
 }
 
+int ncf_undefine_many(struct netcf *ncf, int nifaces,
+                      struct netcf_if **ifaces) {
+    API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
+    ERR_THROW(nifaces < 0, ncf, EOTHER, "invalid number of interfaces %d",
+              nifaces);
+    for (int i=0; i < nifaces; i++)
+        ERR_THROW(ifaces[i] == NULL || ifaces[i]->ncf != ncf, ncf, EOTHER,
+                  "interface %d does not belong to this netcf instance", i);
+    return drv_undefine_many(ncf, nifaces, ifaces);
+ error:
+    return -1;
+}
+
 /* Bring the interface up */
 int ncf_if_up(struct netcf_if *nif) {
     /* I'm a bit concerned that this assumes nif (and nif->ncf) is non-NULL) */
     API_ENTRY(nif->ncf);
+    if (NCF_REMOTE(nif->ncf))
+        return remote_if_up(nif);
     return drv_if_up(nif);
 }
 
@@ -177,15 +361,227 @@ int ncf_if_up(struct netcf_if *nif) {
 int ncf_if_down(struct netcf_if *nif) {
     /* I'm a bit concerned that this assumes nif (and nif->ncf) is non-NULL) */
     API_ENTRY(nif->ncf);
+    if (NCF_REMOTE(nif->ncf))
+        return remote_if_down(nif);
     return drv_if_down(nif);
 }
 
+/* How many programs ncf_if_up_many and ncf_if_down_many run at once
+ * unless the caller says otherwise */
+#define NCF_DEFAULT_JOBS 8
+
+static struct netcf_op *if_async(struct netcf_if *nif, bool up) {
+#ifdef WIN32
+    report_error(nif->ncf, NETCF_EOTHER, "not implemented on this platform");
+    return NULL;
+#else
+    if (remote_unsupported(nif->ncf) < 0)
+        return NULL;
+    return op_start(nif, up);
+#endif
+}
+
+struct netcf_op *ncf_if_up_async(struct netcf_if *nif) {
+    API_ENTRY(nif->ncf);
+    return if_async(nif, true);
+}
+
+struct netcf_op *ncf_if_down_async(struct netcf_if *nif) {
+    API_ENTRY(nif->ncf);
+    return if_async(nif, false);
+}
+
+#ifndef WIN32
+int ncf_op_fd(struct netcf_op *op) {
+    return op_fd(op);
+}
+
+int ncf_op_result(struct netcf_op *op) {
+    API_ENTRY(op_ncf(op));
+    return op_result(op);
+}
+
+void ncf_op_free(struct netcf_op *op) {
+    op_free(op);
+}
+#else
+int ncf_op_fd(struct netcf_op *op ATTRIBUTE_UNUSED) {
+    return -1;
+}
+
+int ncf_op_result(struct netcf_op *op ATTRIBUTE_UNUSED) {
+    return -1;
+}
+
+void ncf_op_free(struct netcf_op *op ATTRIBUTE_UNUSED) {
+}
+#endif
+
+#ifndef WIN32
+int ncf_shm_publish(struct netcf *ncf, const char *path) {
+    API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
+    return shm_publish(ncf, path);
+}
+#else
+int ncf_shm_publish(struct netcf *ncf, const char *path ATTRIBUTE_UNUSED) {
+    API_ENTRY(ncf);
+    report_error(ncf, NETCF_EOTHER, "not implemented on this platform");
+    return -1;
+}
+
+struct netcf_shm *ncf_shm_open(const char *path ATTRIBUTE_UNUSED) {
+    errno = ENOSYS;
+    return NULL;
+}
+
+int ncf_shm_lookup(struct netcf_shm *shm ATTRIBUTE_UNUSED,
+                   const char *name ATTRIBUTE_UNUSED,
+                   struct netcf_shm_entry *entry ATTRIBUTE_UNUSED) {
+    return -1;
+}
+
+int ncf_shm_list(struct netcf_shm *shm ATTRIBUTE_UNUSED,
+                 int maxentries ATTRIBUTE_UNUSED,
+                 struct netcf_shm_entry *entries ATTRIBUTE_UNUSED,
+                 unsigned int *truncated ATTRIBUTE_UNUSED) {
+    return -1;
+}
+
+void ncf_shm_close(struct netcf_shm *shm ATTRIBUTE_UNUSED) {
+}
+#endif
+
+/* Check the arguments of ncf_if_up_many and ncf_if_down_many */
+static int if_many_check(struct netcf *ncf, int nifaces,
+                         struct netcf_if **ifaces, int *status) {
+    ERR_THROW(nifaces < 0, ncf, EOTHER, "invalid number of interfaces %d",
+              nifaces);
+    for (int i=0; i < nifaces; i++) {
+        ERR_THROW(ifaces[i] == NULL || ifaces[i]->ncf != ncf, ncf, EOTHER,
+                  "interface %d does not belong to this netcf instance", i);
+        status[i] = NETCF_NOERROR;
+    }
+    return 0;
+ error:
+    return -1;
+}
+
+int ncf_if_up_many(struct netcf *ncf, int nifaces, struct netcf_if **ifaces,
+                   unsigned int maxjobs, int *status) {
+    API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
+    if (if_many_check(ncf, nifaces, ifaces, status) < 0)
+        return -1;
+    if (maxjobs == 0)
+        maxjobs = NCF_DEFAULT_JOBS;
+    return drv_if_up_many(ncf, nifaces, ifaces, maxjobs, status);
+}
+
+int ncf_if_down_many(struct netcf *ncf, int nifaces,
+                     struct netcf_if **ifaces, unsigned int maxjobs,
+                     int *status) {
+    API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
+    if (if_many_check(ncf, nifaces, ifaces, status) < 0)
+        return -1;
+    if (maxjobs == 0)
+        maxjobs = NCF_DEFAULT_JOBS;
+    return drv_if_down_many(ncf, nifaces, ifaces, maxjobs, status);
+}
+
+/* Growable buffer that collects XML output for ncf_if_xml_*_buf */
+struct xml_buf {
+    char   *buf;
+    size_t  size;
+    size_t  len;
+};
+
+static int xml_buf_write(void *opaque, const char *data, int len) {
+    struct xml_buf *xb = opaque;
+
+    if (xb->len + len + 1 > xb->size) {
+        size_t size = xb->size > 0 ? xb->size : 1024;
+
+        while (size < xb->len + len + 1)
+            size *= 2;
+        if (REALLOC_N(xb->buf, size) < 0)
+            return -1;
+        xb->size = size;
+    }
+    memcpy(xb->buf + xb->len, data, len);
+    xb->len += len;
+    xb->buf[xb->len] = '\0';
+    return len;
+}
+
+/* Write the description (or, if STATE is true, the live state) of NIF to
+ * OUT and release OUT. ERRCODE is reported if writing to OUT fails */
+static int xml_desc_to_output(struct netcf_if *nif, int state,
+                              xmlOutputBufferPtr out,
+                              netcf_errcode_t errcode) {
+    struct netcf *ncf = nif->ncf;
+    int r;
+
+    ERR_NOMEM(out == NULL, ncf);
+
+    if (NCF_REMOTE(ncf)) {
+        char *xml = remote_xml(nif, state);
+        r = -1;
+        if (xml != NULL) {
+            r = xmlOutputBufferWriteString(out, xml) < 0 ? -1 : 0;
+            FREE(xml);
+        }
+    } else if (state)
+        r = drv_xml_state(nif, out);
+    else
+        r = drv_xml_desc(nif, out);
+    if (xmlOutputBufferClose(out) < 0 && r == 0) {
+        report_error(ncf, errcode, "failed to write XML output");
+        r = -1;
+    }
+    return r;
+ error:
+    return -1;
+}
+
+static int xml_desc_to(struct netcf_if *nif, int state,
+                       ncf_write_callback write_cb, void *opaque) {
+    xmlOutputBufferPtr out;
+
+    out = xmlOutputBufferCreateIO(write_cb, NULL, opaque, NULL);
+    return xml_desc_to_output(nif, state, out, NETCF_EOTHER);
+}
+
+static int xml_desc_buf(struct netcf_if *nif, int state,
+                        char **buf, size_t *size) {
+    struct xml_buf xb = { .buf = *buf, .size = *buf ? *size : 0, .len = 0 };
+    xmlOutputBufferPtr out;
+    int r;
+
+    out = xmlOutputBufferCreateIO(xml_buf_write, NULL, &xb, NULL);
+    r = xml_desc_to_output(nif, state, out, NETCF_ENOMEM);
+    if (r == 0 && xb.buf == NULL)
+        r = xml_buf_write(&xb, "", 0);
+    *buf = xb.buf;
+    *size = xb.size;
+    return r < 0 ? -1 : (int) xb.len;
+}
+
 /* Produce an XML description for the interface, in the same format that
  * NCF_DEFINE expects
  */
 char *ncf_if_xml_desc(struct netcf_if *nif) {
-    API_ENTRY(nif->ncf);
-    return drv_xml_desc(nif);
+    char *result = NULL;
+    size_t size = 0;
+
+    API_ENTRY_READ(nif->ncf);
+    if (xml_desc_buf(nif, 0, &result, &size) < 0)
+        FREE(result);
+    return result;
 }
 
 /* Produce an XML description of the current live state of the
@@ -194,15 +590,60 @@ char *ncf_if_xml_desc(struct netcf_if *nif) {
  * the current IP address of an interface that uses DHCP)
  */
 char *ncf_if_xml_state(struct netcf_if *nif) {
-    API_ENTRY(nif->ncf);
-    return drv_xml_state(nif);
+    char *result = NULL;
+    size_t size = 0;
+
+    API_ENTRY_READ(nif->ncf);
+    if (xml_desc_buf(nif, 1, &result, &size) < 0)
+        FREE(result);
+    return result;
+}
+
+int ncf_if_xml_desc_to(struct netcf_if *nif,
+                       ncf_write_callback write_cb, void *opaque) {
+    API_ENTRY_READ(nif->ncf);
+    ERR_THROW(write_cb == NULL, nif->ncf, EOTHER,
+              "NULL write callback in ncf_if_xml_desc_to");
+    return xml_desc_to(nif, 0, write_cb, opaque);
+ error:
+    return -1;
+}
+
+int ncf_if_xml_state_to(struct netcf_if *nif,
+                        ncf_write_callback write_cb, void *opaque) {
+    API_ENTRY_READ(nif->ncf);
+    ERR_THROW(write_cb == NULL, nif->ncf, EOTHER,
+              "NULL write callback in ncf_if_xml_state_to");
+    return xml_desc_to(nif, 1, write_cb, opaque);
+ error:
+    return -1;
+}
+
+int ncf_if_xml_desc_buf(struct netcf_if *nif, char **buf, size_t *size) {
+    API_ENTRY_READ(nif->ncf);
+    ERR_THROW(buf == NULL || size == NULL, nif->ncf, EOTHER,
+              "NULL buffer in ncf_if_xml_desc_buf");
+    return xml_desc_buf(nif, 0, buf, size);
+ error:
+    return -1;
+}
+
+int ncf_if_xml_state_buf(struct netcf_if *nif, char **buf, size_t *size) {
+    API_ENTRY_READ(nif->ncf);
+    ERR_THROW(buf == NULL || size == NULL, nif->ncf, EOTHER,
+              "NULL buffer in ncf_if_xml_state_buf");
+    return xml_desc_buf(nif, 1, buf, size);
+ error:
+    return -1;
 }
 
 /* Report various status info about the interface as bits in
  * "flags". Returns 0 on success, -1 on failure
  */
 int ncf_if_status(struct netcf_if *nif, unsigned int *flags) {
-    API_ENTRY(nif->ncf);
+    API_ENTRY_READ(nif->ncf);
+    if (NCF_REMOTE(nif->ncf))
+        return remote_if_status(nif, flags);
     return drv_if_status(nif, flags);
 }
 
@@ -210,6 +651,8 @@ int
 ncf_change_begin(struct netcf *ncf, unsigned int flags)
 {
     API_ENTRY(ncf);
+    if (NCF_REMOTE(ncf))
+        return remote_change_begin(ncf, flags);
     return drv_change_begin(ncf, flags);
 }
 
@@ -217,13 +660,34 @@ int
 ncf_change_rollback(struct netcf *ncf, unsigned int flags)
 {
     API_ENTRY(ncf);
-    return drv_change_rollback(ncf, flags);
+    if (NCF_REMOTE(ncf))
+        return remote_change_rollback(ncf, flags);
+    return drv_change_rollback(ncf, flags, 0, NULL) < 0 ? -1 : 0;
+}
+
+int
+ncf_change_rollback_list(struct netcf *ncf, unsigned int flags,
+                         int maxnames, char **names)
+{
+    int result;
+
+    API_ENTRY(ncf);
+    if (remote_unsupported(ncf) < 0)
+        return -1;
+    MEMZERO(names, maxnames);
+    result = drv_change_rollback(ncf, flags, maxnames, names);
+    if (result < 0)
+        for (int i=0; i < maxnames; i++)
+            FREE(names[i]);
+    return result;
 }
 
 int
 ncf_change_commit(struct netcf *ncf, unsigned int flags)
 {
     API_ENTRY(ncf);
+    if (NCF_REMOTE(ncf))
+        return remote_change_commit(ncf, flags);
     return drv_change_commit(ncf, flags);
 }
 
@@ -238,13 +702,50 @@ void ncf_if_free(struct netcf_if *nif) {
 }
 
 int ncf_error(struct netcf *ncf, const char **errmsg, const char **details) {
-    netcf_errcode_t errcode = ncf->errcode;
+    const char *errdetails;
+    netcf_errcode_t errcode = api_error(ncf, &errdetails);
 
-    if (ncf->errcode >= ARRAY_CARDINALITY(errmsgs))
+    if (errcode >= ARRAY_CARDINALITY(errmsgs))
         errcode = NETCF_EINTERNAL;
     if (errmsg)
         *errmsg = errmsgs[errcode];
     if (details)
-        *details = ncf->errdetails;
+        *details = errdetails;
     return errcode;
 }
+
+static unsigned long long stat_read(unsigned long long *value, bool reset) {
+    if (reset)
+        return __atomic_exchange_n(value, 0, __ATOMIC_RELAXED);
+    return __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+/* Statistics are only ever updated atomically, so there is no need to
+ * lock NCF for them; this also keeps the call from counting itself */
+int ncf_get_stats(struct netcf *ncf, struct netcf_stat *stats, int nstats,
+                  unsigned int flags) {
+    bool reset = flags & NETCF_STATS_RESET;
+
+    if (ncf == NULL || nstats < 0 || (nstats > 0 && stats == NULL))
+        return -1;
+
+    for (int i=0; i < NETCF_STAT_LAST; i++) {
+        struct netcf_stat *st = ncf->stats + i;
+        struct netcf_stat copy;
+
+        copy.count = stat_read(&st->count, reset);
+        copy.total_ns = stat_read(&st->total_ns, reset);
+        copy.max_ns = stat_read(&st->max_ns, reset);
+        for (int j=0; j < NETCF_STAT_BUCKETS; j++)
+            copy.hist[j] = stat_read(&st->hist[j], reset);
+        if (i < nstats)
+            stats[i] = copy;
+    }
+    return NETCF_STAT_LAST;
+}
+
+const char *ncf_stat_name(int stat) {
+    if (stat < 0 || stat >= (int) ARRAY_CARDINALITY(statnames))
+        return NULL;
+    return statnames[stat];
+}
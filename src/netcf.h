@@ -23,6 +23,8 @@
 #ifndef NETCF_H_
 #define NETCF_H_
 
+#include <stddef.h>
+
 /*
  * FIXME: NM needs a way to be notified of changes to the underlying
  * network files, either we provide a way to register callbacks for an
@@ -31,11 +33,28 @@
  *
  */
 
+/*
+ * Threads: a struct netcf can be shared between threads. Calls that
+ * change the configuration or settings of an instance run by themselves,
+ * so that no other call sees their changes half-done. Queries, i.e. the
+ * functions that list, look up, or describe interfaces, can overlap with
+ * each other, and most of the work of producing an XML description is
+ * done in parallel. Calls on different instances are independent.
+ * Callbacks must not call back into the instance that invoked them.
+ * ncf_error reports the error of the calling thread's last call, and
+ * ncf_if_free can be called from any thread. The exception is ncf_close,
+ * which must not race with other calls on the same instance: it fails
+ * with NETCF_EINUSE if another thread is using the instance at the time.
+ */
+
 /* The main object for netcf, for internal state tracking */
 struct netcf;
 
 /* An individual interface (connection) */
 struct netcf_if;
+struct netcf_op;
+/* A table of interface state published with ncf_shm_publish */
+struct netcf_shm;
 
 /* The error codes returned by ncf_error */
 typedef enum {
@@ -66,8 +85,10 @@ typedef enum {
 #define NETCF_EIOCTL NETCF_EIOCTL
     NETCF_ENETLINK,      /* something related to the netlink socket failed */
 #define NETCF_ENETLINK NETCF_ENETLINK
-    NETCF_EINVALIDOP     /* the requested operation is invalid in this state */
+    NETCF_EINVALIDOP,    /* the requested operation is invalid in this state */
 #define NETCF_EINVALIDOP NETCF_EINVALIDOP
+    NETCF_ETIMEOUT       /* an external program did not finish in time */
+#define NETCF_ETIMEOUT NETCF_ETIMEOUT
 } netcf_errcode_t;
 
 
@@ -81,6 +102,176 @@ typedef enum {
     NETCF_IFACE_ACTIVE = 2,       /* match up interfaces */
 } netcf_if_flag_t;
 
+/* The serial of the interface.rng schema this header goes with; see the
+ * v:serial attribute of its start element
+ */
+#define NETCF_SCHEMA_SERIAL 4
+
+/*
+ * flags accepted by ncf_define_flags
+ */
+typedef enum {
+    /* The caller has already validated the XML against interface.rng with
+     * serial NETCF_SCHEMA_SERIAL. Validation is skipped if the schema used
+     * by the library has the same serial. Bits 8-15 of the flag carry the
+     * serial and must not be used for anything else. */
+    NETCF_DEFINE_VALIDATED = 1 | (NETCF_SCHEMA_SERIAL << 8),
+} netcf_define_flag_t;
+
+/*
+ * flags accepted by ncf_init_flags
+ */
+typedef enum {
+    NETCF_INIT_DAEMON = 1,        /* Fail unless netcfd serves the calls */
+    NETCF_INIT_LOCAL = 2,         /* Never use netcfd; the default */
+    NETCF_INIT_TRY_DAEMON = 4,    /* Use netcfd if it serves ROOT, and work
+                                   * on the files directly otherwise */
+} netcf_init_flag_t;
+
+/*
+ * How carefully changes to the configuration files are written to disk;
+ * see ncf_set_durability
+ */
+typedef enum {
+    NETCF_DURABILITY_DEFAULT = 0, /* write each file on its own, without
+                                   * waiting for it to reach the disk */
+    NETCF_DURABILITY_NONE = 1,    /* write all files of a change together,
+                                   * without waiting for the disk */
+    NETCF_DURABILITY_DATA = 2,    /* like NONE, but make sure the contents
+                                   * of all files are on disk before any of
+                                   * them replaces an old file */
+    NETCF_DURABILITY_FULL = 3,    /* like DATA, and also wait until the new
+                                   * files are in their directories on disk */
+} netcf_durability_t;
+
+/*
+ * flags accepted by ncf_change_rollback and ncf_change_rollback_list
+ */
+typedef enum {
+    NETCF_CHANGE_RESTART = 1,     /* bring down the interfaces whose
+                                   * configuration the rollback changes
+                                   * first, and bring them up afterwards;
+                                   * only supported by the Red Hat driver */
+} netcf_change_flag_t;
+
+/*
+ * Callback used by ncf_if_xml_desc_to and ncf_if_xml_state_to to hand the
+ * XML document to the caller in pieces. It is called with the OPAQUE
+ * pointer passed to those functions and LEN bytes of output in BUF; BUF
+ * is not NUL terminated. The callback must return LEN on success, or -1
+ * to abort the output.
+ */
+typedef int (*ncf_write_callback)(void *opaque, const char *buf, int len);
+
+/*
+ * Callback used to pass the output of external programs like ifup to the
+ * caller as it is produced; see ncf_set_output_callback. It is called
+ * with the OPAQUE pointer passed to ncf_set_output_callback and one line
+ * of output, without the trailing newline. Returning -1 cancels the
+ * program, which is then killed together with anything it started, and
+ * the operation fails with NETCF_EEXEC.
+ */
+typedef int (*ncf_output_callback)(void *opaque, const char *line);
+
+/* Sizes of the fields of struct netcf_shm_entry */
+#define NETCF_SHM_NAME_MAX 16
+#define NETCF_SHM_MAC_MAX 32
+#define NETCF_SHM_ADDR_MAX 48
+#define NETCF_SHM_ADDRS 8
+/* The most interfaces a table holds; ncf_shm_list says when the
+ * publisher had to leave some out */
+#define NETCF_SHM_MAX_ENTRIES 256
+
+/* The live state of one interface, as published by ncf_shm_publish */
+struct netcf_shm_address {
+    int          family;                  /* AF_INET or AF_INET6 */
+    unsigned int prefix;
+    char         address[NETCF_SHM_ADDR_MAX];
+};
+
+struct netcf_shm_entry {
+    char         name[NETCF_SHM_NAME_MAX];
+    char         mac[NETCF_SHM_MAC_MAX];  /* Empty if it has none */
+    int          ifindex;
+    unsigned int flags;                   /* IFF_* from <net/if.h> */
+    unsigned int mtu;
+    unsigned int naddrs;                  /* At most NETCF_SHM_ADDRS;
+                                           * further addresses are
+                                           * left out */
+    struct netcf_shm_address addrs[NETCF_SHM_ADDRS];
+};
+
+/*
+ * The kinds of work ncf_get_stats keeps statistics about
+ */
+typedef enum {
+    NETCF_STAT_API,               /* calls of public functions, including
+                                   * the time spent waiting for the handle
+                                   * if another thread is using it */
+    NETCF_STAT_AUG_LOAD,          /* (re)loading config files into augeas */
+    NETCF_STAT_AUG_MATCH,         /* path expression lookups in augeas */
+    NETCF_STAT_XSLT,              /* stylesheet transformations */
+    NETCF_STAT_RNG_VALIDATE,      /* validations of interface XML */
+    NETCF_STAT_NETLINK_REFILL,    /* netlink dumps of links and addresses */
+    NETCF_STAT_EXEC,              /* running ifup, ifdown and the like */
+    NETCF_STAT_LAST
+} netcf_stat_t;
+
+/*
+ * flags accepted by ncf_get_stats
+ */
+typedef enum {
+    NETCF_STATS_RESET = 1,        /* zero the statistics after reading them */
+} netcf_stats_flag_t;
+
+#define NETCF_STAT_BUCKETS 32
+
+/* How often, and how long, netcf did one kind of work. Times are in
+ * nanoseconds, measured with the monotonic clock. HIST[I] counts the
+ * times that took at least 2^I and less than 2^(I+1) microseconds, except
+ * that HIST[0] also counts everything shorter than a microsecond, and the
+ * last bucket everything longer. */
+struct netcf_stat {
+    unsigned long long count;
+    unsigned long long total_ns;
+    unsigned long long max_ns;
+    unsigned long long hist[NETCF_STAT_BUCKETS];
+};
+
+/*
+ * Events passed to the callback set with ncf_set_trace_callback
+ */
+typedef enum {
+    NETCF_TRACE_BEGIN,            /* the work described by the span starts */
+    NETCF_TRACE_END               /* ... and is done */
+} netcf_trace_event_t;
+
+/* One piece of work, as reported to the trace callback. Spans of one
+ * thread nest; ID tells which NETCF_TRACE_END belongs to which
+ * NETCF_TRACE_BEGIN when the calls of several threads are traced. */
+struct netcf_span {
+    unsigned long long id;        /* unique within the process */
+    int                kind;      /* one of NETCF_STAT_T */
+    const char        *attr;      /* what the work is about, or NULL: the
+                                   * function name for NETCF_STAT_API, the
+                                   * path expression for AUG_MATCH, the
+                                   * stylesheet for XSLT, the cache for
+                                   * NETLINK_REFILL, and the command line
+                                   * for EXEC */
+    unsigned long long start_ns;  /* monotonic clock */
+    unsigned long long end_ns;    /* only set for NETCF_TRACE_END */
+};
+
+/*
+ * Callback used to trace what netcf does; see ncf_set_trace_callback. It
+ * is called with the OPAQUE pointer passed to ncf_set_trace_callback
+ * from the thread doing the work, and may be called for the same handle
+ * from several threads at once. SPAN, including ATTR, is only valid
+ * during the call. The callback must not use the netcf handle.
+ */
+typedef void (*ncf_trace_callback)(void *opaque, netcf_trace_event_t event,
+                                   const struct netcf_span *span);
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -97,16 +288,77 @@ extern "C" {
  */
 int ncf_init(struct netcf **netcf, const char *root);
 
+/*
+ * Like ncf_init, but FLAGS, a combination of NETCF_INIT_FLAG_T, say
+ * whether to use netcfd.
+ *
+ * netcfd keeps the configuration, schema and stylesheets loaded, and
+ * serves the netcf API over a Unix socket; by default, the socket is
+ * LOCALSTATEDIR/run/netcf/netcfd.sock, and the environment variable
+ * NETCF_SOCKET overrides that. The daemon is only used when asked for:
+ * ncf_init, and ncf_init_flags with 0 or NETCF_INIT_LOCAL, always work on
+ * the files directly. NETCF_INIT_DAEMON makes the daemon mandatory, and
+ * NETCF_INIT_TRY_DAEMON uses it if it is running and answers, and falls
+ * back to working on the files otherwise. A daemon that serves a
+ * different root than ROOT is never used.
+ *
+ * Through the daemon, only looking up, listing, describing, defining,
+ * undefining, starting and stopping single interfaces, and
+ * ncf_change_begin, ncf_change_commit and ncf_change_rollback are
+ * available; other calls fail with NETCF_EINVALIDOP.
+ *
+ * Returns the same values as ncf_init.
+ */
+int ncf_init_flags(struct netcf **netcf, const char *root,
+                   unsigned int flags);
+
 /* Close the connection to netcf and release any resources associated with
  * it. It is an error to call this function before all data structeres
  * retrieved using this netcf instance have been free'd; in particular, any
  * struct netcf_if retrieved with this netcf instance must be cleaned up
  * with NCF_IF_FREE before calling this function.
  *
+ * Fails with NETCF_EINUSE if another thread is inside a call on this
+ * netcf instance.
+ *
  * Returns 0 on success, and -1 on error.
  */
 int ncf_close(struct netcf *);
 
+/* Set how changes made through this netcf instance are written to disk.
+ * POLICY is one of NETCF_DURABILITY_T.
+ *
+ * With any policy but NETCF_DURABILITY_DEFAULT, all files touched by a
+ * change are first written next to the files they replace, and then
+ * renamed into place one after the other, starting with the files that
+ * others depend on. For NETCF_DURABILITY_DATA and NETCF_DURABILITY_FULL,
+ * the new files are flushed to disk together before the first rename.
+ *
+ * Returns 0 on success, and -1 on error.
+ */
+int ncf_set_durability(struct netcf *, unsigned int policy);
+
+/* Limit how long external programs run by this netcf instance, like ifup
+ * and ifdown, may take to MSECS milliseconds; 0, the default, means no
+ * limit. A program that takes longer is sent SIGTERM, followed by SIGKILL
+ * if it does not exit promptly, and the operation fails with
+ * NETCF_ETIMEOUT; asynchronous operations send SIGKILL right away. The
+ * signals go to the program's process group, so that helpers it started,
+ * like dhclient, go with it.
+ *
+ * Returns 0 on success, and -1 on error.
+ */
+int ncf_set_exec_timeout(struct netcf *, unsigned int msecs);
+
+/* Pass the output of external programs run by this netcf instance to
+ * CALLBACK line by line, as it is produced. A NULL CALLBACK turns this
+ * off. See ncf_output_callback for cancelling a program.
+ *
+ * Returns 0 on success, and -1 on error.
+ */
+int ncf_set_output_callback(struct netcf *, ncf_output_callback callback,
+                            void *opaque);
+
 /* Number of known interfaces and list of them. For listing, interfaces are
  * identified by their name. FLAGS is a bitmask of NETCF_IF_FLAG_T and
  * makes it possible to filter which interfaces are returned
@@ -151,6 +403,34 @@ ncf_lookup_by_mac_string(struct netcf *, const char *mac,
 struct netcf_if *
 ncf_define(struct netcf *, const char *xml);
 
+/* Same as ncf_define, but FLAGS is a bitmask of NETCF_DEFINE_FLAG_T.
+ *
+ * Independent of FLAGS, a document that passed validation in an earlier
+ * ncf_define through the same struct netcf is not validated again.
+ */
+struct netcf_if *
+ncf_define_flags(struct netcf *, const char *xml, unsigned int flags);
+
+/* Define the NDOCS interfaces in XMLS in one go. This is equivalent to
+ * calling ncf_define_flags for each of them, but much faster for large
+ * NDOCS, since all changes are written to disk together.
+ *
+ * IFACES and STATUS must have room for NDOCS entries. For each document,
+ * STATUS receives NETCF_NOERROR if it was defined, or the error code
+ * that made it fail, and IFACES the interface, which must later be freed
+ * with a call to NCF_IF_FREE, or NULL. A document that fails does not
+ * keep the others from being defined; ncf_error reports details for the
+ * first such failure.
+ *
+ * Writing the changes to disk is all-or-nothing: if it fails, none of
+ * the documents are defined, and all STATUS entries are set to the error.
+ *
+ * Returns the number of documents that were defined, or -1 on error.
+ */
+int
+ncf_define_many(struct netcf *, int ndocs, const char *const *xmls,
+                unsigned int flags, struct netcf_if **ifaces, int *status);
+
 /* Return the name of the interface. The string can be used up until the
  * next call to a function that takes this NETCF_IF as argument
  */
@@ -166,9 +446,68 @@ int ncf_if_up(struct netcf_if *);
 /* Take it down */
 int ncf_if_down(struct netcf_if *);
 
+/* Bring up the NIFACES interfaces in IFACES, which must all belong to
+ * this struct netcf. Slaves are brought up before their bond or bridge,
+ * and physical devices before their VLANs; interfaces that do not depend
+ * on each other are brought up concurrently, running at most MAXJOBS
+ * programs like ifup at once. A MAXJOBS of 0 picks a default.
+ *
+ * STATUS must have room for NIFACES entries. For each interface, it
+ * receives NETCF_NOERROR if the interface came up, or the error code that
+ * made it fail. An interface is not brought up if something it depends on
+ * failed. ncf_error reports details for the first failure.
+ *
+ * Returns the number of interfaces that came up, or -1 on error.
+ */
+int ncf_if_up_many(struct netcf *, int nifaces, struct netcf_if **ifaces,
+                   unsigned int maxjobs, int *status);
+
+/* Take the NIFACES interfaces in IFACES down, like ncf_if_up_many, but
+ * in the opposite order.
+ *
+ * Returns the number of interfaces that went down, or -1 on error.
+ */
+int ncf_if_down_many(struct netcf *, int nifaces, struct netcf_if **ifaces,
+                     unsigned int maxjobs, int *status);
+
+/* Start bringing the interface up or down without waiting for it to
+ * finish. The returned operation has to be freed with NCF_OP_FREE; NULL
+ * is returned on error.
+ *
+ * The operation makes progress only when NCF_OP_RESULT is called. The
+ * caller should call it whenever the file descriptor from NCF_OP_FD
+ * becomes readable, which makes it possible to drive many operations
+ * from one event loop.
+ */
+struct netcf_op *ncf_if_up_async(struct netcf_if *);
+struct netcf_op *ncf_if_down_async(struct netcf_if *);
+
+/* A file descriptor that becomes readable when OP can make progress. It
+ * stays the same for the lifetime of OP and must not be closed by the
+ * caller */
+int ncf_op_fd(struct netcf_op *op);
+
+/* Do as much of OP as possible without blocking. Returns 1 if OP is still
+ * in progress, 0 if it finished successfully, and -1 if it failed; use
+ * ncf_error for details */
+int ncf_op_result(struct netcf_op *op);
+
+/* Free OP. If it is still in progress, the program it runs is killed */
+void ncf_op_free(struct netcf_op *op);
+
 /* Delete the definition */
 int ncf_if_undefine(struct netcf_if *);
 
+/* Delete the definitions of the NIFACES interfaces in IFACES, which must
+ * all belong to this struct netcf. All changes are written to disk
+ * together, and the undefine is all-or-nothing: if it fails, none of the
+ * interfaces are undefined. The interfaces still need to be freed with
+ * NCF_IF_FREE afterwards.
+ *
+ * Returns 0 on success, and -1 on error.
+ */
+int ncf_undefine_many(struct netcf *, int nifaces, struct netcf_if **ifaces);
+
 /* Produce an XML description for the static (stored) interface
  * config, in the same format that NCF_DEFINE expects
  */
@@ -181,6 +520,30 @@ char *ncf_if_xml_desc(struct netcf_if *);
  */
 char *ncf_if_xml_state(struct netcf_if *);
 
+/* Same as ncf_if_xml_desc and ncf_if_xml_state, but rather than returning
+ * a newly allocated string, pass the XML document to WRITE_CB as it is
+ * produced.
+ *
+ * Returns 0 on success, -1 on failure, including when WRITE_CB failed
+ */
+int ncf_if_xml_desc_to(struct netcf_if *,
+                       ncf_write_callback write_cb, void *opaque);
+int ncf_if_xml_state_to(struct netcf_if *,
+                        ncf_write_callback write_cb, void *opaque);
+
+/* Same as ncf_if_xml_desc and ncf_if_xml_state, but store the XML
+ * document as a NUL terminated string in the caller's buffer *BUF, which
+ * has room for *SIZE bytes. If the buffer is too small, or *BUF is NULL,
+ * it is grown with realloc and *BUF and *SIZE are updated accordingly;
+ * the caller must free *BUF eventually. This makes it possible to reuse
+ * the same buffer for many calls.
+ *
+ * Returns the length of the document (not counting the terminating NUL)
+ * on success, and -1 on failure
+ */
+int ncf_if_xml_desc_buf(struct netcf_if *, char **buf, size_t *size);
+int ncf_if_xml_state_buf(struct netcf_if *, char **buf, size_t *size);
+
 /* Report various status info about the interface as bits in
  * "flags". The meaning of the bits is in the enum type netcf_if_flag_t.
  * Returns 0 on success, -1 on failure
@@ -195,11 +558,30 @@ int ncf_if_status(struct netcf_if *nif, unsigned int *flags);
 int ncf_change_begin(struct netcf *ncf, unsigned int flags);
 
 /* Revert to the previously snapshotted (with ncf_change_begin)
- * network configuration, effectively undoing the changes.
+ * network configuration, effectively undoing the changes. FLAGS is a
+ * bitmask of NETCF_CHANGE_FLAG_T; with NETCF_CHANGE_RESTART, only the
+ * interfaces whose configuration is changed by the rollback are
+ * restarted. The files are put back even if bringing an interface down
+ * or up fails; every interface is still tried, and the first error is
+ * reported. Only the Red Hat driver supports NETCF_CHANGE_RESTART, the
+ * others fail with NETCF_EOTHER when it is passed.
  * Returns 0 on success, -1 on failure
  */
 int ncf_change_rollback(struct netcf *ncf, unsigned int flags);
 
+/* Same as ncf_change_rollback, but also report the toplevel interfaces
+ * whose configuration files differed from the snapshot, before or after
+ * the rollback. These are the interfaces that NETCF_CHANGE_RESTART
+ * restarts. Up to MAXNAMES of their names are stored in NAMES; the caller
+ * must free them. Drivers other than the Red Hat one do not track these
+ * interfaces and always report none.
+ *
+ * Returns the number of such interfaces, which can be larger than
+ * MAXNAMES, or -1 on failure
+ */
+int ncf_change_rollback_list(struct netcf *ncf, unsigned int flags,
+                             int maxnames, char **names);
+
 /* Commit the changes made to network configuration since
  * ncf_change_begin was called (usually by simply deleting the
  * snapshot that was saved, as well as bringing down any interfaces
@@ -223,11 +605,89 @@ void ncf_if_free(struct netcf_if *);
  * The pointer passed in to store either of these can be NULL with no ill
  * effects (useful if you just want the code)
  *
- * Both the ERRMSG pointer and the DETAILS pointer are only valid until the
- * next call to another function in this API.
+ * The error is that of the last call the calling thread made with this
+ * netcf instance; calls made by other threads do not change it. Both the
+ * ERRMSG pointer and the DETAILS pointer are only valid until the calling
+ * thread's next call to another function in this API.
  */
 int ncf_error(struct netcf *, const char **errmsg, const char **details);
 
+/* Copy the statistics of the work done for NCF into STATS, indexed by
+ * NETCF_STAT_T, and at most NSTATS of them. If FLAGS contains
+ * NETCF_STATS_RESET, start counting from zero again. The statistics of a
+ * handle that uses netcfd only cover the time spent in NETCF_STAT_API.
+ *
+ * Returns NETCF_STAT_LAST, which can be more than NSTATS, and -1 on error.
+ */
+int ncf_get_stats(struct netcf *ncf, struct netcf_stat *stats, int nstats,
+                  unsigned int flags);
+
+/* Return a short name for STAT, one of NETCF_STAT_T, or NULL if there is
+ * no such statistic
+ */
+const char *ncf_stat_name(int stat);
+
+/* Call CALLBACK when NCF begins and ends each call of a public function
+ * and each piece of work that ncf_get_stats keeps statistics about. Pass
+ * NULL to stop tracing. Set the callback before sharing NCF with other
+ * threads, since work that runs outside the handle's lock may still see
+ * the previous one. A handle that uses netcfd only traces the calls of
+ * public functions.
+ *
+ * Returns 0 on success, and -1 on error.
+ */
+int ncf_set_trace_callback(struct netcf *ncf, ncf_trace_callback callback,
+                           void *opaque);
+
+/*
+ * Shared interface state
+ *
+ * A single process, usually netcfd, can publish the live state of all
+ * network interfaces of the host into a table in a memory-mapped file,
+ * so that any number of readers can look it up without talking to the
+ * kernel. Each entry of the table is protected by a sequence lock: a
+ * reader copies the entry and retries if it was changed in the meantime,
+ * and never blocks the publisher.
+ */
+
+/* Update the table in the file PATH with the current state of all
+ * interfaces, creating it if needed. If PATH is NULL, use the default
+ * LOCALSTATEDIR/run/netcf/state. Call again whenever the state may have
+ * changed; a handle can only publish to one file.
+ *
+ * Returns 0 on success, and -1 on error.
+ */
+int ncf_shm_publish(struct netcf *ncf, const char *path);
+
+/* Map the table in PATH, or the default file if PATH is NULL, for
+ * reading. Does not need a struct netcf.
+ *
+ * Returns NULL with errno set on failure.
+ */
+struct netcf_shm *ncf_shm_open(const char *path);
+
+/* Copy the state of the interface NAME into ENTRY. Makes no system
+ * calls, and can be used from several threads at once.
+ *
+ * Returns 0 if the interface was found, and -1 if not.
+ */
+int ncf_shm_lookup(struct netcf_shm *shm, const char *name,
+                   struct netcf_shm_entry *entry);
+
+/* Copy the state of up to MAXENTRIES interfaces into ENTRIES. The table
+ * holds at most NETCF_SHM_MAX_ENTRIES interfaces; if TRUNCATED is not
+ * NULL, it is set to the number of interfaces the publisher had to leave
+ * out of it, which is 0 unless the system has more than that.
+ *
+ * Returns the number of interfaces in the table, which can be more than
+ * MAXENTRIES, and -1 if the table stays locked because its publisher died
+ * while updating it; publishing to it again fixes that.
+ */
+int ncf_shm_list(struct netcf_shm *shm, int maxentries,
+                 struct netcf_shm_entry *entries, unsigned int *truncated);
+
+void ncf_shm_close(struct netcf_shm *shm);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,581 @@
+/*
+ * netcfd.c: serve the netcf API over a Unix socket
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+/*
+ * netcfd opens one netcf handle when it starts and answers requests from
+ * clients with it, so that the configuration files, the schema and the
+ * stylesheets are only loaded once, and augeas only rereads files that
+ * changed. libnetcf talks to it transparently, see remote.c.
+ *
+ * Anybody who can connect to the socket can query the configuration;
+ * requests that change it are only accepted from root and from the user
+ * running the daemon. Each client is served by a thread of its own; to
+ * keep anybody from making us start threads without end, connections
+ * beyond MAX_CLIENTS (or --max-clients) are closed right away.
+ *
+ * With --publish, netcfd also keeps the table of interface state that
+ * ncf_shm_open reads up to date: it republishes whenever netlink reports
+ * a change to a link or an address, and every PUBLISH_INTERVAL in case
+ * it missed one.
+ */
+
+#include <config.h>
+#include "netcf.h"
+#include "internal.h"
+#include "safe-alloc.h"
+#include "remote_proto.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+static const char *progname;
+static const char *root = NULL;
+static const char *socket_path = REMOTE_SOCKET_PATH;
+static struct netcf *ncf = NULL;
+static bool publishing = false;
+static const char *publish_path = NULL;
+static volatile sig_atomic_t quit = 0;
+
+/* In msecs */
+#define PUBLISH_INTERVAL 5000
+
+/* How many clients we serve at once, unless --max-clients says otherwise */
+#define MAX_CLIENTS 64
+
+static unsigned int max_clients = MAX_CLIENTS;
+static unsigned int nclients = 0;
+
+struct client {
+    int   fd;
+    uid_t uid;
+};
+
+/* What each procedure expects */
+static const struct proc_info {
+    unsigned int nstrs;                   /* Number of strings */
+    bool         mutates;                 /* Changes the configuration */
+    bool         iface;                   /* The string names an interface
+                                           * that must exist */
+} procs[REMOTE_PROC_LAST] = {
+    [REMOTE_PROC_HELLO]             = { 0, false, false },
+    [REMOTE_PROC_NUM_OF_INTERFACES] = { 0, false, false },
+    [REMOTE_PROC_LIST_INTERFACES]   = { 0, false, false },
+    [REMOTE_PROC_LOOKUP_BY_NAME]    = { 1, false, false },
+    [REMOTE_PROC_LOOKUP_BY_MAC]     = { 1, false, false },
+    [REMOTE_PROC_MAC_STRING]        = { 1, false, true },
+    [REMOTE_PROC_XML_DESC]          = { 1, false, true },
+    [REMOTE_PROC_XML_STATE]         = { 1, false, true },
+    [REMOTE_PROC_IF_STATUS]         = { 1, false, true },
+    [REMOTE_PROC_DEFINE]            = { 1, true,  false },
+    [REMOTE_PROC_UNDEFINE]          = { 1, true,  true },
+    [REMOTE_PROC_IF_UP]             = { 1, true,  true },
+    [REMOTE_PROC_IF_DOWN]           = { 1, true,  true },
+    [REMOTE_PROC_CHANGE_BEGIN]      = { 0, true,  false },
+    [REMOTE_PROC_CHANGE_COMMIT]     = { 0, true,  false },
+    [REMOTE_PROC_CHANGE_ROLLBACK]   = { 0, true,  false },
+};
+
+/* Turn REPLY into an error reply */
+static void reply_error(struct remote_msg *reply, netcf_errcode_t errcode,
+                        const char *details) {
+    remote_msg_init(reply, reply->hdr.proc, -1);
+    reply->hdr.errcode = errcode;
+    if (details != NULL)
+        remote_msg_add(reply, details);
+}
+
+/* Turn REPLY into a reply with the error of the last call on NCF */
+static void reply_ncf_error(struct remote_msg *reply) {
+    const char *details;
+    int errcode = ncf_error(ncf, NULL, &details);
+
+    if (errcode == NETCF_NOERROR)
+        errcode = NETCF_EINTERNAL;
+    reply_error(reply, errcode, details);
+}
+
+static int reply_add(struct remote_msg *reply, const char *str) {
+    if (remote_msg_add(reply, str) < 0) {
+        if (errno == ENOMEM)
+            reply_error(reply, NETCF_ENOMEM, NULL);
+        else
+            reply_error(reply, NETCF_EOTHER, "reply too large for netcfd");
+        return -1;
+    }
+    return 0;
+}
+
+/* Answer the request REQ from CL in REPLY */
+static void dispatch(struct client *cl, struct remote_msg *req,
+                     struct remote_msg *reply) {
+    uint32_t proc = req->hdr.proc;
+    unsigned int flags = req->hdr.arg;
+    struct netcf_if *nif = NULL;
+    struct netcf_if **ifaces = NULL;
+    char **names = NULL;
+    char *xml = NULL;
+    const char *mac;
+    int n = 0, r = 0;
+
+    remote_msg_init(reply, proc, 0);
+    if (proc == 0 || proc >= REMOTE_PROC_LAST
+        || req->hdr.nstrs != procs[proc].nstrs) {
+        reply_error(reply, NETCF_EINTERNAL, "malformed request");
+        return;
+    }
+    if (procs[proc].mutates && cl->uid != 0 && cl->uid != getuid()) {
+        reply_error(reply, NETCF_EOTHER, "permission denied");
+        return;
+    }
+    if (procs[proc].iface) {
+        nif = ncf_lookup_by_name(ncf, req->strs[0]);
+        if (nif == NULL) {
+            if (ncf_error(ncf, NULL, NULL) != NETCF_NOERROR)
+                goto failed;
+            reply_error(reply, NETCF_ENOENT, "no such interface");
+            return;
+        }
+    }
+
+    switch(proc) {
+    case REMOTE_PROC_HELLO:
+        reply_add(reply, ncf->root);
+        break;
+    case REMOTE_PROC_NUM_OF_INTERFACES:
+        r = ncf_num_of_interfaces(ncf, flags);
+        if (r < 0)
+            goto failed;
+        reply->hdr.arg = r;
+        break;
+    case REMOTE_PROC_LIST_INTERFACES:
+        n = ncf_num_of_interfaces(ncf, flags);
+        if (n < 0)
+            goto failed;
+        if (ALLOC_N(names, n) < 0) {
+            reply_error(reply, NETCF_ENOMEM, NULL);
+            break;
+        }
+        r = ncf_list_interfaces(ncf, n, names, flags);
+        if (r < 0)
+            goto failed;
+        if (r < n)
+            n = r;
+        reply->hdr.arg = n;
+        for (int i=0; i < n; i++) {
+            if (reply_add(reply, names[i]) < 0)
+                break;
+        }
+        break;
+    case REMOTE_PROC_LOOKUP_BY_NAME:
+        nif = ncf_lookup_by_name(ncf, req->strs[0]);
+        if (nif != NULL)
+            reply_add(reply, ncf_if_name(nif));
+        else if (ncf_error(ncf, NULL, NULL) != NETCF_NOERROR)
+            goto failed;
+        break;
+    case REMOTE_PROC_LOOKUP_BY_MAC:
+        n = ncf_lookup_by_mac_string(ncf, req->strs[0], 0, NULL);
+        if (n < 0)
+            goto failed;
+        if (ALLOC_N(ifaces, n) < 0) {
+            reply_error(reply, NETCF_ENOMEM, NULL);
+            break;
+        }
+        r = ncf_lookup_by_mac_string(ncf, req->strs[0], n, ifaces);
+        if (r < 0)
+            goto failed;
+        if (r < n)
+            n = r;
+        reply->hdr.arg = n;
+        for (int i=0; i < n; i++) {
+            if (reply_add(reply, ncf_if_name(ifaces[i])) < 0)
+                break;
+        }
+        break;
+    case REMOTE_PROC_MAC_STRING:
+        mac = ncf_if_mac_string(nif);
+        if (mac != NULL)
+            reply_add(reply, mac);
+        else if (ncf_error(ncf, NULL, NULL) != NETCF_NOERROR)
+            goto failed;
+        break;
+    case REMOTE_PROC_XML_DESC:
+    case REMOTE_PROC_XML_STATE:
+        if (proc == REMOTE_PROC_XML_DESC)
+            xml = ncf_if_xml_desc(nif);
+        else
+            xml = ncf_if_xml_state(nif);
+        if (xml == NULL)
+            goto failed;
+        reply_add(reply, xml);
+        break;
+    case REMOTE_PROC_IF_STATUS:
+        if (ncf_if_status(nif, &flags) < 0)
+            goto failed;
+        reply->hdr.arg = flags;
+        break;
+    case REMOTE_PROC_DEFINE:
+        nif = ncf_define_flags(ncf, req->strs[0], flags);
+        if (nif == NULL)
+            goto failed;
+        reply_add(reply, ncf_if_name(nif));
+        break;
+    case REMOTE_PROC_UNDEFINE:
+        if (ncf_if_undefine(nif) < 0)
+            goto failed;
+        break;
+    case REMOTE_PROC_IF_UP:
+        if (ncf_if_up(nif) < 0)
+            goto failed;
+        break;
+    case REMOTE_PROC_IF_DOWN:
+        if (ncf_if_down(nif) < 0)
+            goto failed;
+        break;
+    case REMOTE_PROC_CHANGE_BEGIN:
+        if (ncf_change_begin(ncf, flags) < 0)
+            goto failed;
+        break;
+    case REMOTE_PROC_CHANGE_COMMIT:
+        if (ncf_change_commit(ncf, flags) < 0)
+            goto failed;
+        break;
+    case REMOTE_PROC_CHANGE_ROLLBACK:
+        if (ncf_change_rollback(ncf, flags) < 0)
+            goto failed;
+        break;
+    }
+    goto done;
+
+ failed:
+    reply_ncf_error(reply);
+ done:
+    if (names != NULL) {
+        for (int i=0; i < n; i++)
+            free(names[i]);
+        free(names);
+    }
+    if (ifaces != NULL) {
+        for (int i=0; i < n; i++)
+            ncf_if_free(ifaces[i]);
+        free(ifaces);
+    }
+    free(xml);
+    ncf_if_free(nif);
+}
+
+static void *serve_client(void *opaque) {
+    struct client *cl = opaque;
+    struct remote_msg req = { .buf = NULL };
+    struct remote_msg reply = { .buf = NULL };
+
+    while (remote_recv(cl->fd, &req) == 0) {
+        dispatch(cl, &req, &reply);
+        if (remote_send(cl->fd, &reply) < 0)
+            break;
+    }
+    remote_msg_clear(&req);
+    remote_msg_clear(&reply);
+    close(cl->fd);
+    free(cl);
+    __atomic_sub_fetch(&nclients, 1, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+/* Serve the client connected on FD, in its own thread if we can */
+static void start_client(int fd) {
+    struct client *cl = NULL;
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    if (__atomic_load_n(&nclients, __ATOMIC_RELAXED) >= max_clients) {
+        fprintf(stderr, "%s: already serving %u clients, "
+                "refusing connection\n", progname, max_clients);
+        close(fd);
+        return;
+    }
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+        fprintf(stderr, "%s: can not identify client: %s\n", progname,
+                strerror(errno));
+        close(fd);
+        return;
+    }
+    if (ALLOC(cl) < 0) {
+        close(fd);
+        return;
+    }
+    cl->fd = fd;
+    cl->uid = cred.uid;
+    __atomic_add_fetch(&nclients, 1, __ATOMIC_RELAXED);
+
+#ifdef HAVE_LIBPTHREAD
+    pthread_t thread;
+    pthread_attr_t attr;
+    sigset_t all, old;
+    int r;
+
+    /* Leave SIGTERM and SIGINT to the main thread, so that they interrupt
+     * poll() */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    r = pthread_create(&thread, &attr, serve_client, cl);
+    pthread_attr_destroy(&attr);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (r == 0)
+        return;
+#endif
+    serve_client(cl);
+}
+
+static int listen_on(const char *path) {
+    struct sockaddr_un addr;
+    char *dir = NULL, *slash;
+    int fd = -1;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path %s is too long\n", progname, path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    dir = strdup(path);
+    if (dir != NULL && (slash = strrchr(dir, '/')) != NULL && slash != dir) {
+        *slash = '\0';
+        mkdir(dir, 0755);
+    }
+    free(dir);
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        goto error;
+    /* Nobody can be listening on a socket that we can't connect to */
+    unlink(path);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+        goto error;
+    if (chmod(path, 0666) < 0 || listen(fd, 16) < 0)
+        goto error;
+    return fd;
+ error:
+    fprintf(stderr, "%s: can not listen on %s: %s\n", progname, path,
+            strerror(errno));
+    if (fd >= 0)
+        close(fd);
+    return -1;
+}
+
+/* A socket that becomes readable when links or addresses change, or -1
+ * if we can't get one */
+static int watch_links(void) {
+    struct sockaddr_nl addr = {
+        .nl_family = AF_NETLINK,
+        .nl_groups = RTMGRP_LINK|RTMGRP_IPV4_IFADDR|RTMGRP_IPV6_IFADDR
+    };
+    int fd;
+
+    fd = socket(AF_NETLINK, SOCK_RAW|SOCK_NONBLOCK|SOCK_CLOEXEC,
+                NETLINK_ROUTE);
+    if (fd >= 0 && bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0)
+        fprintf(stderr, "%s: can not watch for link changes: %s\n",
+                progname, strerror(errno));
+    return fd;
+}
+
+static void publish(int nlfd) {
+    char buf[4096];
+
+    /* We reread everything anyway, so the notifications themselves don't
+     * matter */
+    if (nlfd >= 0)
+        while (read(nlfd, buf, sizeof(buf)) > 0)
+            ;
+
+    if (ncf_shm_publish(ncf, publish_path) < 0) {
+        const char *errmsg, *details;
+        ncf_error(ncf, &errmsg, &details);
+        fprintf(stderr, "%s: publishing interface state failed: %s\n",
+                progname, details != NULL ? details : errmsg);
+    }
+}
+
+static void handle_signal(int sig ATTRIBUTE_UNUSED) {
+    quit = 1;
+}
+
+__attribute__((noreturn))
+static void usage(void) {
+    fprintf(stderr, "Usage: %s [OPTIONS]\n", progname);
+    fprintf(stderr, "Serve the netcf API over a Unix socket\n");
+    fprintf(stderr, "\nOptions:\n\n");
+    fprintf(stderr,
+            "  -r, --root ROOT    use ROOT as the root of the filesystem\n\n");
+    fprintf(stderr,
+            "  -s, --socket PATH  listen on PATH instead of\n"
+            "                     %s\n\n", REMOTE_SOCKET_PATH);
+    fprintf(stderr,
+            "  -p, --publish[=PATH]\n"
+            "                     publish the state of all interfaces to\n"
+            "                     PATH for ncf_shm_open\n\n");
+    fprintf(stderr,
+            "  -c, --max-clients N\n"
+            "                     serve at most N clients at once (default "
+            "%d)\n\n", MAX_CLIENTS);
+    fprintf(stderr,
+            "  -d, --debug        Show debugging output\n\n");
+
+    exit(EXIT_FAILURE);
+}
+
+static void parse_opts(int argc, char **argv) {
+    int opt;
+    struct option options[] = {
+        { "help",      0, 0, 'h' },
+        { "root",      1, 0, 'r' },
+        { "socket",    1, 0, 's' },
+        { "publish",   2, 0, 'p' },
+        { "max-clients", 1, 0, 'c' },
+        { "debug",     0, 0, 'd' },
+        { 0, 0, 0, 0}
+    };
+    int idx;
+
+    while ((opt = getopt_long(argc, argv, "c:dhp::r:s:", options, &idx)) != -1) {
+        char *end;
+
+        switch(opt) {
+        case 'c':
+            max_clients = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || max_clients == 0)
+                usage();
+            break;
+        case 'd':
+            setenv("NETCF_DEBUG", "1", 1);
+            break;
+        case 'r':
+            root = optarg;
+            break;
+        case 's':
+            socket_path = optarg;
+            break;
+        case 'p':
+            publishing = true;
+            publish_path = optarg;
+            break;
+        case 'h':
+        default:
+            usage();
+            break;
+        }
+    }
+    if (optind < argc)
+        usage();
+}
+
+int main(int argc, char **argv) {
+    struct sigaction sa;
+    struct pollfd fds[2];
+    int fd, nlfd = -1;
+
+    progname = argv[0];
+    parse_opts(argc, argv);
+
+    if (ncf_init_flags(&ncf, root, NETCF_INIT_LOCAL) < 0) {
+        fprintf(stderr, "%s: failed to initialize netcf\n", progname);
+        exit(EXIT_FAILURE);
+    }
+
+    fd = listen_on(socket_path);
+    if (fd < 0)
+        exit(EXIT_FAILURE);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (publishing) {
+        nlfd = watch_links();
+        publish(nlfd);
+    }
+
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = nlfd;
+    fds[1].events = POLLIN;
+    while (!quit) {
+        int r, cfd;
+
+        r = poll(fds, nlfd >= 0 ? 2 : 1, publishing ? PUBLISH_INTERVAL : -1);
+        if (r < 0 && errno != EINTR) {
+            fprintf(stderr, "%s: poll failed: %s\n", progname,
+                    strerror(errno));
+            break;
+        }
+        if (r <= 0) {
+            if (r == 0)
+                publish(nlfd);
+            continue;
+        }
+        if (nlfd >= 0 && (fds[1].revents & POLLIN))
+            publish(nlfd);
+        if (!(fds[0].revents & POLLIN))
+            continue;
+
+        cfd = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+        if (cfd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN)
+                continue;
+            fprintf(stderr, "%s: accept failed: %s\n", progname,
+                    strerror(errno));
+            break;
+        }
+        start_client(cfd);
+    }
+
+    unlink(socket_path);
+    close(fd);
+    /* Clients that are still connected keep using NCF; we are about to
+     * exit anyway, so don't pull it out from under them */
+    return quit ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* vim: set ts=4 sw=4 et: */
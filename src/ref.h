@@ -38,7 +38,8 @@
  * the second case, the caller and whereever the reference was stored both
  * own the reference.
  */
-// FIXME: This is not threadsafe; incr/decr ref needs to be protected
+/* Reference counts are updated atomically, so that references can be
+ * dropped from any thread */
 
 #define REF_MAX UINT_MAX
 
@@ -63,13 +64,15 @@ static int ref_make_ref(void *ptrptr, size_t size, size_t ref_ofs) {
 #define make_ref(var)                                           \
     ref_make_ref(&(var), sizeof(*(var)), offsetof(typeof(*(var)), ref))
 
-#define ref(s) (((s) == NULL || (s)->ref == REF_MAX) ? (s) : ((s)->ref++, (s)))
+#define ref(s)                                                          \
+    (((s) == NULL || (s)->ref == REF_MAX) ? (s)                         \
+     : (__atomic_add_fetch(&(s)->ref, 1, __ATOMIC_RELAXED), (s)))
 
 #define unref(s, t)                                                     \
     do {                                                                \
         if ((s) != NULL && (s)->ref != REF_MAX) {                       \
             assert((s)->ref > 0);                                       \
-            if (--(s)->ref == 0) {                                      \
+            if (__atomic_sub_fetch(&(s)->ref, 1, __ATOMIC_ACQ_REL) == 0) { \
                 /*memset(s, 255, sizeof(*s));*/                         \
                 free_##t(s);                                            \
             }                                                           \
@@ -0,0 +1,347 @@
+/*
+ * remote.c: talk to netcfd instead of the local driver
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+/*
+ * When netcfd is running, a handle opened with ncf_init_flags and
+ * NETCF_INIT_DAEMON or NETCF_INIT_TRY_DAEMON hands its calls to the
+ * daemon instead of loading the configuration itself; the daemon keeps
+ * augeas, the schema and the stylesheets loaded between calls, so that
+ * short lived clients don't pay for setting them up. All
+ * functions here are called with the handle locked, which also keeps
+ * requests and replies on the socket in order.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "safe-alloc.h"
+#include "internal.h"
+#include "dutil.h"
+#include "remote_proto.h"
+
+/* Send MSG to the daemon and replace it with the reply. An error that
+ * the daemon reports is reported on NCF. Returns the return value of the
+ * call in the daemon, or -1 on error */
+static int remote_call(struct netcf *ncf, struct remote_msg *msg) {
+    char errbuf[128];
+    uint32_t proc = msg->hdr.proc;
+
+    ERR_THROW_STRERROR(remote_send(ncf->remote, msg) < 0, ncf, EOTHER,
+                       "failed to send request to netcfd: %s", errbuf);
+    ERR_THROW_STRERROR(remote_recv(ncf->remote, msg) < 0, ncf, EOTHER,
+                       "failed to read reply from netcfd: %s", errbuf);
+    ERR_THROW(msg->hdr.proc != proc, ncf, EINTERNAL,
+              "netcfd answered procedure %u with %u", proc, msg->hdr.proc);
+    if (msg->hdr.errcode != NETCF_NOERROR) {
+        if (msg->hdr.nstrs > 0)
+            report_error(ncf, msg->hdr.errcode, "%s", msg->strs[0]);
+        else
+            report_error(ncf, msg->hdr.errcode, NULL);
+        goto error;
+    }
+    return msg->hdr.arg;
+ error:
+    remote_msg_clear(msg);
+    return -1;
+}
+
+/* Make sure that the reply MSG has at least N strings */
+static int remote_check_strs(struct netcf *ncf, struct remote_msg *msg,
+                             uint32_t n) {
+    ERR_THROW(msg->hdr.nstrs < n, ncf, EINTERNAL,
+              "netcfd sent %u strings where %u were expected",
+              msg->hdr.nstrs, n);
+    return 0;
+ error:
+    return -1;
+}
+
+/* Make a call with a single string argument ARG and flags FLAGS */
+static int remote_call1(struct netcf *ncf, struct remote_msg *msg,
+                        remote_proc_t proc, int32_t flags,
+                        const char *arg) {
+    remote_msg_init(msg, proc, flags);
+    ERR_NOMEM(arg != NULL && remote_msg_add(msg, arg) < 0, ncf);
+    return remote_call(ncf, msg);
+ error:
+    remote_msg_clear(msg);
+    return -1;
+}
+
+int remote_open(struct netcf *ncf, const char *path, bool required) {
+    struct sockaddr_un addr;
+    struct remote_msg msg = { .buf = NULL };
+    char errbuf[128];
+    int fd = -1;
+
+    ERR_THROW(strlen(path) >= sizeof(addr.sun_path), ncf, EOTHER,
+              "netcfd socket path %s is too long", path);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0);
+    ERR_THROW_STRERROR(fd < 0, ncf, EOTHER,
+                       "failed to create socket: %s", errbuf);
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        /* A socket left behind by a daemon that is gone */
+        if (!required)
+            goto fallback;
+        ERR_THROW_STRERROR(true, ncf, EOTHER,
+                           "failed to connect to netcfd at %s: %s",
+                           path, errbuf);
+    }
+
+    ncf->remote = fd;
+    if (remote_call1(ncf, &msg, REMOTE_PROC_HELLO, 0, NULL) < 0
+        || remote_check_strs(ncf, &msg, 1) < 0) {
+        if (required)
+            goto error;
+        /* A daemon that doesn't answer is as good as none */
+        ncf->errcode = NETCF_NOERROR;
+        FREE(ncf->errdetails);
+        ncf->remote = -1;
+        goto fallback;
+    }
+    /* A daemon serving some other root is of no use to us */
+    if (STRNEQ(msg.strs[0], ncf->root)) {
+        ERR_THROW(required, ncf, EOTHER,
+                  "netcfd at %s serves %s, not %s", path, msg.strs[0],
+                  ncf->root);
+        ncf->remote = -1;
+        goto fallback;
+    }
+    remote_msg_clear(&msg);
+    return 0;
+
+ fallback:
+    remote_msg_clear(&msg);
+    close(fd);
+    return 0;
+ error:
+    remote_msg_clear(&msg);
+    ncf->remote = -1;
+    if (fd >= 0)
+        close(fd);
+    return -1;
+}
+
+void remote_close(struct netcf *ncf) {
+    if (ncf->remote >= 0)
+        close(ncf->remote);
+    ncf->remote = -1;
+}
+
+int remote_unsupported(struct netcf *ncf) {
+    if (ncf->remote < 0)
+        return 0;
+    report_error(ncf, NETCF_EINVALIDOP, "not supported through netcfd");
+    return -1;
+}
+
+int remote_num_of_interfaces(struct netcf *ncf, unsigned int flags) {
+    struct remote_msg msg = { .buf = NULL };
+    int r;
+
+    r = remote_call1(ncf, &msg, REMOTE_PROC_NUM_OF_INTERFACES, flags, NULL);
+    remote_msg_clear(&msg);
+    return r;
+}
+
+int remote_list_interfaces(struct netcf *ncf, int maxnames, char **names,
+                           unsigned int flags) {
+    struct remote_msg msg = { .buf = NULL };
+    int nnames;
+
+    nnames = remote_call1(ncf, &msg, REMOTE_PROC_LIST_INTERFACES, flags,
+                          NULL);
+    if (nnames < 0)
+        goto error;
+    for (int i=0; i < maxnames && i < (int) msg.hdr.nstrs; i++) {
+        names[i] = strdup(msg.strs[i]);
+        ERR_NOMEM(names[i] == NULL, ncf);
+    }
+    remote_msg_clear(&msg);
+    return nnames;
+ error:
+    remote_msg_clear(&msg);
+    return -1;
+}
+
+struct netcf_if *remote_lookup_by_name(struct netcf *ncf, const char *name) {
+    struct remote_msg msg = { .buf = NULL };
+    struct netcf_if *nif = NULL;
+    char *nif_name = NULL;
+
+    if (remote_call1(ncf, &msg, REMOTE_PROC_LOOKUP_BY_NAME, 0, name) < 0)
+        goto error;
+    if (msg.hdr.nstrs == 0)
+        goto done;
+    nif_name = strdup(msg.strs[0]);
+    ERR_NOMEM(nif_name == NULL, ncf);
+    nif = make_netcf_if(ncf, nif_name);
+    ERR_NOMEM(nif == NULL, ncf);
+ done:
+ error:
+    remote_msg_clear(&msg);
+    return nif;
+}
+
+int remote_lookup_by_mac_string(struct netcf *ncf, const char *mac,
+                                int maxifaces, struct netcf_if **ifaces) {
+    struct remote_msg msg = { .buf = NULL };
+    int nifaces;
+
+    MEMZERO(ifaces, maxifaces);
+    nifaces = remote_call1(ncf, &msg, REMOTE_PROC_LOOKUP_BY_MAC, 0, mac);
+    if (nifaces < 0)
+        goto error;
+    for (int i=0; i < maxifaces && i < (int) msg.hdr.nstrs; i++) {
+        char *name = strdup(msg.strs[i]);
+        ERR_NOMEM(name == NULL, ncf);
+        ifaces[i] = make_netcf_if(ncf, name);
+        ERR_NOMEM(ifaces[i] == NULL, ncf);
+    }
+    remote_msg_clear(&msg);
+    return nifaces;
+ error:
+    for (int i=0; i < maxifaces; i++)
+        unref(ifaces[i], netcf_if);
+    remote_msg_clear(&msg);
+    return -1;
+}
+
+const char *remote_mac_string(struct netcf_if *nif) {
+    struct netcf *ncf = nif->ncf;
+    struct remote_msg msg = { .buf = NULL };
+
+    if (remote_call1(ncf, &msg, REMOTE_PROC_MAC_STRING, 0, nif->name) < 0)
+        goto error;
+    FREE(nif->mac);
+    if (msg.hdr.nstrs > 0) {
+        nif->mac = strdup(msg.strs[0]);
+        ERR_NOMEM(nif->mac == NULL, ncf);
+    }
+ error:
+    remote_msg_clear(&msg);
+    return nif->mac;
+}
+
+char *remote_xml(struct netcf_if *nif, bool state) {
+    struct netcf *ncf = nif->ncf;
+    struct remote_msg msg = { .buf = NULL };
+    remote_proc_t proc;
+    char *result = NULL;
+
+    proc = state ? REMOTE_PROC_XML_STATE : REMOTE_PROC_XML_DESC;
+    if (remote_call1(ncf, &msg, proc, 0, nif->name) < 0
+        || remote_check_strs(ncf, &msg, 1) < 0)
+        goto error;
+    result = strdup(msg.strs[0]);
+    ERR_NOMEM(result == NULL, ncf);
+ error:
+    remote_msg_clear(&msg);
+    return result;
+}
+
+int remote_if_status(struct netcf_if *nif, unsigned int *flags) {
+    struct remote_msg msg = { .buf = NULL };
+    int r;
+
+    r = remote_call1(nif->ncf, &msg, REMOTE_PROC_IF_STATUS, 0, nif->name);
+    remote_msg_clear(&msg);
+    if (r < 0)
+        return -1;
+    *flags = r;
+    return 0;
+}
+
+struct netcf_if *remote_define(struct netcf *ncf, const char *xml,
+                               unsigned int flags) {
+    struct remote_msg msg = { .buf = NULL };
+    struct netcf_if *nif = NULL;
+    char *name = NULL;
+
+    if (remote_call1(ncf, &msg, REMOTE_PROC_DEFINE, flags, xml) < 0
+        || remote_check_strs(ncf, &msg, 1) < 0)
+        goto error;
+    name = strdup(msg.strs[0]);
+    ERR_NOMEM(name == NULL, ncf);
+    nif = make_netcf_if(ncf, name);
+    ERR_NOMEM(nif == NULL, ncf);
+ error:
+    remote_msg_clear(&msg);
+    return nif;
+}
+
+/* Calls that take an interface and return 0 or -1 */
+static int remote_if_call(struct netcf_if *nif, remote_proc_t proc) {
+    struct remote_msg msg = { .buf = NULL };
+    int r;
+
+    r = remote_call1(nif->ncf, &msg, proc, 0, nif->name);
+    remote_msg_clear(&msg);
+    return r < 0 ? -1 : 0;
+}
+
+int remote_undefine(struct netcf_if *nif) {
+    return remote_if_call(nif, REMOTE_PROC_UNDEFINE);
+}
+
+int remote_if_up(struct netcf_if *nif) {
+    return remote_if_call(nif, REMOTE_PROC_IF_UP);
+}
+
+int remote_if_down(struct netcf_if *nif) {
+    return remote_if_call(nif, REMOTE_PROC_IF_DOWN);
+}
+
+/* Calls that take only flags and return 0 or -1 */
+static int remote_flags_call(struct netcf *ncf, remote_proc_t proc,
+                             unsigned int flags) {
+    struct remote_msg msg = { .buf = NULL };
+    int r;
+
+    r = remote_call1(ncf, &msg, proc, flags, NULL);
+    remote_msg_clear(&msg);
+    return r < 0 ? -1 : 0;
+}
+
+int remote_change_begin(struct netcf *ncf, unsigned int flags) {
+    return remote_flags_call(ncf, REMOTE_PROC_CHANGE_BEGIN, flags);
+}
+
+int remote_change_commit(struct netcf *ncf, unsigned int flags) {
+    return remote_flags_call(ncf, REMOTE_PROC_CHANGE_COMMIT, flags);
+}
+
+int remote_change_rollback(struct netcf *ncf, unsigned int flags) {
+    return remote_flags_call(ncf, REMOTE_PROC_CHANGE_ROLLBACK, flags);
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,156 @@
+/*
+ * remote_proto.c: the protocol between libnetcf and netcfd
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "safe-alloc.h"
+#include "remote_proto.h"
+
+void remote_msg_init(struct remote_msg *msg, remote_proc_t proc,
+                     int32_t arg) {
+    remote_msg_clear(msg);
+    msg->hdr.proc = proc;
+    msg->hdr.arg = arg;
+}
+
+int remote_msg_add(struct remote_msg *msg, const char *str) {
+    size_t len = strlen(str) + 1;
+
+    if (sizeof(msg->hdr) + msg->len + len > REMOTE_MSG_MAX) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (msg->len + len > msg->size) {
+        size_t size = msg->size > 0 ? msg->size : 256;
+
+        while (size < msg->len + len)
+            size *= 2;
+        if (REALLOC_N(msg->buf, size) < 0) {
+            errno = ENOMEM;
+            return -1;
+        }
+        msg->size = size;
+    }
+    memcpy(msg->buf + msg->len, str, len);
+    msg->len += len;
+    msg->hdr.nstrs += 1;
+    return 0;
+}
+
+void remote_msg_clear(struct remote_msg *msg) {
+    FREE(msg->buf);
+    FREE(msg->strs);
+    memset(msg, 0, sizeof(*msg));
+}
+
+int remote_send(int fd, const struct remote_msg *msg) {
+    struct iovec iov[2];
+    struct msghdr mh;
+    ssize_t r;
+
+    iov[0].iov_base = (void *) &msg->hdr;
+    iov[0].iov_len = sizeof(msg->hdr);
+    iov[1].iov_base = msg->buf;
+    iov[1].iov_len = msg->len;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = msg->len > 0 ? 2 : 1;
+
+    do {
+        r = sendmsg(fd, &mh, MSG_NOSIGNAL);
+    } while (r < 0 && errno == EINTR);
+    return r < 0 ? -1 : 0;
+}
+
+int remote_recv(int fd, struct remote_msg *msg) {
+    char *pkt = NULL;
+    ssize_t r;
+    size_t len;
+    char *p;
+
+    remote_msg_clear(msg);
+    if (ALLOC_N(pkt, REMOTE_MSG_MAX) < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    do {
+        r = recv(fd, pkt, REMOTE_MSG_MAX, MSG_TRUNC);
+    } while (r < 0 && errno == EINTR);
+    if (r <= 0) {
+        if (r == 0)
+            errno = ECONNRESET;
+        goto error;
+    }
+    if (r > REMOTE_MSG_MAX || (size_t) r < sizeof(msg->hdr)) {
+        errno = EPROTO;
+        goto error;
+    }
+
+    memcpy(&msg->hdr, pkt, sizeof(msg->hdr));
+    len = r - sizeof(msg->hdr);
+    if (msg->hdr.nstrs > len) {
+        errno = EPROTO;
+        goto error;
+    }
+    memmove(pkt, pkt + sizeof(msg->hdr), len);
+    msg->buf = pkt;
+    msg->len = len;
+    msg->size = REMOTE_MSG_MAX;
+    pkt = NULL;
+
+    if (ALLOC_N(msg->strs, msg->hdr.nstrs + 1) < 0) {
+        errno = ENOMEM;
+        goto error;
+    }
+    p = msg->buf;
+    for (uint32_t i=0; i < msg->hdr.nstrs; i++) {
+        char *end = memchr(p, '\0', msg->buf + len - p);
+        if (end == NULL) {
+            errno = EPROTO;
+            goto error;
+        }
+        msg->strs[i] = p;
+        p = end + 1;
+    }
+    if (p != msg->buf + len) {
+        errno = EPROTO;
+        goto error;
+    }
+    return 0;
+
+ error:
+    {
+        int saved = errno;
+        FREE(pkt);
+        remote_msg_clear(msg);
+        errno = saved;
+    }
+    return -1;
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,107 @@
+/*
+ * remote_proto.h: the protocol between libnetcf and netcfd
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+#ifndef REMOTE_PROTO_H_
+#define REMOTE_PROTO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "configmake.h"
+
+/*
+ * Clients talk to netcfd over a SOCK_SEQPACKET Unix socket. Each request
+ * and each reply is a single packet: a struct remote_hdr, followed by
+ * NSTRS NUL-terminated strings. The daemon answers every request with
+ * exactly one reply, in order.
+ *
+ * In a request, ARG carries the flags of the call, if it has any. In a
+ * reply, ARG is the return value of the call on the daemon's side and
+ * ERRCODE the netcf error code; when ERRCODE is not NETCF_NOERROR, the
+ * only string, if there is one, holds the error details.
+ *
+ * Both ends run on the same host, and use host byte order.
+ */
+
+/* Where netcfd listens, unless NETCF_SOCKET says otherwise */
+#define REMOTE_SOCKET_PATH LOCALSTATEDIR "/run/netcf/netcfd.sock"
+
+/* The largest packet we send or accept */
+#define REMOTE_MSG_MAX (128 * 1024)
+
+typedef enum {
+    REMOTE_PROC_HELLO = 1,            /* -> root of the daemon */
+    REMOTE_PROC_NUM_OF_INTERFACES,    /* ARG flags */
+    REMOTE_PROC_LIST_INTERFACES,      /* ARG flags -> names */
+    REMOTE_PROC_LOOKUP_BY_NAME,       /* name -> name */
+    REMOTE_PROC_LOOKUP_BY_MAC,        /* mac -> names */
+    REMOTE_PROC_MAC_STRING,           /* name -> mac */
+    REMOTE_PROC_XML_DESC,             /* name -> xml */
+    REMOTE_PROC_XML_STATE,            /* name -> xml */
+    REMOTE_PROC_IF_STATUS,            /* name; ARG is the status flags */
+    REMOTE_PROC_DEFINE,               /* ARG flags, xml -> name */
+    REMOTE_PROC_UNDEFINE,             /* name */
+    REMOTE_PROC_IF_UP,                /* name */
+    REMOTE_PROC_IF_DOWN,              /* name */
+    REMOTE_PROC_CHANGE_BEGIN,         /* ARG flags */
+    REMOTE_PROC_CHANGE_COMMIT,        /* ARG flags */
+    REMOTE_PROC_CHANGE_ROLLBACK,      /* ARG flags */
+    REMOTE_PROC_LAST
+} remote_proc_t;
+
+struct remote_hdr {
+    uint32_t proc;
+    int32_t  arg;
+    uint32_t errcode;
+    uint32_t nstrs;
+};
+
+struct remote_msg {
+    struct remote_hdr  hdr;
+    size_t             len;           /* Bytes used in BUF */
+    size_t             size;          /* Bytes allocated for BUF */
+    char              *buf;           /* The strings, back to back */
+    char             **strs;          /* Set by remote_recv, pointing
+                                       * into BUF */
+};
+
+/* Start a new message for PROC with argument ARG */
+void remote_msg_init(struct remote_msg *msg, remote_proc_t proc,
+                     int32_t arg);
+
+/* Append STR to MSG. Returns -1 with errno set to ENOMEM or EMSGSIZE if
+ * there is no room for it */
+int remote_msg_add(struct remote_msg *msg, const char *str);
+
+void remote_msg_clear(struct remote_msg *msg);
+
+/* Send MSG over FD. Returns 0 on success, -1 with errno set on error */
+int remote_send(int fd, const struct remote_msg *msg);
+
+/* Receive the next packet from FD into MSG, which is cleared first.
+ * Returns 0 on success, and -1 with errno set on error; errno is
+ * ECONNRESET if the other end hung up, and EPROTO if the packet is not
+ * well formed */
+int remote_recv(int fd, struct remote_msg *msg);
+
+#endif
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,505 @@
+/*
+ * rng2c.c: compile a RelaxNG schema into a C validator
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+/*
+ * Usage: rng2c NAME SCHEMA > OUTPUT.c
+ *
+ * Writes C code for the validator of SCHEMA to stdout, which defines the
+ * struct rngc_grammar RNGC_NAME for use with the functions in rngc.h.
+ *
+ * Only the subset of RelaxNG needed for netcf's schemas is supported:
+ * elements and attributes with fixed names in the null namespace, group,
+ * interleave, choice, optional, zeroOrMore, oneOrMore, ref, empty and
+ * notAllowed, and, in attributes, value and the XML Schema datatypes
+ * string, unsignedInt and double with pattern, minInclusive and
+ * maxInclusive parameters. Anything else is an error.
+ *
+ * Groups are matched like interleaves, i.e. the order of child elements
+ * is not checked. This is exact as long as no group in the schema
+ * constrains the order of two elements in a way that matters; in
+ * interface.rng, the only such group appears in a choice with its
+ * reversed twin.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#define RNG_NS "http://relaxng.org/ns/structure/1.0"
+#define XSD_DATATYPES "http://www.w3.org/2001/XMLSchema-datatypes"
+#define VERSION_NS "http://netcf.org/xml/version/1.0"
+
+#define STREQ(a, b) (strcmp(a, b) == 0)
+
+struct define {
+    const char *name;
+    xmlNodePtr  node;
+    bool        need_pattern;      /* used as a pattern */
+    bool        need_value;        /* used as an attribute value */
+    bool        have_pattern;      /* pattern function has been emitted */
+    bool        have_value;        /* value function has been emitted */
+};
+
+static struct define *defines;
+static int ndefines;
+
+static const char *schema;
+static FILE *decls, *code, *data;
+static char *decls_buf, *code_buf, *data_buf;
+static size_t decls_len, code_len, data_len;
+static int nfuncs, ndata;
+
+__attribute__((__format__ (printf, 2, 3), __noreturn__))
+static void die(xmlNodePtr node, const char *format, ...) {
+    va_list ap;
+
+    fprintf(stderr, "%s:%ld: ", schema, node ? xmlGetLineNo(node) : 0L);
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    exit(EXIT_FAILURE);
+}
+
+__attribute__((__format__ (printf, 1, 2)))
+static char *format(const char *fmt, ...) {
+    va_list ap;
+    char *result;
+
+    va_start(ap, fmt);
+    if (vasprintf(&result, fmt, ap) < 0) {
+        fprintf(stderr, "allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    va_end(ap);
+    return result;
+}
+
+/* Return S as a C string literal */
+static char *c_string(const char *s) {
+    char *result = format("%*s", (int) (4 * strlen(s) + 3), "");
+    char *p = result;
+
+    *p++ = '"';
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            *p++ = '\\';
+            *p++ = *s;
+        } else if (isprint((unsigned char) *s)) {
+            *p++ = *s;
+        } else {
+            p += sprintf(p, "\\%03o", (unsigned char) *s);
+        }
+    }
+    *p++ = '"';
+    *p = '\0';
+    return result;
+}
+
+static bool is_rng(xmlNodePtr node, const char *name) {
+    return node->type == XML_ELEMENT_NODE && node->ns != NULL
+        && xmlStrEqual(node->ns->href, BAD_CAST RNG_NS)
+        && (name == NULL || xmlStrEqual(node->name, BAD_CAST name));
+}
+
+static const char *rng_name(xmlNodePtr node) {
+    return (const char *) node->name;
+}
+
+/* Return the attribute NAME of NODE; die if it is required but missing */
+static char *prop(xmlNodePtr node, const char *name, bool required) {
+    char *value = (char *) xmlGetNoNsProp(node, BAD_CAST name);
+
+    if (value == NULL && required)
+        die(node, "<%s> lacks the %s attribute", rng_name(node), name);
+    return value;
+}
+
+/* The datatypeLibrary in effect for NODE */
+static char *datatype_library(xmlNodePtr node) {
+    for (; node != NULL && node->type == XML_ELEMENT_NODE;
+         node = node->parent) {
+        char *lib = prop(node, "datatypeLibrary", false);
+        if (lib != NULL)
+            return lib;
+    }
+    return (char *) "";
+}
+
+static struct define *find_define(xmlNodePtr ref) {
+    char *name = prop(ref, "name", true);
+
+    for (int i=0; i < ndefines; i++)
+        if (STREQ(defines[i].name, name))
+            return defines + i;
+    die(ref, "reference to undefined pattern %s", name);
+}
+
+static char *c_ident(const char *prefix, const char *name) {
+    char *result = format("%s%s", prefix, name);
+
+    for (char *p = result; *p != '\0'; p++)
+        if (! isalnum((unsigned char) *p))
+            *p = '_';
+    return result;
+}
+
+static char *compile_pattern(xmlNodePtr node);
+static char *compile_value(xmlNodePtr node);
+
+/* Compile the RNG children of NODE, starting with FIRST, which form an
+ * implicit group */
+static char *compile_group(xmlNodePtr first) {
+    char *result = NULL;
+
+    for (xmlNodePtr cur = first; cur != NULL; cur = cur->next) {
+        if (! is_rng(cur, NULL))
+            continue;
+        char *p = compile_pattern(cur);
+        result = result == NULL ? p : format("%s\n        && %s", result, p);
+    }
+    return result == NULL ? (char *) "true" : result;
+}
+
+/* Emit a pattern function returning EXPR, and return its name */
+static char *pattern_function(const char *expr) {
+    char *name = format("p%d", nfuncs++);
+
+    fprintf(decls, "static bool %s(struct rngc_elem *e);\n", name);
+    /* An empty group compiles to just 'true', which does not look at E */
+    fprintf(code, "static bool %s(struct rngc_elem *e ATTRIBUTE_UNUSED) {\n"
+            "    return %s;\n}\n\n", name, expr);
+    return name;
+}
+
+static char *value_function(const char *expr) {
+    char *name = format("v%d", nfuncs++);
+
+    fprintf(decls, "static bool %s(struct rngc *rc, const char *v);\n", name);
+    fprintf(code, "static bool %s(struct rngc *rc ATTRIBUTE_UNUSED, "
+            "const char *v ATTRIBUTE_UNUSED) {\n"
+            "    return %s;\n}\n\n", name, expr);
+    return name;
+}
+
+/* Return the name of a pattern function for the group of children of
+ * NODE */
+static char *group_function(xmlNodePtr node) {
+    return pattern_function(compile_group(node->children));
+}
+
+static char *compile_element(xmlNodePtr node) {
+    char *name = prop(node, "name", true);
+    char *ns = prop(node, "ns", false);
+
+    if (ns != NULL && *ns != '\0')
+        die(node, "elements in namespace %s are not supported", ns);
+    for (xmlNodePtr cur = node->children; cur != NULL; cur = cur->next)
+        if (is_rng(cur, "name") || is_rng(cur, "anyName")
+            || is_rng(cur, "nsName") || is_rng(cur, "choice"))
+            die(node, "name classes are not supported");
+
+    return format("rngc_element(e, %s, %s)", c_string(name),
+                  group_function(node));
+}
+
+static char *compile_attribute(xmlNodePtr node) {
+    char *name = prop(node, "name", true);
+    char *ns = prop(node, "ns", false);
+    char *value = NULL;
+
+    if (ns != NULL && *ns != '\0')
+        die(node, "attributes in namespace %s are not supported", ns);
+    for (xmlNodePtr cur = node->children; cur != NULL; cur = cur->next) {
+        if (! is_rng(cur, NULL))
+            continue;
+        if (value != NULL)
+            die(node, "attribute %s has more than one pattern", name);
+        value = value_function(compile_value(cur));
+    }
+    return format("rngc_attribute(e, %s, %s)", c_string(name),
+                  value == NULL ? "NULL" : value);
+}
+
+static char *compile_choice(xmlNodePtr node) {
+    char *name = format("c%d", nfuncs++);
+    char *alts = (char *) "";
+
+    for (xmlNodePtr cur = node->children; cur != NULL; cur = cur->next) {
+        if (! is_rng(cur, NULL))
+            continue;
+        alts = format("%s%s, ", alts, pattern_function(compile_pattern(cur)));
+    }
+    fprintf(decls, "static const rngc_pattern %s[] = { %sNULL };\n",
+            name, alts);
+    return format("rngc_choice(e, %s)", name);
+}
+
+static char *compile_pattern(xmlNodePtr node) {
+    const char *name = rng_name(node);
+
+    if (STREQ(name, "element")) {
+        return compile_element(node);
+    } else if (STREQ(name, "attribute")) {
+        return compile_attribute(node);
+    } else if (STREQ(name, "group") || STREQ(name, "interleave")) {
+        return format("(%s)", compile_group(node->children));
+    } else if (STREQ(name, "optional")) {
+        return format("rngc_optional(e, %s)", group_function(node));
+    } else if (STREQ(name, "zeroOrMore")) {
+        return format("rngc_zero_or_more(e, %s)", group_function(node));
+    } else if (STREQ(name, "oneOrMore")) {
+        return format("rngc_one_or_more(e, %s)", group_function(node));
+    } else if (STREQ(name, "choice")) {
+        return compile_choice(node);
+    } else if (STREQ(name, "ref")) {
+        struct define *def = find_define(node);
+        def->need_pattern = true;
+        return format("%s(e)", c_ident("d_", def->name));
+    } else if (STREQ(name, "empty")) {
+        return (char *) "true";
+    } else if (STREQ(name, "notAllowed")) {
+        return (char *) "false";
+    }
+    die(node, "<%s> is not supported here", name);
+}
+
+static char *compile_data(xmlNodePtr node) {
+    char *lib = datatype_library(node);
+    char *type = prop(node, "type", true);
+    const char *rngc_type;
+    char *pattern = NULL, *min = NULL, *max = NULL;
+
+    if (! STREQ(lib, XSD_DATATYPES))
+        die(node, "datatype library '%s' is not supported", lib);
+    if (STREQ(type, "string"))
+        rngc_type = "RNGC_STRING";
+    else if (STREQ(type, "unsignedInt"))
+        rngc_type = "RNGC_UNSIGNED_INT";
+    else if (STREQ(type, "double"))
+        rngc_type = "RNGC_DOUBLE";
+    else
+        die(node, "datatype %s is not supported", type);
+
+    for (xmlNodePtr cur = node->children; cur != NULL; cur = cur->next) {
+        if (! is_rng(cur, NULL))
+            continue;
+        if (! is_rng(cur, "param"))
+            die(cur, "<%s> is not supported in <data>", rng_name(cur));
+
+        char *param = prop(cur, "name", true);
+        char *value = (char *) xmlNodeGetContent(cur);
+        if (STREQ(param, "pattern"))
+            pattern = value;
+        else if (STREQ(param, "minInclusive") && ! STREQ(type, "string"))
+            min = value;
+        else if (STREQ(param, "maxInclusive") && ! STREQ(type, "string"))
+            max = value;
+        else
+            die(cur, "parameter %s is not supported for %s", param, type);
+    }
+
+    fprintf(data, "    { %s, %s, %s, %s, %s, %s },\n", rngc_type,
+            pattern == NULL ? "NULL" : c_string(pattern),
+            min == NULL ? "false" : "true", min == NULL ? "0" : min,
+            max == NULL ? "false" : "true", max == NULL ? "0" : max);
+    return format("rngc_data(rc, %d, v)", ndata++);
+}
+
+static char *compile_value(xmlNodePtr node) {
+    const char *name = rng_name(node);
+
+    if (STREQ(name, "value")) {
+        char *type = prop(node, "type", false);
+        char *lib = type == NULL ? (char *) "" : datatype_library(node);
+        char *value = (char *) xmlNodeGetContent(node);
+
+        /* Without a type, values are tokens; we compare them literally,
+         * which is stricter than necessary */
+        if (type != NULL
+            && ! (STREQ(lib, "") && STREQ(type, "token"))
+            && ! (STREQ(lib, "") && STREQ(type, "string"))
+            && ! (STREQ(lib, XSD_DATATYPES) && STREQ(type, "string")))
+            die(node, "values of type %s are not supported", type);
+        return format("STREQ(v, %s)", c_string(value));
+    } else if (STREQ(name, "data")) {
+        return compile_data(node);
+    } else if (STREQ(name, "choice")) {
+        char *result = NULL;
+
+        for (xmlNodePtr cur = node->children; cur != NULL; cur = cur->next) {
+            if (! is_rng(cur, NULL))
+                continue;
+            char *v = compile_value(cur);
+            result = result == NULL ? v : format("%s\n        || %s", result, v);
+        }
+        if (result == NULL)
+            die(node, "empty <choice>");
+        return format("(%s)", result);
+    } else if (STREQ(name, "ref")) {
+        struct define *def = find_define(node);
+        def->need_value = true;
+        return format("%s(rc, v)", c_ident("v_", def->name));
+    } else if (STREQ(name, "text")) {
+        return (char *) "true";
+    }
+    die(node, "<%s> is not supported in attribute values", name);
+}
+
+/* The content of a <define> used as an attribute value */
+static char *compile_define_value(struct define *def) {
+    xmlNodePtr value = NULL;
+
+    for (xmlNodePtr cur = def->node->children; cur != NULL; cur = cur->next) {
+        if (! is_rng(cur, NULL))
+            continue;
+        if (value != NULL)
+            die(def->node, "define %s is used as a value, but has more "
+                "than one pattern", def->name);
+        value = cur;
+    }
+    if (value == NULL)
+        die(def->node, "define %s is empty", def->name);
+    return compile_value(value);
+}
+
+/* Emit functions for all defines that are referenced, including those
+ * referenced from other defines */
+static void compile_defines(void) {
+    bool progress = true;
+
+    while (progress) {
+        progress = false;
+        for (int i=0; i < ndefines; i++) {
+            struct define *def = defines + i;
+
+            if (def->need_pattern && ! def->have_pattern) {
+                char *fn = c_ident("d_", def->name);
+                char *expr = compile_group(def->node->children);
+
+                fprintf(decls, "static bool %s(struct rngc_elem *e);\n", fn);
+                fprintf(code,
+                        "static bool %s(struct rngc_elem *e ATTRIBUTE_UNUSED) {\n"
+                        "    return %s;\n}\n\n", fn, expr);
+                def->have_pattern = true;
+                progress = true;
+            }
+            if (def->need_value && ! def->have_value) {
+                char *fn = c_ident("v_", def->name);
+                char *expr = compile_define_value(def);
+
+                fprintf(decls,
+                        "static bool %s(struct rngc *rc, const char *v);\n",
+                        fn);
+                fprintf(code, "static bool %s(struct rngc *rc ATTRIBUTE_UNUSED, "
+                        "const char *v ATTRIBUTE_UNUSED) {\n"
+                        "    return %s;\n}\n\n", fn, expr);
+                def->have_value = true;
+                progress = true;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    xmlDocPtr doc;
+    xmlNodePtr grammar, start = NULL;
+    char *serial = NULL;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s NAME SCHEMA\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    schema = argv[2];
+
+    doc = xmlReadFile(schema, NULL, XML_PARSE_NONET);
+    if (doc == NULL)
+        die(NULL, "could not parse schema");
+    grammar = xmlDocGetRootElement(doc);
+    if (! is_rng(grammar, "grammar"))
+        die(grammar, "the root element must be <grammar>");
+
+    for (xmlNodePtr cur = grammar->children; cur != NULL; cur = cur->next) {
+        if (is_rng(cur, "start")) {
+            if (start != NULL || prop(cur, "combine", false) != NULL)
+                die(cur, "combining <start> is not supported");
+            start = cur;
+            serial = (char *) xmlGetNsProp(cur, BAD_CAST "serial",
+                                           BAD_CAST VERSION_NS);
+        } else if (is_rng(cur, "define")) {
+            if (prop(cur, "combine", false) != NULL)
+                die(cur, "combining <define> is not supported");
+            defines = realloc(defines, (ndefines + 1) * sizeof(*defines));
+            if (defines == NULL)
+                die(cur, "allocation failed");
+            memset(defines + ndefines, 0, sizeof(*defines));
+            defines[ndefines].name = prop(cur, "name", true);
+            defines[ndefines].node = cur;
+            ndefines += 1;
+        } else if (is_rng(cur, NULL)) {
+            die(cur, "<%s> is not supported", rng_name(cur));
+        }
+    }
+    if (start == NULL)
+        die(grammar, "the schema has no <start>");
+
+    decls = open_memstream(&decls_buf, &decls_len);
+    code = open_memstream(&code_buf, &code_len);
+    data = open_memstream(&data_buf, &data_len);
+    if (decls == NULL || code == NULL || data == NULL)
+        die(NULL, "allocation failed");
+
+    char *start_expr = compile_group(start->children);
+    fprintf(code, "static bool start(struct rngc_elem *e ATTRIBUTE_UNUSED) {\n"
+            "    return %s;\n}\n\n", start_expr);
+    compile_defines();
+
+    fclose(decls);
+    fclose(code);
+    fclose(data);
+
+    printf("/* Generated by rng2c from %s. Do not edit. */\n\n", schema);
+    printf("#include <config.h>\n"
+           "#include \"internal.h\"\n"
+           "#include \"rngc.h\"\n\n");
+    printf("%s\n", decls_buf);
+    printf("static const struct rngc_data data[] = {\n%s};\n\n", data_buf);
+    printf("%s", code_buf);
+    printf("const struct rngc_grammar rngc_%s = {\n"
+           "    .serial = %s,\n"
+           "    .start = start,\n"
+           "    .ndata = %d,\n"
+           "    .data = data\n"
+           "};\n", argv[1], serial == NULL ? "-1" : serial, ndata);
+
+    xmlFreeDoc(doc);
+    return EXIT_SUCCESS;
+}
+
+/* vim: set ts=4 sw=4 et: */
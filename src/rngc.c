@@ -0,0 +1,296 @@
+/*
+ * rngc.c: support for RelaxNG schemas compiled into C by rng2c
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxml/xmlregexp.h>
+
+#include "safe-alloc.h"
+#include "rngc.h"
+
+/* Elements with more attributes and children than this are left to the
+ * interpreter, so that we can keep our bookkeeping on the stack */
+#define MAX_ITEMS 4096
+
+struct rngc {
+    const struct rngc_grammar *grammar;
+    xmlRegexpPtr              *regexps;
+};
+
+struct rngc *rngc_new(const struct rngc_grammar *grammar) {
+    struct rngc *rc = NULL;
+
+    if (ALLOC(rc) < 0)
+        return NULL;
+    rc->grammar = grammar;
+    if (ALLOC_N(rc->regexps, grammar->ndata) < 0)
+        goto error;
+
+    for (unsigned int i=0; i < grammar->ndata; i++) {
+        const char *pattern = grammar->data[i].pattern;
+
+        if (pattern == NULL)
+            continue;
+        rc->regexps[i] = xmlRegexpCompile(BAD_CAST pattern);
+        if (rc->regexps[i] == NULL)
+            goto error;
+    }
+    return rc;
+
+ error:
+    rngc_free(rc);
+    return NULL;
+}
+
+void rngc_free(struct rngc *rc) {
+    if (rc == NULL)
+        return;
+    if (rc->regexps != NULL) {
+        for (unsigned int i=0; i < rc->grammar->ndata; i++)
+            xmlRegFreeRegexp(rc->regexps[i]);
+        FREE(rc->regexps);
+    }
+    FREE(rc);
+}
+
+#define NITEMS(e) ((e)->nattrs + (e)->nchildren)
+
+/* Validate the attributes and children of NODE against CONTENT */
+static bool check_element(struct rngc *rc, xmlNodePtr node,
+                          rngc_pattern content) {
+    int nattrs = 0, nchildren = 0;
+
+    for (xmlAttrPtr a = node->properties; a != NULL; a = a->next)
+        nattrs += 1;
+    for (xmlNodePtr cur = node->children; cur != NULL; cur = cur->next) {
+        switch (cur->type) {
+        case XML_ELEMENT_NODE:
+            nchildren += 1;
+            break;
+        case XML_TEXT_NODE:
+        case XML_CDATA_SECTION_NODE:
+            /* None of the elements we support have text content */
+            if (! xmlIsBlankNode(cur))
+                return false;
+            break;
+        case XML_COMMENT_NODE:
+        case XML_PI_NODE:
+            break;
+        default:
+            return false;
+        }
+    }
+    if (nattrs + nchildren > MAX_ITEMS)
+        return false;
+
+    xmlAttrPtr attrs[nattrs + 1];
+    xmlNodePtr children[nchildren + 1];
+    unsigned char used[nattrs + nchildren + 1];
+    struct rngc_elem e = {
+        .rc = rc, .nattrs = nattrs, .nchildren = nchildren,
+        .attrs = attrs, .children = children, .used = used
+    };
+
+    nattrs = 0;
+    for (xmlAttrPtr a = node->properties; a != NULL; a = a->next)
+        attrs[nattrs++] = a;
+    nchildren = 0;
+    for (xmlNodePtr cur = node->children; cur != NULL; cur = cur->next)
+        if (cur->type == XML_ELEMENT_NODE)
+            children[nchildren++] = cur;
+    memset(used, 0, NITEMS(&e));
+
+    if (! content(&e))
+        return false;
+    return memchr(used, 0, NITEMS(&e)) == NULL;
+}
+
+int rngc_validate(struct rngc *rc, xmlDocPtr doc) {
+    xmlNodePtr root = xmlDocGetRootElement(doc);
+    unsigned char used = 0;
+    struct rngc_elem e = {
+        .rc = rc, .nattrs = 0, .nchildren = 1,
+        .attrs = NULL, .children = &root, .used = &used
+    };
+
+    if (root == NULL)
+        return 0;
+    return rc->grammar->start(&e) && used;
+}
+
+bool rngc_element(struct rngc_elem *e, const char *name,
+                  rngc_pattern content) {
+    for (int i=0; i < e->nchildren; i++) {
+        xmlNodePtr child = e->children[i];
+
+        if (e->used[e->nattrs + i] || child->ns != NULL
+            || ! xmlStrEqual(child->name, BAD_CAST name))
+            continue;
+        if (check_element(e->rc, child, content)) {
+            e->used[e->nattrs + i] = 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool rngc_attribute(struct rngc_elem *e, const char *name, rngc_value value) {
+    for (int i=0; i < e->nattrs; i++) {
+        xmlAttrPtr attr = e->attrs[i];
+        xmlNodePtr text = attr->children;
+        bool matches;
+
+        if (e->used[i] || attr->ns != NULL
+            || ! xmlStrEqual(attr->name, BAD_CAST name))
+            continue;
+
+        if (value == NULL) {
+            matches = true;
+        } else if (text == NULL) {
+            matches = value(e->rc, "");
+        } else if (text->type == XML_TEXT_NODE && text->next == NULL) {
+            matches = value(e->rc, (const char *) text->content);
+        } else {
+            xmlChar *s = xmlNodeListGetString(attr->doc, text, 1);
+
+            matches = s != NULL && value(e->rc, (const char *) s);
+            xmlFree(s);
+        }
+        if (! matches)
+            return false;
+        e->used[i] = 1;
+        return true;
+    }
+    return false;
+}
+
+bool rngc_optional(struct rngc_elem *e, rngc_pattern p) {
+    unsigned char saved[NITEMS(e) + 1];
+
+    memcpy(saved, e->used, NITEMS(e));
+    if (! p(e))
+        memcpy(e->used, saved, NITEMS(e));
+    return true;
+}
+
+bool rngc_zero_or_more(struct rngc_elem *e, rngc_pattern p) {
+    unsigned char saved[NITEMS(e) + 1];
+
+    while (true) {
+        memcpy(saved, e->used, NITEMS(e));
+        if (! p(e)) {
+            memcpy(e->used, saved, NITEMS(e));
+            break;
+        }
+        /* Stop once P matches without consuming anything */
+        if (memcmp(saved, e->used, NITEMS(e)) == 0)
+            break;
+    }
+    return true;
+}
+
+bool rngc_one_or_more(struct rngc_elem *e, rngc_pattern p) {
+    if (! p(e))
+        return false;
+    return rngc_zero_or_more(e, p);
+}
+
+bool rngc_choice(struct rngc_elem *e, const rngc_pattern *alts) {
+    unsigned char saved[NITEMS(e) + 1];
+
+    memcpy(saved, e->used, NITEMS(e));
+    for (; *alts != NULL; alts++) {
+        if ((*alts)(e))
+            return true;
+        memcpy(e->used, saved, NITEMS(e));
+    }
+    return false;
+}
+
+/* Parse the lexical form of an unsignedInt. Leading '+' and whitespace
+ * are valid, too, but we let the interpreter deal with them */
+static bool parse_uint(const char *s, double *num) {
+    unsigned long long v = 0;
+
+    if (*s == '\0')
+        return false;
+    for (; *s != '\0'; s++) {
+        if (*s < '0' || *s > '9')
+            return false;
+        v = 10 * v + (*s - '0');
+        if (v > 4294967295ULL)
+            return false;
+    }
+    *num = v;
+    return true;
+}
+
+/* Parse simple decimal numbers like '-1', '2.' and '0.25' */
+static bool parse_double(const char *s, double *num) {
+    const char *p = s;
+    char *end;
+
+    if (*p == '-')
+        p++;
+    if (*p < '0' || *p > '9')
+        return false;
+    while (*p >= '0' && *p <= '9')
+        p++;
+    if (*p == '.')
+        for (p++; *p >= '0' && *p <= '9'; p++);
+    if (*p != '\0')
+        return false;
+    *num = strtod(s, &end);
+    return *end == '\0';
+}
+
+bool rngc_data(struct rngc *rc, unsigned int index, const char *value) {
+    const struct rngc_data *data = rc->grammar->data + index;
+    double num = 0;
+
+    switch (data->type) {
+    case RNGC_STRING:
+        break;
+    case RNGC_UNSIGNED_INT:
+        if (! parse_uint(value, &num))
+            return false;
+        break;
+    case RNGC_DOUBLE:
+        if (! parse_double(value, &num))
+            return false;
+        break;
+    default:
+        return false;
+    }
+    if (data->has_min && num < data->min)
+        return false;
+    if (data->has_max && num > data->max)
+        return false;
+    if (rc->regexps[index] != NULL
+        && xmlRegexpExec(rc->regexps[index], BAD_CAST value) != 1)
+        return false;
+    return true;
+}
+
+/* vim: set ts=4 sw=4 et: */
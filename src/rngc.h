@@ -0,0 +1,123 @@
+/*
+ * rngc.h: support for RelaxNG schemas compiled into C by rng2c
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+#ifndef RNGC_H_
+#define RNGC_H_
+
+#include <stdbool.h>
+#include <libxml/tree.h>
+
+/*
+ * rng2c turns every pattern of a schema into a function that checks
+ * whether the attributes and child elements of the element that is being
+ * validated match it. Patterns "consume" the attributes and children they
+ * match; an element is valid if its content pattern matches and all its
+ * attributes and children have been consumed.
+ *
+ * The generated code is meant as a fast path: it never accepts a document
+ * that the RelaxNG interpreter in libxml2 would reject, but it may reject
+ * documents that are valid, for example when they contain whitespace
+ * around a number. Callers should therefore run the interpreter on any
+ * document rejected here, if only to produce a useful error message.
+ */
+
+struct rngc;
+
+/* The attributes and child elements of the element being validated */
+struct rngc_elem {
+    struct rngc    *rc;
+    int             nattrs;
+    int             nchildren;
+    xmlAttrPtr     *attrs;
+    xmlNodePtr     *children;
+    unsigned char  *used;           /* NATTRS flags for the attributes,
+                                     * followed by NCHILDREN flags for the
+                                     * children */
+};
+
+typedef bool (*rngc_pattern)(struct rngc_elem *e);
+typedef bool (*rngc_value)(struct rngc *rc, const char *value);
+
+/* The XML Schema datatypes we support */
+typedef enum {
+    RNGC_STRING,
+    RNGC_UNSIGNED_INT,
+    RNGC_DOUBLE
+} rngc_type_t;
+
+struct rngc_data {
+    rngc_type_t     type;
+    const char     *pattern;        /* XML Schema regexp, or NULL */
+    bool            has_min;
+    double          min;            /* minInclusive */
+    bool            has_max;
+    double          max;            /* maxInclusive */
+};
+
+/* A schema as generated by rng2c */
+struct rngc_grammar {
+    int                     serial; /* v:serial of the start element */
+    rngc_pattern            start;
+    unsigned int            ndata;
+    const struct rngc_data *data;
+};
+
+/* The schema for <interface> elements, generated from interface.rng */
+extern const struct rngc_grammar rngc_interface;
+
+/* Prepare GRAMMAR for validation. Returns NULL if allocation or
+ * compiling one of its regexps fails */
+struct rngc *rngc_new(const struct rngc_grammar *grammar);
+
+void rngc_free(struct rngc *rc);
+
+/* Validate DOC. Returns 1 if the document is valid, and 0 if it is not,
+ * or if this validator can not tell */
+int rngc_validate(struct rngc *rc, xmlDocPtr doc);
+
+/*
+ * Functions used by the generated code
+ */
+
+/* Consume a child element NAME whose content matches CONTENT */
+bool rngc_element(struct rngc_elem *e, const char *name, rngc_pattern content);
+
+/* Consume the attribute NAME if its value matches VALUE; a NULL VALUE
+ * matches any text */
+bool rngc_attribute(struct rngc_elem *e, const char *name, rngc_value value);
+
+/* Match P if possible */
+bool rngc_optional(struct rngc_elem *e, rngc_pattern p);
+
+/* Match P as often as possible, at least once for rngc_one_or_more */
+bool rngc_zero_or_more(struct rngc_elem *e, rngc_pattern p);
+bool rngc_one_or_more(struct rngc_elem *e, rngc_pattern p);
+
+/* Match the first of the NULL-terminated list of ALTS that matches */
+bool rngc_choice(struct rngc_elem *e, const rngc_pattern *alts);
+
+/* Check that VALUE is a valid instance of the INDEX'th datatype in the
+ * grammar */
+bool rngc_data(struct rngc *rc, unsigned int index, const char *value);
+
+#endif
+
+/* vim: set ts=4 sw=4 et: */
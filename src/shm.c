@@ -0,0 +1,445 @@
+/*
+ * shm.c: the shared interface state table
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "safe-alloc.h"
+#include "shm.h"
+
+/* How often a reader looks at a sequence lock that stays odd before it
+ * decides that the publisher died in the middle of an update */
+#define SHM_SPIN_MAX (1 << 20)
+
+#define SHM_SIZE                                                        \
+    (SHM_SLOTS_OFFSET + (size_t) SHM_SLOTS * sizeof(struct shm_slot))
+
+static uint32_t shm_hash(const char *name) {
+    uint32_t h = 2166136261u;
+
+    for (int i=0; i < NETCF_SHM_NAME_MAX && name[i] != '\0'; i++) {
+        h ^= (unsigned char) name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/*
+ * Sequence locks
+ */
+static void seq_write_begin(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void seq_write_end(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+/* Wait for SEQ to be even and return it; return false if it doesn't get
+ * there */
+static bool seq_read_begin(const uint32_t *seq, uint32_t *start) {
+    for (int i=0; i < SHM_SPIN_MAX; i++) {
+        *start = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        if ((*start & 1) == 0)
+            return true;
+    }
+    return false;
+}
+
+/* Return true if what was read since SEQ was START must be read again */
+static bool seq_read_retry(const uint32_t *seq, uint32_t start) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(seq, __ATOMIC_RELAXED) != start;
+}
+
+/*
+ * Reading
+ */
+struct netcf_shm *ncf_shm_open(const char *path) {
+    struct netcf_shm *shm = NULL;
+    struct shm_header *hdr;
+    struct stat st;
+    void *map = MAP_FAILED;
+    int fd = -1;
+
+    if (path == NULL)
+        path = SHM_PATH;
+    fd = open(path, O_RDONLY|O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0)
+        goto error;
+    if ((size_t) st.st_size < SHM_SLOTS_OFFSET) {
+        errno = EPROTO;
+        goto error;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        goto error;
+    hdr = map;
+    if (hdr->magic != SHM_MAGIC || hdr->version != SHM_VERSION
+        || hdr->slot_size != sizeof(struct shm_slot)
+        || hdr->nslots == 0
+        || (size_t) st.st_size < SHM_SLOTS_OFFSET
+                                 + (size_t) hdr->nslots * hdr->slot_size) {
+        errno = EPROTO;
+        goto error;
+    }
+    if (ALLOC(shm) < 0) {
+        errno = ENOMEM;
+        goto error;
+    }
+    shm->fd = -1;
+    shm->size = st.st_size;
+    shm->hdr = hdr;
+    shm->slots = (struct shm_slot *) ((char *) map + SHM_SLOTS_OFFSET);
+    close(fd);
+    return shm;
+
+ error:
+    {
+        int saved = errno;
+        if (map != MAP_FAILED)
+            munmap(map, st.st_size);
+        if (fd >= 0)
+            close(fd);
+        errno = saved;
+    }
+    return NULL;
+}
+
+/* Copy the slot SLOT into ENTRY. Returns 1 if it is in use, 0 if it is
+ * free, and -1 if it stays locked */
+static int slot_read(const struct shm_slot *slot,
+                     struct netcf_shm_entry *entry) {
+    uint32_t start, used;
+
+    do {
+        if (!seq_read_begin(&slot->seq, &start))
+            return -1;
+        used = slot->used;
+        if (used && entry != NULL)
+            memcpy(entry, &slot->entry, sizeof(*entry));
+    } while (seq_read_retry(&slot->seq, start));
+    if (used && entry != NULL)
+        entry->name[NETCF_SHM_NAME_MAX - 1] = '\0';
+    return used ? 1 : 0;
+}
+
+/* Find the interface NAME and copy it to ENTRY. The caller makes sure
+ * that the layout of the table didn't change. Returns 0 if found, and -1
+ * if not */
+static int shm_probe(struct netcf_shm *shm, const char *name,
+                     struct netcf_shm_entry *entry) {
+    uint32_t nslots = shm->hdr->nslots;
+    uint32_t i = shm_hash(name) % nslots;
+
+    for (uint32_t n=0; n < nslots; n++, i = (i + 1) % nslots) {
+        const struct shm_slot *slot = shm->slots + i;
+
+        /* Names only change when the table is laid out anew */
+        if (!__atomic_load_n(&slot->used, __ATOMIC_RELAXED))
+            return -1;
+        if (strncmp(slot->entry.name, name, NETCF_SHM_NAME_MAX) != 0)
+            continue;
+        return slot_read(slot, entry) == 1 ? 0 : -1;
+    }
+    return -1;
+}
+
+int ncf_shm_lookup(struct netcf_shm *shm, const char *name,
+                   struct netcf_shm_entry *entry) {
+    uint32_t start;
+    int r;
+
+    if (shm == NULL || name == NULL)
+        return -1;
+    do {
+        if (!seq_read_begin(&shm->hdr->seq, &start))
+            return -1;
+        r = shm_probe(shm, name, entry);
+    } while (seq_read_retry(&shm->hdr->seq, start));
+    return r;
+}
+
+int ncf_shm_list(struct netcf_shm *shm, int maxentries,
+                 struct netcf_shm_entry *entries, unsigned int *truncated) {
+    uint32_t start, ndropped;
+    int n;
+
+    if (shm == NULL)
+        return -1;
+    do {
+        if (!seq_read_begin(&shm->hdr->seq, &start))
+            return -1;
+        n = 0;
+        for (uint32_t i=0; i < shm->hdr->nslots; i++) {
+            struct netcf_shm_entry *entry =
+                n < maxentries ? entries + n : NULL;
+            int r = slot_read(shm->slots + i, entry);
+
+            /* Don't pretend an entry we can't read isn't there */
+            if (r < 0)
+                return -1;
+            n += r;
+        }
+        ndropped = __atomic_load_n(&shm->hdr->ndropped, __ATOMIC_RELAXED);
+    } while (seq_read_retry(&shm->hdr->seq, start));
+    if (truncated != NULL)
+        *truncated = ndropped;
+    return n;
+}
+
+void ncf_shm_close(struct netcf_shm *shm) {
+    if (shm == NULL)
+        return;
+    munmap(shm->hdr, shm->size);
+    if (shm->fd >= 0)
+        close(shm->fd);
+    free(shm->path);
+    free(shm);
+}
+
+/*
+ * Publishing
+ */
+
+/* Check that FD holds a table we can publish to */
+static bool shm_usable(int fd) {
+    struct shm_header hdr;
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size != SHM_SIZE)
+        return false;
+    if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+        return false;
+    return hdr.magic == SHM_MAGIC && hdr.version == SHM_VERSION
+        && hdr.nslots == SHM_SLOTS
+        && hdr.slot_size == sizeof(struct shm_slot);
+}
+
+/* Put a new, empty table in place at PATH, and return a locked fd for
+ * it. Readers that still map an old file keep seeing that */
+static int shm_replace(const char *path) {
+    struct shm_header hdr;
+    char *tmp = NULL;
+    int fd = -1;
+
+    if (asprintf(&tmp, "%s.new", path) < 0) {
+        tmp = NULL;
+        errno = ENOMEM;
+        goto error;
+    }
+    fd = open(tmp, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+    if (fd < 0)
+        goto error;
+    /* Readers must be able to open the table whatever our umask */
+    if (fchmod(fd, 0644) < 0 || ftruncate(fd, SHM_SIZE) < 0)
+        goto error;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = SHM_MAGIC;
+    hdr.version = SHM_VERSION;
+    hdr.nslots = SHM_SLOTS;
+    hdr.slot_size = sizeof(struct shm_slot);
+    if (pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+        errno = EIO;
+        goto error;
+    }
+    if (flock(fd, LOCK_EX|LOCK_NB) < 0 || rename(tmp, path) < 0)
+        goto error;
+    free(tmp);
+    return fd;
+
+ error:
+    {
+        int saved = errno;
+        if (fd >= 0) {
+            unlink(tmp);
+            close(fd);
+        }
+        free(tmp);
+        errno = saved;
+    }
+    return -1;
+}
+
+static void slot_write(struct shm_slot *slot, uint32_t used,
+                       const struct netcf_shm_entry *entry) {
+    seq_write_begin(&slot->seq);
+    __atomic_store_n(&slot->used, used, __ATOMIC_RELAXED);
+    if (entry != NULL)
+        memcpy(&slot->entry, entry, sizeof(*entry));
+    else
+        memset(&slot->entry, 0, sizeof(slot->entry));
+    seq_write_end(&slot->seq);
+}
+
+/* A publisher that died in the middle of an update left an odd SEQ
+ * behind, which readers would wait on until they give up, and possibly a
+ * torn slot. Make all of them even again, and start over with an empty
+ * table, which shm_update fills in right away */
+static void shm_recover(struct netcf_shm *shm) {
+    bool torn = (shm->hdr->seq & 1) != 0;
+
+    for (int i=0; i < SHM_SLOTS && !torn; i++)
+        torn = (shm->slots[i].seq & 1) != 0;
+    if (!torn)
+        return;
+
+    if ((shm->hdr->seq & 1) == 0)
+        seq_write_begin(&shm->hdr->seq);
+    for (int i=0; i < SHM_SLOTS; i++) {
+        struct shm_slot *slot = shm->slots + i;
+
+        if (slot->seq & 1)
+            __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+        slot_write(slot, 0, NULL);
+    }
+    shm->hdr->nentries = 0;
+    shm->hdr->ndropped = 0;
+    seq_write_end(&shm->hdr->seq);
+}
+
+struct netcf_shm *shm_create(const char *path) {
+    struct netcf_shm *shm = NULL;
+    char *dir = NULL, *slash;
+    void *map = MAP_FAILED;
+    int fd = -1;
+
+    dir = strdup(path);
+    if (dir != NULL && (slash = strrchr(dir, '/')) != NULL && slash != dir) {
+        *slash = '\0';
+        mkdir(dir, 0755);
+    }
+    free(dir);
+
+    fd = open(path, O_RDWR|O_CLOEXEC);
+    if (fd >= 0) {
+        if (flock(fd, LOCK_EX|LOCK_NB) < 0) {
+            if (errno == EWOULDBLOCK)
+                errno = EBUSY;
+            goto error;
+        }
+        if (!shm_usable(fd)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        fd = shm_replace(path);
+        if (fd < 0)
+            goto error;
+    }
+
+    map = mmap(NULL, SHM_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        goto error;
+    if (ALLOC(shm) < 0 || (shm->path = strdup(path)) == NULL) {
+        errno = ENOMEM;
+        goto error;
+    }
+    shm->fd = fd;
+    shm->size = SHM_SIZE;
+    shm->hdr = map;
+    shm->slots = (struct shm_slot *) ((char *) map + SHM_SLOTS_OFFSET);
+    shm_recover(shm);
+    return shm;
+
+ error:
+    {
+        int saved = errno;
+        if (map != MAP_FAILED)
+            munmap(map, SHM_SIZE);
+        if (fd >= 0)
+            close(fd);
+        free(shm);
+        errno = saved;
+    }
+    return NULL;
+}
+
+/* The slot that holds NAME, or -1 */
+static int shm_find(struct netcf_shm *shm, const char *name) {
+    uint32_t i = shm_hash(name) % SHM_SLOTS;
+
+    for (int n=0; n < SHM_SLOTS; n++, i = (i + 1) % SHM_SLOTS) {
+        if (!shm->slots[i].used)
+            return -1;
+        if (strncmp(shm->slots[i].entry.name, name, NETCF_SHM_NAME_MAX) == 0)
+            return i;
+    }
+    return -1;
+}
+
+void shm_update(struct netcf_shm *shm, const struct netcf_shm_entry *entries,
+                int n) {
+    int where[SHM_MAX_ENTRIES];
+    uint32_t ndropped = 0;
+    bool moved;
+
+    if (n > SHM_MAX_ENTRIES) {
+        ndropped = n - SHM_MAX_ENTRIES;
+        n = SHM_MAX_ENTRIES;
+    }
+    __atomic_store_n(&shm->hdr->ndropped, ndropped, __ATOMIC_RELAXED);
+
+    /* In the common case, the same interfaces are still there, and only
+     * the entries that changed need to be rewritten */
+    moved = (uint32_t) n != shm->hdr->nentries;
+    for (int i=0; i < n && !moved; i++) {
+        where[i] = shm_find(shm, entries[i].name);
+        moved = where[i] < 0;
+    }
+    if (!moved) {
+        for (int i=0; i < n; i++) {
+            struct shm_slot *slot = shm->slots + where[i];
+            if (memcmp(&slot->entry, entries + i, sizeof(entries[i])) != 0)
+                slot_write(slot, 1, entries + i);
+        }
+        return;
+    }
+
+    seq_write_begin(&shm->hdr->seq);
+    for (int i=0; i < SHM_SLOTS; i++) {
+        if (shm->slots[i].used)
+            slot_write(shm->slots + i, 0, NULL);
+    }
+    for (int i=0; i < n; i++) {
+        uint32_t s = shm_hash(entries[i].name) % SHM_SLOTS;
+
+        while (shm->slots[s].used)
+            s = (s + 1) % SHM_SLOTS;
+        slot_write(shm->slots + s, 1, entries + i);
+    }
+    shm->hdr->nentries = n;
+    seq_write_end(&shm->hdr->seq);
+}
+
+/* vim: set ts=4 sw=4 et: */
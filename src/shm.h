@@ -0,0 +1,98 @@
+/*
+ * shm.h: the layout of the shared interface state table
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+#ifndef SHM_H_
+#define SHM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "configmake.h"
+#include "netcf.h"
+
+/*
+ * The file starts with a struct shm_header, padded to SHM_SLOTS_OFFSET
+ * bytes, followed by NSLOTS struct shm_slot. Interfaces are placed in the
+ * slots by the hash of their name, with linear probing, and the table is
+ * never more than half full, so that lookups stay short. The publisher
+ * leaves out interfaces beyond SHM_MAX_ENTRIES, and says how many in
+ * NDROPPED.
+ *
+ * There are two levels of sequence locks. The publisher bumps the SEQ of
+ * a slot to an odd number before it changes the slot, and to the next
+ * even number when it is done; readers copy the slot and start over if
+ * its SEQ was odd or changed while they copied. When interfaces appear or
+ * disappear, the publisher lays out the whole table anew, and does that
+ * under the SEQ of the header, so that lookups never miss an interface
+ * that moved to another slot.
+ */
+
+#define SHM_PATH LOCALSTATEDIR "/run/netcf/state"
+
+#define SHM_MAGIC 0x5346434e              /* "NCFS" */
+#define SHM_VERSION 2
+#define SHM_MAX_ENTRIES NETCF_SHM_MAX_ENTRIES
+#define SHM_SLOTS (2 * SHM_MAX_ENTRIES)
+#define SHM_SLOTS_OFFSET 64
+
+struct shm_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nslots;
+    uint32_t slot_size;                   /* sizeof(struct shm_slot) */
+    uint32_t seq;                         /* Odd while the publisher lays
+                                           * out the table */
+    uint32_t nentries;
+    uint32_t ndropped;                    /* Interfaces that did not fit */
+};
+
+struct shm_slot {
+    uint32_t seq;                         /* Odd while the publisher
+                                           * writes to the slot */
+    uint32_t used;
+    struct netcf_shm_entry entry;
+};
+
+/* A mapped table, for reading or, if FD is not -1, for publishing */
+struct netcf_shm {
+    char              *path;
+    int                fd;                /* Locked by the publisher */
+    size_t             size;
+    struct shm_header *hdr;
+    struct shm_slot   *slots;
+};
+
+/* Map the table in PATH for publishing, creating it if it does not exist
+ * or has the wrong layout. Only one process can publish to a table at a
+ * time. Returns NULL with errno set on error; errno is EBUSY if another
+ * process publishes to PATH */
+struct netcf_shm *shm_create(const char *path);
+
+/* Publish the N interfaces in ENTRIES, which must be zeroed apart from
+ * the fields that are set, so that unchanged entries can be recognized.
+ * Only the first SHM_MAX_ENTRIES interfaces are published, and the
+ * number of the others is recorded in the header */
+void shm_update(struct netcf_shm *shm, const struct netcf_shm_entry *entries,
+                int n);
+
+#endif
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,118 @@
+/*
+ * bench-exec.c: measure how long it takes netcf to run a program
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+/*
+ * Usage: bench-exec [MEGABYTES...]
+ *
+ * For each size, grow the process by that many megabytes of touched
+ * memory, open as many file descriptors as the soft limit allows, and
+ * time how long ncf_run_program takes to run /bin/true. With a launcher
+ * based on fork(), the time grows with the size of the process and the
+ * file descriptor limit; it should stay flat otherwise.
+ */
+
+#include <config.h>
+#include "netcf.h"
+#include "internal.h"
+#include "safe-alloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#define ITERATIONS 200
+#define MAX_FDS 1024
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die(const char *msg) {
+    fprintf(stderr, "bench-exec: %s\n", msg);
+    exit(EXIT_FAILURE);
+}
+
+/* Raise the file descriptor limit as far as we are allowed to, and open a
+ * few descriptors so that the child has something to close */
+static void open_fds(void) {
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+        getrlimit(RLIMIT_NOFILE, &rl);
+        printf("RLIMIT_NOFILE: %llu\n", (unsigned long long) rl.rlim_cur);
+    }
+    for (int i=0; i < MAX_FDS; i++) {
+        if (open("/dev/null", O_RDONLY) < 0)
+            break;
+    }
+}
+
+int main(int argc, char **argv) {
+    static const char *const true_argv[] = { "true", NULL };
+    struct netcf *ncf = NULL;
+    size_t total = 0;
+
+    if (getenv("NETCF_DATADIR") == NULL)
+        setenv("NETCF_DATADIR", "../data", 1);
+    if (ncf_init(&ncf, "/") < 0)
+        die("ncf_init failed");
+    open_fds();
+
+    printf("%10s %12s\n", "RSS (MB)", "usec/run");
+    for (int i = (argc > 1) ? 1 : 0; i < argc; i++) {
+        size_t size = (argc > 1) ? strtoul(argv[i], NULL, 10) : 0;
+        double start, elapsed;
+
+        /* Leak the memory on purpose so that the process keeps growing */
+        if (size > 0) {
+            char *grown = malloc(size << 20);
+            if (grown == NULL)
+                die("allocation failed");
+            memset(grown, 1, size << 20);
+            total += size;
+        }
+
+        start = now();
+        for (int j=0; j < ITERATIONS; j++) {
+            if (ncf_run_program(ncf, true_argv, NULL) < 0) {
+                const char *errmsg, *details;
+                ncf_error(ncf, &errmsg, &details);
+                die(details != NULL ? details : errmsg);
+            }
+        }
+        elapsed = now() - start;
+        printf("%10zu %12.1f\n", total, elapsed * 1e6 / ITERATIONS);
+    }
+
+    ncf_close(ncf);
+    return 0;
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,716 @@
+/*
+ * netcf-bench.c: measure how netcf scales with the number of interfaces
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+/*
+ * Usage: netcf-bench [-g|-l] -d DRIVER -o DIR [N...]
+ *
+ * For each N (10, 100, 1000 and 10000 by default), generate a filesystem
+ * root in DIR/DRIVER-N with N interface topologies in the format of
+ * DRIVER (redhat, debian or suse), and time the main netcf calls against
+ * it. The topologies cycle through a plain ethernet interface, a bridge
+ * with one port, an active-backup bond with two slaves and a VLAN on an
+ * ethernet interface. Bonds get a bonding alias in etc/modprobe.d, and
+ * every device an address file in a fake sys/class/net.
+ *
+ * netcf has to be built with DRIVER, since the driver is chosen at
+ * configure time; 'make bench' takes care of that. With -g, only the
+ * filesystem roots are generated.
+ *
+ * With -l, the devices of the topologies are also created, as veth
+ * pairs, bridges, bonds and VLANs, in a user and network namespace of
+ * their own for each N, and the calls that look at the live state of
+ * interfaces are timed, too. Kinds of devices the kernel can not create
+ * in the namespace are left out.
+ *
+ * Results go to stdout, one line per N and operation, with tab-separated
+ * fields: driver, N, operation, number of calls, and the total, minimum
+ * and maximum time per call in nanoseconds.
+ */
+
+#include <config.h>
+#include "netcf.h"
+#include "internal.h"
+#include "safe-alloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "netns.h"
+
+/* How many times to repeat the operations that touch all interfaces, and
+ * how many interfaces to use for the ones that work on one */
+#define LIST_REPEAT 5
+#define INIT_REPEAT 5
+#define SAMPLE_MAX 100
+#define DEFINE_REPEAT 10
+
+enum topology {
+    TOPO_ETHERNET,
+    TOPO_BRIDGE,
+    TOPO_BOND,
+    TOPO_VLAN,
+    TOPO_LAST
+};
+
+struct timing {
+    const char        *op;
+    unsigned long long calls;
+    unsigned long long total;
+    unsigned long long min;
+    unsigned long long max;
+};
+
+static const char *driver = NULL;
+static bool live = false;
+
+static void die(const char *format, ...) {
+    va_list args;
+
+    fprintf(stderr, "netcf-bench: ");
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    exit(EXIT_FAILURE);
+}
+
+static void die_ncf(struct netcf *ncf, const char *what) {
+    const char *errmsg, *details;
+
+    ncf_error(ncf, &errmsg, &details);
+    die("%s failed: %s%s%s", what, errmsg,
+        details != NULL ? ": " : "", details != NULL ? details : "");
+}
+
+static unsigned long long now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Generating filesystem roots
+ */
+
+static void mkdir_p(const char *path) {
+    char *p, *dir = strdup(path);
+
+    if (dir == NULL)
+        die("allocation failed");
+    for (p = strchr(dir + 1, '/'); ; p = strchr(p + 1, '/')) {
+        if (p != NULL)
+            *p = '\0';
+        if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+            die("mkdir %s: %s", dir, strerror(errno));
+        if (p == NULL)
+            break;
+        *p = '/';
+    }
+    free(dir);
+}
+
+static FILE *create(const char *root, const char *format, ...) {
+    char *rel = NULL, *path = NULL;
+    va_list args;
+    FILE *fp;
+    int r;
+
+    va_start(args, format);
+    r = vasprintf(&rel, format, args);
+    va_end(args);
+    if (r < 0 || asprintf(&path, "%s/%s", root, rel) < 0)
+        die("allocation failed");
+    fp = fopen(path, "w");
+    if (fp == NULL)
+        die("can not create %s: %s", path, strerror(errno));
+    free(rel);
+    free(path);
+    return fp;
+}
+
+static void finish(FILE *fp) {
+    if (ferror(fp) || fclose(fp) != 0)
+        die("write failed: %s", strerror(errno));
+}
+
+/* The MAC address of the first (SLAVE == 0) or second device of
+ * topology I */
+static void topo_mac(int i, int slave, char *buf, size_t size) {
+    snprintf(buf, size, "52:54:%02x:%02x:%02x:%02x",
+             slave, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+}
+
+/* The name of the toplevel interface of topology I */
+static void topo_name(int i, char *buf, size_t size) {
+    switch (i % TOPO_LAST) {
+    case TOPO_BRIDGE:
+        snprintf(buf, size, "br%d", i);
+        break;
+    case TOPO_BOND:
+        snprintf(buf, size, "bond%d", i);
+        break;
+    case TOPO_VLAN:
+        snprintf(buf, size, "eth%d.42", i);
+        break;
+    default:
+        snprintf(buf, size, "eth%d", i);
+        break;
+    }
+}
+
+static void sysfs_address(const char *root, const char *dev,
+                          const char *mac) {
+    char *path = NULL;
+    FILE *fp;
+
+    if (asprintf(&path, "%s/sys/class/net/%s", root, dev) < 0)
+        die("allocation failed");
+    mkdir_p(path);
+    free(path);
+    fp = create(root, "sys/class/net/%s/address", dev);
+    fprintf(fp, "%s\n", mac);
+    finish(fp);
+}
+
+/* Red Hat and SUSE keep one ifcfg file per device, with mostly the same
+ * keys for our purposes; they differ in how bridges, bonds and VLANs
+ * are tied together */
+static void gen_ifcfg(const char *root, bool suse, int i,
+                      const char *mac, const char *mac2) {
+    const char *dir = suse ? "etc/sysconfig/network"
+                           : "etc/sysconfig/network-scripts";
+    const char *onboot = suse ? "STARTMODE=auto" : "ONBOOT=yes";
+    FILE *fp;
+
+    switch (i % TOPO_LAST) {
+    case TOPO_ETHERNET:
+        fp = create(root, "%s/ifcfg-eth%d", dir, i);
+        fprintf(fp, "DEVICE=eth%d\nHWADDR=%s\n%s\nBOOTPROTO=dhcp\n",
+                i, mac, onboot);
+        finish(fp);
+        break;
+    case TOPO_BRIDGE:
+        fp = create(root, "%s/ifcfg-br%d", dir, i);
+        fprintf(fp, "DEVICE=br%d\n%s\nBOOTPROTO=static\n"
+                "IPADDR=10.%d.%d.1\nNETMASK=255.255.255.0\n",
+                i, onboot, (i >> 8) & 0xff, i & 0xff);
+        if (suse)
+            fprintf(fp, "BRIDGE=yes\nBRIDGE_PORTS=eth%d\n", i);
+        else
+            fprintf(fp, "TYPE=Bridge\nDELAY=0\n");
+        finish(fp);
+        fp = create(root, "%s/ifcfg-eth%d", dir, i);
+        fprintf(fp, "DEVICE=eth%d\nHWADDR=%s\n%s\n", i, mac, onboot);
+        if (!suse)
+            fprintf(fp, "BRIDGE=br%d\n", i);
+        finish(fp);
+        break;
+    case TOPO_BOND:
+        fp = create(root, "%s/ifcfg-bond%d", dir, i);
+        fprintf(fp, "DEVICE=bond%d\n%s\nBOOTPROTO=static\n"
+                "IPADDR=10.%d.%d.1\nNETMASK=255.255.255.0\n"
+                "BONDING_OPTS='mode=active-backup miimon=100'\n",
+                i, onboot, (i >> 8) & 0xff, i & 0xff);
+        if (suse)
+            fprintf(fp, "BONDING_MASTER=yes\n"
+                    "BONDING_SLAVE_0=eth%d\nBONDING_SLAVE_1=eth%ds\n", i, i);
+        finish(fp);
+        for (int s=0; s < 2; s++) {
+            fp = create(root, "%s/ifcfg-eth%d%s", dir, i, s ? "s" : "");
+            fprintf(fp, "DEVICE=eth%d%s\nHWADDR=%s\n%s\nBOOTPROTO=none\n",
+                    i, s ? "s" : "", s ? mac2 : mac,
+                    suse ? "STARTMODE=hotplug" : onboot);
+            if (!suse)
+                fprintf(fp, "MASTER=bond%d\nSLAVE=yes\n", i);
+            finish(fp);
+        }
+        break;
+    case TOPO_VLAN:
+        fp = create(root, "%s/ifcfg-eth%d", dir, i);
+        fprintf(fp, "DEVICE=eth%d\nHWADDR=%s\n%s\nBOOTPROTO=none\n",
+                i, mac, onboot);
+        finish(fp);
+        fp = create(root, "%s/ifcfg-eth%d.42", dir, i);
+        fprintf(fp, "DEVICE=eth%d.42\n%s\nBOOTPROTO=dhcp\n", i, onboot);
+        if (suse)
+            fprintf(fp, "ETHERDEVICE=eth%d\n", i);
+        else
+            fprintf(fp, "VLAN=yes\n");
+        finish(fp);
+        break;
+    }
+}
+
+/* Debian has all interfaces in one file */
+static void gen_debian(FILE *fp, int i, const char *mac) {
+    switch (i % TOPO_LAST) {
+    case TOPO_ETHERNET:
+        fprintf(fp, "auto eth%d\niface eth%d inet dhcp\n"
+                "        hwaddress ether %s\n\n", i, i, mac);
+        break;
+    case TOPO_BRIDGE:
+        fprintf(fp, "auto br%d\niface br%d inet static\n"
+                "        address 10.%d.%d.1\n"
+                "        netmask 255.255.255.0\n"
+                "        bridge_ports eth%d\n"
+                "        bridge_maxwait 0\n\n",
+                i, i, (i >> 8) & 0xff, i & 0xff, i);
+        break;
+    case TOPO_BOND:
+        fprintf(fp, "auto bond%d\niface bond%d inet static\n"
+                "        address 10.%d.%d.1\n"
+                "        netmask 255.255.255.0\n"
+                "        bond_slaves eth%d eth%ds\n"
+                "        bond_mode active-backup\n"
+                "        bond_miimon 100\n\n",
+                i, i, (i >> 8) & 0xff, i & 0xff, i, i);
+        break;
+    case TOPO_VLAN:
+        fprintf(fp, "auto eth%d.42\niface eth%d.42 inet dhcp\n"
+                "        vlan_raw_device eth%d\n\n", i, i, i);
+        break;
+    }
+}
+
+static void generate(const char *root, int n) {
+    char *path = NULL;
+    FILE *interfaces = NULL, *modprobe;
+
+    if (STREQ(driver, "debian")) {
+        if (asprintf(&path, "%s/etc/network", root) < 0)
+            die("allocation failed");
+    } else if (STREQ(driver, "suse")) {
+        if (asprintf(&path, "%s/etc/sysconfig/network", root) < 0)
+            die("allocation failed");
+    } else {
+        if (asprintf(&path, "%s/etc/sysconfig/network-scripts", root) < 0)
+            die("allocation failed");
+    }
+    mkdir_p(path);
+    FREE(path);
+    if (asprintf(&path, "%s/etc/modprobe.d", root) < 0)
+        die("allocation failed");
+    mkdir_p(path);
+    FREE(path);
+
+    if (STREQ(driver, "debian")) {
+        interfaces = create(root, "etc/network/interfaces");
+        fprintf(interfaces, "auto lo\niface lo inet loopback\n\n");
+    }
+    modprobe = create(root, "etc/modprobe.d/netcf.conf");
+
+    for (int i=0; i < n; i++) {
+        char mac[32], mac2[32], dev[32];
+
+        topo_mac(i, 0, mac, sizeof(mac));
+        topo_mac(i, 1, mac2, sizeof(mac2));
+        if (interfaces != NULL)
+            gen_debian(interfaces, i, mac);
+        else
+            gen_ifcfg(root, STREQ(driver, "suse"), i, mac, mac2);
+
+        if (i % TOPO_LAST == TOPO_BOND) {
+            fprintf(modprobe, "alias bond%d bonding\n", i);
+            snprintf(dev, sizeof(dev), "bond%d", i);
+            sysfs_address(root, dev, mac);
+            snprintf(dev, sizeof(dev), "eth%ds", i);
+            sysfs_address(root, dev, mac2);
+        } else if (i % TOPO_LAST == TOPO_BRIDGE) {
+            snprintf(dev, sizeof(dev), "br%d", i);
+            sysfs_address(root, dev, mac);
+        }
+        snprintf(dev, sizeof(dev), "eth%d", i);
+        sysfs_address(root, dev, mac);
+    }
+
+    finish(modprobe);
+    if (interfaces != NULL)
+        finish(interfaces);
+}
+
+/* Write the commands that create the devices of N topologies to
+ * ROOT/topology for netns_setup, with one paragraph for each kind of
+ * topology */
+static void generate_devices(const char *root, int n) {
+    FILE *fp = create(root, "topology");
+
+    for (int kind=0; kind < TOPO_LAST; kind++) {
+        for (int i=kind; i < n; i += TOPO_LAST) {
+            int a = (i >> 8) & 0xff, b = i & 0xff;
+
+            switch (kind) {
+            case TOPO_ETHERNET:
+                fprintf(fp, "link add eth%d type veth peer name eth%dp\n"
+                        "link set eth%d up\n", i, i, i);
+                break;
+            case TOPO_BRIDGE:
+                fprintf(fp, "link add br%d type bridge\n"
+                        "link add eth%d type veth peer name eth%dp\n"
+                        "link set eth%d master br%d\n"
+                        "link set eth%d up\n"
+                        "link set br%d up\n"
+                        "address add 10.%d.%d.1/24 dev br%d\n",
+                        i, i, i, i, i, i, i, a, b, i);
+                break;
+            case TOPO_BOND:
+                fprintf(fp, "link add bond%d type bond mode active-backup\n"
+                        "link add eth%d type veth peer name eth%dp\n"
+                        "link add eth%ds type veth peer name eth%dsp\n"
+                        "link set eth%d master bond%d\n"
+                        "link set eth%ds master bond%d\n"
+                        "link set bond%d up\n"
+                        "address add 10.%d.%d.1/24 dev bond%d\n",
+                        i, i, i, i, i, i, i, i, i, i, a, b, i);
+                break;
+            case TOPO_VLAN:
+                fprintf(fp, "link add eth%d type veth peer name eth%dp\n"
+                        "link set eth%d up\n"
+                        "link add link eth%d name eth%d.42 type vlan id 42\n"
+                        "link set eth%d.42 up\n",
+                        i, i, i, i, i, i);
+                break;
+            }
+        }
+        fprintf(fp, "\n");
+    }
+    finish(fp);
+}
+
+/*
+ * Timing
+ */
+
+static void timing_add(struct timing *t, unsigned long long start) {
+    unsigned long long ns = now() - start;
+
+    if (t->calls == 0 || ns < t->min)
+        t->min = ns;
+    if (ns > t->max)
+        t->max = ns;
+    t->total += ns;
+    t->calls += 1;
+}
+
+static void report(int n, const struct timing *t) {
+    printf("%s\t%d\t%s\t%llu\t%llu\t%llu\t%llu\n", driver, n, t->op,
+           t->calls, t->total, t->min, t->max);
+    fflush(stdout);
+}
+
+static void bench_init(const char *root, int n) {
+    struct timing t = { .op = "init" };
+
+    for (int r=0; r < INIT_REPEAT; r++) {
+        struct netcf *ncf = NULL;
+        unsigned long long start = now();
+
+        if (ncf_init_flags(&ncf, root, NETCF_INIT_LOCAL) < 0)
+            die_ncf(ncf, "ncf_init");
+        timing_add(&t, start);
+        ncf_close(ncf);
+    }
+    report(n, &t);
+}
+
+static void bench_list(struct netcf *ncf, int n, const char *op,
+                       unsigned int flags) {
+    struct timing t = { .op = op };
+
+    for (int r=0; r < LIST_REPEAT; r++) {
+        unsigned long long start = now();
+        char **names = NULL;
+        int nint;
+
+        nint = ncf_num_of_interfaces(ncf, flags);
+        if (nint < 0)
+            die_ncf(ncf, "ncf_num_of_interfaces");
+        if (ALLOC_N(names, nint) < 0)
+            die("allocation failed");
+        nint = ncf_list_interfaces(ncf, nint, names, flags);
+        if (nint < 0)
+            die_ncf(ncf, "ncf_list_interfaces");
+        timing_add(&t, start);
+        for (int i=0; i < nint; i++)
+            free(names[i]);
+        free(names);
+    }
+    report(n, &t);
+}
+
+/* Look up, by name and by MAC address, and describe up to SAMPLE_MAX
+ * interfaces spread over all of them */
+static void bench_lookup(struct netcf *ncf, int n) {
+    struct timing by_name = { .op = "lookup-name" };
+    struct timing by_mac = { .op = "lookup-mac" };
+    struct timing desc = { .op = "xml-desc" };
+    int step = n > SAMPLE_MAX ? n / SAMPLE_MAX : 1;
+
+    for (int i=0; i < n; i += step) {
+        struct netcf_if *nif;
+        unsigned long long start;
+        char name[32], mac[32];
+        char *xml;
+
+        topo_name(i, name, sizeof(name));
+        start = now();
+        nif = ncf_lookup_by_name(ncf, name);
+        if (nif == NULL)
+            die_ncf(ncf, "ncf_lookup_by_name");
+        timing_add(&by_name, start);
+
+        start = now();
+        xml = ncf_if_xml_desc(nif);
+        if (xml == NULL)
+            die_ncf(ncf, "ncf_if_xml_desc");
+        timing_add(&desc, start);
+        free(xml);
+        ncf_if_free(nif);
+
+        if (i % TOPO_LAST != TOPO_ETHERNET)
+            continue;
+        topo_mac(i, 0, mac, sizeof(mac));
+        start = now();
+        if (ncf_lookup_by_mac_string(ncf, mac, 1, &nif) < 0)
+            die_ncf(ncf, "ncf_lookup_by_mac_string");
+        timing_add(&by_mac, start);
+        ncf_if_free(nif);
+    }
+    report(n, &by_name);
+    report(n, &by_mac);
+    report(n, &desc);
+}
+
+static void bench_define(struct netcf *ncf, int n) {
+    static const char *const xml =
+        "<interface type='ethernet' name='ethbench'>"
+        "  <start mode='onboot'/>"
+        "  <mac address='52:54:ff:00:00:01'/>"
+        "  <protocol family='ipv4'><dhcp/></protocol>"
+        "</interface>";
+    struct timing def = { .op = "define" };
+    struct timing undef = { .op = "undefine" };
+
+    for (int r=0; r < DEFINE_REPEAT; r++) {
+        struct netcf_if *nif;
+        unsigned long long start = now();
+
+        nif = ncf_define(ncf, xml);
+        if (nif == NULL)
+            die_ncf(ncf, "ncf_define");
+        timing_add(&def, start);
+
+        start = now();
+        if (ncf_if_undefine(nif) < 0)
+            die_ncf(ncf, "ncf_if_undefine");
+        timing_add(&undef, start);
+        ncf_if_free(nif);
+    }
+    report(n, &def);
+    report(n, &undef);
+}
+
+/* Time the calls that look at the live devices: the status and the
+ * state XML of up to SAMPLE_MAX interfaces, and publishing the state of
+ * all of them with ncf_shm_publish */
+static void bench_state(struct netcf *ncf, const char *root, int n) {
+    struct timing status = { .op = "if-status" };
+    struct timing state = { .op = "xml-state" };
+    struct timing publish = { .op = "shm-publish" };
+    int step = n > SAMPLE_MAX ? n / SAMPLE_MAX : 1;
+    char *path = NULL;
+
+    for (int i=0; i < n; i += step) {
+        struct netcf_if *nif;
+        unsigned long long start;
+        unsigned int flags;
+        char name[32];
+        char *xml;
+
+        topo_name(i, name, sizeof(name));
+        nif = ncf_lookup_by_name(ncf, name);
+        if (nif == NULL)
+            die_ncf(ncf, "ncf_lookup_by_name");
+
+        start = now();
+        if (ncf_if_status(nif, &flags) < 0)
+            die_ncf(ncf, "ncf_if_status");
+        timing_add(&status, start);
+
+        start = now();
+        xml = ncf_if_xml_state(nif);
+        if (xml == NULL)
+            die_ncf(ncf, "ncf_if_xml_state");
+        timing_add(&state, start);
+        free(xml);
+        ncf_if_free(nif);
+    }
+
+    if (asprintf(&path, "%s/netcf-state", root) < 0)
+        die("allocation failed");
+    for (int r=0; r < LIST_REPEAT; r++) {
+        unsigned long long start = now();
+
+        if (ncf_shm_publish(ncf, path) < 0)
+            die_ncf(ncf, "ncf_shm_publish");
+        timing_add(&publish, start);
+    }
+    free(path);
+
+    report(n, &status);
+    report(n, &state);
+    report(n, &publish);
+}
+
+static void bench(const char *root, int n) {
+    struct netcf *ncf = NULL;
+
+    bench_init(root, n);
+    if (ncf_init_flags(&ncf, root, NETCF_INIT_LOCAL) < 0)
+        die_ncf(ncf, "ncf_init");
+    bench_list(ncf, n, "list-active", NETCF_IFACE_ACTIVE);
+    bench_list(ncf, n, "list-inactive", NETCF_IFACE_INACTIVE);
+    bench_list(ncf, n, "list-all",
+               NETCF_IFACE_ACTIVE|NETCF_IFACE_INACTIVE);
+    bench_lookup(ncf, n);
+    if (live)
+        bench_state(ncf, root, n);
+    bench_define(ncf, n);
+    ncf_close(ncf);
+}
+
+/* Each N gets a namespace of its own, since the topologies of different
+ * sizes use the same device names */
+static void bench_live(const char *root, int n) {
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0)
+        die("fork failed: %s", strerror(errno));
+    if (pid == 0) {
+        char *path = NULL;
+
+        if (netns_enter() < 0)
+            _exit(EXIT_SKIP);
+        generate_devices(root, n);
+        if (asprintf(&path, "%s/topology", root) < 0)
+            die("allocation failed");
+        if (netns_setup(path) < 0)
+            _exit(EXIT_SKIP);
+        free(path);
+        bench(root, n);
+        fflush(stdout);
+        _exit(EXIT_SUCCESS);
+    }
+
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR)
+            die("waitpid failed: %s", strerror(errno));
+    }
+    if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SKIP)
+        die("can not create devices in a network namespace");
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        exit(EXIT_FAILURE);
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: netcf-bench [-g|-l] -d DRIVER -o DIR [N...]\n"
+            "Generate filesystem roots with N interfaces in DIR and time\n"
+            "netcf calls against them. With -g, only generate them; with\n"
+            "-l, also create the devices in a network namespace.\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+    static const int default_sizes[] = { 10, 100, 1000, 10000 };
+    const char *outdir = NULL;
+    bool generate_only = false;
+    int *sizes = NULL;
+    int nsizes, c;
+
+    while ((c = getopt(argc, argv, "d:glo:h")) != -1) {
+        switch (c) {
+        case 'd':
+            driver = optarg;
+            break;
+        case 'g':
+            generate_only = true;
+            break;
+        case 'l':
+            live = true;
+            break;
+        case 'o':
+            outdir = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (driver == NULL || outdir == NULL || (generate_only && live))
+        usage();
+    if (STRNEQ(driver, "redhat") && STRNEQ(driver, "debian")
+        && STRNEQ(driver, "suse"))
+        die("unknown driver %s", driver);
+
+    nsizes = argc - optind;
+    if (nsizes == 0)
+        nsizes = ARRAY_CARDINALITY(default_sizes);
+    if (ALLOC_N(sizes, nsizes) < 0)
+        die("allocation failed");
+    for (int i=0; i < nsizes; i++) {
+        sizes[i] = (optind < argc) ? atoi(argv[optind + i])
+                                   : default_sizes[i];
+        if (sizes[i] <= 0)
+            die("invalid size %s", argv[optind + i]);
+    }
+
+    if (getenv("NETCF_DATADIR") == NULL)
+        setenv("NETCF_DATADIR", "../data", 1);
+    if (!generate_only)
+        printf("# driver\tn\top\tcalls\ttotal_ns\tmin_ns\tmax_ns\n");
+    for (int i=0; i < nsizes; i++) {
+        char *root = NULL;
+
+        if (asprintf(&root, "%s/%s-%d", outdir, driver, sizes[i]) < 0)
+            die("allocation failed");
+        mkdir_p(root);
+        generate(root, sizes[i]);
+        if (live)
+            bench_live(root, sizes[i]);
+        else if (!generate_only)
+            bench(root, sizes[i]);
+        free(root);
+    }
+    free(sizes);
+    return 0;
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,174 @@
+/*
+ * netns.c: run tests against real network devices without privileges
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/wait.h>
+
+#include "netns.h"
+
+extern char **environ;
+
+static int write_proc(const char *path, const char *text) {
+    int fd, r;
+
+    fd = open(path, O_WRONLY);
+    if (fd < 0)
+        return -1;
+    r = write(fd, text, strlen(text));
+    close(fd);
+    return r < 0 ? -1 : 0;
+}
+
+int netns_enter(void) {
+    uid_t uid = geteuid();
+    gid_t gid = getegid();
+    char map[64];
+
+    if (unshare(CLONE_NEWUSER|CLONE_NEWNET|CLONE_NEWNS) < 0) {
+        /* Some systems turn off unprivileged user namespaces; root can
+         * still get a network namespace of its own */
+        if (uid != 0 || unshare(CLONE_NEWNET|CLONE_NEWNS) < 0)
+            return -1;
+    } else {
+        /* Become root in the new namespace, which gives us CAP_NET_ADMIN
+         * over its network devices. Kernels before 3.19 have no
+         * setgroups file */
+        if (write_proc("/proc/self/setgroups", "deny") < 0
+            && errno != ENOENT)
+            return -1;
+        snprintf(map, sizeof(map), "0 %lu 1", (unsigned long) uid);
+        if (write_proc("/proc/self/uid_map", map) < 0)
+            return -1;
+        snprintf(map, sizeof(map), "0 %lu 1", (unsigned long) gid);
+        if (write_proc("/proc/self/gid_map", map) < 0)
+            return -1;
+    }
+
+    /* netcf looks at bridges, bonds and link state in /sys/class/net,
+     * which shows the devices of the namespace sysfs was mounted in */
+    if (mount(NULL, "/", NULL, MS_REC|MS_PRIVATE, NULL) < 0)
+        return -1;
+    if (mount("sysfs", "/sys", "sysfs", 0, NULL) < 0)
+        return -1;
+    return 0;
+}
+
+/* Run the commands CMDS with one 'ip -batch' */
+static int run_batch(const char *cmds, size_t len) {
+    const char *const argv[] = { "ip", "-force", "-batch", "-", NULL };
+    posix_spawn_file_actions_t actions;
+    int fds[2];
+    pid_t pid;
+    int r, status;
+
+    if (pipe(fds) < 0)
+        return -1;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[1]);
+    r = posix_spawnp(&pid, "ip", &actions, NULL,
+                     (char *const *) argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[0]);
+    if (r != 0) {
+        close(fds[1]);
+        return -1;
+    }
+
+    while (len > 0) {
+        ssize_t n = write(fds[1], cmds, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            break;
+        cmds += n;
+        len -= n;
+    }
+    close(fds[1]);
+
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR)
+            return -1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) == 127)
+        return -1;
+    return WEXITSTATUS(status) == 0 ? 0 : 1;
+}
+
+/* ip gives up on a batch at the first command it can not parse, even
+ * with -force, e.g. when a device an earlier command should have created
+ * is missing. Running each paragraph of PATH as its own batch keeps one
+ * missing kind of device from taking the others with it */
+int netns_setup(const char *path) {
+    FILE *fp;
+    char *line = NULL, *batch = NULL;
+    size_t size = 0, len = 0;
+    ssize_t n;
+    int result = 0;
+
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+
+    do {
+        n = getline(&line, &size, fp);
+        if (n > 0 && line[0] != '\n') {
+            char *p;
+
+            if (line[0] == '#')
+                continue;
+            p = realloc(batch, len + n);
+            if (p == NULL) {
+                result = -1;
+                break;
+            }
+            batch = p;
+            memcpy(batch + len, line, n);
+            len += n;
+        } else if (len > 0) {
+            int r = run_batch(batch, len);
+            if (r < 0) {
+                result = -1;
+                break;
+            }
+            if (r > 0)
+                result = 1;
+            len = 0;
+        }
+    } while (n > 0);
+
+    free(line);
+    free(batch);
+    fclose(fp);
+    return result;
+}
+
+/* vim: set ts=4 sw=4 et: */
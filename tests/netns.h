@@ -0,0 +1,51 @@
+/*
+ * netns.h: run tests against real network devices without privileges
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+#ifndef _NETNS_H
+#define _NETNS_H
+
+/* Exit status that tells automake to count a test as skipped */
+#define EXIT_SKIP 77
+
+/* Move the calling process into a new user and network namespace, in
+ * which it may create and configure network devices as an ordinary
+ * user, and mount a sysfs for that namespace on /sys. Must be called
+ * before the process starts any threads.
+ *
+ * Returns 0 on success, and -1 if the kernel does not allow it.
+ */
+int netns_enter(void);
+
+/* Create the links and addresses described by the file PATH, which holds
+ * commands in the syntax of 'ip -batch', and comments starting with '#'.
+ * Empty lines separate groups of commands; when a command fails, e.g.
+ * because a kernel module can not be loaded from inside the namespace,
+ * the rest of its group may be skipped, but the other groups are still
+ * run.
+ *
+ * Returns 0 if all commands succeeded, 1 if some failed, and -1 if ip
+ * could not be run.
+ */
+int netns_setup(const char *path);
+
+#endif
+
+/* vim: set ts=4 sw=4 et: */
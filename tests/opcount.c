@@ -0,0 +1,198 @@
+/*
+ * opcount.c: count the Augeas operations and system calls of netcf
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+/* The fortified open in <fcntl.h> is an inline function, which would
+ * clash with the definition of open below */
+#undef _FORTIFY_SOURCE
+
+#include <config.h>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <augeas.h>
+
+#include "internal.h"
+#include "safe-alloc.h"
+#include "opcount.h"
+
+/* We want the real functions here, not gnulib replacements */
+#undef open
+#undef ioctl
+
+static unsigned long counts[OPCOUNT_LAST];
+
+static const char *const opnames[OPCOUNT_LAST] = {
+    "aug_match", "aug_get", "aug_set", "ioctl", "open"
+};
+
+static void count(opcount_t op) {
+    __atomic_fetch_add(&counts[op], 1, __ATOMIC_RELAXED);
+}
+
+/* Look up the definition of NAME that ours hides */
+static void *real_function(const char *name) {
+    void *fn = dlsym(RTLD_NEXT, name);
+
+    if (fn == NULL) {
+        fprintf(stderr, "opcount: can not find %s: %s\n", name, dlerror());
+        abort();
+    }
+    return fn;
+}
+
+/* Declare REAL_ as a pointer to the real FN, looked up on first use. All
+ * threads store the same pointer, so the race on it is harmless */
+#define REAL(fn)                                                        \
+    static __typeof__(&fn) real_ = NULL;                                \
+    if (__atomic_load_n(&real_, __ATOMIC_RELAXED) == NULL)              \
+        __atomic_store_n(&real_, real_function(#fn), __ATOMIC_RELAXED)
+
+int aug_match(const augeas *aug, const char *path, char ***matches) {
+    REAL(aug_match);
+
+    count(OPCOUNT_AUG_MATCH);
+    return real_(aug, path, matches);
+}
+
+int aug_get(const augeas *aug, const char *path, const char **value) {
+    REAL(aug_get);
+
+    count(OPCOUNT_AUG_GET);
+    return real_(aug, path, value);
+}
+
+int aug_set(augeas *aug, const char *path, const char *value) {
+    REAL(aug_set);
+
+    count(OPCOUNT_AUG_SET);
+    return real_(aug, path, value);
+}
+
+int ioctl(int fd, unsigned long request, ...) {
+    void *arg;
+    va_list ap;
+    REAL(ioctl);
+
+    va_start(ap, request);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    count(OPCOUNT_IOCTL);
+    return real_(fd, request, arg);
+}
+
+int open(const char *path, int flags, ...) {
+    int mode = 0;
+    REAL(open);
+
+    if ((flags & O_CREAT) != 0
+#ifdef O_TMPFILE
+        || (flags & O_TMPFILE) == O_TMPFILE
+#endif
+        ) {
+        va_list ap;
+
+        va_start(ap, flags);
+        mode = va_arg(ap, int);
+        va_end(ap);
+    }
+
+    count(OPCOUNT_OPEN);
+    return real_(path, flags, mode);
+}
+
+void opcount_reset(void) {
+    for (int i=0; i < OPCOUNT_LAST; i++)
+        __atomic_store_n(&counts[i], 0, __ATOMIC_RELAXED);
+}
+
+void opcount_read(struct opcount *count) {
+    for (int i=0; i < OPCOUNT_LAST; i++)
+        count->ops[i] = __atomic_load_n(&counts[i], __ATOMIC_RELAXED);
+}
+
+void opcount_add_topologies(CuTest *tc, opcount_topology_t add,
+                            int first, int last) {
+    for (int i=first; i < last; i++)
+        add(tc, 100 + i, i % 2 == 0);
+}
+
+int opcount_list(CuTest *tc, struct netcf *ncf, struct opcount *count) {
+    char **names = NULL;
+    int nint, r;
+
+    /* Load the configuration before counting anything */
+    nint = ncf_num_of_interfaces(ncf, NETCF_IFACE_ACTIVE|NETCF_IFACE_INACTIVE);
+    CuAssert(tc, "failed to count interfaces", nint > 0);
+    r = ALLOC_N(names, nint);
+    CuAssert(tc, "allocation failed", r == 0);
+
+    opcount_reset();
+    r = ncf_num_of_interfaces(ncf, NETCF_IFACE_ACTIVE|NETCF_IFACE_INACTIVE);
+    CuAssertIntEquals(tc, nint, r);
+    r = ncf_list_interfaces(ncf, nint, names, NETCF_IFACE_INACTIVE);
+    CuAssert(tc, "failed to list interfaces", r >= 0);
+    opcount_read(count);
+    for (int i=0; i < r; i++)
+        free(names[i]);
+    free(names);
+
+    return nint;
+}
+
+static void fail_ops(CuTest *tc, const char *what, opcount_t op,
+                     int n_small, unsigned long small,
+                     int n_large, unsigned long large) {
+    char *msg = NULL;
+
+    if (asprintf(&msg, "%s: %lu calls to %s for %d interfaces, "
+                 "but %lu for %d interfaces", what, small, opnames[op],
+                 n_small, large, n_large) < 0)
+        msg = NULL;
+    CuFail(tc, msg != NULL ? msg : what);
+}
+
+void assert_ops_linear(CuTest *tc, const char *what,
+                       int n_small, const struct opcount *small,
+                       int n_large, const struct opcount *large) {
+    for (int i=0; i < OPCOUNT_LAST; i++) {
+        /* large / n_large <= small / n_small */
+        if (large->ops[i] * n_small > small->ops[i] * n_large)
+            fail_ops(tc, what, i, n_small, small->ops[i],
+                     n_large, large->ops[i]);
+    }
+}
+
+void assert_ops_constant(CuTest *tc, const char *what,
+                         int n_small, const struct opcount *small,
+                         int n_large, const struct opcount *large) {
+    for (int i=0; i < OPCOUNT_LAST; i++) {
+        if (large->ops[i] > small->ops[i])
+            fail_ops(tc, what, i, n_small, small->ops[i],
+                     n_large, large->ops[i]);
+    }
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,91 @@
+/*
+ * opcount.h: count the Augeas operations and system calls of netcf
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+#ifndef _OPCOUNT_H
+#define _OPCOUNT_H
+
+#include <stdbool.h>
+
+#include "cutest.h"
+#include "netcf.h"
+
+/*
+ * Test programs linked with opcount.c define aug_match, aug_get, aug_set,
+ * ioctl and open themselves; the definitions count each call and pass it
+ * on to the real function. Since the test program comes first in symbol
+ * lookup, the calls libnetcf makes end up there, too.
+ *
+ * Wall-clock time is too noisy to tell a linear from a quadratic
+ * algorithm in the test suite, but the number of these calls is not: the
+ * tests count them for configurations of different sizes and check how
+ * they grow.
+ */
+typedef enum {
+    OPCOUNT_AUG_MATCH,
+    OPCOUNT_AUG_GET,
+    OPCOUNT_AUG_SET,
+    OPCOUNT_IOCTL,
+    OPCOUNT_OPEN,
+    OPCOUNT_LAST
+} opcount_t;
+
+struct opcount {
+    unsigned long ops[OPCOUNT_LAST];
+};
+
+/* Set all counts back to 0 */
+void opcount_reset(void);
+
+/* Store the counts since the last opcount_reset in COUNT */
+void opcount_read(struct opcount *count);
+
+/* Write the configuration for one topology in the format of the driver
+ * under test: a bridge brN with port ethN if BRIDGE is true, a plain ethN
+ * otherwise */
+typedef void (*opcount_topology_t)(CuTest *tc, int n, bool bridge);
+
+/* Add topologies FIRST up to LAST with ADD: the even ones are bridges,
+ * the odd ones plain interfaces, and N is 100 + the number of the
+ * topology */
+void opcount_add_topologies(CuTest *tc, opcount_topology_t add,
+                            int first, int last);
+
+/* Count the calls NCF makes to count and list its interfaces in COUNT,
+ * after loading the configuration. Returns the number of interfaces */
+int opcount_list(CuTest *tc, struct netcf *ncf, struct opcount *count);
+
+/* Assert that the calls counted in LARGE for a configuration with N_LARGE
+ * interfaces grew at most linearly from those in SMALL for N_SMALL
+ * interfaces, i.e., that no count grew by more than N_LARGE / N_SMALL.
+ * WHAT names the operation that was counted in failure messages */
+void assert_ops_linear(CuTest *tc, const char *what,
+                       int n_small, const struct opcount *small,
+                       int n_large, const struct opcount *large);
+
+/* Assert that none of the counts in LARGE exceeds the one in SMALL, for
+ * operations whose cost must not depend on the number of interfaces */
+void assert_ops_constant(CuTest *tc, const char *what,
+                         int n_small, const struct opcount *small,
+                         int n_large, const struct opcount *large);
+
+#endif
+
+/* vim: set ts=4 sw=4 et: */
@@ -29,6 +29,7 @@
 #include "read-file.h"
 
 #include "tutil.h"
+#include "opcount.h"
 
 #include <stdio.h>
 
@@ -125,6 +126,46 @@ static void testDefineUndefine(CuTest *tc) {
     CuAssertPtrEquals(tc, NULL, nif);
 }
 
+/* Rolling back a transaction restores the interfaces file */
+static void testChangeTransaction(CuTest *tc) {
+    char *bridge_xml = NULL, *path = NULL;
+    char *before = NULL, *after = NULL;
+    size_t before_len, after_len;
+    struct netcf_if *nif = NULL;
+    int r;
+
+    bridge_xml = read_test_file(tc, "interface/bridge42.xml");
+    CuAssertPtrNotNull(tc, bridge_xml);
+    r = asprintf(&path, "%s/etc/network/interfaces", root);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    before = read_file(path, &before_len);
+    CuAssertPtrNotNull(tc, before);
+
+    r = ncf_change_begin(ncf, 0);
+    CuAssertIntEquals(tc, 0, r);
+    nif = ncf_define(ncf, bridge_xml);
+    CuAssertPtrNotNull(tc, nif);
+    ncf_if_free(nif);
+
+    r = ncf_change_rollback(ncf, 0);
+    CuAssertIntEquals(tc, 0, r);
+    assert_ncf_no_error(tc);
+    after = read_file(path, &after_len);
+    CuAssertPtrNotNull(tc, after);
+    CuAssertIntEquals(tc, before_len, after_len);
+    CuAssertStrEquals(tc, before, after);
+    CuAssertPtrEquals(tc, NULL, ncf_lookup_by_name(ncf, "br42"));
+
+    r = ncf_change_commit(ncf, 0);
+    CuAssertIntEquals(tc, -1, r);
+    CuAssertIntEquals(tc, NETCF_EINVALIDOP, ncf_error(ncf, NULL, NULL));
+
+    free(before);
+    free(after);
+    free(path);
+    free(bridge_xml);
+}
+
 static void assert_transforms(CuTest *tc, const char *base) {
     char *aug_fname = NULL, *ncf_fname = NULL;
     char *aug_xml_exp = NULL, *ncf_xml_exp = NULL;
@@ -186,6 +227,90 @@ static void testTransforms(CuTest *tc) {
     assert_transforms(tc, "ipv6-static-multi");
 }
 
+static void testIfFailedInOutput(CuTest *tc) {
+    static const char *const vlan =
+        "ifup: failed to bring up eth0.42\n";
+    static const char *const parent =
+        "RTNETLINK answers: File exists\n"
+        "Failed to bring up eth0.\n";
+    static const char *const unknown =
+        "ifdown: unknown interface br1\n"
+        "Ignoring unknown interface bond0=bond0.\n";
+
+    CuAssertIntEquals(tc, 1, ncf_if_failed_in_output(vlan, "eth0.42"));
+    CuAssertIntEquals(tc, 0, ncf_if_failed_in_output(vlan, "eth0"));
+    CuAssertIntEquals(tc, 0, ncf_if_failed_in_output(vlan, "eth0.4"));
+    CuAssertIntEquals(tc, 1, ncf_if_failed_in_output(parent, "eth0"));
+    CuAssertIntEquals(tc, 0, ncf_if_failed_in_output(parent, "eth0.42"));
+    CuAssertIntEquals(tc, 0, ncf_if_failed_in_output(parent, "eth"));
+    CuAssertIntEquals(tc, 1, ncf_if_failed_in_output(unknown, "br1"));
+    CuAssertIntEquals(tc, 1, ncf_if_failed_in_output(unknown, "bond0"));
+    CuAssertIntEquals(tc, 0, ncf_if_failed_in_output(unknown, "br0"));
+}
+
+/* A failing ifdown for several interfaces only fails the ones it names */
+static void testIfDownManyBlame(CuTest *tc) {
+    struct netcf_if *ifaces[2];
+    int status[2];
+    char *old_path = NULL;
+    int r;
+
+    old_path = use_fake_program(tc, "ifdown",
+                                "echo ifdown: failed to bring down bond0\n"
+                                "exit 1\n");
+
+    ifaces[0] = ncf_lookup_by_name(ncf, "br0");
+    ifaces[1] = ncf_lookup_by_name(ncf, "bond0");
+    CuAssertPtrNotNull(tc, ifaces[0]);
+    CuAssertPtrNotNull(tc, ifaces[1]);
+    r = ncf_if_down_many(ncf, 2, ifaces, 0, status);
+    setenv("PATH", old_path, 1);
+    CuAssertIntEquals(tc, 1, r);
+    CuAssertIntEquals(tc, NETCF_NOERROR, status[0]);
+    CuAssertIntEquals(tc, NETCF_EEXEC, status[1]);
+
+    ncf_if_free(ifaces[0]);
+    ncf_if_free(ifaces[1]);
+    free(old_path);
+}
+
+/* Append a stanza to /etc/network/interfaces for each topology */
+static void add_topology(CuTest *tc, int n, bool bridge) {
+    char *path = NULL;
+    FILE *fp;
+
+    if (asprintf(&path, "%s/etc/network/interfaces", root) < 0)
+        die("asprintf failed");
+    fp = fopen(path, "a");
+    CuAssertPtrNotNull(tc, fp);
+    if (bridge)
+        fprintf(fp, "\nauto br%d\niface br%d inet dhcp\n"
+                "        bridge_ports eth%d\n"
+                "iface eth%d inet manual\n", n, n, n, n);
+    else
+        fprintf(fp, "\nauto eth%d\niface eth%d inet dhcp\n", n, n);
+    CuAssertIntEquals(tc, 0, fclose(fp));
+    free(path);
+}
+
+/* Listing interfaces must take a number of Augeas operations and system
+ * calls that is linear in the number of interfaces; checking each of them
+ * against all bridge ports and bond slaves made it quadratic */
+static void testOpCounts(CuTest *tc) {
+    struct opcount small, large;
+    int n_small, n_large;
+
+    opcount_add_topologies(tc, add_topology, 0, 8);
+    n_small = opcount_list(tc, ncf, &small);
+    opcount_add_topologies(tc, add_topology, 8, 64);
+    n_large = opcount_list(tc, ncf, &large);
+    CuAssertIntEquals(tc, n_small + 56, n_large);
+
+    CuAssert(tc, "aug_match not counted", small.ops[OPCOUNT_AUG_MATCH] > 0);
+    CuAssertIntEquals(tc, 0, large.ops[OPCOUNT_AUG_SET]);
+    assert_ops_linear(tc, "listing", n_small, &small, n_large, &large);
+}
+
 static void testCorruptedSetup(CuTest *tc) {
     int r;
 
@@ -226,7 +351,11 @@ int main(void) {
     SUITE_ADD_TEST(suite, testLookupByName);
     SUITE_ADD_TEST(suite, testLookupByMAC);
     SUITE_ADD_TEST(suite, testDefineUndefine);
+    SUITE_ADD_TEST(suite, testChangeTransaction);
     SUITE_ADD_TEST(suite, testTransforms);
+    SUITE_ADD_TEST(suite, testIfFailedInOutput);
+    SUITE_ADD_TEST(suite, testIfDownManyBlame);
+    SUITE_ADD_TEST(suite, testOpCounts);
     SUITE_ADD_TEST(suite, testCorruptedSetup);
 
     CuSuiteRun(suite);
@@ -0,0 +1,240 @@
+/*
+ * test-netns.c: test the live state of interfaces against real devices
+ *
+ * Copyright (C) 2026 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ *
+ */
+
+/*
+ * The tests run in a user and network namespace of their own, with the
+ * devices from netns/topology, and the Red Hat style configuration of
+ * the same interfaces in netns/fsroot. If the kernel does not let us
+ * create the namespace, or ip is not installed, all tests are skipped.
+ *
+ * The configuration uses DHCP throughout, so that the addresses in the
+ * XML can only have come from the live devices.
+ */
+
+#include <config.h>
+#include "netcf.h"
+#include "internal.h"
+#include "cutest.h"
+#include "safe-alloc.h"
+
+#include "tutil.h"
+#include "netns.h"
+
+#include <stdio.h>
+#include <net/if.h>
+
+extern const char *abs_top_srcdir;
+extern const char *abs_top_builddir;
+extern char *driver_name;
+extern char *root, *src_root;
+extern struct netcf *ncf;
+
+/* Tests for devices whose module could not be loaded in the namespace
+ * pass without checking anything */
+static bool have_device(const char *name) {
+    if (if_nametoindex(name) != 0)
+        return true;
+    fprintf(stderr, "test-netns: no device %s, not testing it\n", name);
+    return false;
+}
+
+static char *xml_state(CuTest *tc, const char *name) {
+    struct netcf_if *nif;
+    char *xml;
+
+    nif = ncf_lookup_by_name(ncf, name);
+    CuAssertPtrNotNull(tc, nif);
+    xml = ncf_if_xml_state(nif);
+    CuAssertPtrNotNull(tc, xml);
+    ncf_if_free(nif);
+    return xml;
+}
+
+static void testListActive(CuTest *tc) {
+    char **names = NULL;
+    bool br0 = false, eth4 = false;
+    int nint;
+
+    if (!have_device("br0") || !have_device("eth4"))
+        return;
+    nint = ncf_num_of_interfaces(ncf, NETCF_IFACE_ACTIVE);
+    CuAssert(tc, "no active interfaces", nint > 0);
+    if (ALLOC_N(names, nint) < 0)
+        die("allocation failed");
+    nint = ncf_list_interfaces(ncf, nint, names, NETCF_IFACE_ACTIVE);
+    CuAssert(tc, "listing failed", nint > 0);
+    for (int i=0; i < nint; i++) {
+        br0 |= STREQ(names[i], "br0");
+        eth4 |= STREQ(names[i], "eth4");
+        free(names[i]);
+    }
+    free(names);
+    CuAssert(tc, "br0 is not active", br0);
+    CuAssert(tc, "eth4 is active", !eth4);
+}
+
+static void testStatus(CuTest *tc) {
+    struct netcf_if *nif;
+    unsigned int flags;
+    int r;
+
+    if (!have_device("br0") || !have_device("eth4"))
+        return;
+    nif = ncf_lookup_by_name(ncf, "br0");
+    CuAssertPtrNotNull(tc, nif);
+    r = ncf_if_status(nif, &flags);
+    CuAssertIntEquals(tc, 0, r);
+    CuAssertIntEquals(tc, NETCF_IFACE_ACTIVE, flags);
+    ncf_if_free(nif);
+
+    nif = ncf_lookup_by_name(ncf, "eth4");
+    CuAssertPtrNotNull(tc, nif);
+    r = ncf_if_status(nif, &flags);
+    CuAssertIntEquals(tc, 0, r);
+    CuAssertIntEquals(tc, NETCF_IFACE_INACTIVE, flags);
+    ncf_if_free(nif);
+}
+
+static void testBridgeState(CuTest *tc) {
+    char *xml;
+
+    if (!have_device("br0") || !have_device("eth0"))
+        return;
+    xml = xml_state(tc, "br0");
+    CuAssertPtrNotNull(tc, strstr(xml, "address=\"192.168.122.1\""));
+    CuAssertPtrNotNull(tc, strstr(xml, "prefix=\"24\""));
+    CuAssertPtrNotNull(tc, strstr(xml, "name=\"eth0\""));
+    free(xml);
+}
+
+static void testBondState(CuTest *tc) {
+    char *xml;
+
+    if (!have_device("bond0"))
+        return;
+    xml = xml_state(tc, "bond0");
+    CuAssertPtrNotNull(tc, strstr(xml, "address=\"10.0.1.27\""));
+    CuAssertPtrNotNull(tc, strstr(xml, "name=\"eth1\""));
+    CuAssertPtrNotNull(tc, strstr(xml, "name=\"eth2\""));
+    free(xml);
+}
+
+static void testVlanState(CuTest *tc) {
+    char *xml;
+
+    if (!have_device("eth3.42"))
+        return;
+    xml = xml_state(tc, "eth3.42");
+    CuAssertPtrNotNull(tc, strstr(xml, "tag=\"42\""));
+    CuAssertPtrNotNull(tc, strstr(xml, "name=\"eth3\""));
+    CuAssertPtrNotNull(tc, strstr(xml, "address=\"10.0.3.1\""));
+    free(xml);
+}
+
+static void testShmState(CuTest *tc) {
+    struct netcf_shm *shm;
+    struct netcf_shm_entry entry;
+    char *path = NULL;
+    bool found = false;
+    int r;
+
+    if (!have_device("br0") || !have_device("eth4"))
+        return;
+    r = asprintf(&path, "%s/netcf-state", root);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    r = ncf_shm_publish(ncf, path);
+    CuAssertIntEquals(tc, 0, r);
+    shm = ncf_shm_open(path);
+    CuAssertPtrNotNull(tc, shm);
+
+    CuAssertIntEquals(tc, 0, ncf_shm_lookup(shm, "br0", &entry));
+    CuAssert(tc, "br0 is not up", entry.flags & IFF_UP);
+    CuAssertIntEquals(tc, if_nametoindex("br0"), entry.ifindex);
+    for (unsigned int i=0; i < entry.naddrs && i < NETCF_SHM_ADDRS; i++) {
+        if (STREQ(entry.addrs[i].address, "192.168.122.1")) {
+            CuAssertIntEquals(tc, 24, entry.addrs[i].prefix);
+            found = true;
+        }
+    }
+    CuAssert(tc, "address of br0 missing", found);
+
+    CuAssertIntEquals(tc, 0, ncf_shm_lookup(shm, "eth4", &entry));
+    CuAssert(tc, "eth4 is up", !(entry.flags & IFF_UP));
+
+    ncf_shm_close(shm);
+    free(path);
+}
+
+int main(void) {
+    char *output = NULL, *topology = NULL;
+    CuSuite* suite;
+    int r;
+
+    abs_top_srcdir = getenv("abs_top_srcdir");
+    if (abs_top_srcdir == NULL)
+        die("env var abs_top_srcdir must be set");
+
+    abs_top_builddir = getenv("abs_top_builddir");
+    if (abs_top_builddir == NULL)
+        die("env var abs_top_builddir must be set");
+
+    if (netns_enter() < 0) {
+        fprintf(stderr, "test-netns: can not create a network namespace\n");
+        return EXIT_SKIP;
+    }
+    if (asprintf(&topology, "%s/tests/netns/topology", abs_top_srcdir) < 0)
+        die("failed to set topology");
+    r = netns_setup(topology);
+    if (r < 0) {
+        fprintf(stderr, "test-netns: can not run ip\n");
+        return EXIT_SKIP;
+    }
+    free(topology);
+
+    if (asprintf(&src_root, "%s/tests/netns/fsroot", abs_top_srcdir) < 0) {
+        die("failed to set src_root");
+    }
+
+    driver_name = strdup("netns");
+    if (driver_name == NULL) {
+        die("failed to set driver name");
+    }
+
+    suite = CuSuiteNew();
+    CuSuiteSetup(suite, setup, teardown);
+
+    SUITE_ADD_TEST(suite, testListActive);
+    SUITE_ADD_TEST(suite, testStatus);
+    SUITE_ADD_TEST(suite, testBridgeState);
+    SUITE_ADD_TEST(suite, testBondState);
+    SUITE_ADD_TEST(suite, testVlanState);
+    SUITE_ADD_TEST(suite, testShmState);
+
+    CuSuiteRun(suite);
+    CuSuiteSummary(suite, &output);
+    CuSuiteDetails(suite, &output);
+    printf("%s\n", output);
+    free(output);
+    free(driver_name);
+    return suite->failCount;
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -28,8 +28,22 @@
 #include "read-file.h"
 
 #include "tutil.h"
+#include "opcount.h"
+#include "shm.h"
 
 #include <stdio.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #include <libxml/tree.h>
 
@@ -38,6 +52,7 @@ extern const char *abs_top_builddir;
 extern char *driver_name;
 extern char *root, *src_root;
 extern struct netcf *ncf;
+extern char **environ;
 
 static void testListInterfaces(CuTest *tc) {
     int nint;
@@ -93,6 +108,59 @@ static void testLookupByNameDecoy(CuTest *tc) {
     CuAssertIntEquals(tc, 1, ncf->ref);
 }
 
+static int append_output(void *opaque, const char *buf, int len) {
+    char **xml = opaque;
+    size_t xml_len = *xml == NULL ? 0 : strlen(*xml);
+
+    if (REALLOC_N(*xml, xml_len + len + 1) < 0)
+        return -1;
+    memcpy(*xml + xml_len, buf, len);
+    (*xml)[xml_len + len] = '\0';
+    return len;
+}
+
+static int fail_output(void *opaque ATTRIBUTE_UNUSED,
+                       const char *buf ATTRIBUTE_UNUSED,
+                       int len ATTRIBUTE_UNUSED) {
+    return -1;
+}
+
+static void testXmlDescTo(CuTest *tc) {
+    struct netcf_if *nif;
+    char *xml, *xml_to = NULL, *buf = NULL;
+    size_t size = 0;
+    int r;
+
+    nif = ncf_lookup_by_name(ncf, "br0");
+    CuAssertPtrNotNull(tc, nif);
+
+    xml = ncf_if_xml_desc(nif);
+    CuAssertPtrNotNull(tc, xml);
+
+    r = ncf_if_xml_desc_to(nif, append_output, &xml_to);
+    CuAssertIntEquals(tc, 0, r);
+    CuAssertStrEquals(tc, xml, xml_to);
+
+    /* The buffer is reused, and only grown when needed */
+    r = ncf_if_xml_desc_buf(nif, &buf, &size);
+    CuAssertIntEquals(tc, strlen(xml), r);
+    CuAssertStrEquals(tc, xml, buf);
+    r = ncf_if_xml_desc_buf(nif, &buf, &size);
+    CuAssertIntEquals(tc, strlen(xml), r);
+    CuAssertStrEquals(tc, xml, buf);
+    CuAssertTrue(tc, size > strlen(xml));
+
+    r = ncf_if_xml_desc_to(nif, fail_output, NULL);
+    CuAssertIntEquals(tc, -1, r);
+    CuAssertIntEquals(tc, NETCF_EOTHER, ncf_error(ncf, NULL, NULL));
+
+    free(xml);
+    free(xml_to);
+    free(buf);
+    ncf_if_free(nif);
+    CuAssertIntEquals(tc, 1, ncf->ref);
+}
+
 static void testLookupByMAC(CuTest *tc) {
     static const char *const good_mac = "aa:bb:cc:dd:ee:ff";
     static const char *const good_mac_caps = "AA:bb:cc:DD:Ee:ff";
@@ -144,6 +212,512 @@ static void testDefineUndefine(CuTest *tc) {
     CuAssertPtrEquals(tc, NULL, nif);
 }
 
+static void testDefineValidationCache(CuTest *tc) {
+    char *bridge_xml = NULL;
+    struct netcf_if *nif = NULL;
+    unsigned long *counters = ncf->counters;
+    int r;
+
+    CuAssertIntEquals(tc, NETCF_SCHEMA_SERIAL, ncf->rng_serial);
+
+    bridge_xml = read_test_file(tc, "interface/bridge42.xml");
+    CuAssertPtrNotNull(tc, bridge_xml);
+
+    nif = ncf_define(ncf, bridge_xml);
+    CuAssertPtrNotNull(tc, nif);
+    ncf_if_free(nif);
+    CuAssertIntEquals(tc, 1, counters[NCF_COUNTER_RNG_VALIDATE]
+                      + counters[NCF_COUNTER_RNG_NATIVE]);
+    CuAssertIntEquals(tc, 0, counters[NCF_COUNTER_RNG_CACHED]);
+
+    /* Defining the same document again skips validation */
+    nif = ncf_define(ncf, bridge_xml);
+    CuAssertPtrNotNull(tc, nif);
+    ncf_if_free(nif);
+    CuAssertIntEquals(tc, 1, counters[NCF_COUNTER_RNG_VALIDATE]
+                      + counters[NCF_COUNTER_RNG_NATIVE]);
+    CuAssertIntEquals(tc, 1, counters[NCF_COUNTER_RNG_CACHED]);
+
+    nif = ncf_define_flags(ncf, bridge_xml, NETCF_DEFINE_VALIDATED);
+    CuAssertPtrNotNull(tc, nif);
+    ncf_if_free(nif);
+    CuAssertIntEquals(tc, 1, counters[NCF_COUNTER_RNG_TRUSTED]);
+
+    /* Callers that validated against a different schema don't count */
+    nif = ncf_define_flags(ncf, bridge_xml,
+                           1 | ((NETCF_SCHEMA_SERIAL + 1) << 8));
+    CuAssertPtrNotNull(tc, nif);
+    CuAssertIntEquals(tc, 1, counters[NCF_COUNTER_RNG_TRUSTED]);
+    CuAssertIntEquals(tc, 2, counters[NCF_COUNTER_RNG_CACHED]);
+
+    r = ncf_if_undefine(nif);
+    CuAssertIntEquals(tc, 0, r);
+    ncf_if_free(nif);
+    free(bridge_xml);
+}
+
+static void testDefineMany(CuTest *tc) {
+    const char *xmls[3];
+    struct netcf_if *ifaces[3];
+    int status[3];
+    char *bridge_xml = NULL, *path = NULL;
+    int r;
+
+    bridge_xml = read_test_file(tc, "interface/bridge42.xml");
+    CuAssertPtrNotNull(tc, bridge_xml);
+    xmls[0] = bridge_xml;
+    xmls[1] = "<interface type='ethernet' name='eth43'/>";
+    xmls[2] = "<interface type='ethernet' name='eth44'>"
+        "<start mode='nonsense'/></interface>";
+
+    r = ncf_define_many(ncf, 3, xmls, 0, ifaces, status);
+    CuAssertIntEquals(tc, 2, r);
+    CuAssertIntEquals(tc, NETCF_NOERROR, status[0]);
+    CuAssertIntEquals(tc, NETCF_NOERROR, status[1]);
+    CuAssertIntEquals(tc, NETCF_EXMLINVALID, status[2]);
+    CuAssertIntEquals(tc, NETCF_EXMLINVALID, ncf_error(ncf, NULL, NULL));
+    CuAssertStrEquals(tc, "br42", ncf_if_name(ifaces[0]));
+    CuAssertStrEquals(tc, "eth43", ncf_if_name(ifaces[1]));
+    CuAssertPtrEquals(tc, NULL, ifaces[2]);
+
+    /* The backups we keep while saving are gone */
+    r = asprintf(&path, "%s/etc/sysconfig/network-scripts/ifcfg-br42"
+                 ".netcf-backup", root);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    CuAssertIntEquals(tc, -1, access(path, F_OK));
+    free(path);
+
+    ncf_if_free(ifaces[0]);
+    ncf_if_free(ifaces[1]);
+    ncf_close(ncf);
+    r = ncf_init(&ncf, root);
+    CuAssertIntEquals(tc, 0, r);
+
+    for (int i=0; i < 2; i++) {
+        struct netcf_if *nif;
+
+        nif = ncf_lookup_by_name(ncf, i == 0 ? "br42" : "eth43");
+        CuAssertPtrNotNull(tc, nif);
+        r = ncf_if_undefine(nif);
+        CuAssertIntEquals(tc, 0, r);
+        ncf_if_free(nif);
+    }
+    CuAssertPtrEquals(tc, NULL, ncf_lookup_by_name(ncf, "eth44"));
+    free(bridge_xml);
+}
+
+static int ifcfg_exists(const char *name) {
+    char *path = NULL;
+    int r;
+
+    if (asprintf(&path, "%s/etc/sysconfig/network-scripts/ifcfg-%s",
+                 root, name) < 0)
+        die("asprintf failed");
+    r = access(path, F_OK) == 0;
+    free(path);
+    return r;
+}
+
+static void stat_ifcfg(CuTest *tc, const char *name, struct stat *st) {
+    char *path = NULL;
+
+    if (asprintf(&path, "%s/etc/sysconfig/network-scripts/ifcfg-%s",
+                 root, name) < 0)
+        die("asprintf failed");
+    CuAssertIntEquals(tc, 0, stat(path, st));
+    free(path);
+}
+
+/* Redefining an interface with the same XML must not write any files */
+static void testRedefineUnchanged(CuTest *tc) {
+    char *bridge_xml = NULL;
+    struct netcf_if *nif = NULL;
+    struct stat br_before, br_after, eth_before, eth_after;
+
+    bridge_xml = read_test_file(tc, "interface/bridge42.xml");
+    CuAssertPtrNotNull(tc, bridge_xml);
+
+    nif = ncf_define(ncf, bridge_xml);
+    CuAssertPtrNotNull(tc, nif);
+    ncf_if_free(nif);
+    stat_ifcfg(tc, "br42", &br_before);
+    stat_ifcfg(tc, "eth42", &eth_before);
+
+    nif = ncf_define(ncf, bridge_xml);
+    CuAssertPtrNotNull(tc, nif);
+    assert_ncf_no_error(tc);
+    stat_ifcfg(tc, "br42", &br_after);
+    stat_ifcfg(tc, "eth42", &eth_after);
+
+    CuAssertIntEquals(tc, br_before.st_ino, br_after.st_ino);
+    CuAssertIntEquals(tc, eth_before.st_ino, eth_after.st_ino);
+
+    ncf_if_undefine(nif);
+    ncf_if_free(nif);
+    free(bridge_xml);
+}
+
+/* With a durability policy, files are staged and renamed into place */
+static void testDurability(CuTest *tc) {
+    char *bridge_xml = NULL, *path = NULL;
+    struct netcf_if *nif = NULL;
+    int r;
+
+    r = ncf_set_durability(ncf, NETCF_DURABILITY_FULL + 1);
+    CuAssertIntEquals(tc, -1, r);
+    r = ncf_set_durability(ncf, NETCF_DURABILITY_FULL);
+    CuAssertIntEquals(tc, 0, r);
+
+    bridge_xml = read_test_file(tc, "interface/bridge42.xml");
+    CuAssertPtrNotNull(tc, bridge_xml);
+    nif = ncf_define(ncf, bridge_xml);
+    CuAssertPtrNotNull(tc, nif);
+    assert_ncf_no_error(tc);
+    CuAssertIntEquals(tc, 1, ifcfg_exists("br42"));
+    CuAssertIntEquals(tc, 1, ifcfg_exists("eth42"));
+
+    /* No staged files are left behind */
+    r = asprintf(&path, "%s/etc/sysconfig/network-scripts/ifcfg-br42.augnew",
+                 root);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    CuAssertIntEquals(tc, -1, access(path, F_OK));
+    free(path);
+
+    r = ncf_if_undefine(nif);
+    CuAssertIntEquals(tc, 0, r);
+    CuAssertIntEquals(tc, 0, ifcfg_exists("br42"));
+    CuAssertIntEquals(tc, 0, ifcfg_exists("eth42"));
+
+    ncf_if_free(nif);
+    free(bridge_xml);
+    ncf_set_durability(ncf, NETCF_DURABILITY_DEFAULT);
+}
+
+static void testChangeTransaction(CuTest *tc) {
+    char *bridge_xml = NULL;
+    struct netcf_if *nif = NULL;
+    int r;
+
+    bridge_xml = read_test_file(tc, "interface/bridge42.xml");
+    CuAssertPtrNotNull(tc, bridge_xml);
+
+    r = ncf_change_commit(ncf, 0);
+    CuAssertIntEquals(tc, -1, r);
+    CuAssertIntEquals(tc, NETCF_EINVALIDOP, ncf_error(ncf, NULL, NULL));
+
+    r = ncf_change_begin(ncf, 0);
+    CuAssertIntEquals(tc, 0, r);
+    r = ncf_change_begin(ncf, 0);
+    CuAssertIntEquals(tc, -1, r);
+    CuAssertIntEquals(tc, NETCF_EINVALIDOP, ncf_error(ncf, NULL, NULL));
+
+    nif = ncf_define(ncf, bridge_xml);
+    CuAssertPtrNotNull(tc, nif);
+    ncf_if_free(nif);
+    nif = ncf_lookup_by_name(ncf, "br1");
+    CuAssertPtrNotNull(tc, nif);
+    r = ncf_if_undefine(nif);
+    CuAssertIntEquals(tc, 0, r);
+    ncf_if_free(nif);
+    CuAssertIntEquals(tc, 1, ifcfg_exists("br42"));
+    CuAssertIntEquals(tc, 0, ifcfg_exists("br1"));
+
+    /* Rolling back removes new files and restores deleted ones */
+    r = ncf_change_rollback(ncf, 0);
+    CuAssertIntEquals(tc, 0, r);
+    CuAssertIntEquals(tc, 0, ifcfg_exists("br42"));
+    CuAssertIntEquals(tc, 0, ifcfg_exists("eth42"));
+    CuAssertIntEquals(tc, 1, ifcfg_exists("br1"));
+    nif = ncf_lookup_by_name(ncf, "br1");
+    CuAssertPtrNotNull(tc, nif);
+    ncf_if_free(nif);
+
+    r = ncf_change_begin(ncf, 0);
+    CuAssertIntEquals(tc, 0, r);
+    nif = ncf_define(ncf, bridge_xml);
+    CuAssertPtrNotNull(tc, nif);
+    r = ncf_change_commit(ncf, 0);
+    CuAssertIntEquals(tc, 0, r);
+    CuAssertIntEquals(tc, 1, ifcfg_exists("br42"));
+    r = ncf_change_rollback(ncf, 0);
+    CuAssertIntEquals(tc, -1, r);
+    CuAssertIntEquals(tc, NETCF_EINVALIDOP, ncf_error(ncf, NULL, NULL));
+
+    ncf_if_undefine(nif);
+    ncf_if_free(nif);
+    free(bridge_xml);
+}
+
+/* Rolling back reports the toplevel interfaces whose files changed */
+static void testChangeRollbackList(CuTest *tc) {
+    char *bridge_xml = NULL;
+    char *names[3];
+    struct netcf_if *nif = NULL;
+    int r;
+
+    bridge_xml = read_test_file(tc, "interface/bridge42.xml");
+    CuAssertPtrNotNull(tc, bridge_xml);
+
+    r = ncf_change_begin(ncf, 0);
+    CuAssertIntEquals(tc, 0, r);
+    nif = ncf_define(ncf, bridge_xml);
+    CuAssertPtrNotNull(tc, nif);
+    ncf_if_free(nif);
+    nif = ncf_lookup_by_name(ncf, "bond0");
+    CuAssertPtrNotNull(tc, nif);
+    r = ncf_if_undefine(nif);
+    CuAssertIntEquals(tc, 0, r);
+    ncf_if_free(nif);
+
+    /* The slaves of bond0 are reported as bond0, and eth42 as br42 */
+    r = ncf_change_rollback_list(ncf, 0, 3, names);
+    CuAssertIntEquals(tc, 2, r);
+    CuAssertStrEquals(tc, "br42", names[0]);
+    CuAssertStrEquals(tc, "bond0", names[1]);
+    CuAssertPtrEquals(tc, NULL, names[2]);
+    CuAssertIntEquals(tc, 1, ifcfg_exists("bond0"));
+    CuAssertIntEquals(tc, 0, ifcfg_exists("br42"));
+
+    free(names[0]);
+    free(names[1]);
+    free(bridge_xml);
+}
+
+/* An edit that keeps both the size and the modification time of a file
+ * must still be undone by the rollback */
+static void testChangeRollbackSameSize(CuTest *tc) {
+    char *path = NULL, *text = NULL;
+    size_t len;
+    int r;
+
+    r = ncf_change_begin(ncf, 0);
+    CuAssertIntEquals(tc, 0, r);
+
+    r = asprintf(&path, "%s/etc/sysconfig/network-scripts/ifcfg-br1", root);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    run(tc, "cp -p %s %s/ifcfg-br1.orig && "
+        "sed -i \"s/ONBOOT='yes'/ONBOOT='nah'/\" %s && "
+        "touch -r %s/ifcfg-br1.orig %s", path, root, path, root, path);
+
+    r = ncf_change_rollback(ncf, 0);
+    CuAssertIntEquals(tc, 0, r);
+    text = read_file(path, &len);
+    CuAssertPtrNotNull(tc, text);
+    CuAssertPtrNotNull(tc, strstr(text, "ONBOOT='yes'"));
+
+    free(text);
+    free(path);
+}
+
+/* A failing ifdown must not keep the rollback from putting the files back
+ * and bringing up the interfaces it restored */
+static void testChangeRollbackRestart(CuTest *tc) {
+    char *bridge_xml = NULL, *path = NULL, *old_path = NULL, *log = NULL;
+    struct netcf_if *nif = NULL;
+    size_t len;
+    int r;
+
+    bridge_xml = read_test_file(tc, "interface/bridge42.xml");
+    CuAssertPtrNotNull(tc, bridge_xml);
+
+    r = ncf_change_begin(ncf, 0);
+    CuAssertIntEquals(tc, 0, r);
+    nif = ncf_define(ncf, bridge_xml);
+    CuAssertPtrNotNull(tc, nif);
+    ncf_if_free(nif);
+    nif = ncf_lookup_by_name(ncf, "bond0");
+    CuAssertPtrNotNull(tc, nif);
+    r = ncf_if_undefine(nif);
+    CuAssertIntEquals(tc, 0, r);
+    ncf_if_free(nif);
+
+    run(tc, "rm -f %s/ifup.log", root);
+    old_path = use_fake_program(tc, "ifdown", "exit 1\n");
+    free(use_fake_program(tc, "ifup", "echo $1 >> %s/ifup.log\n", root));
+
+    r = ncf_change_rollback(ncf, NETCF_CHANGE_RESTART);
+    setenv("PATH", old_path, 1);
+    CuAssertIntEquals(tc, -1, r);
+    CuAssertIntEquals(tc, NETCF_EEXEC, ncf_error(ncf, NULL, NULL));
+    CuAssertIntEquals(tc, 1, ifcfg_exists("bond0"));
+    CuAssertIntEquals(tc, 0, ifcfg_exists("br42"));
+
+    r = asprintf(&path, "%s/ifup.log", root);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    log = read_file(path, &len);
+    CuAssertPtrNotNull(tc, log);
+    CuAssertStrEquals(tc, "bond0\n", log);
+
+    /* The transaction is over */
+    r = ncf_change_begin(ncf, 0);
+    CuAssertIntEquals(tc, 0, r);
+    r = ncf_change_commit(ncf, 0);
+    CuAssertIntEquals(tc, 0, r);
+
+    free(log);
+    free(path);
+    free(old_path);
+    free(bridge_xml);
+}
+
+/* A handle that read the tree before another one changed a file must
+ * not undo that change when it saves the same file; here, both add an
+ * alias to modprobe.d/netcf.conf, most likely within the same second */
+static void testLockedDefine(CuTest *tc) {
+    static const char *const bond_fmt =
+        "<interface type='bond' name='%s'><start mode='none'/>"
+        "<bond><interface type='ethernet' name='%s'/></bond></interface>";
+    struct netcf *ncf2 = NULL;
+    struct netcf_if *nif;
+    char *xml = NULL, *path = NULL, *conf = NULL;
+    size_t length;
+    int r;
+
+    /* The test root has no modprobe config at all */
+    if (asprintf(&path, "%s/etc/modprobe.d", root) < 0)
+        die("asprintf failed");
+    CuAssertIntEquals(tc, 0, mkdir(path, 0755));
+    free(path);
+
+    r = ncf_init(&ncf2, root);
+    CuAssertIntEquals(tc, 0, r);
+    CuAssert(tc, "ncf_num_of_interfaces failed",
+             ncf_num_of_interfaces(ncf2, NETCF_IFACE_INACTIVE) >= 0);
+
+    if (asprintf(&xml, bond_fmt, "bond7", "eth70") < 0)
+        die("asprintf failed");
+    nif = ncf_define(ncf, xml);
+    CuAssertPtrNotNull(tc, nif);
+    ncf_if_free(nif);
+    free(xml);
+
+    if (asprintf(&xml, bond_fmt, "bond8", "eth80") < 0)
+        die("asprintf failed");
+    nif = ncf_define(ncf2, xml);
+    CuAssertPtrNotNull(tc, nif);
+    ncf_if_free(nif);
+    free(xml);
+    ncf_close(ncf2);
+
+    if (asprintf(&path, "%s/etc/modprobe.d/netcf.conf", root) < 0)
+        die("asprintf failed");
+    conf = read_file(path, &length);
+    CuAssertPtrNotNull(tc, conf);
+    CuAssertPtrNotNull(tc, strstr(conf, "alias bond7 bonding"));
+    CuAssertPtrNotNull(tc, strstr(conf, "alias bond8 bonding"));
+    free(conf);
+    free(path);
+}
+
+static void testUndefineMany(CuTest *tc) {
+    static const char *const removed[] =
+        { "br0", "eth0", "bond0", "eth1", "eth2" };
+    struct netcf_if *ifaces[2];
+    int r;
+
+    ifaces[0] = ncf_lookup_by_name(ncf, "br0");
+    CuAssertPtrNotNull(tc, ifaces[0]);
+    ifaces[1] = ncf_lookup_by_name(ncf, "bond0");
+    CuAssertPtrNotNull(tc, ifaces[1]);
+
+    r = ncf_undefine_many(ncf, 2, ifaces);
+    CuAssertIntEquals(tc, 0, r);
+    assert_ncf_no_error(tc);
+    ncf_if_free(ifaces[0]);
+    ncf_if_free(ifaces[1]);
+
+    for (int i=0; i < ARRAY_CARDINALITY(removed); i++)
+        CuAssertIntEquals(tc, 0, ifcfg_exists(removed[i]));
+    CuAssertIntEquals(tc, 1, ifcfg_exists("br1"));
+
+    ncf_close(ncf);
+    r = ncf_init(&ncf, root);
+    CuAssertIntEquals(tc, 0, r);
+    r = ncf_num_of_interfaces(ncf, NETCF_IFACE_ACTIVE|NETCF_IFACE_INACTIVE);
+    CuAssertIntEquals(tc, 5, r);
+}
+
+/* Check that the validator compiled from interface.rng agrees with the
+ * RelaxNG interpreter. The compiled validator is allowed to reject valid
+ * documents, but none of the ones we use here */
+static void assert_validators_agree(CuTest *tc, const char *name,
+                                    const char *xml, int exp) {
+    int native, interp;
+
+    interp = ncf_validate_xml(ncf, xml, 0);
+    native = ncf_validate_xml(ncf, xml, 1);
+    if (interp != exp || native != exp) {
+        char *msg = NULL;
+
+        if (asprintf(&msg, "%s: expected %d, interpreter %d, native %d",
+                     name, exp, interp, native) < 0)
+            die("asprintf failed");
+        CuFail(tc, msg);
+    }
+}
+
+static void testNativeValidation(CuTest *tc) {
+    static const char *const fixtures[] = {
+        "bond", "bond-arp", "bond-defaults", "bridge", "bridge42",
+        "bridge-no-address", "bridge-vlan", "bridge-empty", "bridge-bond",
+        "bridge-multi", "bridge-multi-all", "ethernet-static",
+        "ethernet-static-no-prefix", "ethernet-dhcp", "vlan",
+        "ipv6-local", "ipv6-static", "ipv6-dhcp", "ipv6-autoconf",
+        "ipv6-autoconf-dhcp", "ipv6-static-multi"
+    };
+    static const char *const invalid[] = {
+        "<interface type='token' name='eth0'/>",
+        "<interface type='ethernet'/>",
+        "<interface type='ethernet' name='eth 0'/>",
+        "<interface type='ethernet' name='eth0' extra='1'/>",
+        "<interface type='ethernet' name='eth0'><foo/></interface>",
+        "<interface type='ethernet' name='eth0'>text</interface>",
+        "<interface type='ethernet' name='eth0'>"
+        "<mac address='aa:bb:cc:dd:ee'/></interface>",
+        "<interface type='ethernet' name='eth0'>"
+        "<mtu size='9000'/><mtu size='1500'/></interface>",
+        "<interface type='ethernet' name='eth0'><start mode='always'/>"
+        "</interface>",
+        "<interface type='ethernet' name='eth0'><protocol family='ipv4'>"
+        "<ip address='192.168.0.1' prefix='33'/></protocol></interface>",
+        "<interface type='ethernet' name='eth0'><protocol family='ipv4'>"
+        "<ip address='192.168.0.256'/></protocol></interface>",
+        "<interface type='ethernet' name='eth0'><protocol family='ipv6'>"
+        "<ip address='::1' prefix='129'/></protocol></interface>",
+        "<interface type='ethernet' name='eth0'><protocol family='ipv4'/>"
+        "<protocol family='ipv4'/></interface>",
+        "<interface type='vlan' name='eth0.42'><vlan tag='4096'>"
+        "<interface name='eth0'/></vlan></interface>",
+        "<interface type='vlan' name='eth0.42'><vlan tag='42'>"
+        "<interface name='eth0'/><interface name='eth1'/></vlan>"
+        "</interface>",
+        "<interface type='bridge' name='br0'><bridge delay='-1'/>"
+        "</interface>",
+        "<interface type='bond' name='bond0'><bond/></interface>",
+        "<interface type='bond' name='bond0'><bond mode='fast'>"
+        "<interface type='ethernet' name='eth0'/></bond></interface>",
+        "<interface type='bond' name='bond0'><bond>"
+        "<miimon freq='100'/><arpmon interval='1' target='10.0.0.1'/>"
+        "<interface type='ethernet' name='eth0'/></bond></interface>",
+        "<interface type='bond' name='bond0'><link state='sideways'/>"
+        "<bond><interface type='ethernet' name='eth0'/></bond></interface>",
+        "<interface xmlns='urn:x' type='ethernet' name='eth0'/>"
+    };
+
+    for (int i=0; i < ARRAY_CARDINALITY(fixtures); i++) {
+        char *fname = NULL, *xml;
+
+        if (asprintf(&fname, "interface/%s.xml", fixtures[i]) < 0)
+            die("asprintf failed");
+        xml = read_test_file(tc, fname);
+        assert_validators_agree(tc, fname, xml, 1);
+        free(xml);
+        free(fname);
+    }
+    for (int i=0; i < ARRAY_CARDINALITY(invalid); i++)
+        assert_validators_agree(tc, invalid[i], invalid[i], 0);
+}
+
 static void assert_transforms(CuTest *tc, const char *base) {
     char *aug_fname = NULL, *ncf_fname = NULL;
     char *aug_xml_exp = NULL, *ncf_xml_exp = NULL;
@@ -171,6 +745,655 @@ static void assert_transforms(CuTest *tc, const char *base) {
     free(aug_xml_act);
 }
 
+static int collect_line(void *opaque, const char *line) {
+    char **lines = opaque;
+    char *s;
+
+    if (asprintf(&s, "%s%s;", *lines ? *lines : "", line) < 0)
+        return -1;
+    free(*lines);
+    *lines = s;
+    return STREQ(line, "stop") ? -1 : 0;
+}
+
+static void testExecTimeout(CuTest *tc) {
+    static const char *const sleep_argv[] = { "sleep", "10", NULL };
+    static const char *const echo_argv[] =
+        { "sh", "-c", "echo one; echo two >&2; printf three", NULL };
+    static const char *const stop_argv[] =
+        { "sh", "-c", "echo stop; sleep 10", NULL };
+    char *lines = NULL, *output = NULL;
+    time_t start;
+    int r;
+
+    ncf_set_exec_timeout(ncf, 200);
+    start = time(NULL);
+    r = ncf_run_program(ncf, sleep_argv, NULL);
+    CuAssertIntEquals(tc, -1, r);
+    CuAssertIntEquals(tc, NETCF_ETIMEOUT, ncf_error(ncf, NULL, NULL));
+    CuAssert(tc, "sleep was not killed", time(NULL) - start < 5);
+    ncf_set_exec_timeout(ncf, 0);
+
+    ncf_set_output_callback(ncf, collect_line, &lines);
+    r = ncf_run_program(ncf, echo_argv, &output);
+    CuAssertIntEquals(tc, 0, r);
+    CuAssertStrEquals(tc, "one;two;three;", lines);
+    CuAssertStrEquals(tc, "one\ntwo\nthree", output);
+    FREE(lines);
+    FREE(output);
+
+    start = time(NULL);
+    r = ncf_run_program(ncf, stop_argv, NULL);
+    CuAssertIntEquals(tc, -1, r);
+    CuAssertIntEquals(tc, NETCF_EEXEC, ncf_error(ncf, NULL, NULL));
+    CuAssert(tc, "cancelled program was not killed", time(NULL) - start < 5);
+    ncf_set_output_callback(ncf, NULL, NULL);
+    FREE(lines);
+}
+
+/* Wait up to 2s for PID to be gone or a zombie */
+static bool process_gone(pid_t pid) {
+    for (int i=0; i < 100; i++) {
+        char *path = NULL, *stat, *paren;
+        size_t len;
+
+        if (asprintf(&path, "/proc/%d/stat", (int) pid) < 0)
+            die("asprintf failed");
+        stat = read_file(path, &len);
+        free(path);
+        if (stat == NULL)
+            return true;
+        paren = strrchr(stat, ')');
+        if (paren != NULL && paren[1] == ' ' && paren[2] == 'Z') {
+            free(stat);
+            return true;
+        }
+        free(stat);
+        usleep(20 * 1000);
+    }
+    return false;
+}
+
+/* Killing a program that timed out also kills what it started */
+static void testExecKillsGroup(CuTest *tc) {
+    char *script = NULL, *path = NULL, *pid_str = NULL;
+    size_t len;
+    int r;
+
+    r = asprintf(&path, "%s/grandchild.pid", root);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    r = asprintf(&script, "sleep 10 & echo $! > %s; wait", path);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    const char *const argv[] = { "sh", "-c", script, NULL };
+
+    ncf_set_exec_timeout(ncf, 200);
+    r = ncf_run_program(ncf, argv, NULL);
+    ncf_set_exec_timeout(ncf, 0);
+    CuAssertIntEquals(tc, -1, r);
+    CuAssertIntEquals(tc, NETCF_ETIMEOUT, ncf_error(ncf, NULL, NULL));
+
+    pid_str = read_file(path, &len);
+    CuAssertPtrNotNull(tc, pid_str);
+    CuAssert(tc, "grandchild survived", process_gone(atoi(pid_str)));
+
+    free(pid_str);
+    free(script);
+    free(path);
+}
+
+/* Put a fake ifdown that records the devices it is called for in
+ * ROOT/ifdown.log first in PATH, and return the old PATH */
+static char *use_fake_ifdown(CuTest *tc) {
+    run(tc, "rm -f %s/ifdown.log", root);
+    return use_fake_program(tc, "ifdown", "echo $1 >> %s/ifdown.log\n", root);
+}
+
+static void testIfDownMany(CuTest *tc) {
+    struct netcf_stat stats[NETCF_STAT_LAST];
+    struct netcf_if *ifaces[2];
+    int status[2];
+    char *log = NULL, *path = NULL, *old_path = NULL;
+    const char *br0, *eth0;
+    size_t len;
+    int r;
+
+    old_path = use_fake_ifdown(tc);
+    ifaces[0] = ncf_lookup_by_name(ncf, "br0");
+    ifaces[1] = ncf_lookup_by_name(ncf, "bond0");
+    CuAssertPtrNotNull(tc, ifaces[0]);
+    CuAssertPtrNotNull(tc, ifaces[1]);
+
+    ncf_get_stats(ncf, NULL, 0, NETCF_STATS_RESET);
+    r = ncf_if_down_many(ncf, 2, ifaces, 0, status);
+    setenv("PATH", old_path, 1);
+    CuAssertIntEquals(tc, 2, r);
+    CuAssertIntEquals(tc, NETCF_NOERROR, status[0]);
+    CuAssertIntEquals(tc, NETCF_NOERROR, status[1]);
+    /* One ifdown each for br0, eth0 and bond0 */
+    ncf_get_stats(ncf, stats, NETCF_STAT_LAST, 0);
+    CuAssertIntEquals(tc, 3, (int) stats[NETCF_STAT_EXEC].count);
+
+    /* The bridge goes down before its slave; the slaves of the bond are
+     * left to ifdown */
+    r = asprintf(&path, "%s/ifdown.log", root);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    log = read_file(path, &len);
+    CuAssertPtrNotNull(tc, log);
+    br0 = strstr(log, "br0\n");
+    eth0 = strstr(log, "eth0\n");
+    CuAssertPtrNotNull(tc, br0);
+    CuAssertPtrNotNull(tc, eth0);
+    CuAssert(tc, "br0 went down after eth0", br0 < eth0);
+    CuAssertPtrNotNull(tc, strstr(log, "bond0\n"));
+    CuAssertPtrEquals(tc, NULL, strstr(log, "eth1"));
+
+    ncf_if_free(ifaces[0]);
+    ncf_if_free(ifaces[1]);
+    free(log);
+    free(path);
+    free(old_path);
+}
+
+static void testIfDownAsync(CuTest *tc) {
+    struct netcf_stat stats[NETCF_STAT_LAST];
+    struct netcf_if *nif = NULL;
+    struct netcf_op *op = NULL;
+    char *log = NULL, *path = NULL, *old_path = NULL;
+    struct pollfd pfd;
+    size_t len;
+    int r;
+
+    old_path = use_fake_ifdown(tc);
+    nif = ncf_lookup_by_name(ncf, "br0");
+    CuAssertPtrNotNull(tc, nif);
+    ncf_get_stats(ncf, NULL, 0, NETCF_STATS_RESET);
+    op = ncf_if_down_async(nif);
+    CuAssertPtrNotNull(tc, op);
+
+    pfd.fd = ncf_op_fd(op);
+    pfd.events = POLLIN;
+    CuAssert(tc, "no fd for operation", pfd.fd >= 0);
+    while ((r = ncf_op_result(op)) == 1)
+        poll(&pfd, 1, 5000);
+    setenv("PATH", old_path, 1);
+    CuAssertIntEquals(tc, 0, r);
+    assert_ncf_no_error(tc);
+    ncf_op_free(op);
+    ncf_get_stats(ncf, stats, NETCF_STAT_LAST, 0);
+    CuAssertIntEquals(tc, 2, (int) stats[NETCF_STAT_EXEC].count);
+
+    r = asprintf(&path, "%s/ifdown.log", root);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    log = read_file(path, &len);
+    CuAssertPtrNotNull(tc, log);
+    CuAssertStrEquals(tc, "br0\neth0\n", log);
+
+    ncf_if_free(nif);
+    free(log);
+    free(path);
+    free(old_path);
+}
+
+/* Milliseconds on the monotonic clock */
+static long long now_msecs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/* An ifdown that closes its output and only exits later neither blocks
+ * ncf_op_result nor makes the caller's poll spin */
+static void testIfDownAsyncQuiet(CuTest *tc) {
+    struct netcf_if *nif = NULL;
+    struct netcf_op *op = NULL;
+    char *old_path = NULL;
+    struct pollfd pfd;
+    long long start, slowest = 0;
+    int r, rounds = 0;
+
+    old_path = use_fake_program(tc, "ifdown",
+                                "exec >/dev/null 2>&1\nsleep 0.5\n");
+    nif = ncf_lookup_by_name(ncf, "br0");
+    CuAssertPtrNotNull(tc, nif);
+    op = ncf_if_down_async(nif);
+    CuAssertPtrNotNull(tc, op);
+
+    pfd.fd = ncf_op_fd(op);
+    pfd.events = POLLIN;
+    do {
+        poll(&pfd, 1, 5000);
+        start = now_msecs();
+        r = ncf_op_result(op);
+        if (now_msecs() - start > slowest)
+            slowest = now_msecs() - start;
+        rounds += 1;
+    } while (r == 1 && rounds < 10000);
+    setenv("PATH", old_path, 1);
+    CuAssertIntEquals(tc, 0, r);
+    CuAssert(tc, "ncf_op_result blocked", slowest < 250);
+    CuAssert(tc, "polling the operation spins", rounds < 1000);
+
+    ncf_op_free(op);
+    ncf_if_free(nif);
+    free(old_path);
+}
+
+/* Start netcfd for the test root, and check that a handle that goes
+ * through it sees the same interfaces as one that reads the files, and
+ * that handles only use it when asked to */
+static void testDaemon(CuTest *tc) {
+    struct netcf *ncf2 = NULL, *ncf3 = NULL;
+    struct netcf_if *nif = NULL, *nif2 = NULL;
+    char *sock = NULL, *xml = NULL, *xml2 = NULL;
+    char *names[16];
+    int nint = -1, nint2 = -2, errcode = NETCF_NOERROR;
+    pid_t pid;
+    int r, r3 = -1;
+
+    /* The test root is too deep for the path of a Unix socket */
+    r = asprintf(&sock, "/tmp/netcfd-test-%d.sock", (int) getpid());
+    CuAssert(tc, "asprintf failed", r >= 0);
+    char *const argv[] = {
+        (char *) "netcfd", (char *) "--root", root, (char *) "--socket", sock,
+        NULL
+    };
+    r = posix_spawnp(&pid, "netcfd", NULL, NULL, argv, environ);
+    CuAssertIntEquals(tc, 0, r);
+
+    setenv("NETCF_SOCKET", sock, 1);
+    for (int i=0; i < 100 && ncf2 == NULL; i++) {
+        if (ncf_init_flags(&ncf2, root, NETCF_INIT_DAEMON) < 0)
+            usleep(50 * 1000);
+    }
+    if (ncf_init(&ncf3, root) == 0) {
+        r3 = ncf_set_exec_timeout(ncf3, 100);
+        ncf_close(ncf3);
+    }
+    unsetenv("NETCF_SOCKET");
+
+    if (ncf2 != NULL) {
+        nint = ncf_num_of_interfaces(ncf, NETCF_IFACE_INACTIVE);
+        nint2 = ncf_list_interfaces(ncf2, ARRAY_CARDINALITY(names), names,
+                                    NETCF_IFACE_INACTIVE);
+        for (int i=0; i < nint2 && i < ARRAY_CARDINALITY(names); i++)
+            free(names[i]);
+
+        nif = ncf_lookup_by_name(ncf, "br0");
+        nif2 = ncf_lookup_by_name(ncf2, "br0");
+        xml = nif != NULL ? ncf_if_xml_desc(nif) : NULL;
+        xml2 = nif2 != NULL ? ncf_if_xml_desc(nif2) : NULL;
+        ncf_if_free(nif);
+        ncf_if_free(nif2);
+
+        r = ncf_set_exec_timeout(ncf2, 100);
+        errcode = ncf_error(ncf2, NULL, NULL);
+        ncf_close(ncf2);
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    free(sock);
+
+    CuAssertPtrNotNull(tc, ncf2);
+    CuAssertIntEquals(tc, nint, nint2);
+    CuAssertPtrNotNull(tc, xml);
+    CuAssertStrEquals(tc, xml, xml2);
+    CuAssertIntEquals(tc, -1, r);
+    CuAssertIntEquals(tc, NETCF_EINVALIDOP, errcode);
+    CuAssertIntEquals(tc, 0, r3);
+    free(xml);
+    free(xml2);
+}
+
+/* NETCF_INIT_TRY_DAEMON works on the files when nobody listens on the
+ * socket */
+static void testTryDaemon(CuTest *tc) {
+    struct netcf *ncf2 = NULL;
+    char *sock = NULL;
+    FILE *fp;
+    int r;
+
+    r = asprintf(&sock, "%s/netcfd.sock", root);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    fp = fopen(sock, "w");
+    CuAssertPtrNotNull(tc, fp);
+    fclose(fp);
+
+    setenv("NETCF_SOCKET", sock, 1);
+    r = ncf_init_flags(&ncf2, root, NETCF_INIT_TRY_DAEMON);
+    unsetenv("NETCF_SOCKET");
+    CuAssertIntEquals(tc, 0, r);
+    CuAssertIntEquals(tc, 0, ncf_set_exec_timeout(ncf2, 100));
+    CuAssertIntEquals(tc, NETCF_NOERROR, ncf_error(ncf2, NULL, NULL));
+
+    ncf_close(ncf2);
+    unlink(sock);
+    free(sock);
+}
+
+static void testShm(CuTest *tc) {
+    struct netcf_shm *shm = NULL;
+    struct netcf_shm_entry entry, entries[64];
+    char *path = NULL;
+    unsigned int truncated = 1;
+    int n, r;
+
+    r = asprintf(&path, "%s/netcf-state", root);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    r = ncf_shm_publish(ncf, path);
+    CuAssertIntEquals(tc, 0, r);
+    shm = ncf_shm_open(path);
+    CuAssertPtrNotNull(tc, shm);
+
+    n = ncf_shm_list(shm, ARRAY_CARDINALITY(entries), entries, &truncated);
+    CuAssert(tc, "no interfaces published", n > 0);
+    CuAssertIntEquals(tc, 0, truncated);
+    for (int i=0; i < n && i < ARRAY_CARDINALITY(entries); i++) {
+        r = ncf_shm_lookup(shm, entries[i].name, &entry);
+        CuAssertIntEquals(tc, 0, r);
+        CuAssertIntEquals(tc, entries[i].ifindex, entry.ifindex);
+    }
+    CuAssertIntEquals(tc, -1, ncf_shm_lookup(shm, "nosuchif0", &entry));
+
+    /* Publishing again updates the table that readers already mapped */
+    r = ncf_shm_publish(ncf, path);
+    CuAssertIntEquals(tc, 0, r);
+    CuAssertIntEquals(tc, 0, ncf_shm_lookup(shm, "lo", &entry));
+    CuAssertStrEquals(tc, "lo", entry.name);
+
+    ncf_shm_close(shm);
+    free(path);
+}
+
+/* A publisher that died while writing a slot leaves it locked; readers
+ * fail instead of skipping it, and the next publisher unlocks it */
+static void testShmDeadPublisher(CuTest *tc) {
+    const size_t size = SHM_SLOTS_OFFSET + SHM_SLOTS * sizeof(struct shm_slot);
+    struct netcf *ncf2 = NULL;
+    struct netcf_shm *shm = NULL;
+    struct netcf_shm_entry entries[64];
+    struct shm_slot *slots;
+    char *path = NULL;
+    void *map;
+    int fd, n, r;
+
+    r = asprintf(&path, "%s/netcf-state", root);
+    CuAssert(tc, "asprintf failed", r >= 0);
+    r = ncf_init(&ncf2, root);
+    CuAssertIntEquals(tc, 0, r);
+    r = ncf_shm_publish(ncf2, path);
+    ncf_close(ncf2);
+    CuAssertIntEquals(tc, 0, r);
+
+    fd = open(path, O_RDWR);
+    CuAssert(tc, "failed to open table", fd >= 0);
+    map = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    CuAssert(tc, "failed to map table", map != MAP_FAILED);
+    slots = (struct shm_slot *) ((char *) map + SHM_SLOTS_OFFSET);
+    for (int i=0; i < SHM_SLOTS; i++) {
+        if (slots[i].used) {
+            slots[i].seq += 1;
+            break;
+        }
+    }
+    munmap(map, size);
+
+    shm = ncf_shm_open(path);
+    CuAssertPtrNotNull(tc, shm);
+    n = ncf_shm_list(shm, ARRAY_CARDINALITY(entries), entries, NULL);
+    CuAssertIntEquals(tc, -1, n);
+
+    r = ncf_shm_publish(ncf, path);
+    CuAssertIntEquals(tc, 0, r);
+    n = ncf_shm_list(shm, ARRAY_CARDINALITY(entries), entries, NULL);
+    CuAssert(tc, "no interfaces published", n > 0);
+
+    ncf_shm_close(shm);
+    free(path);
+}
+
+static void testStats(CuTest *tc) {
+    struct netcf_stat stats[NETCF_STAT_LAST];
+    struct netcf_if *nif;
+    char *xml;
+    int r;
+
+    r = ncf_get_stats(ncf, NULL, 0, NETCF_STATS_RESET);
+    CuAssertIntEquals(tc, NETCF_STAT_LAST, r);
+
+    nif = ncf_lookup_by_name(ncf, "br0");
+    CuAssertPtrNotNull(tc, nif);
+    xml = ncf_if_xml_desc(nif);
+    CuAssertPtrNotNull(tc, xml);
+    free(xml);
+    ncf_if_free(nif);
+
+    r = ncf_get_stats(ncf, stats, NETCF_STAT_LAST, 0);
+    CuAssertIntEquals(tc, NETCF_STAT_LAST, r);
+    CuAssert(tc, "API calls not counted", stats[NETCF_STAT_API].count >= 2);
+    CuAssert(tc, "no aug_match", stats[NETCF_STAT_AUG_MATCH].count > 0);
+    CuAssert(tc, "no XSLT", stats[NETCF_STAT_XSLT].count > 0);
+    for (int i=0; i < NETCF_STAT_LAST; i++) {
+        unsigned long long n = 0;
+
+        CuAssertPtrNotNull(tc, ncf_stat_name(i));
+        for (int j=0; j < NETCF_STAT_BUCKETS; j++)
+            n += stats[i].hist[j];
+        CuAssert(tc, "histogram does not add up", n == stats[i].count);
+        CuAssert(tc, "max exceeds total",
+                 stats[i].max_ns <= stats[i].total_ns);
+    }
+    CuAssertPtrEquals(tc, NULL, (void *) ncf_stat_name(NETCF_STAT_LAST));
+
+    r = ncf_get_stats(ncf, stats, NETCF_STAT_LAST, NETCF_STATS_RESET);
+    CuAssertIntEquals(tc, NETCF_STAT_LAST, r);
+    CuAssert(tc, "API calls not counted", stats[NETCF_STAT_API].count >= 2);
+    r = ncf_get_stats(ncf, stats, NETCF_STAT_LAST, 0);
+    for (int i=0; i < NETCF_STAT_LAST; i++)
+        CuAssert(tc, "reset left a count", stats[i].count == 0);
+}
+
+static void add_ifcfg(CuTest *tc, const char *name, const char *entries) {
+    char *path = NULL;
+    FILE *fp;
+
+    if (asprintf(&path, "%s/etc/sysconfig/network-scripts/ifcfg-%s",
+                 root, name) < 0)
+        die("asprintf failed");
+    fp = fopen(path, "w");
+    CuAssertPtrNotNull(tc, fp);
+    fprintf(fp, "DEVICE=%s\nONBOOT=yes\n%s", name, entries);
+    CuAssertIntEquals(tc, 0, fclose(fp));
+    free(path);
+}
+
+/* Write an ifcfg file for each interface of a topology */
+static void add_topology(CuTest *tc, int n, bool bridge) {
+    char eth[16], br[16], entries[64];
+
+    snprintf(eth, sizeof(eth), "eth%d", n);
+    snprintf(br, sizeof(br), "br%d", n);
+    if (bridge) {
+        add_ifcfg(tc, br, "TYPE=Bridge\nBOOTPROTO=dhcp\n");
+        snprintf(entries, sizeof(entries), "BRIDGE=%s\n", br);
+        add_ifcfg(tc, eth, entries);
+    } else {
+        add_ifcfg(tc, eth, "BOOTPROTO=none\n");
+    }
+}
+
+/* Count the calls netcf makes to list the interfaces in LIST, and to look
+ * up br100 and get its XML description in LOOKUP. Returns the number of
+ * interfaces */
+static int count_ops(CuTest *tc, struct opcount *list,
+                     struct opcount *lookup) {
+    struct netcf_if *nif;
+    char *xml;
+    int nint;
+
+    nint = opcount_list(tc, ncf, list);
+
+    opcount_reset();
+    nif = ncf_lookup_by_name(ncf, "br100");
+    CuAssertPtrNotNull(tc, nif);
+    xml = ncf_if_xml_desc(nif);
+    CuAssertPtrNotNull(tc, xml);
+    opcount_read(lookup);
+    free(xml);
+    ncf_if_free(nif);
+
+    return nint;
+}
+
+/* Listing interfaces must take a number of Augeas operations and system
+ * calls that is linear in the number of interfaces, and looking up one
+ * interface a number that does not depend on it */
+static void testOpCounts(CuTest *tc) {
+    struct opcount list_small, list_large, lookup_small, lookup_large;
+    int n_small, n_large;
+
+    opcount_add_topologies(tc, add_topology, 0, 8);
+    n_small = count_ops(tc, &list_small, &lookup_small);
+    opcount_add_topologies(tc, add_topology, 8, 64);
+    n_large = count_ops(tc, &list_large, &lookup_large);
+    CuAssertIntEquals(tc, n_small + 56, n_large);
+
+    CuAssert(tc, "aug_match not counted",
+             list_small.ops[OPCOUNT_AUG_MATCH] > 0);
+    CuAssertIntEquals(tc, 0, list_large.ops[OPCOUNT_AUG_SET]);
+    assert_ops_linear(tc, "listing", n_small, &list_small,
+                      n_large, &list_large);
+    assert_ops_constant(tc, "lookup", n_small, &lookup_small,
+                        n_large, &lookup_large);
+}
+
+struct trace {
+    int  depth;                           /* spans begun but not ended */
+    bool nested;                          /* every end matched a begin */
+    bool lookup;                          /* saw ncf_lookup_by_name */
+    bool match;                           /* saw a path expression */
+    bool xslt;                            /* saw redhat-get.xsl */
+    unsigned long long id[16];
+};
+
+static void trace_span(void *opaque, netcf_trace_event_t event,
+                       const struct netcf_span *span) {
+    struct trace *trace = opaque;
+    const char *attr = span->attr != NULL ? span->attr : "";
+
+    if (event == NETCF_TRACE_BEGIN) {
+        if (trace->depth < ARRAY_CARDINALITY(trace->id))
+            trace->id[trace->depth] = span->id;
+        trace->depth += 1;
+        if (span->kind == NETCF_STAT_API)
+            trace->lookup |= STREQ(attr, "ncf_lookup_by_name");
+        else if (span->kind == NETCF_STAT_AUG_MATCH)
+            trace->match |= (attr[0] == '/');
+        else if (span->kind == NETCF_STAT_XSLT)
+            trace->xslt |= STREQ(attr, "redhat-get.xsl");
+        return;
+    }
+    trace->depth -= 1;
+    if (trace->depth < 0 || span->end_ns < span->start_ns
+        || (trace->depth < ARRAY_CARDINALITY(trace->id)
+            && trace->id[trace->depth] != span->id))
+        trace->nested = false;
+}
+
+static void testTrace(CuTest *tc) {
+    struct trace trace = { .nested = true };
+    struct netcf_if *nif;
+    char *xml;
+    int r;
+
+    r = ncf_set_trace_callback(ncf, trace_span, &trace);
+    CuAssertIntEquals(tc, 0, r);
+    nif = ncf_lookup_by_name(ncf, "br0");
+    CuAssertPtrNotNull(tc, nif);
+    xml = ncf_if_xml_desc(nif);
+    CuAssertPtrNotNull(tc, xml);
+    free(xml);
+    ncf_if_free(nif);
+    r = ncf_set_trace_callback(ncf, NULL, NULL);
+    CuAssertIntEquals(tc, 0, r);
+
+    CuAssertIntEquals(tc, 0, trace.depth);
+    CuAssert(tc, "spans do not nest", trace.nested);
+    CuAssert(tc, "no span for the lookup", trace.lookup);
+    CuAssert(tc, "no span for aug_match", trace.match);
+    CuAssert(tc, "no span for the stylesheet", trace.xslt);
+}
+
+#ifdef HAVE_LIBPTHREAD
+#define NTHREADS 4
+
+/* Describe an interface and try to define a bad one on the shared handle,
+ * and check that each thread sees the error of its own calls */
+static void *query_thread(void *opaque) {
+    const char *bad = opaque;
+    int failures = 0;
+
+    for (int i=0; i < 100; i++) {
+        struct netcf_if *nif;
+        const char *details;
+        char *xml;
+
+        nif = ncf_lookup_by_name(ncf, "br0");
+        if (nif == NULL || ncf_error(ncf, NULL, NULL) != NETCF_NOERROR)
+            failures += 1;
+        xml = nif != NULL ? ncf_if_xml_desc(nif) : NULL;
+        if (xml == NULL || strstr(xml, "<bridge") == NULL)
+            failures += 1;
+        free(xml);
+        ncf_if_free(nif);
+
+        nif = ncf_lookup_by_name(ncf, bad);
+        if (nif != NULL)
+            failures += 1;
+        ncf_if_free(nif);
+        if (ncf_define(ncf, bad) != NULL
+            || ncf_error(ncf, NULL, &details) != NETCF_EXMLPARSER)
+            failures += 1;
+    }
+    return (void *) (long) failures;
+}
+
+static void testThreads(CuTest *tc) {
+    static const char *const bad[NTHREADS] =
+        { "<a", "<b", "<c", "<d" };
+    pthread_t threads[NTHREADS];
+
+    for (int i=0; i < NTHREADS; i++) {
+        int r = pthread_create(threads + i, NULL, query_thread,
+                               (void *) bad[i]);
+        CuAssertIntEquals(tc, 0, r);
+    }
+    for (int i=0; i < NTHREADS; i++) {
+        void *failures;
+        pthread_join(threads[i], &failures);
+        CuAssertIntEquals(tc, 0, (int) (long) failures);
+    }
+    CuAssertIntEquals(tc, 1, ncf->ref);
+}
+
+/* Closing a handle forgets the error this thread kept for it; a new
+ * handle, which may well get the same address, starts out clean */
+static void testErrorAfterClose(CuTest *tc) {
+    for (int i=0; i < 3; i++) {
+        struct netcf *ncf2 = NULL;
+        int r;
+
+        r = ncf_init(&ncf2, root);
+        CuAssertIntEquals(tc, 0, r);
+        CuAssertIntEquals(tc, NETCF_NOERROR, ncf_error(ncf2, NULL, NULL));
+        CuAssertPtrEquals(tc, NULL, ncf_define(ncf2, "<a"));
+        CuAssertIntEquals(tc, NETCF_EXMLPARSER, ncf_error(ncf2, NULL, NULL));
+        ncf_close(ncf2);
+    }
+}
+#endif
+
 static void testTransforms(CuTest *tc) {
     assert_transforms(tc, "bond");
     assert_transforms(tc, "bond-arp");
@@ -235,7 +1458,35 @@ int main(void) {
     SUITE_ADD_TEST(suite, testLookupByName);
     SUITE_ADD_TEST(suite, testLookupByNameDecoy);
     SUITE_ADD_TEST(suite, testLookupByMAC);
+    SUITE_ADD_TEST(suite, testXmlDescTo);
     SUITE_ADD_TEST(suite, testDefineUndefine);
+    SUITE_ADD_TEST(suite, testDefineValidationCache);
+    SUITE_ADD_TEST(suite, testNativeValidation);
+    SUITE_ADD_TEST(suite, testDefineMany);
+    SUITE_ADD_TEST(suite, testUndefineMany);
+    SUITE_ADD_TEST(suite, testLockedDefine);
+    SUITE_ADD_TEST(suite, testRedefineUnchanged);
+    SUITE_ADD_TEST(suite, testDurability);
+    SUITE_ADD_TEST(suite, testChangeTransaction);
+    SUITE_ADD_TEST(suite, testChangeRollbackList);
+    SUITE_ADD_TEST(suite, testChangeRollbackSameSize);
+    SUITE_ADD_TEST(suite, testChangeRollbackRestart);
+    SUITE_ADD_TEST(suite, testExecTimeout);
+    SUITE_ADD_TEST(suite, testExecKillsGroup);
+    SUITE_ADD_TEST(suite, testIfDownMany);
+    SUITE_ADD_TEST(suite, testIfDownAsync);
+    SUITE_ADD_TEST(suite, testIfDownAsyncQuiet);
+    SUITE_ADD_TEST(suite, testDaemon);
+    SUITE_ADD_TEST(suite, testTryDaemon);
+    SUITE_ADD_TEST(suite, testShm);
+    SUITE_ADD_TEST(suite, testShmDeadPublisher);
+    SUITE_ADD_TEST(suite, testStats);
+    SUITE_ADD_TEST(suite, testTrace);
+    SUITE_ADD_TEST(suite, testOpCounts);
+#ifdef HAVE_LIBPTHREAD
+    SUITE_ADD_TEST(suite, testThreads);
+    SUITE_ADD_TEST(suite, testErrorAfterClose);
+#endif
     SUITE_ADD_TEST(suite, testTransforms);
     SUITE_ADD_TEST(suite, testCorruptedSetup);
 
@@ -22,6 +22,7 @@
 
 #include <config.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <libxml/tree.h>
 
 #include "internal.h"
@@ -187,6 +188,45 @@ void run(CuTest *tc, const char *format, ...) {
     }
 }
 
+char *use_fake_program(CuTest *tc, const char *name, const char *format, ...) {
+    char *bin = NULL, *prog = NULL, *path = NULL, *old_path;
+    const char *cur = getenv("PATH");
+    size_t len;
+    va_list args;
+    FILE *fp;
+
+    if (asprintf(&bin, "%s/bin", root) < 0
+        || asprintf(&prog, "%s/%s", bin, name) < 0)
+        die("asprintf failed");
+    run(tc, "mkdir -p %s", bin);
+    fp = fopen(prog, "w");
+    CuAssertPtrNotNull(tc, fp);
+    fprintf(fp, "#!/bin/sh\n");
+    va_start(args, format);
+    vfprintf(fp, format, args);
+    va_end(args);
+    CuAssertIntEquals(tc, 0, fclose(fp));
+    CuAssertIntEquals(tc, 0, chmod(prog, 0755));
+
+    if (cur == NULL)
+        cur = "";
+    len = strlen(bin);
+    if (STREQLEN(cur, bin, len) && cur[len] == ':') {
+        old_path = strdup(cur + len + 1);
+    } else {
+        old_path = strdup(cur);
+        if (asprintf(&path, "%s:%s", bin, cur) < 0)
+            die("asprintf failed");
+        setenv("PATH", path, 1);
+    }
+    if (old_path == NULL)
+        die("strdup failed");
+    free(path);
+    free(prog);
+    free(bin);
+    return old_path;
+}
+
 void setup(CuTest *tc) {
     int r;
 
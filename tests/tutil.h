@@ -68,6 +68,12 @@ void assert_xml_equals(CuTest *tc, const char *fname,
  * exit with status 0 */
 void run(CuTest *tc, const char *format, ...);
 
+/* Install a shell script with the body formed by FORMAT as ROOT/bin/NAME,
+ * and put ROOT/bin first in PATH if it isn't there yet. Returns the PATH
+ * without ROOT/bin, for the caller to restore with setenv and free */
+char *use_fake_program(CuTest *tc, const char *name, const char *format, ...)
+    ATTRIBUTE_FORMAT(printf, 3, 4);
+
 /* Setup test directories */
 void setup(CuTest *tc);
 